@@ -0,0 +1,231 @@
+#include "autoscale.h"
+#include "cgroup.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+// cpu.stat 的一次採樣（時間單位皆為微秒）
+typedef struct {
+    unsigned long long usage_us;
+    unsigned long long nr_periods;
+    unsigned long long nr_throttled;
+    unsigned long long throttled_us;
+} cpu_sample_t;
+
+// 填入預設的自動調節配置（未啟用）
+void cpu_autoscale_defaults(cpu_autoscale_config_t* config) {
+    memset(config, 0, sizeof(*config));
+    config->target_ratio = 0.05;
+    config->interval_ms = 1000;
+    config->step_percent = 25;
+    config->down_intervals = 5;
+}
+
+// 解析 "FLOOR:CEILING" 格式的配額範圍（微秒）
+int cpu_autoscale_parse_range(const char* str, cpu_autoscale_config_t* config) {
+    int floor_us, ceiling_us;
+    if (sscanf(str, "%d:%d", &floor_us, &ceiling_us) != 2) {
+        return -1;
+    }
+    if (floor_us < 1000 || ceiling_us < floor_us) {
+        return -1;
+    }
+    config->floor_us = floor_us;
+    config->ceiling_us = ceiling_us;
+    config->enabled = 1;
+    return 0;
+}
+
+// 讀取 cpu.stat（v1 的 usage 來自 cpuacct.usage，單位為納秒）
+static int read_cpu_sample(int version, const char* cpu_path, cpu_sample_t* sample) {
+    char path[600];
+    char key[64];
+    unsigned long long value;
+
+    memset(sample, 0, sizeof(*sample));
+    snprintf(path, sizeof(path), "%s/cpu.stat", cpu_path);
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    while (fscanf(file, "%63s %llu", key, &value) == 2) {
+        if (strcmp(key, "usage_usec") == 0) sample->usage_us = value;
+        else if (strcmp(key, "nr_periods") == 0) sample->nr_periods = value;
+        else if (strcmp(key, "nr_throttled") == 0) sample->nr_throttled = value;
+        else if (strcmp(key, "throttled_usec") == 0) sample->throttled_us = value;
+        else if (strcmp(key, "throttled_time") == 0) sample->throttled_us = value / 1000;
+    }
+    fclose(file);
+
+    if (version == 1) {
+        char buffer[64];
+        if (read_cgroup_file(cpu_path, "cpuacct.usage", buffer, sizeof(buffer)) == 0) {
+            sample->usage_us = strtoull(buffer, NULL, 10) / 1000;
+        }
+    }
+    return 0;
+}
+
+// 讀取目前的配額與週期，不限制時配額返回 -1
+static int read_quota(int version, const char* cpu_path, long* quota, long* period) {
+    char buffer[64];
+
+    *quota = -1;
+    *period = 100000;
+    if (version == 2) {
+        if (read_cgroup_file(cpu_path, "cpu.max", buffer, sizeof(buffer)) != 0) {
+            return -1;
+        }
+        char* space = strchr(buffer, ' ');
+        if (space) *period = atol(space + 1);
+        if (strncmp(buffer, "max", 3) != 0) *quota = atol(buffer);
+        return 0;
+    }
+    if (read_cgroup_file(cpu_path, "cpu.cfs_period_us", buffer, sizeof(buffer)) == 0) {
+        *period = atol(buffer);
+    }
+    if (read_cgroup_file(cpu_path, "cpu.cfs_quota_us", buffer, sizeof(buffer)) != 0) {
+        return -1;
+    }
+    *quota = atol(buffer);
+    return 0;
+}
+
+// 寫入新的配額
+static int write_quota(int version, const char* cpu_path, long quota, long period) {
+    char buffer[64];
+    if (version == 2) {
+        snprintf(buffer, sizeof(buffer), "%ld %ld", quota, period);
+        return write_cgroup_file(cpu_path, "cpu.max", buffer);
+    }
+    snprintf(buffer, sizeof(buffer), "%ld", quota);
+    return write_cgroup_file(cpu_path, "cpu.cfs_quota_us", buffer);
+}
+
+// 記錄一次決策
+static void log_decision(FILE* log, const char* action, double ratio, double util,
+                         long old_quota, long new_quota, long period) {
+    if (!log) {
+        return;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    fprintf(log, "%lld.%03ld %-5s throttle_ratio=%.3f quota_util=%.3f cpu.max=%ld->%ld/%ld\n",
+            (long long)ts.tv_sec, ts.tv_nsec / 1000000, action, ratio, util, old_quota, new_quota, period);
+    fflush(log);
+}
+
+// 等待容器進程結束，最多等待 timeout_ms 毫秒
+// @return 1 已結束，0 超時，-1 失敗
+static int wait_child(pid_t pid, int pidfd, int timeout_ms, int* status) {
+    if (pidfd >= 0) {
+        struct pollfd pfd = {pidfd, POLLIN, 0};
+        if (poll(&pfd, 1, timeout_ms) == -1 && errno != EINTR) {
+            return -1;
+        }
+    } else {
+        struct timespec ts = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+        nanosleep(&ts, NULL);
+    }
+    pid_t ret = waitpid(pid, status, WNOHANG);
+    if (ret == -1) {
+        return -1;
+    }
+    return ret == pid ? 1 : 0;
+}
+
+// 在等待容器進程結束的同時運行 CPU 配額控制迴圈
+int cpu_autoscale_run(pid_t pid, const char* cgroup_name, const cpu_autoscale_config_t* config, int* status) {
+    int version = detect_cgroup_version();
+    char cpu_path[512];
+    long quota, period;
+    cpu_sample_t prev, cur;
+    int below = 0;
+
+    get_cgroup_path(version, "cpu", cgroup_name, cpu_path, sizeof(cpu_path));
+
+    FILE* log = config->log_path[0] ? fopen(config->log_path, "a") : NULL;
+
+    // pidfd 可在容器退出時立即喚醒 poll，否則退回定時輪詢
+    int pidfd = -1;
+#ifdef SYS_pidfd_open
+    pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+#endif
+
+    int controllable = version != 0 && read_quota(version, cpu_path, &quota, &period) == 0 &&
+                       read_cpu_sample(version, cpu_path, &prev) == 0;
+    if (controllable) {
+        // 先把目前配額收斂到 [floor, ceiling] 區間
+        long start = quota < 0 || quota > config->ceiling_us ? config->ceiling_us : quota;
+        if (start < config->floor_us) start = config->floor_us;
+        if (start != quota && write_quota(version, cpu_path, start, period) == 0) {
+            log_decision(log, "init", 0, 0, quota, start, period);
+            quota = start;
+        }
+        controllable = quota > 0;
+    }
+    if (!controllable && log) {
+        fprintf(log, "無法讀取 %s 的 cpu.stat / cpu.max，自動調節停用\n", cpu_path);
+        fflush(log);
+    }
+
+    int result = 0;
+    for (;;) {
+        int ret = wait_child(pid, pidfd, config->interval_ms, status);
+        if (ret != 0) {
+            result = ret == 1 ? 0 : -1;
+            break;
+        }
+        if (!controllable || read_cpu_sample(version, cpu_path, &cur) != 0) {
+            continue;
+        }
+
+        unsigned long long periods = cur.nr_periods - prev.nr_periods;
+        unsigned long long throttled = cur.nr_throttled - prev.nr_throttled;
+        unsigned long long usage = cur.usage_us - prev.usage_us;
+        prev = cur;
+
+        double ratio = periods ? (double)throttled / periods : 0;
+        double util = periods ? (double)usage / ((double)quota * periods) : 0;
+        long new_quota = quota;
+        const char* action = "hold";
+
+        if (ratio > config->target_ratio) {
+            // 節流過多：立即放大配額
+            below = 0;
+            if (quota < config->ceiling_us) {
+                new_quota = quota + quota * config->step_percent / 100;
+                if (new_quota < quota + 1000) new_quota = quota + 1000;
+                if (new_quota > config->ceiling_us) new_quota = config->ceiling_us;
+                action = "up";
+            }
+        } else if (ratio <= config->target_ratio / 2 && util < 0.5) {
+            // 低用量需持續多個間隔才縮小配額，避免來回振盪
+            if (++below >= config->down_intervals && quota > config->floor_us) {
+                new_quota = quota - quota * config->step_percent / 100;
+                if (new_quota < config->floor_us) new_quota = config->floor_us;
+                action = "down";
+                below = 0;
+            }
+        } else {
+            below = 0;
+        }
+
+        if (new_quota != quota && write_quota(version, cpu_path, new_quota, period) != 0) {
+            action = "fail";
+            new_quota = quota;
+        }
+        log_decision(log, action, ratio, util, quota, new_quota, period);
+        quota = new_quota;
+    }
+
+    if (pidfd >= 0) close(pidfd);
+    if (log) fclose(log);
+    return result;
+}
@@ -0,0 +1,44 @@
+#ifndef AUTOSCALE_H
+#define AUTOSCALE_H
+
+#include <sys/types.h>
+
+// CPU 配額自動調節配置
+typedef struct {
+    int enabled;               // 是否啟用
+    int floor_us;              // 配額下限 (微秒/週期)
+    int ceiling_us;            // 配額上限 (微秒/週期)
+    double target_ratio;       // 目標節流比例 (被節流的週期 / 總週期)
+    int interval_ms;           // 採樣間隔 (毫秒)
+    int step_percent;          // 每次調整的幅度 (%)
+    int down_intervals;        // 連續多少個間隔低於下調閾值才縮小配額（滯後）
+    char log_path[256];        // 決策日誌路徑
+} cpu_autoscale_config_t;
+
+/**
+ * 填入預設的自動調節配置（未啟用）
+ * @param config 輸出的配置
+ */
+void cpu_autoscale_defaults(cpu_autoscale_config_t* config);
+
+/**
+ * 解析 "FLOOR:CEILING" 格式的配額範圍（微秒）
+ * @param str 範圍字串
+ * @param config 輸出的配置（成功時同時設置 enabled）
+ * @return 0 成功，-1 格式錯誤
+ */
+int cpu_autoscale_parse_range(const char* str, cpu_autoscale_config_t* config);
+
+/**
+ * 在等待容器進程結束的同時運行 CPU 配額控制迴圈
+ * 每個採樣間隔讀取 cpu.stat 的 nr_periods / nr_throttled / usage_usec，
+ * 節流比例超過目標時放大 cpu.max，長期低用量時在滯後後縮小，並記錄每一次決策
+ * @param pid 容器 init 進程 ID
+ * @param cgroup_name cgroup 名稱
+ * @param config 自動調節配置
+ * @param status 輸出容器進程的退出狀態 (同 waitpid)
+ * @return 0 成功，-1 等待失敗
+ */
+int cpu_autoscale_run(pid_t pid, const char* cgroup_name, const cpu_autoscale_config_t* config, int* status);
+
+#endif // AUTOSCALE_H
@@ -0,0 +1,202 @@
+// CPU 帶寬控制基準測試：突發型請求負載在不同 CFS 週期 / 突發配額下的尾延遲
+//
+// 每種配置啟動一個容器（./main run --detach，閒置的 /bin/cat），再 fork 一個加入該容器 cgroup 的工作進程：
+//   每隔 INTERVAL 毫秒同時到達 N 個請求，每個請求消耗 W 微秒的 CPU 時間（以線程 CPU 時鐘計算，
+//   被節流的時間只會拉長牆鐘時間），依序處理並記錄「完成時間 - 到達時間」。
+// 平均用量遠低於配額，但單次突發超過一個週期的配額時，其餘請求要等到下一個週期才能繼續，
+// 尾延遲因此取決於週期長度與可累積的突發配額。
+// 配置：不限制 / 配額 Q + 週期 100ms / 相同比例 + 週期 10ms / 配額 Q + 週期 100ms + 突發 Q
+// 輸出每種配置的 p50 / p99 / 最大延遲，以及 cpu.stat 中被節流的週期數與時間。
+// 需要 root，並在專案根目錄運行（調用 ./main）。
+//
+// 用法: ./bench/bench_burst [每次突發的請求數] [每個請求的 CPU 微秒] [突發次數] [配額 us]
+
+#include "bench_common.h"
+#include "../state.h"
+#include "../cgroup.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define INTERVAL_MS 500
+
+// 一種 CPU 帶寬配置
+typedef struct {
+    const char* label;
+    int quota_us;              // -1 表示不限制
+    int period_us;
+    int burst_us;
+} bandwidth_config_t;
+
+// cpu.stat 中的節流統計
+typedef struct {
+    long long nr_throttled;
+    long long throttled_us;
+} throttle_stat_t;
+
+// 消耗指定的 CPU 時間
+static void burn_cpu(long us) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    do {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000L + (now.tv_nsec - start.tv_nsec) / 1000 < us);
+}
+
+static void read_throttle_stat(const char* cpu_path, int version, throttle_stat_t* stat) {
+    char path[600], key[64];
+    long long value;
+
+    memset(stat, 0, sizeof(*stat));
+    snprintf(path, sizeof(path), "%s/cpu.stat", cpu_path);
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return;
+    }
+    while (fscanf(fp, "%63s %lld", key, &value) == 2) {
+        if (strcmp(key, "nr_throttled") == 0) {
+            stat->nr_throttled = value;
+        } else if (version == 2 && strcmp(key, "throttled_usec") == 0) {
+            stat->throttled_us = value;
+        } else if (version == 1 && strcmp(key, "throttled_time") == 0) {
+            stat->throttled_us = value / 1000;
+        }
+    }
+    fclose(fp);
+}
+
+// 在容器的 cgroup 中運行突發負載，延遲（微秒）寫入共享的 latencies
+static int run_workload(const char* cgroup_name, int requests, int request_us, int bursts, double* latencies) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        return -1;
+    }
+    if (pid == 0) {
+        if (join_cgroup(getpid(), cgroup_name) != 0) {
+            _exit(1);
+        }
+        for (int b = 0; b < bursts; b++) {
+            // 先閒置一段時間，讓配額（及可累積的突發配額）恢復
+            sleep_ms(INTERVAL_MS);
+            double arrival = now_sec();
+            for (int i = 0; i < requests; i++) {
+                burn_cpu(request_us);
+                latencies[b * requests + i] = (now_sec() - arrival) * 1e6;
+            }
+        }
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+// 輸出按顯示寬度對齊的標籤（中文字元佔兩格）
+static void print_label(const char* label, int width) {
+    int used = 0;
+    for (const unsigned char* p = (const unsigned char*)label; *p; p++) {
+        if (*p < 0x80) {
+            used++;
+        } else if (*p >= 0xE0) {
+            used += 2;
+        } else if (*p >= 0xC0) {
+            used++;
+        }
+    }
+    printf("%s%*s", label, used < width ? width - used : 1, "");
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void bench_config(const bandwidth_config_t* config, int requests, int request_us, int bursts,
+                         int cgroup_version, double* latencies) {
+    char id[CONTAINER_ID_LEN + 1];
+    char cpu_path[512];
+    container_record_t record;
+    throttle_stat_t before, after;
+    int total = requests * bursts;
+
+    char quota[16], period[16], burst[16];
+    snprintf(quota, sizeof(quota), "%d", config->quota_us);
+    snprintf(period, sizeof(period), "%d", config->period_us);
+    snprintf(burst, sizeof(burst), "%d", config->burst_us);
+    const char* extra[] = {"--rootfs", "bind", "--cpu-quota", quota, "--cpu-period", period, "--cpu-burst", burst, NULL};
+    if (start_container(extra, id) != 0 || state_find(id, &record) != 0) {
+        print_label(config->label, 28);
+        printf("無法啟動容器（以 sudo 在專案根目錄運行？）\n");
+        return;
+    }
+    get_cgroup_path(cgroup_version, "cpu", record.cgroup_name, cpu_path, sizeof(cpu_path));
+    read_throttle_stat(cpu_path, cgroup_version, &before);
+    int result = run_workload(record.cgroup_name, requests, request_us, bursts, latencies);
+    read_throttle_stat(cpu_path, cgroup_version, &after);
+    stop_container(id);
+    if (result != 0) {
+        print_label(config->label, 28);
+        printf("無法加入容器的 cgroup\n");
+        return;
+    }
+
+    qsort(latencies, total, sizeof(double), compare_double);
+    print_label(config->label, 28);
+    printf("%9.1f %9.1f %9.1f %12lld %14.1f\n",
+           latencies[total / 2] / 1000, latencies[(int)(total * 0.99)] / 1000, latencies[total - 1] / 1000,
+           after.nr_throttled - before.nr_throttled, (after.throttled_us - before.throttled_us) / 1000.0);
+}
+
+int main(int argc, char* argv[]) {
+    int requests = argc > 1 ? atoi(argv[1]) : 40;
+    int request_us = argc > 2 ? atoi(argv[2]) : 1000;
+    int bursts = argc > 3 ? atoi(argv[3]) : 20;
+    int quota = argc > 4 ? atoi(argv[4]) : 20000;
+
+    if (requests < 1 || request_us < 1 || bursts < 1 || quota < 1000 || quota > 100000) {
+        fprintf(stderr, "用法: %s [每次突發的請求數] [每個請求的 CPU 微秒] [突發次數] [配額 us (1000-100000)]\n", argv[0]);
+        return 1;
+    }
+    if (access(MAIN_PATH, X_OK) != 0) {
+        fprintf(stderr, "錯誤: 找不到 %s，請在專案根目錄運行\n", MAIN_PATH);
+        return 1;
+    }
+
+    char labels[4][64];
+    snprintf(labels[0], sizeof(labels[0]), "不限制");
+    snprintf(labels[1], sizeof(labels[1]), "%d/100000", quota);
+    snprintf(labels[2], sizeof(labels[2]), "%d/10000", quota / 10);
+    snprintf(labels[3], sizeof(labels[3]), "%d/100000 突發 %d", quota, quota);
+    bandwidth_config_t configs[] = {
+        {labels[0], -1, CGROUP_DEFAULT_CPU_PERIOD_US, 0},
+        {labels[1], quota, 100000, 0},
+        {labels[2], quota / 10, 10000, 0},
+        {labels[3], quota, 100000, quota},
+    };
+
+    // 延遲陣列與工作進程共享
+    size_t size = sizeof(double) * requests * bursts;
+    double* latencies = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (latencies == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    int cgroup_version = detect_cgroup_version();
+    printf("每 %d ms 突發 %d 個請求，每個 %d us CPU（單次突發 %.1f ms，平均用量 %.1f%%），共 %d 次\n\n",
+           INTERVAL_MS, requests, request_us, requests * request_us / 1000.0,
+           requests * request_us / (INTERVAL_MS * 10.0), bursts);
+    print_label("配額/週期 (us)", 28);
+    printf("%9s %9s %9s %12s %14s\n", "p50 ms", "p99 ms", "max ms", "throttled", "throttled ms");
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        bench_config(&configs[i], requests, request_us, bursts, cgroup_version, latencies);
+    }
+    munmap(latencies, size);
+    return 0;
+}
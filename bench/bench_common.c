@@ -0,0 +1,87 @@
+#include "bench_common.h"
+#include "../state.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void sleep_ms(int ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+int start_container(const char* const* extra, char* id) {
+    const char* argv[32] = {MAIN_PATH, "run", "--detach"};
+    int argc = 3;
+    int out[2];
+
+    while (*extra && argc < 30) {
+        argv[argc++] = *extra++;
+    }
+    argv[argc++] = "/bin/cat";
+    argv[argc] = NULL;
+    if (pipe(out) == -1) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_RDWR);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        close(out[0]);
+        execv(MAIN_PATH, (char* const*)argv);
+        _exit(127);
+    }
+    close(out[1]);
+
+    // 只讀到 ID 那一行：runtime 在背景繼續運行，不等待管道關閉
+    // （讀端在前台進程退出後才關閉，避免它之後的輸出收到 SIGPIPE）
+    char buffer[1024];
+    size_t len = 0;
+    ssize_t n;
+    int found = -1;
+    while (found != 0 && len < sizeof(buffer) - 1 && (n = read(out[0], buffer + len, sizeof(buffer) - 1 - len)) > 0) {
+        len += n;
+        buffer[len] = '\0';
+        char* p = strstr(buffer, "容器 ID: ");
+        if (p && strchr(p, '\n')) {
+            p += strlen("容器 ID: ");
+            size_t id_len = strcspn(p, " \n");
+            if (id_len == CONTAINER_ID_LEN) {
+                memcpy(id, p, id_len);
+                id[id_len] = '\0';
+                found = 0;
+            }
+        }
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    close(out[0]);
+    // 取得 ID 即表示容器已創建（之後的失敗由 runtime 自行清理，記錄隨之消失）
+    return found;
+}
+
+void stop_container(const char* id) {
+    container_record_t record;
+    if (state_find(id, &record) != 0) {
+        return;
+    }
+    // PID 1 忽略 SIGTERM，直接以 SIGKILL 終止 init，runtime 隨後完成清理
+    if (record.pid > 0) {
+        kill(record.pid, SIGKILL);
+    }
+    double deadline = now_sec() + 10;
+    while (state_find(id, &record) == 0 && now_sec() < deadline) {
+        sleep_ms(20);
+    }
+}
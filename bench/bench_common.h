@@ -0,0 +1,34 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+// 需要啟動容器的基準測試共用的輔助函數（在專案根目錄運行，調用 ./main）
+
+#define MAIN_PATH "./main"
+
+/**
+ * 單調時鐘的目前時間
+ * @return 秒
+ */
+double now_sec(void);
+
+/**
+ * 睡眠指定的毫秒數
+ * @param ms 毫秒
+ */
+void sleep_ms(int ms);
+
+/**
+ * 以背景模式啟動一個運行 /bin/cat 的閒置容器（./main run --detach <extra...> /bin/cat）
+ * @param extra 附加的 run 選項（以 NULL 結尾），例如 {"--rootfs", "bind", "--memory", "64", NULL}
+ * @param id 輸出的容器 ID（至少 CONTAINER_ID_LEN + 1 位元組）
+ * @return 0 成功，-1 失敗
+ */
+int start_container(const char* const* extra, char* id);
+
+/**
+ * 以 SIGKILL 終止容器的 init，並等待 runtime 刪除其記錄（最多 10 秒）
+ * @param id 容器 ID
+ */
+void stop_container(const char* id);
+
+#endif // BENCH_COMMON_H
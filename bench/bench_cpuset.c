@@ -0,0 +1,154 @@
+// CPU 放置基準測試：比較「不綁定」與「依拓撲綁定」時的跨節點記憶體流量
+//
+// 每個工作進程模擬一個容器：分配一塊記憶體並反覆讀寫。
+// 綁定的一輪與 runtime 一樣以 cpuset_allocate 分配放置（記錄在共享狀態文件中，結束時釋放），
+// 所以同時反映分配器的選擇與 --cpuset 策略的效果。
+// 測試前後讀取 /sys/devices/system/node/node*/numastat，
+// 以 other_node / numa_miss 的增量衡量跨節點 (跨 socket) 的記憶體訪問。
+//
+// 用法: ./bench/bench_cpuset [工作進程數] [每個進程的記憶體 MB] [秒數] [策略 shared|exclusive[:N]]
+
+#include "../cpuset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+
+typedef struct {
+    unsigned long long numa_miss;
+    unsigned long long other_node;
+} numastat_t;
+
+// 匯總所有節點的 numastat
+static void read_numastat(numastat_t* stat) {
+    char path[256];
+    char key[64];
+    unsigned long long value;
+
+    memset(stat, 0, sizeof(*stat));
+    for (int node = 0; node < CPUSET_MAX_DOMAINS; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/numastat", node);
+        FILE* file = fopen(path, "r");
+        if (!file) {
+            continue;
+        }
+        while (fscanf(file, "%63s %llu", key, &value) == 2) {
+            if (strcmp(key, "numa_miss") == 0) stat->numa_miss += value;
+            else if (strcmp(key, "other_node") == 0) stat->other_node += value;
+        }
+        fclose(file);
+    }
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 工作負載：首次觸碰分配記憶體後反覆掃描，返回掃描的位元組數
+static double run_worker(size_t bytes, double seconds) {
+    volatile unsigned long* buf = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        return 0;
+    }
+    size_t words = bytes / sizeof(unsigned long);
+    for (size_t i = 0; i < words; i++) {
+        buf[i] = i;
+    }
+
+    double scanned = 0;
+    double end = now_sec() + seconds;
+    unsigned long sum = 0;
+    while (now_sec() < end) {
+        for (size_t i = 0; i < words; i += 8) {
+            sum += buf[i];
+            buf[i] = sum;
+        }
+        scanned += bytes;
+    }
+    munmap((void*)buf, bytes);
+    return scanned;
+}
+
+// 執行一輪測試，request 不為 NULL 時每個工作進程先向分配器取得放置並綁定 CPU
+static void run_round(const char* name, const cpuset_request_t* request, int workers, size_t bytes, double seconds) {
+    int pipes[2];
+    numastat_t before, after;
+
+    if (pipe(pipes) == -1) {
+        perror("pipe");
+        return;
+    }
+
+    read_numastat(&before);
+    for (int w = 0; w < workers; w++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(pipes[0]);
+            char id[64];
+            cpuset_placement_t placement = {.domain = -1};
+            snprintf(id, sizeof(id), "bench-%d", (int)getpid());
+            if (request && cpuset_allocate(id, request, &placement) == 0 && placement.domain >= 0) {
+                cpu_set_t cpus;
+                if (cpuset_parse_list(placement.cpus, &cpus) == 0) {
+                    sched_setaffinity(0, sizeof(cpus), &cpus);
+                }
+                fprintf(stderr, "  工作進程 %d: 域 %d cpus=%s mems=%s\n", w, placement.domain, placement.cpus, placement.mems);
+            } else if (request) {
+                fprintf(stderr, "  工作進程 %d: 未綁定\n", w);
+            }
+            double scanned = run_worker(bytes, seconds);
+            if (placement.domain >= 0) {
+                cpuset_release(id);
+            }
+            if (write(pipes[1], &scanned, sizeof(scanned)) != sizeof(scanned)) {
+                _exit(1);
+            }
+            _exit(0);
+        }
+    }
+    close(pipes[1]);
+
+    double total = 0, scanned;
+    while (read(pipes[0], &scanned, sizeof(scanned)) == sizeof(scanned)) {
+        total += scanned;
+    }
+    close(pipes[0]);
+    while (wait(NULL) > 0) {
+    }
+    read_numastat(&after);
+
+    printf("%-10s  吞吐量: %8.1f MB/s  other_node: %10llu  numa_miss: %10llu\n",
+           name, total / seconds / (1024 * 1024),
+           after.other_node - before.other_node,
+           after.numa_miss - before.numa_miss);
+}
+
+int main(int argc, char* argv[]) {
+    int workers = argc > 1 ? atoi(argv[1]) : 4;
+    size_t mb = argc > 2 ? (size_t)atol(argv[2]) : 256;
+    double seconds = argc > 3 ? atof(argv[3]) : 5;
+    const char* policy = argc > 4 ? argv[4] : "shared";
+    cpuset_request_t request = {CPUSET_POLICY_SHARED, CPUSET_DOMAIN_NODE, 0};
+    cpuset_topology_t topo;
+
+    if (cpuset_parse_policy(policy, &request) != 0 || request.policy == CPUSET_POLICY_NONE) {
+        fprintf(stderr, "無效的放置策略: %s（可用 shared 或 exclusive[:N]）\n", policy);
+        return 1;
+    }
+
+    if (cpuset_read_topology(CPUSET_DOMAIN_NODE, &topo) == 0) {
+        printf("NUMA 節點數: %d\n", topo.domain_count);
+    }
+    printf("工作進程: %d, 每進程記憶體: %zu MB, 時間: %.1f 秒, 策略: %s\n\n", workers, mb, seconds, policy);
+
+    run_round("floating", NULL, workers, mb * 1024 * 1024, seconds);
+    run_round("pinned", &request, workers, mb * 1024 * 1024, seconds);
+    return 0;
+}
@@ -0,0 +1,315 @@
+// 容器密度基準測試：每種 rootfs 模式下每個閒置容器在主機上的邊際記憶體成本
+//
+// 對每種模式（bind / copy / overlay，以及每個 --image 指定的鏡像）依序：
+//   1. 清空頁快取（sync + drop_caches，可用 --no-drop-caches 關閉），記錄 slabinfo 與 MemAvailable
+//   2. 以 ./main run --detach 啟動 N 個運行 /bin/cat 的閒置容器
+//   3. 統計每個容器：
+//        容器進程 PSS     容器 cgroup 中所有進程 smaps_rollup 的 Pss 之和
+//        runtime PSS      管理該容器的 runtime 及其輔助進程（監控、終端轉發、/proc 服務等）
+//        頁快取           容器 cgroup memory.stat 的 file（計入該容器的頁快取）
+//        cgroup slab      容器 cgroup memory.stat 的 slab
+//   4. 主機層面：dentry 與各 inode slab 的增長、MemAvailable 的下降，除以 N 得到每容器的邊際成本，
+//      再以開始前的 MemAvailable 估算一台主機能容納的容器數
+//   5. 終止所有容器並等待 runtime 清理完畢
+// 需要 root，並在專案根目錄運行（調用 ./main）。
+//
+// 用法: ./bench/bench_density [容器數] [--image NAME]... [--no-drop-caches]
+
+#include "bench_common.h"
+#include "../state.h"
+#include "../cgroup.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define MAX_CONTAINERS 512
+#define MAX_MODES 16
+#define MAX_TREE 256
+#define SETTLE_SEC 2
+
+// 一次測量的結果（位元組）
+typedef struct {
+    double container_pss;
+    double runtime_pss;
+    double file;
+    double cgroup_slab;
+} footprint_t;
+
+// 主機層面的快照
+typedef struct {
+    long long dentry;          // dentry slab 佔用
+    long long inode;           // 所有 *inode* slab 佔用
+    long long available;       // MemAvailable
+} host_snapshot_t;
+
+static void drop_caches(void) {
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (fd != -1) {
+        if (write(fd, "3", 1) != 1) {
+            perror("drop_caches");
+        }
+        close(fd);
+    }
+}
+
+static void take_snapshot(host_snapshot_t* snap) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    char line[512];
+
+    memset(snap, 0, sizeof(*snap));
+    // slabinfo: name active_objs num_objs objsize objperslab pagesperslab : tunables ... : slabdata active num shared
+    FILE* fp = fopen("/proc/slabinfo", "r");
+    if (fp) {
+        while (fgets(line, sizeof(line), fp)) {
+            char name[64];
+            long pages_per_slab, num_slabs;
+            char* slabdata = strstr(line, "slabdata");
+            if (line[0] == '#' || !slabdata ||
+                sscanf(line, "%63s %*d %*d %*d %*d %ld", name, &pages_per_slab) != 2 ||
+                sscanf(slabdata, "slabdata %*d %ld", &num_slabs) != 1) {
+                continue;
+            }
+            long long bytes = (long long)num_slabs * pages_per_slab * page_size;
+            if (strcmp(name, "dentry") == 0) {
+                snap->dentry += bytes;
+            } else if (strstr(name, "inode")) {
+                snap->inode += bytes;
+            }
+        }
+        fclose(fp);
+    }
+
+    fp = fopen("/proc/meminfo", "r");
+    if (fp) {
+        long long kb;
+        while (fgets(line, sizeof(line), fp)) {
+            if (sscanf(line, "MemAvailable: %lld kB", &kb) == 1) {
+                snap->available = kb * 1024;
+                break;
+            }
+        }
+        fclose(fp);
+    }
+}
+
+// 讀取進程的 PSS（位元組），進程已退出時為 0
+static long long read_pss(pid_t pid) {
+    char path[64], line[256];
+    long long kb = 0;
+    snprintf(path, sizeof(path), "/proc/%d/smaps_rollup", pid);
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "Pss: %lld kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(fp);
+    return kb * 1024;
+}
+
+// 進程是否屬於指定的 cgroup
+static int in_cgroup(pid_t pid, const char* cgroup_name) {
+    char path[64], line[512];
+    int found = 0;
+    snprintf(path, sizeof(path), "/proc/%d/cgroup", pid);
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return 0;
+    }
+    while (!found && fgets(line, sizeof(line), fp)) {
+        found = strstr(line, cgroup_name) != NULL;
+    }
+    fclose(fp);
+    return found;
+}
+
+// 收集 pid 及其所有子孫進程
+static int collect_tree(pid_t pid, pid_t* pids, int count) {
+    char path[64];
+    if (count >= MAX_TREE) {
+        return count;
+    }
+    pids[count++] = pid;
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/children", pid, pid);
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return count;
+    }
+    int child;
+    pid_t children[MAX_TREE];
+    int child_count = 0;
+    while (child_count < MAX_TREE && fscanf(fp, "%d", &child) == 1) {
+        children[child_count++] = child;
+    }
+    fclose(fp);
+    for (int i = 0; i < child_count; i++) {
+        count = collect_tree(children[i], pids, count);
+    }
+    return count;
+}
+
+// 從 memory.stat 讀取一項（位元組）
+static long long read_memory_stat(const char* cgroup_path, const char* key) {
+    char path[512], line[256];
+    long long value = 0;
+    size_t key_len = strlen(key);
+    snprintf(path, sizeof(path), "%s/memory.stat", cgroup_path);
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, key, key_len) == 0 && line[key_len] == ' ') {
+            value = atoll(line + key_len + 1);
+            break;
+        }
+    }
+    fclose(fp);
+    return value;
+}
+
+static void measure(const container_record_t* record, int cgroup_version, footprint_t* fp) {
+    pid_t pids[MAX_TREE];
+    int count = collect_tree(record->runtime_pid, pids, 0);
+    for (int i = 0; i < count; i++) {
+        long long pss = read_pss(pids[i]);
+        if (in_cgroup(pids[i], record->cgroup_name)) {
+            fp->container_pss += pss;
+        } else {
+            fp->runtime_pss += pss;
+        }
+    }
+
+    char cgroup_path[512];
+    get_cgroup_path(cgroup_version, "memory", record->cgroup_name, cgroup_path, sizeof(cgroup_path));
+    if (cgroup_version == 2) {
+        fp->file += read_memory_stat(cgroup_path, "file");
+        fp->cgroup_slab += read_memory_stat(cgroup_path, "slab");
+    } else {
+        // v1 的 memory.stat 沒有 slab，以內核記憶體用量代替
+        char buffer[32];
+        fp->file += read_memory_stat(cgroup_path, "cache");
+        if (read_cgroup_file(cgroup_path, "memory.kmem.usage_in_bytes", buffer, sizeof(buffer)) == 0) {
+            fp->cgroup_slab += atoll(buffer);
+        }
+    }
+}
+
+// 輸出一行，標籤按顯示寬度對齊（中文字元佔兩格）
+static void print_row(const char* label, double value, const char* format) {
+    int width = 0;
+    for (const unsigned char* p = (const unsigned char*)label; *p; p++) {
+        if (*p < 0x80) {
+            width++;
+        } else if (*p >= 0xE0) {
+            width += 2;
+        } else if (*p >= 0xC0) {
+            width++;
+        }
+    }
+    printf("  %s%*s", label, width < 20 ? 20 - width : 1, "");
+    printf(format, value);
+    printf("\n");
+}
+
+static void bench_mode(const char* mode, int count, int drop, int cgroup_version) {
+    static char ids[MAX_CONTAINERS][CONTAINER_ID_LEN + 1];
+    host_snapshot_t before, after;
+    footprint_t total = {0, 0, 0, 0};
+    int started = 0, measured = 0;
+
+    if (drop) {
+        drop_caches();
+        // 等待上一種模式的清理與 RCU 延遲釋放完成，避免 slab 增長被抵消
+        sleep(1);
+    }
+    take_snapshot(&before);
+
+    // "image:NAME" 以 --image 啟動，其餘為 --rootfs 模式
+    const char* extra[] = {"--rootfs", mode, NULL};
+    if (strncmp(mode, "image:", 6) == 0) {
+        extra[0] = "--image";
+        extra[1] = mode + 6;
+    }
+    double start = now_sec();
+    for (int i = 0; i < count; i++) {
+        if (start_container(extra, ids[started]) == 0) {
+            started++;
+        }
+    }
+    double elapsed = now_sec() - start;
+    sleep(SETTLE_SEC);
+    take_snapshot(&after);
+
+    for (int i = 0; i < started; i++) {
+        container_record_t record;
+        if (state_find(ids[i], &record) == 0 && state_is_alive(&record)) {
+            measure(&record, cgroup_version, &total);
+            measured++;
+        }
+    }
+    for (int i = 0; i < started; i++) {
+        stop_container(ids[i]);
+    }
+
+    printf("\n[%s] 啟動 %d / %d 個容器，耗時 %.2f 秒\n", mode, started, count, elapsed);
+    if (measured == 0) {
+        printf("  沒有可測量的容器（以 sudo 在專案根目錄運行？）\n");
+        return;
+    }
+    double mb = 1024.0 * 1024.0;
+    double marginal = (double)(before.available - after.available) / started;
+    printf("  每容器平均:\n");
+    print_row("容器進程 PSS", total.container_pss / measured / mb, "%10.2f MB");
+    print_row("runtime PSS", total.runtime_pss / measured / mb, "%10.2f MB");
+    print_row("頁快取 (cgroup)", total.file / measured / mb, "%10.2f MB");
+    print_row("內核記憶體 (cgroup)", total.cgroup_slab / measured / mb, "%10.2f MB");
+    print_row("dentry slab 增長", (double)(after.dentry - before.dentry) / started / 1024, "%10.2f KB");
+    print_row("inode slab 增長", (double)(after.inode - before.inode) / started / 1024, "%10.2f KB");
+    print_row("MemAvailable 下降", marginal / mb, "%10.2f MB");
+    if (marginal > 0) {
+        print_row("估計可容納", before.available / marginal, "%10.0f 個");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int count = 10;
+    int drop = 1;
+    char modes[MAX_MODES][160] = {"bind", "copy", "overlay"};
+    int mode_count = 3;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-drop-caches") == 0) {
+            drop = 0;
+        } else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+            if (mode_count < MAX_MODES) {
+                snprintf(modes[mode_count++], sizeof(modes[0]), "image:%s", argv[++i]);
+            }
+        } else if (atoi(argv[i]) > 0) {
+            count = atoi(argv[i]);
+        }
+    }
+    if (count > MAX_CONTAINERS) {
+        count = MAX_CONTAINERS;
+    }
+    if (access(MAIN_PATH, X_OK) != 0) {
+        fprintf(stderr, "錯誤: 找不到 %s，請在專案根目錄運行\n", MAIN_PATH);
+        return 1;
+    }
+
+    int cgroup_version = detect_cgroup_version();
+    printf("每種模式啟動 %d 個閒置容器 (/bin/cat)%s\n", count, drop ? "，每種模式前清空頁快取" : "");
+    for (int i = 0; i < mode_count; i++) {
+        bench_mode(modes[i], count, drop, cgroup_version);
+    }
+    return 0;
+}
@@ -0,0 +1,548 @@
+// 資源限制與命名空間開銷基準測試：壓力負載下每項 cgroup 限制是否真的生效，以及在容器內運行的額外開銷
+//
+// 每項測試啟動一個帶指定限制的容器（./main run --detach，閒置的 /bin/cat），再 fork 一個工作進程：
+// 加入容器的 cgroup，以 pidfd 加入容器的命名空間並 chroot 到其根目錄（與 ./main exec 相同），
+// 在容器的 PID 命名空間中 fork 出負載進程。
+//   CPU     單線程忙等，實際 CPU 使用率與 cpu_quota_us / 週期比較
+//   記憶體  每次分配並寫入 1 MB，記錄被 OOM 終止時已寫入的量與 cgroup 的峰值用量，與 memory_limit_mb 比較
+//   進程數  不斷 fork 直到失敗，記錄失敗時 cgroup 的 pids.current 與錯誤碼，與 pids_max 比較
+//   磁碟    以 O_DIRECT 寫入容器的 /tmp 並 fsync，比較主機、容器不限制與 --io-max wbps 限制時的吞吐量
+//   開銷    getpid / open+close / stat / fork+wait 在主機與容器內的每次耗時
+// 需要 root，並在專案根目錄運行（調用 ./main）。
+//
+// 用法: ./bench/bench_limits [CPU 秒數] [記憶體 MB] [進程數] [寫入 MB] [寫入限速 MB/s]
+
+#include "bench_common.h"
+#include "../state.h"
+#include "../cgroup.h"
+#include "../namespace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <sys/wait.h>
+
+#define MB (1024 * 1024)
+#define MAX_FORKS 4096
+#define OP_COUNT 4
+
+// 工作進程與基準測試進程共享的結果（位於 MAP_SHARED 映射中）
+typedef struct {
+    volatile int status;       // 負載進程的 wait 狀態（由容器內的中間進程填寫）
+    volatile int ready;        // 負載已到達測量點，等待讀取 cgroup 狀態
+    volatile int release;      // 已讀取完畢，負載可以收尾
+    volatile int error;        // 負載遇到的 errno
+    volatile long long count;  // 計數（已寫入的 MB、成功 fork 的次數）
+    volatile double value;     // 測量值（CPU 使用率、吞吐量）
+    volatile double ops[OP_COUNT]; // 每種系統調用的耗時 (ns)
+} shared_t;
+
+typedef void (*workload_fn)(shared_t* shared, long arg);
+
+static const char* op_names[OP_COUNT] = {"getpid", "open+close", "stat", "fork+wait"};
+
+static double cpu_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 在容器內運行負載：加入 cgroup 與命名空間後，在容器的 PID 命名空間中 fork 出負載進程
+// 返回負載進程的 wait 狀態，無法進入容器時返回 -1
+static int run_in_container(const container_record_t* record, workload_fn fn, long arg, shared_t* shared) {
+    memset((void*)shared, 0, sizeof(*shared));
+    pid_t pid = fork();
+    if (pid == -1) {
+        return -1;
+    }
+    if (pid == 0) {
+        char path[64];
+        int pidfd = (int)syscall(SYS_pidfd_open, record->pid, 0);
+        snprintf(path, sizeof(path), "/proc/%d/root", record->pid);
+        int root_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (pidfd == -1 || root_fd == -1 || join_cgroup(getpid(), record->cgroup_name) != 0 ||
+            enter_container_namespaces(pidfd, root_fd) != 0) {
+            _exit(1);
+        }
+        pid_t child = fork();
+        if (child == 0) {
+            fn(shared, arg);
+            _exit(0);
+        }
+        int status;
+        waitpid(child, &status, 0);
+        shared->status = status;
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    // v2 的 memory.oom.group 會連同中間進程一起終止，這時以中間進程的狀態代表負載
+    if (WIFSIGNALED(status)) {
+        return status;
+    }
+    return WEXITSTATUS(status) == 0 ? shared->status : -1;
+}
+
+// 在主機上（不在任何容器的 cgroup 或命名空間中）運行負載，作為比較基準
+static int run_on_host(workload_fn fn, long arg, shared_t* shared) {
+    memset((void*)shared, 0, sizeof(*shared));
+    pid_t pid = fork();
+    if (pid == -1) {
+        return -1;
+    }
+    if (pid == 0) {
+        fn(shared, arg);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return status;
+}
+
+// 單線程忙等 arg 毫秒，記錄實際取得的 CPU 百分比
+static void cpu_spinner(shared_t* shared, long arg) {
+    double start = now_sec(), start_cpu = cpu_sec();
+    double end = start + arg / 1000.0;
+    while (now_sec() < end) {
+        // 忙等
+    }
+    shared->value = (cpu_sec() - start_cpu) / (now_sec() - start) * 100;
+}
+
+// 每次分配並寫入 1 MB，直到被 OOM 終止或達到 arg MB
+static void memory_ramp(shared_t* shared, long arg) {
+    for (long i = 0; i < arg; i++) {
+        char* chunk = malloc(MB);
+        if (!chunk) {
+            shared->error = ENOMEM;
+            return;
+        }
+        memset(chunk, 1, MB);
+        shared->count = i + 1;
+    }
+}
+
+// 不斷 fork 直到失敗（最多 arg 次），等基準測試進程讀取 pids.current 後終止所有子進程
+static void fork_loop(shared_t* shared, long arg) {
+    static pid_t children[MAX_FORKS];
+    long forked = 0;
+
+    while (forked < arg && forked < MAX_FORKS) {
+        pid_t pid = fork();
+        if (pid == -1) {
+            shared->error = errno;
+            break;
+        }
+        if (pid == 0) {
+            pause();
+            _exit(0);
+        }
+        children[forked++] = pid;
+    }
+    shared->count = forked;
+    shared->ready = 1;
+    while (!shared->release) {
+        sleep_ms(10);
+    }
+    for (long i = 0; i < forked; i++) {
+        kill(children[i], SIGKILL);
+        waitpid(children[i], NULL, 0);
+    }
+}
+
+// 以 O_DIRECT 寫入 arg MB 到 /tmp 並 fsync，記錄吞吐量（文件系統不支援 O_DIRECT 時改用普通寫入）
+static void disk_writer(shared_t* shared, long arg) {
+    char path[64];
+    void* buffer;
+
+    snprintf(path, sizeof(path), "/tmp/bench_limits.%d", getpid());
+    if (posix_memalign(&buffer, 4096, MB) != 0) {
+        shared->error = ENOMEM;
+        return;
+    }
+    memset(buffer, 0xab, MB);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0600);
+    if (fd == -1 && errno == EINVAL) {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    }
+    if (fd == -1) {
+        shared->error = errno;
+        return;
+    }
+    double start = now_sec();
+    for (long i = 0; i < arg; i++) {
+        if (write(fd, buffer, MB) != MB) {
+            shared->error = errno;
+            break;
+        }
+    }
+    fsync(fd);
+    shared->value = arg / (now_sec() - start);
+    close(fd);
+    unlink(path);
+    free(buffer);
+}
+
+// 每種系統調用重複 arg 次（fork+wait 為 arg / 100 次），記錄每次的平均耗時
+static void syscall_ops(shared_t* shared, long arg) {
+    struct stat st;
+    double start;
+
+    start = now_sec();
+    for (long i = 0; i < arg; i++) {
+        syscall(SYS_getpid);
+    }
+    shared->ops[0] = (now_sec() - start) * 1e9 / arg;
+
+    start = now_sec();
+    for (long i = 0; i < arg; i++) {
+        int fd = open("/etc/passwd", O_RDONLY);
+        if (fd == -1) {
+            shared->error = errno;
+            return;
+        }
+        close(fd);
+    }
+    shared->ops[1] = (now_sec() - start) * 1e9 / arg;
+
+    start = now_sec();
+    for (long i = 0; i < arg; i++) {
+        stat("/etc/passwd", &st);
+    }
+    shared->ops[2] = (now_sec() - start) * 1e9 / arg;
+
+    long forks = arg / 100 > 0 ? arg / 100 : 1;
+    start = now_sec();
+    for (long i = 0; i < forks; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(0);
+        }
+        waitpid(pid, NULL, 0);
+    }
+    shared->ops[3] = (now_sec() - start) * 1e9 / forks;
+}
+
+// 字串的顯示寬度（中文字元佔兩格）
+static int display_width(const char* text) {
+    int used = 0;
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        if (*p < 0x80) {
+            used++;
+        } else if (*p >= 0xE0) {
+            used += 2;
+        } else if (*p >= 0xC0) {
+            used++;
+        }
+    }
+    return used;
+}
+
+// 輸出按顯示寬度左對齊的標籤
+static void print_label(const char* label, int width) {
+    int used = display_width(label);
+    printf("%s%*s", label, used < width ? width - used : 1, "");
+}
+
+// 輸出按顯示寬度右對齊的一格
+static void print_cell(const char* text, int width) {
+    int used = display_width(text);
+    printf("%*s%s", used < width ? width - used : 0, "", text);
+}
+
+// 輸出表頭，列之間以一個空格分隔；columns 以 NULL 結尾，寬度與之後的數值列一致
+static void print_header(const char* first, const char* const* columns, const int* widths) {
+    print_label(first, 22);
+    for (int i = 0; columns[i]; i++) {
+        if (i > 0) {
+            printf(" ");
+        }
+        print_cell(columns[i], widths[i]);
+    }
+    printf("\n");
+}
+
+// 輸出限制是否生效（結果列）
+static void print_verdict(int enforced) {
+    printf(" ");
+    print_cell(enforced ? "生效" : "未生效", 8);
+    printf("\n");
+}
+
+// 啟動容器並取得其記錄，失敗時輸出原因
+static int start_and_find(const char* label, const char* const* extra, char* id, container_record_t* record) {
+    if (start_container(extra, id) != 0 || state_find(id, record) != 0) {
+        print_label(label, 22);
+        printf("無法啟動容器（以 sudo 在專案根目錄運行？）\n");
+        return -1;
+    }
+    return 0;
+}
+
+static long long read_cgroup_number(int version, const char* controller, const char* cgroup_name, const char* file) {
+    char path[512], buffer[64];
+    get_cgroup_path(version, controller, cgroup_name, path, sizeof(path));
+    if (read_cgroup_file(path, file, buffer, sizeof(buffer)) != 0) {
+        return -1;
+    }
+    return atoll(buffer);
+}
+
+static void bench_cpu(int duration_ms, shared_t* shared) {
+    static const int quotas[] = {-1, 20000, 50000, 80000};
+    char id[CONTAINER_ID_LEN + 1], quota[16], label[32];
+    container_record_t record;
+
+    printf("== CPU 配額（單線程忙等 %d ms，週期 %d us）==\n", duration_ms, CGROUP_DEFAULT_CPU_PERIOD_US);
+    print_header("配額", (const char*[]){"目標 %", "實際 %", "結果", NULL}, (const int[]){8, 8, 8});
+    for (size_t i = 0; i < sizeof(quotas) / sizeof(quotas[0]); i++) {
+        snprintf(quota, sizeof(quota), "%d", quotas[i]);
+        if (quotas[i] > 0) {
+            snprintf(label, sizeof(label), "%d us", quotas[i]);
+        } else {
+            snprintf(label, sizeof(label), "不限制");
+        }
+        const char* extra[] = {"--rootfs", "bind", "--cpu-quota", quota, NULL};
+        if (start_and_find(label, extra, id, &record) != 0) {
+            continue;
+        }
+        int status = run_in_container(&record, cpu_spinner, duration_ms, shared);
+        stop_container(id);
+        print_label(label, 22);
+        if (status == -1 || !WIFEXITED(status)) {
+            printf("無法在容器內運行負載\n");
+            continue;
+        }
+        if (quotas[i] > 0) {
+            double target = quotas[i] * 100.0 / CGROUP_DEFAULT_CPU_PERIOD_US;
+            // 單線程最多使用一個 CPU；允許 10% 的相對誤差
+            printf("%8.1f %8.1f", target, shared->value);
+            print_verdict(shared->value <= target * 1.1);
+        } else {
+            printf("%8s %8.1f\n", "-", shared->value);
+        }
+    }
+    printf("\n");
+}
+
+static void bench_memory(long limit_mb, int version, shared_t* shared) {
+    char id[CONTAINER_ID_LEN + 1], memory[16];
+    container_record_t record;
+
+    printf("== 記憶體上限（每次寫入 1 MB，直到被終止或達到上限的 4 倍）==\n");
+    print_header("上限", (const char*[]){"已寫入 MB", "峰值 MB", "終止信號", "結果", NULL}, (const int[]){12, 12, 14, 8});
+    snprintf(memory, sizeof(memory), "%ld", limit_mb);
+    const char* extra[] = {"--rootfs", "bind", "--memory", memory, NULL};
+    char label[32];
+    snprintf(label, sizeof(label), "%ld MB", limit_mb);
+    if (start_and_find(label, extra, id, &record) != 0) {
+        printf("\n");
+        return;
+    }
+    int status = run_in_container(&record, memory_ramp, limit_mb * 4, shared);
+    // 峰值在 v2 為 memory.peak（Linux 5.19 起），v1 為 memory.max_usage_in_bytes
+    long long peak = read_cgroup_number(version, "memory", record.cgroup_name,
+                                        version == 2 ? "memory.peak" : "memory.max_usage_in_bytes");
+    stop_container(id);
+    print_label(label, 22);
+    if (status == -1) {
+        printf("無法在容器內運行負載\n\n");
+        return;
+    }
+    int killed = WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL;
+    printf("%12lld ", shared->count);
+    if (peak >= 0) {
+        printf("%12.1f ", peak / (double)MB);
+    } else {
+        printf("%12s ", "-");
+    }
+    print_cell(killed ? "SIGKILL (OOM)" : "無", 14);
+    print_verdict(killed && shared->count <= limit_mb);
+    printf("\n");
+}
+
+static void bench_pids(int pids_max, int version, shared_t* shared) {
+    char id[CONTAINER_ID_LEN + 1], pids[16], label[32];
+    container_record_t record;
+
+    printf("== 進程數上限（不斷 fork 直到失敗）==\n");
+    print_header("pids.max", (const char*[]){"fork 成功", "pids.current", "錯誤", "結果", NULL}, (const int[]){10, 14, 10, 8});
+    snprintf(pids, sizeof(pids), "%d", pids_max);
+    snprintf(label, sizeof(label), "%d", pids_max);
+    const char* extra[] = {"--rootfs", "bind", "--pids", pids, NULL};
+    if (start_and_find(label, extra, id, &record) != 0) {
+        printf("\n");
+        return;
+    }
+    memset((void*)shared, 0, sizeof(*shared));
+    // fork_loop 在達到上限後停下等待，在它終止子進程之前讀取 pids.current
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(run_in_container(&record, fork_loop, pids_max * 2 + 16, shared) == -1);
+    }
+    long long current = -1;
+    double deadline = now_sec() + 30;
+    while (!shared->ready && now_sec() < deadline) {
+        sleep_ms(10);
+    }
+    if (shared->ready) {
+        current = read_cgroup_number(version, "pids", record.cgroup_name, "pids.current");
+    }
+    shared->release = 1;
+    int status;
+    waitpid(pid, &status, 0);
+    stop_container(id);
+    print_label(label, 22);
+    if (!shared->ready) {
+        printf("無法在容器內運行負載\n\n");
+        return;
+    }
+    printf("%10lld %14lld ", shared->count, current);
+    print_cell(shared->error ? strerrorname_np(shared->error) : "無", 10);
+    print_verdict(shared->error == EAGAIN && current >= 0 && current <= pids_max);
+    printf("\n");
+}
+
+// 取得 path 所在的整個磁碟的 MAJ:MIN（io.max / blkio 不接受分區）
+static int whole_disk_of(const char* path, char* device, size_t size) {
+    struct stat st;
+    char sys[64], real[PATH_MAX], probe[PATH_MAX + 16];
+
+    if (stat(path, &st) != 0) {
+        return -1;
+    }
+    snprintf(sys, sizeof(sys), "/sys/dev/block/%u:%u", major(st.st_dev), minor(st.st_dev));
+    // 不是塊設備（例如 tmpfs、overlay）時沒有這個連結
+    if (!realpath(sys, real)) {
+        return -1;
+    }
+    snprintf(probe, sizeof(probe), "%s/partition", real);
+    if (access(probe, F_OK) == 0) {
+        *strrchr(real, '/') = '\0';
+    }
+    return read_cgroup_file(real, "dev", device, size);
+}
+
+static void bench_disk(long write_mb, long wbps_mb, shared_t* shared) {
+    char id[CONTAINER_ID_LEN + 1], device[32], io_max[128], label[64];
+    container_record_t record;
+
+    printf("== 磁碟寫入（%ld MB，O_DIRECT + fsync）==\n", write_mb);
+    print_header("配置", (const char*[]){"MB/s", "結果", NULL}, (const int[]){10, 8});
+
+    int status = run_on_host(disk_writer, write_mb, shared);
+    print_label("主機", 22);
+    if (WIFEXITED(status) && !shared->error) {
+        printf("%10.1f\n", shared->value);
+    } else {
+        printf("寫入失敗: %s\n", strerror(shared->error));
+    }
+
+    int has_device = whole_disk_of("/tmp", device, sizeof(device)) == 0;
+    for (int limited = 0; limited <= 1; limited++) {
+        const char* extra[] = {"--rootfs", "bind", "--io-max", io_max, NULL};
+        if (limited) {
+            if (!has_device) {
+                print_label("容器 wbps 限制", 22);
+                printf("/tmp 不在塊設備上，跳過\n");
+                break;
+            }
+            snprintf(io_max, sizeof(io_max), "%s wbps=%ld", device, wbps_mb * MB);
+            snprintf(label, sizeof(label), "容器 wbps=%ld MB/s", wbps_mb);
+        } else {
+            extra[0] = NULL;
+            snprintf(label, sizeof(label), "容器 不限制");
+        }
+        if (start_and_find(label, extra, id, &record) != 0) {
+            continue;
+        }
+        status = run_in_container(&record, disk_writer, write_mb, shared);
+        stop_container(id);
+        print_label(label, 22);
+        if (status == -1 || !WIFEXITED(status) || shared->error) {
+            printf("寫入失敗: %s\n", strerror(shared->error));
+        } else if (limited) {
+            printf("%10.1f", shared->value);
+            print_verdict(shared->value <= wbps_mb * 1.2);
+        } else {
+            printf("%10.1f\n", shared->value);
+        }
+    }
+    printf("\n");
+}
+
+static void bench_overhead(long iterations, shared_t* shared) {
+    char id[CONTAINER_ID_LEN + 1];
+    container_record_t record;
+    double host[OP_COUNT];
+
+    printf("== 命名空間開銷（每次耗時 ns，各 %ld 次，fork+wait 為 %ld 次）==\n", iterations, iterations / 100);
+    int status = run_on_host(syscall_ops, iterations, shared);
+    if (!WIFEXITED(status) || shared->error) {
+        printf("主機上的測量失敗: %s\n\n", strerror(shared->error));
+        return;
+    }
+    memcpy(host, (const void*)shared->ops, sizeof(host));
+
+    // 不限制 CPU，避免配額節流被計入開銷
+    const char* extra[] = {"--rootfs", "bind", "--cpu-quota", "-1", NULL};
+    if (start_and_find("容器", extra, id, &record) != 0) {
+        printf("\n");
+        return;
+    }
+    status = run_in_container(&record, syscall_ops, iterations, shared);
+    stop_container(id);
+    if (status == -1 || !WIFEXITED(status) || shared->error) {
+        printf("容器內的測量失敗: %s\n\n", strerror(shared->error));
+        return;
+    }
+    print_header("操作", (const char*[]){"主機", "容器", "比例", NULL}, (const int[]){10, 10, 8});
+    for (int i = 0; i < OP_COUNT; i++) {
+        print_label(op_names[i], 22);
+        printf("%10.0f %10.0f %7.2fx\n", host[i], shared->ops[i], shared->ops[i] / host[i]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char* argv[]) {
+    int duration_ms = (int)((argc > 1 ? atof(argv[1]) : 2) * 1000);
+    long memory_mb = argc > 2 ? atol(argv[2]) : 64;
+    int pids_max = argc > 3 ? atoi(argv[3]) : 32;
+    long write_mb = argc > 4 ? atol(argv[4]) : 64;
+    long wbps_mb = argc > 5 ? atol(argv[5]) : 16;
+
+    if (duration_ms < 100 || memory_mb < 8 || pids_max < 4 || pids_max > MAX_FORKS / 2 || write_mb < 1 || wbps_mb < 1) {
+        fprintf(stderr, "用法: %s [CPU 秒數] [記憶體 MB (>= 8)] [進程數 (4-%d)] [寫入 MB] [寫入限速 MB/s]\n",
+                argv[0], MAX_FORKS / 2);
+        return 1;
+    }
+    if (access(MAIN_PATH, X_OK) != 0) {
+        fprintf(stderr, "錯誤: 找不到 %s，請在專案根目錄運行\n", MAIN_PATH);
+        return 1;
+    }
+
+    shared_t* shared = mmap(NULL, sizeof(shared_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    int version = detect_cgroup_version();
+    printf("cgroup v%d\n\n", version);
+
+    bench_cpu(duration_ms, shared);
+    bench_memory(memory_mb, version, shared);
+    bench_pids(pids_max, version, shared);
+    bench_disk(write_mb, wbps_mb, shared);
+    bench_overhead(200000, shared);
+    munmap(shared, sizeof(shared_t));
+    return 0;
+}
@@ -0,0 +1,211 @@
+// 網絡命名空間基準測試：比較容器網絡就緒所需的時間與 TCP 吞吐量
+//
+// 啟動延遲（每次迭代都是「得到一個位於目標網絡中的進程並等它結束」）：
+//   host    只 fork，共用主機網絡
+//   fresh   當場創建並配置命名空間，再取用
+//   pooled  從預先填滿的池中取用（容器啟動時的路徑）
+// 吞吐量：在命名空間內以 127.0.0.1 傳輸；bridge 模式另外測試主機經 veth 到容器地址的傳輸。
+// 全部在本機完成，不需要外部網絡。
+//
+// 用法: ./bench/bench_netns [次數] [傳輸 MB] [--bridge]
+
+#include "../netns.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sched.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define CHUNK (64 * 1024)
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// fork 一個進程（可選地先切換到 ns_fd 的網絡命名空間）並等待它結束
+static int spawn_in(int ns_fd) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (ns_fd >= 0 && setns(ns_fd, CLONE_NEWNET) == -1) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+static void bench_startup(const char* label, net_mode_t mode, int pooled, int iterations) {
+    char address[32];
+    int failures = 0;
+
+    if (mode != NET_HOST && pooled) {
+        netns_pool_fill(mode, iterations);
+    }
+    double start = now_sec();
+    for (int i = 0; i < iterations; i++) {
+        int fd = -1;
+        if (mode != NET_HOST) {
+            if (!pooled && netns_create(mode) != 0) {
+                failures++;
+                continue;
+            }
+            fd = netns_claim(mode, address, sizeof(address));
+            if (fd == -1) {
+                failures++;
+                continue;
+            }
+        }
+        if (spawn_in(fd) != 0) {
+            failures++;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    double elapsed = now_sec() - start;
+    printf("  %-18s %9.3f ms/次", label, elapsed * 1000 / iterations);
+    if (failures) {
+        printf("  (%d 次失敗)", failures);
+    }
+    printf("\n");
+}
+
+// 在 listen_addr 上接收 total 位元組，返回 MB/s；client_ns 為客戶端所在的命名空間（-1 表示與伺服器相同）
+static double transfer(int server_ns, int client_ns, const char* listen_addr, const char* connect_addr, size_t total) {
+    int result_pipe[2], port_pipe[2];
+    if (pipe(result_pipe) == -1 || pipe(port_pipe) == -1) {
+        return 0;
+    }
+
+    pid_t server = fork();
+    if (server == 0) {
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        char buf[CHUNK];
+        double mbps = 0;
+
+        if (server_ns >= 0 && setns(server_ns, CLONE_NEWNET) == -1) {
+            _exit(1);
+        }
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        inet_pton(AF_INET, listen_addr, &addr.sin_addr);
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, 1) == -1 ||
+            getsockname(fd, (struct sockaddr*)&addr, &len) == -1) {
+            _exit(1);
+        }
+        unsigned short port = addr.sin_port;
+        if (write(port_pipe[1], &port, sizeof(port)) != sizeof(port)) {
+            _exit(1);
+        }
+        int conn = accept(fd, NULL, NULL);
+        double start = now_sec();
+        size_t received = 0;
+        ssize_t n;
+        while (conn != -1 && (n = read(conn, buf, sizeof(buf))) > 0) {
+            received += n;
+        }
+        double elapsed = now_sec() - start;
+        if (received == total && elapsed > 0) {
+            mbps = total / elapsed / (1024 * 1024);
+        }
+        if (write(result_pipe[1], &mbps, sizeof(mbps)) != sizeof(mbps)) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    unsigned short port = 0;
+    if (read(port_pipe[0], &port, sizeof(port)) != sizeof(port)) {
+        waitpid(server, NULL, 0);
+        return 0;
+    }
+
+    pid_t client = fork();
+    if (client == 0) {
+        struct sockaddr_in addr;
+        static char buf[CHUNK];
+        int ns = client_ns >= 0 ? client_ns : server_ns;
+
+        if (ns >= 0 && setns(ns, CLONE_NEWNET) == -1) {
+            _exit(1);
+        }
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = port;
+        inet_pton(AF_INET, connect_addr, &addr.sin_addr);
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+            _exit(1);
+        }
+        for (size_t sent = 0; sent < total; ) {
+            size_t want = total - sent < CHUNK ? total - sent : CHUNK;
+            ssize_t n = write(fd, buf, want);
+            if (n <= 0) {
+                _exit(1);
+            }
+            sent += n;
+        }
+        _exit(0);
+    }
+
+    double mbps = 0;
+    waitpid(client, NULL, 0);
+    if (read(result_pipe[0], &mbps, sizeof(mbps)) != sizeof(mbps)) {
+        mbps = 0;
+    }
+    waitpid(server, NULL, 0);
+    close(result_pipe[0]);
+    close(result_pipe[1]);
+    close(port_pipe[0]);
+    close(port_pipe[1]);
+    return mbps;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    size_t mb = argc > 2 ? (size_t)atol(argv[2]) : 1024;
+    int bridge = argc > 3 && strcmp(argv[3], "--bridge") == 0;
+    char address[32];
+
+    printf("迭代次數: %d, 傳輸量: %zu MB%s\n\n", iterations, mb, bridge ? ", 包含 bridge 模式" : "");
+
+    printf("啟動延遲:\n");
+    bench_startup("host", NET_HOST, 0, iterations);
+    bench_startup("loopback fresh", NET_LOOPBACK, 0, iterations);
+    bench_startup("loopback pooled", NET_LOOPBACK, 1, iterations);
+    if (bridge) {
+        bench_startup("bridge fresh", NET_BRIDGE, 0, iterations);
+        bench_startup("bridge pooled", NET_BRIDGE, 1, iterations);
+    }
+
+    printf("\nTCP 吞吐量:\n");
+    printf("  %-18s %9.0f MB/s\n", "host lo", transfer(-1, -1, "127.0.0.1", "127.0.0.1", mb << 20));
+    int fd = netns_claim(NET_LOOPBACK, address, sizeof(address));
+    if (fd >= 0) {
+        printf("  %-18s %9.0f MB/s\n", "netns lo", transfer(fd, -1, "127.0.0.1", "127.0.0.1", mb << 20));
+        close(fd);
+    }
+    if (bridge) {
+        fd = netns_claim(NET_BRIDGE, address, sizeof(address));
+        if (fd >= 0) {
+            // 伺服器在容器中監聽 eth0 的地址，客戶端在主機經網橋和 veth 連入
+            int host_ns = open("/proc/self/ns/net", O_RDONLY);
+            printf("  %-18s %9.0f MB/s\n", "host -> veth", transfer(fd, host_ns, address, address, mb << 20));
+            close(host_ns);
+            close(fd);
+        }
+    }
+    return 0;
+}
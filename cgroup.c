@@ -4,6 +4,10 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -12,26 +16,89 @@ int write_cgroup_file(const char* cgroup_path, const char* filename, const char*
     char path[512];
     snprintf(path, sizeof(path), "%s/%s", cgroup_path, filename);
     
+    // 不在這裡輸出錯誤：清理等路徑上的失敗是預期的，由調用者根據 errno 決定是否報告
     FILE* file = fopen(path, "w");
     if (!file) {
-        // 在用戶命名空間中，cgroup 操作可能因權限不足而失敗
-        // 這是正常的，靜默失敗即可
-        // fprintf(stderr, "警告: 無法打開 %s: %s\n", path, strerror(errno));
         return -1;
     }
     
     if (fprintf(file, "%s", value) < 0) {
-        // 在用戶命名空間中，cgroup 操作可能因權限不足而失敗
-        // 這是正常的，靜默失敗即可
-        // fprintf(stderr, "警告: 無法寫入 %s: %s\n", path, strerror(errno));
+        int saved_errno = errno;
         fclose(file);
+        errno = saved_errno;
         return -1;
     }
     
+    // cgroup 文件在 flush 時才真正校驗寫入值，錯誤會從 fclose 返回
+    if (fclose(file) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// 讀取 cgroup 檔案的輔助函數
+int read_cgroup_file(const char* cgroup_path, const char* filename, char* buffer, size_t size) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", cgroup_path, filename);
+    
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    if (!fgets(buffer, size, file)) {
+        fclose(file);
+        return -1;
+    }
     fclose(file);
+    buffer[strcspn(buffer, "\n")] = '\0';
     return 0;
 }
 
+// 檢查資源限制配置是否自洽
+int validate_cgroup_limits(const cgroup_limits_t* limits) {
+    long max = limits->memory_limit_mb;
+    
+    if (max > 0 && limits->memory_high_mb > max) {
+        fprintf(stderr, "錯誤: memory.high (%ld MB) 不能超過 memory.max (%ld MB)\n", limits->memory_high_mb, max);
+        return -1;
+    }
+    if (max > 0 && limits->memory_low_mb > max) {
+        fprintf(stderr, "錯誤: memory.low (%ld MB) 不能超過 memory.max (%ld MB)\n", limits->memory_low_mb, max);
+        return -1;
+    }
+    if (limits->memory_low_mb > 0 && limits->memory_min_mb > limits->memory_low_mb) {
+        fprintf(stderr, "錯誤: memory.min (%ld MB) 不能超過 memory.low (%ld MB)\n", limits->memory_min_mb, limits->memory_low_mb);
+        return -1;
+    }
+    if (limits->memory_high_mb < 0 || limits->memory_low_mb < 0 || limits->memory_min_mb < 0 ||
+        limits->memory_swap_max_mb < -1 || limits->memory_zswap_max_mb < -1) {
+        fprintf(stderr, "錯誤: 記憶體限制不能為負數（swap/zswap 可用 -1 表示不限制）\n");
+        return -1;
+    }
+    if (limits->cpu_period_us != 0 && (limits->cpu_period_us < 1000 || limits->cpu_period_us > 1000000)) {
+        fprintf(stderr, "錯誤: CPU 週期必須在 1000-1000000 us 之間\n");
+        return -1;
+    }
+    if (limits->cpu_burst_us > 0 && limits->cpu_quota_us <= 0) {
+        fprintf(stderr, "錯誤: --cpu-burst 需要同時設置 CPU 配額 (--cpu-quota)\n");
+        return -1;
+    }
+    if (limits->cpu_burst_us < 0 || (limits->cpu_quota_us > 0 && limits->cpu_burst_us > limits->cpu_quota_us)) {
+        fprintf(stderr, "錯誤: CPU 突發配額必須在 0 與 CPU 配額 (%d us) 之間\n", limits->cpu_quota_us);
+        return -1;
+    }
+    return 0;
+}
+
+// 將 MB 數值格式化為 cgroup 接受的字串，-1 表示 "max"
+static void format_mb(char* buffer, size_t size, long mb) {
+    if (mb < 0) {
+        snprintf(buffer, size, "max");
+    } else {
+        snprintf(buffer, size, "%ld", mb * 1024 * 1024);
+    }
+}
+
 // 檢測 cgroup 版本 (v1 或 v2)
 int detect_cgroup_version(void) {
     struct stat st;
@@ -46,37 +113,108 @@ int detect_cgroup_version(void) {
     return 0;
 }
 
+// 寫入一項資源限制，失敗時輸出警告並累計到 failed（容器照常運行，但該限制沒有生效）
+static void set_limit(const char* cgroup_path, const char* filename, const char* value, int* failed) {
+    if (write_cgroup_file(cgroup_path, filename, value) != 0) {
+        fprintf(stderr, "警告: 無法設置 %s/%s = %s: %s\n", cgroup_path, filename, value, strerror(errno));
+        (*failed)++;
+    }
+}
+
+// 創建容器在某個控制器下的 cgroup 目錄，失敗時輸出警告並累計到 failed
+static int make_cgroup_dir(const char* cgroup_path, int* failed) {
+    if (mkdir(cgroup_path, 0755) == -1 && errno != EEXIST) {
+        fprintf(stderr, "警告: 無法創建 cgroup %s: %s，其資源限制不會生效\n", cgroup_path, strerror(errno));
+        (*failed)++;
+        return -1;
+    }
+    return 0;
+}
+
+// 寫入服務等級相關的 CPU 設定（v1 與 v2 的 cpu 控制器使用相同的文件名）
+static void write_cpu_qos(const char* cgroup_path, const cgroup_limits_t* limits, int* failed) {
+    char buffer[32];
+    
+    if (limits->cpu_idle) {
+        set_limit(cgroup_path, "cpu.idle", "1", failed);
+    }
+    // 需要內核的 CONFIG_UCLAMP_TASK_GROUP，否則這兩個文件不存在
+    if (limits->cpu_uclamp_min > 0) {
+        snprintf(buffer, sizeof(buffer), "%d.00", limits->cpu_uclamp_min);
+        set_limit(cgroup_path, "cpu.uclamp.min", buffer, failed);
+    }
+    if (limits->cpu_uclamp_max > 0) {
+        snprintf(buffer, sizeof(buffer), "%d.00", limits->cpu_uclamp_max);
+        set_limit(cgroup_path, "cpu.uclamp.max", buffer, failed);
+    }
+}
+
 // 創建並配置 cgroup v2
 int setup_cgroup_v2(pid_t pid, const cgroup_limits_t* limits, const char* cgroup_name) {
     char cgroup_path[512];
     char buffer[128];
+    int failed = 0;
     
     // printf("正在設置資源限制 (cgroup v2)...\n");
     
-    // 創建 cgroup 目錄
+    // 創建 cgroup 目錄（失敗時容器仍可運行，只是沒有資源限制）
     snprintf(cgroup_path, sizeof(cgroup_path), "%s/%s", CGROUP_ROOT, cgroup_name);
-    if (mkdir(cgroup_path, 0755) == -1 && errno != EEXIST) {
-        // 在用戶命名空間中，cgroup 創建可能因權限不足而失敗
-        // 這是正常的，容器仍可運行，只是沒有資源限制
-        // fprintf(stderr, "警告: 無法創建 cgroup 目錄: %s（在用戶命名空間中這是正常的）\n", strerror(errno));
+    if (make_cgroup_dir(cgroup_path, &failed) != 0) {
         return -1;
     }
     
     // 先將進程移入 cgroup（在設置限制之前）
     // 這樣可以避免某些系統上的權限問題
     snprintf(buffer, sizeof(buffer), "%d", pid);
-    write_cgroup_file(cgroup_path, "cgroup.procs", buffer);
+    set_limit(cgroup_path, "cgroup.procs", buffer, &failed);
     
     // 嘗試在根 cgroup 中啟用控制器
     // 注意：這可能會失敗，但不影響基本功能
     write_cgroup_file(CGROUP_ROOT, "cgroup.subtree_control", "+cpu +memory +pids");
     
+    // cpuset 控制器單獨啟用，避免在不支援的系統上連帶影響其他控制器
+    if (limits->cpuset_cpus[0] || limits->cpuset_mems[0]) {
+        write_cgroup_file(CGROUP_ROOT, "cgroup.subtree_control", "+cpuset");
+    }
+    if (limits->io_max[0]) {
+        write_cgroup_file(CGROUP_ROOT, "cgroup.subtree_control", "+io");
+    }
+    
     // 設置記憶體限制
     if (limits->memory_limit_mb > 0) {
         snprintf(buffer, sizeof(buffer), "%ld", limits->memory_limit_mb * 1024 * 1024);
-        if (write_cgroup_file(cgroup_path, "memory.max", buffer) == 0) {
-            // printf("  記憶體限制: %ld MB\n", limits->memory_limit_mb);
-        }
+        set_limit(cgroup_path, "memory.max", buffer, &failed);
+    }
+    
+    // 設置記憶體保護（先於節流閾值，保護延遲敏感容器的工作集）
+    if (limits->memory_min_mb > 0) {
+        format_mb(buffer, sizeof(buffer), limits->memory_min_mb);
+        set_limit(cgroup_path, "memory.min", buffer, &failed);
+    }
+    if (limits->memory_low_mb > 0) {
+        format_mb(buffer, sizeof(buffer), limits->memory_low_mb);
+        set_limit(cgroup_path, "memory.low", buffer, &failed);
+    }
+    
+    // 設置記憶體節流閾值：超過後進程被節流並主動回收，而不是直接被 OOM 終止
+    if (limits->memory_high_mb > 0) {
+        format_mb(buffer, sizeof(buffer), limits->memory_high_mb);
+        set_limit(cgroup_path, "memory.high", buffer, &failed);
+    }
+    
+    // 設置 swap / zswap 上限（內核未啟用 swap 記帳時這些文件不存在）
+    if (limits->memory_swap_max_mb >= 0) {
+        format_mb(buffer, sizeof(buffer), limits->memory_swap_max_mb);
+        set_limit(cgroup_path, "memory.swap.max", buffer, &failed);
+    }
+    if (limits->memory_zswap_max_mb >= 0) {
+        format_mb(buffer, sizeof(buffer), limits->memory_zswap_max_mb);
+        set_limit(cgroup_path, "memory.zswap.max", buffer, &failed);
+    }
+    
+    // OOM 時整個容器作為一個整體被終止，避免殘留半死的工作進程
+    if (limits->memory_oom_group) {
+        set_limit(cgroup_path, "memory.oom.group", "1", &failed);
     }
     
     // 設置 CPU 權重 (cgroup v2 使用 weight 代替 shares)
@@ -87,30 +225,85 @@ int setup_cgroup_v2(pid_t pid, const cgroup_limits_t* limits, const char* cgroup
         if (weight > 10000) weight = 10000;
         
         snprintf(buffer, sizeof(buffer), "%d", weight);
-        if (write_cgroup_file(cgroup_path, "cpu.weight", buffer) == 0) {
-            // printf("  CPU 權重: %d (shares: %d)\n", weight, limits->cpu_shares);
-        }
+        set_limit(cgroup_path, "cpu.weight", buffer, &failed);
     }
     
-    // 設置 CPU 配額
+    // 設置服務等級：閒置調度與使用率鉗制 (uclamp)
+    write_cpu_qos(cgroup_path, limits, &failed);
+    
+    // 設置 CPU 配額、週期與突發配額（週期越短，用完配額後被節流的時間越短）
     if (limits->cpu_quota_us > 0) {
-        snprintf(buffer, sizeof(buffer), "%d 100000", limits->cpu_quota_us);
-        if (write_cgroup_file(cgroup_path, "cpu.max", buffer) == 0) {
-            // printf("  CPU 配額: %d us / 100000 us (%.1f%%)\n", 
-                //    limits->cpu_quota_us, (limits->cpu_quota_us / 1000.0));
+        snprintf(buffer, sizeof(buffer), "%d %d", limits->cpu_quota_us,
+                 limits->cpu_period_us > 0 ? limits->cpu_period_us : CGROUP_DEFAULT_CPU_PERIOD_US);
+        set_limit(cgroup_path, "cpu.max", buffer, &failed);
+        if (limits->cpu_burst_us > 0) {
+            snprintf(buffer, sizeof(buffer), "%d", limits->cpu_burst_us);
+            set_limit(cgroup_path, "cpu.max.burst", buffer, &failed);
         }
     }
     
     // 設置進程數限制
     if (limits->pids_max > 0) {
         snprintf(buffer, sizeof(buffer), "%d", limits->pids_max);
-        if (write_cgroup_file(cgroup_path, "pids.max", buffer) == 0) {
-            // printf("  最大進程數: %d\n", limits->pids_max);
-        }
+        set_limit(cgroup_path, "pids.max", buffer, &failed);
+    }
+    
+    // 設置 I/O 限制
+    if (limits->io_max[0]) {
+        set_limit(cgroup_path, "io.max", limits->io_max, &failed);
+    }
+    
+    // 設置 CPU / NUMA 節點綁定
+    if (limits->cpuset_cpus[0]) {
+        set_limit(cgroup_path, "cpuset.cpus", limits->cpuset_cpus, &failed);
+    }
+    if (limits->cpuset_mems[0]) {
+        set_limit(cgroup_path, "cpuset.mems", limits->cpuset_mems, &failed);
     }
     
     // printf("  已將進程 %d 加入 cgroup\n", pid);
     
+    return failed ? -1 : 0;
+}
+
+// 將 io.max 格式的限制轉換為 cgroup v1 的 blkio.throttle.* 文件
+static int write_blkio_v1(const char* cgroup_path, const char* io_max, int* failed) {
+    static const struct {
+        const char* key;
+        const char* file;
+    } map[] = {
+        {"rbps", "blkio.throttle.read_bps_device"},
+        {"wbps", "blkio.throttle.write_bps_device"},
+        {"riops", "blkio.throttle.read_iops_device"},
+        {"wiops", "blkio.throttle.write_iops_device"},
+    };
+    char spec[256];
+    char device[32];
+    char buffer[128];
+    
+    snprintf(spec, sizeof(spec), "%s", io_max);
+    char* saveptr = NULL;
+    char* token = strtok_r(spec, " ", &saveptr);
+    if (!token) {
+        return -1;
+    }
+    snprintf(device, sizeof(device), "%s", token);
+    
+    while ((token = strtok_r(NULL, " ", &saveptr)) != NULL) {
+        char* eq = strchr(token, '=');
+        if (!eq) {
+            continue;
+        }
+        *eq = '\0';
+        const char* value = eq + 1;
+        for (size_t i = 0; i < sizeof(map) / sizeof(map[0]); i++) {
+            if (strcmp(token, map[i].key) == 0) {
+                // v1 以 0 表示移除限制
+                snprintf(buffer, sizeof(buffer), "%s %s", device, strcmp(value, "max") == 0 ? "0" : value);
+                set_limit(cgroup_path, map[i].file, buffer, failed);
+            }
+        }
+    }
     return 0;
 }
 
@@ -118,22 +311,32 @@ int setup_cgroup_v2(pid_t pid, const cgroup_limits_t* limits, const char* cgroup
 int setup_cgroup_v1(pid_t pid, const cgroup_limits_t* limits, const char* cgroup_name) {
     char cgroup_path[512];
     char buffer[128];
+    int failed = 0;
     
     // printf("正在設置資源限制 (cgroup v1)...\n");
     
     // 設置記憶體限制
     if (limits->memory_limit_mb > 0) {
         snprintf(cgroup_path, sizeof(cgroup_path), "/sys/fs/cgroup/memory/%s", cgroup_name);
-        if (mkdir(cgroup_path, 0755) == -1 && errno != EEXIST) {
-            // 在用戶命名空間中，cgroup 創建可能因權限不足而失敗
-            // 這是正常的，容器仍可運行，只是沒有資源限制
-            // fprintf(stderr, "警告: 無法創建 memory cgroup: %s（在用戶命名空間中這是正常的）\n", strerror(errno));
-        } else {
+        if (make_cgroup_dir(cgroup_path, &failed) == 0) {
             snprintf(buffer, sizeof(buffer), "%ld", limits->memory_limit_mb * 1024 * 1024);
-            write_cgroup_file(cgroup_path, "memory.limit_in_bytes", buffer);
+            set_limit(cgroup_path, "memory.limit_in_bytes", buffer, &failed);
+            
+            // v1 沒有 memory.high / memory.low，以軟限制近似保護工作集
+            if (limits->memory_low_mb > 0) {
+                snprintf(buffer, sizeof(buffer), "%ld", limits->memory_low_mb * 1024 * 1024);
+                set_limit(cgroup_path, "memory.soft_limit_in_bytes", buffer, &failed);
+            }
+            
+            // v1 的 memsw 限制的是記憶體 + swap 的總和
+            if (limits->memory_swap_max_mb >= 0) {
+                snprintf(buffer, sizeof(buffer), "%ld",
+                         (limits->memory_limit_mb + limits->memory_swap_max_mb) * 1024 * 1024);
+                set_limit(cgroup_path, "memory.memsw.limit_in_bytes", buffer, &failed);
+            }
             
             snprintf(buffer, sizeof(buffer), "%d", pid);
-            write_cgroup_file(cgroup_path, "tasks", buffer);
+            set_limit(cgroup_path, "tasks", buffer, &failed);
             // printf("  記憶體限制: %ld MB\n", limits->memory_limit_mb);
         }
     }
@@ -141,47 +344,93 @@ int setup_cgroup_v1(pid_t pid, const cgroup_limits_t* limits, const char* cgroup
     // 設置 CPU 限制
     if (limits->cpu_shares > 0 || limits->cpu_quota_us > 0) {
         snprintf(cgroup_path, sizeof(cgroup_path), "/sys/fs/cgroup/cpu/%s", cgroup_name);
-        if (mkdir(cgroup_path, 0755) == -1 && errno != EEXIST) {
-            // 在用戶命名空間中，cgroup 創建可能因權限不足而失敗
-            // 這是正常的，容器仍可運行，只是沒有資源限制
-            // fprintf(stderr, "警告: 無法創建 cpu cgroup: %s（在用戶命名空間中這是正常的）\n", strerror(errno));
-        } else {
+        if (make_cgroup_dir(cgroup_path, &failed) == 0) {
             if (limits->cpu_shares > 0) {
                 snprintf(buffer, sizeof(buffer), "%d", limits->cpu_shares);
-                write_cgroup_file(cgroup_path, "cpu.shares", buffer);
+                set_limit(cgroup_path, "cpu.shares", buffer, &failed);
                 // printf("  CPU 份額: %d\n", limits->cpu_shares);
             }
             
+            write_cpu_qos(cgroup_path, limits, &failed);
+            
             if (limits->cpu_quota_us > 0) {
+                if (limits->cpu_period_us > 0) {
+                    snprintf(buffer, sizeof(buffer), "%d", limits->cpu_period_us);
+                    set_limit(cgroup_path, "cpu.cfs_period_us", buffer, &failed);
+                }
                 snprintf(buffer, sizeof(buffer), "%d", limits->cpu_quota_us);
-                write_cgroup_file(cgroup_path, "cpu.cfs_quota_us", buffer);
+                set_limit(cgroup_path, "cpu.cfs_quota_us", buffer, &failed);
                 // printf("  CPU 配額: %d us / 100000 us (%.1f%%)\n", 
                     //    limits->cpu_quota_us, (limits->cpu_quota_us / 1000.0));
+                if (limits->cpu_burst_us > 0) {
+                    snprintf(buffer, sizeof(buffer), "%d", limits->cpu_burst_us);
+                    set_limit(cgroup_path, "cpu.cfs_burst_us", buffer, &failed);
+                }
             }
             
             snprintf(buffer, sizeof(buffer), "%d", pid);
-            write_cgroup_file(cgroup_path, "tasks", buffer);
+            set_limit(cgroup_path, "tasks", buffer, &failed);
         }
     }
     
     // 設置進程數限制
     if (limits->pids_max > 0) {
         snprintf(cgroup_path, sizeof(cgroup_path), "/sys/fs/cgroup/pids/%s", cgroup_name);
-        if (mkdir(cgroup_path, 0755) == -1 && errno != EEXIST) {
-            // 在用戶命名空間中，cgroup 創建可能因權限不足而失敗
-            // 這是正常的，容器仍可運行，只是沒有資源限制
-            // fprintf(stderr, "警告: 無法創建 pids cgroup: %s（在用戶命名空間中這是正常的）\n", strerror(errno));
-        } else {
+        if (make_cgroup_dir(cgroup_path, &failed) == 0) {
             snprintf(buffer, sizeof(buffer), "%d", limits->pids_max);
-            write_cgroup_file(cgroup_path, "pids.max", buffer);
+            set_limit(cgroup_path, "pids.max", buffer, &failed);
             
             snprintf(buffer, sizeof(buffer), "%d", pid);
-            write_cgroup_file(cgroup_path, "tasks", buffer);
+            set_limit(cgroup_path, "tasks", buffer, &failed);
             // printf("  最大進程數: %d\n", limits->pids_max);
         }
     }
     
-    return 0;
+    // 設置 I/O 限制
+    if (limits->io_max[0]) {
+        snprintf(cgroup_path, sizeof(cgroup_path), "/sys/fs/cgroup/blkio/%s", cgroup_name);
+        if (make_cgroup_dir(cgroup_path, &failed) == 0) {
+            write_blkio_v1(cgroup_path, limits->io_max, &failed);
+            
+            snprintf(buffer, sizeof(buffer), "%d", pid);
+            set_limit(cgroup_path, "tasks", buffer, &failed);
+        }
+    }
+    
+    // 加入 freezer 子系統，讓清理時可以凍結後一次終止所有進程
+    snprintf(cgroup_path, sizeof(cgroup_path), "/sys/fs/cgroup/freezer/%s", cgroup_name);
+    if (mkdir(cgroup_path, 0755) == 0 || errno == EEXIST) {
+        snprintf(buffer, sizeof(buffer), "%d", pid);
+        write_cgroup_file(cgroup_path, "tasks", buffer);
+    }
+    
+    // 加入 cpuacct 子系統統計 CPU 用量（與 cpu 共同掛載時這是 cpu 下已創建的同一個目錄）
+    snprintf(cgroup_path, sizeof(cgroup_path), "/sys/fs/cgroup/cpuacct/%s", cgroup_name);
+    if (mkdir(cgroup_path, 0755) == 0 || errno == EEXIST) {
+        snprintf(buffer, sizeof(buffer), "%d", pid);
+        write_cgroup_file(cgroup_path, "tasks", buffer);
+    }
+    
+    // 設置 CPU / NUMA 節點綁定（v1 要求先設置 cpus 和 mems 才能加入進程）
+    if (limits->cpuset_cpus[0] || limits->cpuset_mems[0]) {
+        char cpus[256];
+        snprintf(cgroup_path, sizeof(cgroup_path), "/sys/fs/cgroup/cpuset/%s", cgroup_name);
+        // 只綁定 NUMA 節點時沿用父 cgroup 的全部 CPU
+        if (limits->cpuset_cpus[0]) {
+            snprintf(cpus, sizeof(cpus), "%s", limits->cpuset_cpus);
+        } else if (read_cgroup_file("/sys/fs/cgroup/cpuset", "cpuset.cpus", cpus, sizeof(cpus)) != 0) {
+            cpus[0] = '\0';
+        }
+        if (make_cgroup_dir(cgroup_path, &failed) == 0) {
+            set_limit(cgroup_path, "cpuset.cpus", cpus, &failed);
+            set_limit(cgroup_path, "cpuset.mems", limits->cpuset_mems[0] ? limits->cpuset_mems : "0", &failed);
+            
+            snprintf(buffer, sizeof(buffer), "%d", pid);
+            set_limit(cgroup_path, "tasks", buffer, &failed);
+        }
+    }
+    
+    return failed ? -1 : 0;
 }
 
 // 設置 cgroup 資源限制
@@ -200,22 +449,491 @@ int setup_cgroup_limits(pid_t pid, const cgroup_limits_t* limits, const char* cg
     }
 }
 
+// 取得某個控制器下容器 cgroup 的路徑（v2 所有控制器共用同一個目錄）
+void get_cgroup_path(int version, const char* controller, const char* cgroup_name, char* path, size_t size) {
+    if (version == 2) {
+        snprintf(path, size, "%s/%s", CGROUP_ROOT, cgroup_name);
+    } else {
+        snprintf(path, size, "/sys/fs/cgroup/%s/%s", controller, cgroup_name);
+    }
+}
+
+// 把進程加入已存在的容器 cgroup
+int join_cgroup(pid_t pid, const char* cgroup_name) {
+    static const char* controllers[] = {"memory", "cpu", "cpuacct", "pids", "cpuset", "blkio", "freezer"};
+    char cgroup_path[512];
+    char buffer[32];
+    int version = detect_cgroup_version();
+    int joined = 0;
+
+    snprintf(buffer, sizeof(buffer), "%d", pid);
+    if (version == 2) {
+        get_cgroup_path(version, NULL, cgroup_name, cgroup_path, sizeof(cgroup_path));
+        return write_cgroup_file(cgroup_path, "cgroup.procs", buffer);
+    }
+    for (size_t i = 0; i < sizeof(controllers) / sizeof(controllers[0]); i++) {
+        get_cgroup_path(version, controllers[i], cgroup_name, cgroup_path, sizeof(cgroup_path));
+        if (access(cgroup_path, F_OK) == 0 && write_cgroup_file(cgroup_path, "cgroup.procs", buffer) == 0) {
+            joined++;
+        }
+    }
+    return joined > 0 ? 0 : -1;
+}
+
+// 讀取以位元組為單位的記憶體數值，"max" 返回 -1
+static long long read_bytes(const char* cgroup_path, const char* filename) {
+    char buffer[64];
+    if (read_cgroup_file(cgroup_path, filename, buffer, sizeof(buffer)) != 0) {
+        return -2;
+    }
+    if (strncmp(buffer, "max", 3) == 0) {
+        return -1;
+    }
+    return atoll(buffer);
+}
+
+// 寫入一個 cgroup 文件，失敗時輸出錯誤
+static int apply_knob(const char* cgroup_path, const char* filename, const char* value) {
+    if (write_cgroup_file(cgroup_path, filename, value) != 0) {
+        fprintf(stderr, "錯誤: 無法寫入 %s/%s = %s: %s\n", cgroup_path, filename, value, strerror(errno));
+        return -1;
+    }
+    printf("  %s = %s\n", filename, value);
+    return 0;
+}
+
+// 讀取 v1 的記憶體上限，未限制（接近 LLONG_MAX 的頁對齊值）返回 -1，文件不存在返回 -2
+static long long read_limit_v1(const char* cgroup_path, const char* filename) {
+    long long value = read_bytes(cgroup_path, filename);
+    return value >= (1LL << 62) ? -1 : value;
+}
+
+// 修改 v1 的記憶體上限與 memsw（記憶體 + swap）上限
+// 內核要求 memsw >= limit：放大時先寫 memsw，縮小時先寫 limit；只修改記憶體上限時保持目前的 swap 餘量
+static int update_memory_v1(const char* mem_path, const cgroup_limits_t* limits, unsigned int mask, long long new_max) {
+    char buffer[64];
+    long long current_max = read_limit_v1(mem_path, "memory.limit_in_bytes");
+    long long current_memsw = read_limit_v1(mem_path, "memory.memsw.limit_in_bytes");
+    long long max = (mask & CGROUP_SET_MEMORY_MAX) ? new_max : current_max;
+    long long memsw = -2;  // -2 表示不修改
+    
+    if (mask & CGROUP_SET_MEMORY_SWAP) {
+        memsw = limits->memory_swap_max_mb < 0 || max < 0 ? -1 : max + limits->memory_swap_max_mb * 1024 * 1024;
+    } else if (current_memsw >= 0 && current_max >= 0) {
+        memsw = max < 0 ? -1 : max + (current_memsw - current_max);
+    }
+    int grow = current_max >= 0 && (max < 0 || max > current_max);
+    
+    int result = 0;
+    if (memsw != -2 && grow) {
+        snprintf(buffer, sizeof(buffer), "%lld", memsw);
+        result |= apply_knob(mem_path, "memory.memsw.limit_in_bytes", buffer);
+    }
+    if (mask & CGROUP_SET_MEMORY_MAX) {
+        snprintf(buffer, sizeof(buffer), "%lld", new_max);
+        result |= apply_knob(mem_path, "memory.limit_in_bytes", buffer);
+    }
+    if (memsw != -2 && !grow) {
+        snprintf(buffer, sizeof(buffer), "%lld", memsw);
+        result |= apply_knob(mem_path, "memory.memsw.limit_in_bytes", buffer);
+    }
+    return result;
+}
+
+// 就地修改運行中容器的資源限制
+int update_cgroup_limits(const char* cgroup_name, const cgroup_limits_t* limits, unsigned int mask, int force) {
+    int version = detect_cgroup_version();
+    char mem_path[512], cpu_path[512], pids_path[512], io_path[512];
+    char buffer[256];
+    struct stat st;
+    
+    if (version == 0) {
+        fprintf(stderr, "錯誤: 未檢測到 cgroup 支援\n");
+        return -1;
+    }
+    
+    get_cgroup_path(version, "memory", cgroup_name, mem_path, sizeof(mem_path));
+    get_cgroup_path(version, "cpu", cgroup_name, cpu_path, sizeof(cpu_path));
+    get_cgroup_path(version, "pids", cgroup_name, pids_path, sizeof(pids_path));
+    get_cgroup_path(version, "blkio", cgroup_name, io_path, sizeof(io_path));
+    
+    if (stat(version == 2 ? mem_path : cpu_path, &st) != 0 && stat(mem_path, &st) != 0) {
+        fprintf(stderr, "錯誤: 找不到容器的 cgroup: %s\n", cgroup_name);
+        return -1;
+    }
+    
+    // 先完成所有檢查，避免只套用了一半的修改
+    long long new_max = limits->memory_limit_mb > 0 ? limits->memory_limit_mb * 1024 * 1024 : -1;
+    if (mask & CGROUP_SET_MEMORY_MAX && new_max > 0) {
+        long long current = read_bytes(mem_path, version == 2 ? "memory.current" : "memory.usage_in_bytes");
+        if (current > new_max && !force) {
+            fprintf(stderr, "錯誤: 新的記憶體上限 %lld MB 低於目前用量 %lld MB（使用 --force 強制回收）\n",
+                    new_max / (1024 * 1024), current / (1024 * 1024));
+            return -1;
+        }
+    }
+    if (mask & CGROUP_SET_MEMORY_HIGH && limits->memory_high_mb > 0) {
+        long long max = (mask & CGROUP_SET_MEMORY_MAX) ? new_max
+                        : read_bytes(mem_path, version == 2 ? "memory.max" : "memory.limit_in_bytes");
+        if (max > 0 && limits->memory_high_mb * 1024 * 1024 > max) {
+            fprintf(stderr, "錯誤: memory.high (%ld MB) 不能超過 memory.max (%lld MB)\n",
+                    limits->memory_high_mb, max / (1024 * 1024));
+            return -1;
+        }
+    }
+    if ((mask & (CGROUP_SET_MEMORY_HIGH | CGROUP_SET_MEMORY_LOW | CGROUP_SET_MEMORY_MIN)) &&
+        (limits->memory_high_mb < 0 || limits->memory_low_mb < 0 || limits->memory_min_mb < 0)) {
+        fprintf(stderr, "錯誤: 記憶體限制不能為負數\n");
+        return -1;
+    }
+    if (mask & CGROUP_SET_CPU_SHARES && (limits->cpu_shares < 2 || limits->cpu_shares > 262144)) {
+        fprintf(stderr, "錯誤: CPU 份額必須在 2-262144 之間\n");
+        return -1;
+    }
+    if (mask & CGROUP_SET_CPU_QUOTA && limits->cpu_quota_us >= 0 && limits->cpu_quota_us < 1000) {
+        fprintf(stderr, "錯誤: CPU 配額至少為 1000 us（-1 表示不限制）\n");
+        return -1;
+    }
+    if (mask & CGROUP_SET_CPU_PERIOD && (limits->cpu_period_us < 1000 || limits->cpu_period_us > 1000000)) {
+        fprintf(stderr, "錯誤: CPU 週期必須在 1000-1000000 us 之間\n");
+        return -1;
+    }
+    if (mask & CGROUP_SET_CPU_BURST && limits->cpu_burst_us < 0) {
+        fprintf(stderr, "錯誤: CPU 突發配額不能為負數\n");
+        return -1;
+    }
+    // 內核拒絕突發配額大於配額的設置 (EINVAL)：以新的或目前的配額檢查突發配額，
+    // 只縮小配額時把超出的突發配額一併降到新的配額
+    long long new_burst = -1;   // >= 0 表示需要寫入
+    int burst_first = 0;        // 突發配額變小時先寫突發配額，否則先寫配額，保證每一步都滿足 burst <= quota
+    if (mask & (CGROUP_SET_CPU_QUOTA | CGROUP_SET_CPU_BURST)) {
+        long long quota = (mask & CGROUP_SET_CPU_QUOTA) ? limits->cpu_quota_us
+                          : read_bytes(cpu_path, version == 2 ? "cpu.max" : "cpu.cfs_quota_us");
+        long long current_burst = read_bytes(cpu_path, version == 2 ? "cpu.max.burst" : "cpu.cfs_burst_us");
+        if (quota < 0) quota = -1;
+        if (current_burst < 0) current_burst = 0;
+        if (mask & CGROUP_SET_CPU_BURST) {
+            if (limits->cpu_burst_us > 0 && quota < 0) {
+                fprintf(stderr, "錯誤: 容器沒有 CPU 配額，無法設置突發配額（請同時指定 --cpu-quota）\n");
+                return -1;
+            }
+            if (quota >= 0 && limits->cpu_burst_us > quota) {
+                fprintf(stderr, "錯誤: CPU 突發配額 (%d us) 不能超過 CPU 配額 (%lld us)\n",
+                        limits->cpu_burst_us, quota);
+                return -1;
+            }
+            new_burst = limits->cpu_burst_us;
+        } else if (quota >= 0 && current_burst > quota) {
+            new_burst = quota;
+        }
+        burst_first = new_burst >= 0 && new_burst <= current_burst;
+    }
+    if (mask & CGROUP_SET_PIDS && limits->pids_max > 0) {
+        char current[64];
+        if (read_cgroup_file(pids_path, "pids.current", current, sizeof(current)) == 0 &&
+            atoi(current) > limits->pids_max && !force) {
+            fprintf(stderr, "錯誤: 新的進程數上限 %d 低於目前進程數 %s（使用 --force 強制設置）\n",
+                    limits->pids_max, current);
+            return -1;
+        }
+    }
+    if (mask & CGROUP_SET_IO) {
+        unsigned int major, minor;
+        if (sscanf(limits->io_max, "%u:%u", &major, &minor) != 2 || !strchr(limits->io_max, '=')) {
+            fprintf(stderr, "錯誤: 無效的 I/O 限制格式: %s\n", limits->io_max);
+            return -1;
+        }
+    }
+    if (version == 1 && mask & (CGROUP_SET_MEMORY_HIGH | CGROUP_SET_MEMORY_MIN | CGROUP_SET_MEMORY_ZSWAP | CGROUP_SET_OOM_GROUP)) {
+        fprintf(stderr, "錯誤: cgroup v1 不支援 memory.high / memory.min / memory.zswap.max / memory.oom.group\n");
+        return -1;
+    }
+    
+    int result = 0;
+    
+    // 記憶體
+    if (mask & CGROUP_SET_MEMORY_MIN) {
+        snprintf(buffer, sizeof(buffer), "%ld", limits->memory_min_mb * 1024 * 1024);
+        result |= apply_knob(mem_path, "memory.min", buffer);
+    }
+    if (mask & CGROUP_SET_MEMORY_LOW) {
+        snprintf(buffer, sizeof(buffer), "%ld", limits->memory_low_mb * 1024 * 1024);
+        result |= apply_knob(mem_path, version == 2 ? "memory.low" : "memory.soft_limit_in_bytes", buffer);
+    }
+    if (mask & CGROUP_SET_MEMORY_HIGH) {
+        format_mb(buffer, sizeof(buffer), limits->memory_high_mb > 0 ? limits->memory_high_mb : -1);
+        result |= apply_knob(mem_path, "memory.high", buffer);
+    }
+    if (version == 1) {
+        if (mask & (CGROUP_SET_MEMORY_MAX | CGROUP_SET_MEMORY_SWAP)) {
+            result |= update_memory_v1(mem_path, limits, mask, new_max);
+        }
+    } else {
+        if (mask & CGROUP_SET_MEMORY_MAX) {
+            format_mb(buffer, sizeof(buffer), limits->memory_limit_mb > 0 ? limits->memory_limit_mb : -1);
+            result |= apply_knob(mem_path, "memory.max", buffer);
+        }
+        if (mask & CGROUP_SET_MEMORY_SWAP) {
+            format_mb(buffer, sizeof(buffer), limits->memory_swap_max_mb);
+            result |= apply_knob(mem_path, "memory.swap.max", buffer);
+        }
+    }
+    if (mask & CGROUP_SET_MEMORY_ZSWAP) {
+        format_mb(buffer, sizeof(buffer), limits->memory_zswap_max_mb);
+        result |= apply_knob(mem_path, "memory.zswap.max", buffer);
+    }
+    if (mask & CGROUP_SET_OOM_GROUP) {
+        result |= apply_knob(mem_path, "memory.oom.group", limits->memory_oom_group ? "1" : "0");
+    }
+    
+    // CPU
+    if (mask & CGROUP_SET_CPU_SHARES) {
+        if (version == 2) {
+            int weight = (limits->cpu_shares * 10000) / 1024;
+            if (weight < 1) weight = 1;
+            if (weight > 10000) weight = 10000;
+            snprintf(buffer, sizeof(buffer), "%d", weight);
+            result |= apply_knob(cpu_path, "cpu.weight", buffer);
+        } else {
+            snprintf(buffer, sizeof(buffer), "%d", limits->cpu_shares);
+            result |= apply_knob(cpu_path, "cpu.shares", buffer);
+        }
+    }
+    if (new_burst >= 0 && burst_first) {
+        snprintf(buffer, sizeof(buffer), "%lld", new_burst);
+        result |= apply_knob(cpu_path, version == 2 ? "cpu.max.burst" : "cpu.cfs_burst_us", buffer);
+    }
+    if (mask & (CGROUP_SET_CPU_QUOTA | CGROUP_SET_CPU_PERIOD)) {
+        if (version == 2) {
+            // cpu.max 同時包含配額與週期，未指定的一項保留目前的值
+            char current[64] = "max";
+            long period = CGROUP_DEFAULT_CPU_PERIOD_US;
+            if (read_cgroup_file(cpu_path, "cpu.max", current, sizeof(current)) == 0) {
+                char* space = strchr(current, ' ');
+                if (space) {
+                    period = atol(space + 1);
+                    *space = '\0';
+                }
+            }
+            if (mask & CGROUP_SET_CPU_QUOTA) {
+                if (limits->cpu_quota_us < 0) {
+                    snprintf(current, sizeof(current), "max");
+                } else {
+                    snprintf(current, sizeof(current), "%d", limits->cpu_quota_us);
+                }
+            }
+            if (mask & CGROUP_SET_CPU_PERIOD) {
+                period = limits->cpu_period_us;
+            }
+            snprintf(buffer, sizeof(buffer), "%s %ld", current, period);
+            result |= apply_knob(cpu_path, "cpu.max", buffer);
+        } else {
+            if (mask & CGROUP_SET_CPU_PERIOD) {
+                snprintf(buffer, sizeof(buffer), "%d", limits->cpu_period_us);
+                result |= apply_knob(cpu_path, "cpu.cfs_period_us", buffer);
+            }
+            if (mask & CGROUP_SET_CPU_QUOTA) {
+                snprintf(buffer, sizeof(buffer), "%d", limits->cpu_quota_us < 0 ? -1 : limits->cpu_quota_us);
+                result |= apply_knob(cpu_path, "cpu.cfs_quota_us", buffer);
+            }
+        }
+    }
+    if (new_burst >= 0 && !burst_first) {
+        snprintf(buffer, sizeof(buffer), "%lld", new_burst);
+        result |= apply_knob(cpu_path, version == 2 ? "cpu.max.burst" : "cpu.cfs_burst_us", buffer);
+    }
+    
+    // 進程數
+    if (mask & CGROUP_SET_PIDS) {
+        if (limits->pids_max > 0) {
+            snprintf(buffer, sizeof(buffer), "%d", limits->pids_max);
+        } else {
+            snprintf(buffer, sizeof(buffer), "max");
+        }
+        result |= apply_knob(pids_path, "pids.max", buffer);
+    }
+    
+    // I/O
+    if (mask & CGROUP_SET_IO) {
+        if (version == 2) {
+            write_cgroup_file(CGROUP_ROOT, "cgroup.subtree_control", "+io");
+            result |= apply_knob(io_path, "io.max", limits->io_max);
+        } else {
+            int failed = 0;
+            if (write_blkio_v1(io_path, limits->io_max, &failed) != 0 || failed) {
+                fprintf(stderr, "錯誤: 無法寫入 %s 的 blkio 限制\n", io_path);
+                result = -1;
+            }
+        }
+    }
+    
+    return result == 0 ? 0 : -1;
+}
+
+// 等待 cgroup.events 中出現指定的狀態（例如 "populated 0"、"frozen 1"）
+// 內核在 cgroup.events 變化時會喚醒 poll (POLLPRI)，不需要輪詢睡眠
+static int wait_cgroup_event_v2(const char* cgroup_path, const char* expected, int timeout_ms) {
+    char path[600];
+    char buffer[256];
+    
+    snprintf(path, sizeof(path), "%s/cgroup.events", cgroup_path);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return errno == ENOENT && strcmp(expected, "populated 0") == 0 ? 0 : -1;
+    }
+    
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int result = -1;
+    for (;;) {
+        ssize_t n = pread(fd, buffer, sizeof(buffer) - 1, 0);
+        if (n < 0) {
+            break;
+        }
+        buffer[n] = '\0';
+        if (strstr(buffer, expected)) {
+            result = 0;
+            break;
+        }
+        
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (elapsed >= timeout_ms) {
+            break;
+        }
+        struct pollfd pfd = {fd, POLLPRI, 0};
+        if (poll(&pfd, 1, (int)(timeout_ms - elapsed)) == -1 && errno != EINTR) {
+            break;
+        }
+    }
+    close(fd);
+    return result;
+}
+
+// 向 cgroup 中的所有進程發送 SIGKILL
+static void kill_listed_tasks(const char* cgroup_path, const char* filename) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/%s", cgroup_path, filename);
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return;
+    }
+    int pid;
+    while (fscanf(file, "%d", &pid) == 1) {
+        kill(pid, SIGKILL);
+    }
+    fclose(file);
+}
+
+// 一次終止 cgroup v2 中的所有進程
+static void kill_cgroup_v2(const char* cgroup_path) {
+    // cgroup.kill (Linux 5.14+) 由內核原子地終止所有成員，包括正在 fork 的進程
+    if (write_cgroup_file(cgroup_path, "cgroup.kill", "1") == 0) {
+        return;
+    }
+    // 舊內核：先凍結避免進程在掃描期間 fork，再逐一終止（SIGKILL 對已凍結的進程同樣生效）
+    write_cgroup_file(cgroup_path, "cgroup.freeze", "1");
+    kill_listed_tasks(cgroup_path, "cgroup.procs");
+    write_cgroup_file(cgroup_path, "cgroup.freeze", "0");
+}
+
+// 判斷 v1 cgroup 的 tasks 是否已為空
+static int tasks_empty_v1(const char* cgroup_path) {
+    char buffer[64];
+    return read_cgroup_file(cgroup_path, "tasks", buffer, sizeof(buffer)) != 0 || buffer[0] == '\0';
+}
+
+// 凍結或解凍容器的所有進程
+int freeze_cgroup(const char* cgroup_name, int frozen) {
+    int version = detect_cgroup_version();
+    char cgroup_path[512];
+    char state[32];
+    
+    if (version == 2) {
+        get_cgroup_path(version, NULL, cgroup_name, cgroup_path, sizeof(cgroup_path));
+        if (write_cgroup_file(cgroup_path, "cgroup.freeze", frozen ? "1" : "0") != 0) {
+            return -1;
+        }
+        // 寫入只是發出請求，進程在返回用戶態時才真正停下；等不到（例如有進程卡在 D 狀態）時解凍，不留下凍結的容器
+        if (frozen && wait_cgroup_event_v2(cgroup_path, "frozen 1", CGROUP_TEARDOWN_TIMEOUT_MS) != 0) {
+            write_cgroup_file(cgroup_path, "cgroup.freeze", "0");
+            return -1;
+        }
+        return 0;
+    }
+    if (version == 1) {
+        get_cgroup_path(version, "freezer", cgroup_name, cgroup_path, sizeof(cgroup_path));
+        if (write_cgroup_file(cgroup_path, "freezer.state", frozen ? "FROZEN" : "THAWED") != 0) {
+            return -1;
+        }
+        // v1 在所有進程停下前顯示 FREEZING
+        for (int waited_ms = 0; frozen && waited_ms < CGROUP_TEARDOWN_TIMEOUT_MS; waited_ms++) {
+            if (read_cgroup_file(cgroup_path, "freezer.state", state, sizeof(state)) == 0 && strcmp(state, "FROZEN") == 0) {
+                return 0;
+            }
+            usleep(1000);
+        }
+        if (frozen) {
+            write_cgroup_file(cgroup_path, "freezer.state", "THAWED");
+            return -1;
+        }
+        return 0;
+    }
+    return -1;
+}
+
 // 清理 cgroup
-void cleanup_cgroup(const char* cgroup_name) {
+int cleanup_cgroup(const char* cgroup_name) {
     int cgroup_version = detect_cgroup_version();
     char cgroup_path[512];
+    int result = 0;
     
     if (cgroup_version == 2) {
         snprintf(cgroup_path, sizeof(cgroup_path), "%s/%s", CGROUP_ROOT, cgroup_name);
-        rmdir(cgroup_path);
+        if (access(cgroup_path, F_OK) != 0) {
+            return 0;
+        }
+        kill_cgroup_v2(cgroup_path);
+        if (wait_cgroup_event_v2(cgroup_path, "populated 0", CGROUP_TEARDOWN_TIMEOUT_MS) != 0) {
+            fprintf(stderr, "警告: cgroup %s 中仍有進程未退出\n", cgroup_name);
+        }
+        if (rmdir(cgroup_path) == -1 && errno != ENOENT) {
+            fprintf(stderr, "警告: 無法刪除 cgroup %s: %s\n", cgroup_path, strerror(errno));
+            result = -1;
+        }
     } else if (cgroup_version == 1) {
+        // v1 沒有 cgroup.kill：先凍結，終止所有進程後解凍讓 SIGKILL 生效
+        char freezer_path[512];
+        snprintf(freezer_path, sizeof(freezer_path), "/sys/fs/cgroup/freezer/%s", cgroup_name);
+        if (access(freezer_path, F_OK) == 0) {
+            write_cgroup_file(freezer_path, "freezer.state", "FROZEN");
+            kill_listed_tasks(freezer_path, "tasks");
+            write_cgroup_file(freezer_path, "freezer.state", "THAWED");
+        }
+        
         // 清理各個子系統的 cgroup
-        char* subsystems[] = {"memory", "cpu", "pids", NULL};
+        char* subsystems[] = {"memory", "cpu", "cpuacct", "pids", "cpuset", "blkio", "freezer", NULL};
         for (int i = 0; subsystems[i]; i++) {
             snprintf(cgroup_path, sizeof(cgroup_path), 
                      "/sys/fs/cgroup/%s/%s", subsystems[i], cgroup_name);
-            rmdir(cgroup_path);
+            if (access(cgroup_path, F_OK) != 0) {
+                continue;
+            }
+            kill_listed_tasks(cgroup_path, "tasks");
+            
+            // v1 沒有 populated 事件通知，以遞增間隔短暫等待進程退出
+            long delay_us = 100;
+            long waited_us = 0;
+            while (!tasks_empty_v1(cgroup_path) && waited_us < CGROUP_TEARDOWN_TIMEOUT_MS * 1000L) {
+                usleep(delay_us);
+                waited_us += delay_us;
+                if (delay_us < 50000) delay_us *= 2;
+            }
+            if (rmdir(cgroup_path) == -1 && errno != ENOENT) {
+                fprintf(stderr, "警告: 無法刪除 cgroup %s: %s\n", cgroup_path, strerror(errno));
+                result = -1;
+            }
         }
     }
+    return result;
 }
-
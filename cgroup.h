@@ -6,44 +6,109 @@
 // cgroup root directory version 2
 #define CGROUP_ROOT "/sys/fs/cgroup"
 
+// 預設的 CFS 帶寬控制週期（微秒）
+#define CGROUP_DEFAULT_CPU_PERIOD_US 100000
+
+// 清理 cgroup 時等待進程退出的最長時間（毫秒）
+#define CGROUP_TEARDOWN_TIMEOUT_MS 5000
+
 // 資源限制配置結構
 typedef struct {
     long memory_limit_mb;      // 記憶體限制 (MB)
+    long memory_high_mb;       // 記憶體節流閾值 (MB)，超過後內核主動回收而不是 OOM，0 表示不設置
+    long memory_low_mb;        // 盡力保護的記憶體 (MB)，0 表示不設置
+    long memory_min_mb;        // 硬保護的記憶體 (MB)，0 表示不設置
+    long memory_swap_max_mb;   // swap 上限 (MB)，0 表示禁用 swap，-1 表示不限制（不寫入）
+    long memory_zswap_max_mb;  // zswap 上限 (MB)，0 表示禁用 zswap，-1 表示不限制
+    int memory_oom_group;      // 1 表示 OOM 時整個容器一起終止
     int cpu_shares;            // CPU 份額 (預設 1024)
-    int cpu_quota_us;          // CPU 配額 (微秒/100ms週期)
+    int cpu_quota_us;          // CPU 配額 (微秒/週期)
+    int cpu_period_us;         // CFS 週期 (微秒，1000-1000000)，0 表示預設的 100000
+    int cpu_burst_us;          // 可累積到之後週期使用的未用配額上限 (微秒，不超過配額)，0 表示不允許突發
+    int cpu_idle;              // 1 表示設置 cpu.idle，cgroup 只在 CPU 閒置時運行
+    int cpu_uclamp_min;        // cpu.uclamp.min (%)，0 表示不設置
+    int cpu_uclamp_max;        // cpu.uclamp.max (%)，0 表示不設置
     int pids_max;              // 最大進程數
+    char io_max[256];          // I/O 限制，io.max 格式 "MAJ:MIN rbps=N wbps=N riops=N wiops=N"，空字串表示不限制
+    char cpuset_cpus[256];     // 綁定的 CPU 列表 (cpulist 格式，空字串表示不綁定)
+    char cpuset_mems[64];      // 綁定的 NUMA 節點列表 (空字串表示不綁定)
 } cgroup_limits_t;
 
+// update_cgroup_limits() 的欄位掩碼，標記要修改的限制
+#define CGROUP_SET_MEMORY_MAX   (1u << 0)
+#define CGROUP_SET_MEMORY_HIGH  (1u << 1)
+#define CGROUP_SET_MEMORY_LOW   (1u << 2)
+#define CGROUP_SET_MEMORY_MIN   (1u << 3)
+#define CGROUP_SET_MEMORY_SWAP  (1u << 4)
+#define CGROUP_SET_MEMORY_ZSWAP (1u << 5)
+#define CGROUP_SET_OOM_GROUP    (1u << 6)
+#define CGROUP_SET_CPU_SHARES   (1u << 7)
+#define CGROUP_SET_CPU_QUOTA    (1u << 8)
+#define CGROUP_SET_PIDS         (1u << 9)
+#define CGROUP_SET_IO           (1u << 10)
+#define CGROUP_SET_CPU_PERIOD   (1u << 11)
+#define CGROUP_SET_CPU_BURST    (1u << 12)
+
 /**
  * 寫入 cgroup 檔案的輔助函數
  * @param cgroup_path cgroup 路徑
  * @param filename 檔案名稱
  * @param value 要寫入的值
- * @return 0 成功，-1 失敗
+ * @return 0 成功，-1 失敗（errno 為失敗原因，不輸出錯誤信息）
  */
 int write_cgroup_file(const char* cgroup_path, const char* filename, const char* value);
 
+/**
+ * 讀取 cgroup 檔案的輔助函數（去掉結尾換行）
+ * @param cgroup_path cgroup 路徑
+ * @param filename 檔案名稱
+ * @param buffer 輸出緩衝區
+ * @param size 緩衝區大小
+ * @return 0 成功，-1 失敗
+ */
+int read_cgroup_file(const char* cgroup_path, const char* filename, char* buffer, size_t size);
+
+/**
+ * 檢查資源限制配置是否自洽（例如 memory.high 不應超過 memory.max）
+ * @param limits 資源限制配置
+ * @return 0 有效，-1 無效（已輸出錯誤信息）
+ */
+int validate_cgroup_limits(const cgroup_limits_t* limits);
+
 /**
  * 檢測 cgroup 版本 (v1 或 v2)
  * @return 2 為 cgroup v2, 1 為 cgroup v1, 0 為不支援
  */
 int detect_cgroup_version(void);
 
+/**
+ * 取得某個控制器下容器 cgroup 的路徑
+ * cgroup v2 所有控制器共用同一個目錄，v1 則為 /sys/fs/cgroup/<controller>/<name>
+ * @param version cgroup 版本 (detect_cgroup_version() 的返回值)
+ * @param controller 控制器名稱 (例如 "memory", "cpu")
+ * @param cgroup_name cgroup 名稱
+ * @param path 輸出路徑
+ * @param size 緩衝區大小
+ */
+void get_cgroup_path(int version, const char* controller, const char* cgroup_name, char* path, size_t size);
+
 /**
  * 創建並配置 cgroup v2
+ * 每項未能套用的限制都會輸出警告（文件路徑、寫入值與原因）
  * @param pid 進程 ID
  * @param limits 資源限制配置
  * @param cgroup_name cgroup 名稱
- * @return 0 成功，-1 失敗
+ * @return 0 所有限制都已套用，-1 有限制未能套用
  */
 int setup_cgroup_v2(pid_t pid, const cgroup_limits_t* limits, const char* cgroup_name);
 
 /**
  * 創建並配置 cgroup v1
+ * 每項未能套用的限制都會輸出警告（文件路徑、寫入值與原因）
  * @param pid 進程 ID
  * @param limits 資源限制配置
  * @param cgroup_name cgroup 名稱
- * @return 0 成功，-1 失敗
+ * @return 0 所有限制都已套用，-1 有限制未能套用
  */
 int setup_cgroup_v1(pid_t pid, const cgroup_limits_t* limits, const char* cgroup_name);
 
@@ -52,15 +117,47 @@ int setup_cgroup_v1(pid_t pid, const cgroup_limits_t* limits, const char* cgroup
  * @param pid 進程 ID
  * @param limits 資源限制配置
  * @param cgroup_name cgroup 名稱
- * @return 0 成功，-1 失敗
+ * @return 0 所有限制都已套用，-1 有限制未能套用（已輸出警告）
  */
 int setup_cgroup_limits(pid_t pid, const cgroup_limits_t* limits, const char* cgroup_name);
 
+/**
+ * 把進程加入已存在的容器 cgroup（v1 為每個已創建的控制器）
+ * @param pid 進程 ID
+ * @param cgroup_name cgroup 名稱
+ * @return 0 成功，-1 失敗
+ */
+int join_cgroup(pid_t pid, const char* cgroup_name);
+
+/**
+ * 就地修改運行中容器的資源限制
+ * 只修改 mask 中標記的欄位，每項修改寫入前都會先檢查，
+ * 例如 memory.max 不能縮小到 memory.current 以下（除非 force）
+ * @param cgroup_name cgroup 名稱
+ * @param limits 新的資源限制（只讀取 mask 標記的欄位）
+ * @param mask CGROUP_SET_* 掩碼
+ * @param force 是否允許把限制縮小到目前用量以下
+ * @return 0 成功，-1 失敗（已輸出錯誤信息）
+ */
+int update_cgroup_limits(const char* cgroup_name, const cgroup_limits_t* limits, unsigned int mask, int force);
+
+/**
+ * 凍結或解凍容器 cgroup 中的所有進程（v2 cgroup.freeze，v1 freezer.state）
+ * 凍結時等待所有進程真正停下後才返回；逾時未能全部停下時解凍後返回 -1，不會留下凍結的 cgroup
+ * @param cgroup_name cgroup 名稱
+ * @param frozen 1 凍結，0 解凍
+ * @return 0 成功，-1 失敗
+ */
+int freeze_cgroup(const char* cgroup_name, int frozen);
+
 /**
  * 清理 cgroup
+ * 先終止 cgroup 中的所有進程（v2 使用 cgroup.kill，v1 凍結後終止），
+ * 等待 cgroup 變為空（v2 以 poll 等待 cgroup.events 的 populated 0）後刪除
  * @param cgroup_name cgroup 名稱
+ * @return 0 成功，-1 cgroup 未能刪除
  */
-void cleanup_cgroup(const char* cgroup_name);
+int cleanup_cgroup(const char* cgroup_name);
 
 #endif // CGROUP_H
 
@@ -0,0 +1,302 @@
+#include "codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <zlib.h>
+
+// libzstd 的流式 API（穩定 ABI，只在執行時載入，編譯時不需要 zstd.h）
+typedef struct { const void* src; size_t size; size_t pos; } zstd_in_buffer_t;
+typedef struct { void* dst; size_t size; size_t pos; } zstd_out_buffer_t;
+
+// zstd.h 中的參數編號（穩定 API）
+#define ZSTD_C_COMPRESSION_LEVEL 100
+#define ZSTD_C_WINDOW_LOG 101
+#define ZSTD_C_ENABLE_LDM 160
+#define ZSTD_C_CHECKSUM_FLAG 201
+#define ZSTD_C_NB_WORKERS 400
+#define ZSTD_E_CONTINUE 0
+#define ZSTD_E_END 2
+
+// 長距離匹配的窗口：2^27 = 128 MB，等於解壓端預設允許的上限，不需要 --long 參數即可解壓
+#define ZSTD_LDM_WINDOW_LOG 27
+
+static struct {
+    void* handle;
+    void* (*create_dstream)(void);
+    size_t (*free_dstream)(void*);
+    size_t (*decompress_stream)(void*, zstd_out_buffer_t*, zstd_in_buffer_t*);
+    unsigned (*is_error)(size_t);
+    void* (*create_cctx)(void);
+    size_t (*free_cctx)(void*);
+    size_t (*set_parameter)(void*, int, int);
+    size_t (*compress_stream2)(void*, zstd_out_buffer_t*, zstd_in_buffer_t*, int);
+} zstd;
+
+static pthread_once_t zstd_once = PTHREAD_ONCE_INIT;
+
+static void zstd_load(void) {
+    void* handle = dlopen("libzstd.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        return;
+    }
+    *(void**)&zstd.create_dstream = dlsym(handle, "ZSTD_createDStream");
+    *(void**)&zstd.free_dstream = dlsym(handle, "ZSTD_freeDStream");
+    *(void**)&zstd.decompress_stream = dlsym(handle, "ZSTD_decompressStream");
+    *(void**)&zstd.is_error = dlsym(handle, "ZSTD_isError");
+    *(void**)&zstd.create_cctx = dlsym(handle, "ZSTD_createCCtx");
+    *(void**)&zstd.free_cctx = dlsym(handle, "ZSTD_freeCCtx");
+    *(void**)&zstd.set_parameter = dlsym(handle, "ZSTD_CCtx_setParameter");
+    *(void**)&zstd.compress_stream2 = dlsym(handle, "ZSTD_compressStream2");
+    if (zstd.create_dstream && zstd.free_dstream && zstd.decompress_stream && zstd.is_error &&
+        zstd.create_cctx && zstd.free_cctx && zstd.set_parameter && zstd.compress_stream2) {
+        zstd.handle = handle;
+    } else {
+        dlclose(handle);
+    }
+}
+
+codec_type_t codec_detect(const unsigned char* data, size_t len) {
+    if (len >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+        return CODEC_GZIP;
+    }
+    if (len >= 4 && data[0] == 0x28 && data[1] == 0xb5 && data[2] == 0x2f && data[3] == 0xfd) {
+        return CODEC_ZSTD;
+    }
+    return CODEC_NONE;
+}
+
+const char* codec_name(codec_type_t type) {
+    switch (type) {
+    case CODEC_GZIP: return "gzip";
+    case CODEC_ZSTD: return "zstd";
+    default:         return "none";
+    }
+}
+
+int codec_parse(const char* name, codec_type_t* type) {
+    for (int i = CODEC_NONE; i <= CODEC_ZSTD; i++) {
+        if (strcmp(name, codec_name((codec_type_t)i)) == 0) {
+            *type = (codec_type_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int codec_available(codec_type_t type) {
+    if (type == CODEC_ZSTD) {
+        pthread_once(&zstd_once, zstd_load);
+        return zstd.handle != NULL;
+    }
+    return 1;
+}
+
+int decoder_init(decoder_t* decoder, codec_type_t type) {
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->type = type;
+
+    if (type == CODEC_GZIP) {
+        z_stream* strm = calloc(1, sizeof(z_stream));
+        // 15 + 32：自動識別 gzip / zlib 頭部
+        if (!strm || inflateInit2(strm, 15 + 32) != Z_OK) {
+            free(strm);
+            return -1;
+        }
+        decoder->stream = strm;
+    } else if (type == CODEC_ZSTD) {
+        if (!codec_available(CODEC_ZSTD) || !(decoder->stream = zstd.create_dstream())) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// gzip：支援多個串接的成員（例如分段壓縮的層）
+static ssize_t gzip_run(decoder_t* decoder, const unsigned char** in, size_t* in_len, unsigned char* out, size_t out_size) {
+    z_stream* strm = decoder->stream;
+
+    strm->next_in = (unsigned char*)*in;
+    strm->avail_in = (uInt)*in_len;
+    strm->next_out = out;
+    strm->avail_out = (uInt)out_size;
+    while (strm->avail_out > 0 && strm->avail_in > 0) {
+        if (decoder->finished) {
+            inflateReset(strm);
+            decoder->finished = 0;
+        }
+        int ret = inflate(strm, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            decoder->finished = 1;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return -1;
+        } else if (ret == Z_BUF_ERROR) {
+            break;
+        }
+    }
+    *in = strm->next_in;
+    *in_len = strm->avail_in;
+    return (ssize_t)(out_size - strm->avail_out);
+}
+
+static ssize_t zstd_run(decoder_t* decoder, const unsigned char** in, size_t* in_len, unsigned char* out, size_t out_size) {
+    zstd_in_buffer_t input = {*in, *in_len, 0};
+    zstd_out_buffer_t output = {out, out_size, 0};
+
+    while (output.pos < output.size && input.pos < input.size) {
+        size_t before = input.pos + output.pos;
+        size_t ret = zstd.decompress_stream(decoder->stream, &output, &input);
+        if (zstd.is_error(ret)) {
+            return -1;
+        }
+        // 返回 0 表示一個 frame 已完整解壓
+        decoder->finished = ret == 0;
+        if (input.pos + output.pos == before) {
+            break;
+        }
+    }
+    *in += input.pos;
+    *in_len -= input.pos;
+    return (ssize_t)output.pos;
+}
+
+ssize_t decoder_run(decoder_t* decoder, const unsigned char** in, size_t* in_len, unsigned char* out, size_t out_size) {
+    switch (decoder->type) {
+    case CODEC_GZIP:
+        return gzip_run(decoder, in, in_len, out, out_size);
+    case CODEC_ZSTD:
+        return zstd_run(decoder, in, in_len, out, out_size);
+    default: {
+        size_t n = *in_len < out_size ? *in_len : out_size;
+        memcpy(out, *in, n);
+        *in += n;
+        *in_len -= n;
+        decoder->finished = 1;
+        return (ssize_t)n;
+    }
+    }
+}
+
+void decoder_free(decoder_t* decoder) {
+    if (decoder->type == CODEC_GZIP && decoder->stream) {
+        inflateEnd(decoder->stream);
+        free(decoder->stream);
+    } else if (decoder->type == CODEC_ZSTD && decoder->stream) {
+        zstd.free_dstream(decoder->stream);
+    }
+    decoder->stream = NULL;
+}
+
+int encoder_init(encoder_t* encoder, codec_type_t type, int level, int threads) {
+    memset(encoder, 0, sizeof(*encoder));
+    encoder->type = type;
+
+    if (type == CODEC_GZIP) {
+        z_stream* strm = calloc(1, sizeof(z_stream));
+        // 15 + 16：輸出 gzip 頭部
+        if (!strm || deflateInit2(strm, level > 0 ? level : Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                                  Z_DEFAULT_STRATEGY) != Z_OK) {
+            free(strm);
+            return -1;
+        }
+        encoder->stream = strm;
+    } else if (type == CODEC_ZSTD) {
+        if (!codec_available(CODEC_ZSTD) || !(encoder->stream = zstd.create_cctx())) {
+            return -1;
+        }
+        if (zstd.is_error(zstd.set_parameter(encoder->stream, ZSTD_C_COMPRESSION_LEVEL, level > 0 ? level : 3)) ||
+            zstd.is_error(zstd.set_parameter(encoder->stream, ZSTD_C_ENABLE_LDM, 1)) ||
+            zstd.is_error(zstd.set_parameter(encoder->stream, ZSTD_C_WINDOW_LOG, ZSTD_LDM_WINDOW_LOG)) ||
+            zstd.is_error(zstd.set_parameter(encoder->stream, ZSTD_C_CHECKSUM_FLAG, 1))) {
+            encoder_free(encoder);
+            return -1;
+        }
+        // 沒有以多線程編譯的 libzstd 會拒絕此參數，退回單線程壓縮
+        if (threads > 0 && zstd.is_error(zstd.set_parameter(encoder->stream, ZSTD_C_NB_WORKERS, threads))) {
+            fprintf(stderr, "警告: libzstd 不支援多線程壓縮，改用單線程\n");
+        }
+    }
+    return 0;
+}
+
+int encoder_init_frames(encoder_t* encoder, int level) {
+    memset(encoder, 0, sizeof(*encoder));
+    encoder->type = CODEC_ZSTD;
+    if (!codec_available(CODEC_ZSTD) || !(encoder->stream = zstd.create_cctx())) {
+        return -1;
+    }
+    if (zstd.is_error(zstd.set_parameter(encoder->stream, ZSTD_C_COMPRESSION_LEVEL, level > 0 ? level : 3)) ||
+        zstd.is_error(zstd.set_parameter(encoder->stream, ZSTD_C_CHECKSUM_FLAG, 1))) {
+        encoder_free(encoder);
+        return -1;
+    }
+    return 0;
+}
+
+static ssize_t gzip_encode(encoder_t* encoder, const unsigned char** in, size_t* in_len, unsigned char* out, size_t out_size, int finish) {
+    z_stream* strm = encoder->stream;
+
+    strm->next_in = (unsigned char*)*in;
+    strm->avail_in = (uInt)*in_len;
+    strm->next_out = out;
+    strm->avail_out = (uInt)out_size;
+    int ret = deflate(strm, finish ? Z_FINISH : Z_NO_FLUSH);
+    if (ret == Z_STREAM_ERROR) {
+        return -1;
+    }
+    encoder->finished = ret == Z_STREAM_END;
+    *in = strm->next_in;
+    *in_len = strm->avail_in;
+    return (ssize_t)(out_size - strm->avail_out);
+}
+
+static ssize_t zstd_encode(encoder_t* encoder, const unsigned char** in, size_t* in_len, unsigned char* out, size_t out_size, int finish) {
+    zstd_in_buffer_t input = {*in, *in_len, 0};
+    zstd_out_buffer_t output = {out, out_size, 0};
+
+    // 多線程模式下壓縮在背景的工作線程中進行，這裡只是交出輸入、取回已完成的輸出
+    size_t ret = zstd.compress_stream2(encoder->stream, &output, &input, finish ? ZSTD_E_END : ZSTD_E_CONTINUE);
+    if (zstd.is_error(ret)) {
+        return -1;
+    }
+    // ZSTD_e_end 返回 0 表示 frame 已完整寫出
+    encoder->finished = finish && ret == 0;
+    *in += input.pos;
+    *in_len -= input.pos;
+    return (ssize_t)output.pos;
+}
+
+ssize_t encoder_run(encoder_t* encoder, const unsigned char** in, size_t* in_len, unsigned char* out, size_t out_size, int finish) {
+    // 上一個 frame 已結束：zstd 自動開始新的 frame，gzip 需要重置後輸出新的成員
+    if (encoder->finished) {
+        if (encoder->type == CODEC_GZIP) {
+            deflateReset(encoder->stream);
+        }
+        encoder->finished = 0;
+    }
+    switch (encoder->type) {
+    case CODEC_GZIP:
+        return gzip_encode(encoder, in, in_len, out, out_size, finish);
+    case CODEC_ZSTD:
+        return zstd_encode(encoder, in, in_len, out, out_size, finish);
+    default: {
+        size_t n = *in_len < out_size ? *in_len : out_size;
+        memcpy(out, *in, n);
+        *in += n;
+        *in_len -= n;
+        encoder->finished = finish && *in_len == 0;
+        return (ssize_t)n;
+    }
+    }
+}
+
+void encoder_free(encoder_t* encoder) {
+    if (encoder->type == CODEC_GZIP && encoder->stream) {
+        deflateEnd(encoder->stream);
+        free(encoder->stream);
+    } else if (encoder->type == CODEC_ZSTD && encoder->stream) {
+        zstd.free_cctx(encoder->stream);
+    }
+    encoder->stream = NULL;
+}
@@ -0,0 +1,127 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// 層內容的壓縮格式
+typedef enum {
+    CODEC_NONE = 0,            // 未壓縮的 tar
+    CODEC_GZIP,                // gzip（zlib）
+    CODEC_ZSTD                 // zstd（執行時以 dlopen 載入 libzstd.so.1）
+} codec_type_t;
+
+// 流式解壓縮器
+typedef struct {
+    codec_type_t type;
+    void* stream;              // z_stream* 或 ZSTD_DStream*
+    int finished;              // 是否已讀到壓縮流的結尾
+} decoder_t;
+
+// 流式壓縮器
+typedef struct {
+    codec_type_t type;
+    void* stream;              // z_stream* 或 ZSTD_CCtx*
+    int finished;              // 壓縮流是否已完整輸出（結尾已寫出）
+} encoder_t;
+
+/**
+ * 根據開頭的魔數判斷壓縮格式
+ * @param data 數據開頭
+ * @param len 長度
+ * @return 壓縮格式
+ */
+codec_type_t codec_detect(const unsigned char* data, size_t len);
+
+/**
+ * 壓縮格式的名稱
+ * @param type 壓縮格式
+ * @return 名稱
+ */
+const char* codec_name(codec_type_t type);
+
+/**
+ * 檢查壓縮格式是否可用（zstd 需要系統中有 libzstd.so.1）
+ * @param type 壓縮格式
+ * @return 1 可用，0 不可用
+ */
+int codec_available(codec_type_t type);
+
+/**
+ * 初始化解壓縮器
+ * @param decoder 解壓縮器
+ * @param type 壓縮格式
+ * @return 0 成功，-1 失敗
+ */
+int decoder_init(decoder_t* decoder, codec_type_t type);
+
+/**
+ * 解壓縮一段輸入
+ * 消耗 *in / *in_len 中的數據，最多輸出 out_size 位元組；
+ * 輸出未填滿且輸入已耗盡時，表示目前的輸入已全部解壓
+ * @param decoder 解壓縮器
+ * @param in 輸入指針（會前移）
+ * @param in_len 剩餘輸入長度（會減少）
+ * @param out 輸出緩衝區
+ * @param out_size 輸出緩衝區大小
+ * @return 輸出的位元組數，-1 數據損壞
+ */
+ssize_t decoder_run(decoder_t* decoder, const unsigned char** in, size_t* in_len, unsigned char* out, size_t out_size);
+
+/**
+ * 釋放解壓縮器
+ * @param decoder 解壓縮器
+ */
+void decoder_free(decoder_t* decoder);
+
+/**
+ * 根據名稱取得壓縮格式
+ * @param name "gzip" / "zstd" / "none"
+ * @param type 輸出的壓縮格式
+ * @return 0 成功，-1 無效的名稱
+ */
+int codec_parse(const char* name, codec_type_t* type);
+
+/**
+ * 初始化壓縮器
+ * zstd 啟用長距離匹配（窗口 128 MB，仍在解壓端的預設上限之內），threads > 0 時以多個工作線程壓縮
+ * @param encoder 壓縮器
+ * @param type 壓縮格式
+ * @param level 壓縮等級，0 表示該格式的預設值
+ * @param threads zstd 的工作線程數，0 表示單線程
+ * @return 0 成功，-1 失敗
+ */
+int encoder_init(encoder_t* encoder, codec_type_t type, int level, int threads);
+
+/**
+ * 初始化以多個獨立 frame 輸出的 zstd 壓縮器（可隨機讀取的層）
+ * 不啟用長距離匹配、窗口保持預設大小，解壓單個 frame 只需要幾 MB 記憶體
+ * @param encoder 壓縮器
+ * @param level 壓縮等級，0 表示預設值
+ * @return 0 成功，-1 失敗
+ */
+int encoder_init_frames(encoder_t* encoder, int level);
+
+/**
+ * 壓縮一段輸入
+ * 消耗 *in / *in_len 中的數據，最多輸出 out_size 位元組；
+ * finish 為 0 時，輸出未填滿表示輸入已全部交給壓縮器；
+ * finish 為 1 時（輸入已是最後一段），需重複調用直到 encoder->finished；
+ * 結束後再次調用會開始新的 frame（gzip 為新的成員），解壓端把它們當作連續的數據
+ * @param encoder 壓縮器
+ * @param in 輸入指針（會前移）
+ * @param in_len 剩餘輸入長度（會減少）
+ * @param out 輸出緩衝區
+ * @param out_size 輸出緩衝區大小
+ * @param finish 是否結束壓縮流
+ * @return 輸出的位元組數，-1 失敗
+ */
+ssize_t encoder_run(encoder_t* encoder, const unsigned char** in, size_t* in_len, unsigned char* out, size_t out_size, int finish);
+
+/**
+ * 釋放壓縮器
+ * @param encoder 壓縮器
+ */
+void encoder_free(encoder_t* encoder);
+
+#endif // CODEC_H
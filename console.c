@@ -0,0 +1,607 @@
+#include "console.h"
+#include "runtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+// attach 連線的第一個訊息
+typedef struct {
+    char type;                 // 'A' = attach，'W' = 只更新視窗大小
+    struct winsize ws;
+} console_hello_t;
+
+// 轉發進程回覆 attach 的狀態
+#define CONSOLE_ATTACH_OK 0
+#define CONSOLE_ATTACH_BUSY 1
+
+#define CONSOLE_CHUNK 65536
+
+// 回滾緩衝區（只存在於轉發進程中）
+static char scrollback[CONSOLE_SCROLLBACK_SIZE];
+static size_t scrollback_total;  // 累計寫入的位元組數，取模即為寫入位置
+
+static void scrollback_append(const char* data, size_t len) {
+    if (len > CONSOLE_SCROLLBACK_SIZE) {
+        data += len - CONSOLE_SCROLLBACK_SIZE;
+        scrollback_total += len - CONSOLE_SCROLLBACK_SIZE;
+        len = CONSOLE_SCROLLBACK_SIZE;
+    }
+    size_t pos = scrollback_total % CONSOLE_SCROLLBACK_SIZE;
+    size_t first = CONSOLE_SCROLLBACK_SIZE - pos < len ? CONSOLE_SCROLLBACK_SIZE - pos : len;
+    memcpy(scrollback + pos, data, first);
+    memcpy(scrollback, data + first, len - first);
+    scrollback_total += len;
+}
+
+static int write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// 依時間順序把回滾緩衝區寫給剛 attach 的終端
+static int scrollback_replay(int fd) {
+    size_t pos = scrollback_total % CONSOLE_SCROLLBACK_SIZE;
+
+    if (scrollback_total > CONSOLE_SCROLLBACK_SIZE &&
+        write_all(fd, scrollback + pos, CONSOLE_SCROLLBACK_SIZE - pos) != 0) {
+        return -1;
+    }
+    return write_all(fd, scrollback, pos);
+}
+
+void console_socket_path(const char* container_id, char* path, size_t size) {
+    char dir[256];
+    container_runtime_path(container_id, dir, sizeof(dir));
+    snprintf(path, size, "%s/console.sock", dir);
+}
+
+int console_open(console_t* console, const char* container_id) {
+    console->relay_pid = -1;
+    console->slave = -1;
+    console->log.fd = -1;
+    console_socket_path(container_id, console->socket_path, sizeof(console->socket_path));
+
+    console->master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (console->master == -1) {
+        return -1;
+    }
+    if (grantpt(console->master) == -1 || unlockpt(console->master) == -1) {
+        close(console->master);
+        return -1;
+    }
+    // 從端在 runtime 中打開後由 clone 繼承：容器掛載自己的 devpts 之後就看不到主機的 /dev/pts
+    console->slave = open(ptsname(console->master), O_RDWR | O_NOCTTY);
+    if (console->slave == -1) {
+        close(console->master);
+        return -1;
+    }
+
+    // 初始視窗大小取自啟動容器的終端
+    struct winsize ws;
+    if (ioctl(STDIN_FILENO, TIOCGWINSZ, &ws) == 0) {
+        ioctl(console->master, TIOCSWINSZ, &ws);
+    }
+    return 0;
+}
+
+int console_setup_slave(int slave) {
+    if (setsid() == -1 || ioctl(slave, TIOCSCTTY, 0) == -1) {
+        return -1;
+    }
+    for (int fd = 0; fd <= 2; fd++) {
+        if (dup2(slave, fd) == -1) {
+            return -1;
+        }
+    }
+    if (slave > 2) {
+        close(slave);
+    }
+    return 0;
+}
+
+// 轉發進程的狀態
+typedef struct {
+    int master;
+    int client;                // 目前 attach 的連線，-1 表示沒有
+    int epoll_fd;
+    int use_splice;            // 內核不支援 tty splice 時退回 read/write
+    int out_pipe[2];           // 主端 -> 連線
+    int copy_pipe[2];          // tee 出的副本 -> 回滾緩衝區
+    int in_pipe[2];            // 連線 -> 主端
+    int log_pipe[2];           // tee 出的副本 -> 日誌文件（有連線時使用）
+    log_writer_t* log;
+    int throttled;             // 超出日誌速率，暫停讀取主端
+    struct timespec resume_at; // 恢復讀取的時間
+} relay_t;
+
+// 丟棄管道中剩餘的資料
+static void drain_pipe(int fd) {
+    char buf[CONSOLE_CHUNK];
+    int avail;
+
+    while (ioctl(fd, FIONREAD, &avail) == 0 && avail > 0) {
+        if (read(fd, buf, avail < CONSOLE_CHUNK ? avail : CONSOLE_CHUNK) <= 0) {
+            break;
+        }
+    }
+}
+
+static void relay_drop_client(relay_t* relay) {
+    if (relay->client < 0) {
+        return;
+    }
+    epoll_ctl(relay->epoll_fd, EPOLL_CTL_DEL, relay->client, NULL);
+    close(relay->client);
+    relay->client = -1;
+}
+
+// 把主端的輸出 splice 到管道，tee 一份給回滾緩衝區，再 splice 到日誌文件和已 attach 的連線
+// @return 搬運的位元組數，0 暫無資料，-1 主端已掛斷
+static ssize_t relay_output_splice(relay_t* relay) {
+    char buf[CONSOLE_CHUNK];
+
+    ssize_t n = splice(relay->master, NULL, relay->out_pipe[1], NULL, CONSOLE_CHUNK, SPLICE_F_NONBLOCK);
+    if (n == -1 && errno == EINVAL) {
+        relay->use_splice = 0;
+        return 0;
+    }
+    if (n == -1) {
+        return errno == EAGAIN || errno == EINTR ? 0 : -1;
+    }
+    if (n == 0) {
+        return -1;
+    }
+
+    // tee 不消耗管道中的資料，只複製頁面引用
+    ssize_t copied = tee(relay->out_pipe[0], relay->copy_pipe[1], n, SPLICE_F_NONBLOCK);
+    if (copied > 0) {
+        ssize_t r = read(relay->copy_pipe[0], buf, copied);
+        if (r > 0) {
+            scrollback_append(buf, r);
+        }
+    }
+
+    if (relay->log->fd >= 0) {
+        if (relay->client < 0) {
+            // 沒有連線時直接把管道中的資料移到日誌文件
+            log_write_pipe(relay->log, relay->out_pipe[0], n);
+        } else {
+            copied = tee(relay->out_pipe[0], relay->log_pipe[1], n, 0);
+            if (copied > 0 && log_write_pipe(relay->log, relay->log_pipe[0], copied) != 0) {
+                drain_pipe(relay->log_pipe[0]);
+            }
+        }
+    }
+
+    ssize_t left = n;
+    while (relay->client >= 0 && left > 0) {
+        ssize_t sent = splice(relay->out_pipe[0], NULL, relay->client, NULL, left, SPLICE_F_MOVE);
+        if (sent == -1 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            // 連線已斷開
+            relay_drop_client(relay);
+            break;
+        }
+        left -= sent;
+    }
+    drain_pipe(relay->out_pipe[0]);
+    return n;
+}
+
+// 主端有輸出時調用
+// @return 0 繼續，-1 主端已掛斷（容器內已沒有進程持有從端）
+static int relay_output(relay_t* relay) {
+    char buf[CONSOLE_CHUNK];
+    ssize_t n = 0;
+
+    // 輸出只進入回滾緩衝區時直接 read 即可
+    if ((relay->client >= 0 || relay->log->fd >= 0) && relay->use_splice) {
+        n = relay_output_splice(relay);
+    }
+    if (n == 0 && (!relay->use_splice || (relay->client < 0 && relay->log->fd < 0))) {
+        n = read(relay->master, buf, sizeof(buf));
+        if (n == -1) {
+            n = errno == EAGAIN || errno == EINTR ? 0 : -1;
+        } else if (n == 0) {
+            n = -1;
+        } else {
+            scrollback_append(buf, n);
+            if (relay->log->fd >= 0) {
+                log_write(relay->log, buf, n);
+            }
+            if (relay->client >= 0 && write_all(relay->client, buf, n) != 0) {
+                relay_drop_client(relay);
+            }
+        }
+    }
+    if (n <= 0) {
+        return n < 0 ? -1 : 0;
+    }
+
+    // 超出日誌速率時暫停讀取主端：容器的寫入在 pty 緩衝區滿後阻塞，而不是丟棄輸出
+    int delay = relay->log->fd >= 0 ? log_throttle_ms(relay->log, n) : 0;
+    if (delay > 0) {
+        struct epoll_event ev = {.events = 0, .data.fd = relay->master};
+        epoll_ctl(relay->epoll_fd, EPOLL_CTL_MOD, relay->master, &ev);
+        clock_gettime(CLOCK_MONOTONIC, &relay->resume_at);
+        relay->resume_at.tv_sec += delay / 1000;
+        relay->resume_at.tv_nsec += (delay % 1000) * 1000000L;
+        if (relay->resume_at.tv_nsec >= 1000000000L) {
+            relay->resume_at.tv_sec++;
+            relay->resume_at.tv_nsec -= 1000000000L;
+        }
+        relay->throttled = 1;
+    }
+    return 0;
+}
+
+// attach 的連線有輸入時調用：socket -> 管道 -> 主端
+static void relay_input(relay_t* relay) {
+    char buf[CONSOLE_CHUNK];
+    ssize_t n;
+
+    if (relay->use_splice) {
+        n = splice(relay->client, NULL, relay->in_pipe[1], NULL, CONSOLE_CHUNK, SPLICE_F_NONBLOCK);
+        if (n > 0) {
+            ssize_t left = n;
+            while (left > 0) {
+                ssize_t w = splice(relay->in_pipe[0], NULL, relay->master, NULL, left, SPLICE_F_MOVE);
+                if (w == -1 && errno == EINTR) {
+                    continue;
+                }
+                if (w <= 0) {
+                    // 主端無法寫入時丟棄這些輸入
+                    while (left > 0 && (w = read(relay->in_pipe[0], buf, left < CONSOLE_CHUNK ? left : CONSOLE_CHUNK)) > 0) {
+                        left -= w;
+                    }
+                    break;
+                }
+                left -= w;
+            }
+            return;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EINTR)) {
+            return;
+        }
+        if (n == -1 && errno == EINVAL) {
+            relay->use_splice = 0;
+            return;
+        }
+    } else {
+        n = read(relay->client, buf, sizeof(buf));
+        if (n > 0) {
+            write_all(relay->master, buf, n);
+            return;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EINTR)) {
+            return;
+        }
+    }
+
+    // 終端已分離
+    relay_drop_client(relay);
+}
+
+// 處理新的連線：attach 或更新視窗大小
+static void relay_accept(relay_t* relay, int listen_fd) {
+    console_hello_t hello;
+    struct timeval timeout = {1, 0};
+
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+    // 客戶端連線後立即送出 hello，避免異常的客戶端卡住轉發進程
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (recv(fd, &hello, sizeof(hello), MSG_WAITALL) != sizeof(hello)) {
+        close(fd);
+        return;
+    }
+    if (hello.ws.ws_row > 0 && hello.ws.ws_col > 0) {
+        ioctl(relay->master, TIOCSWINSZ, &hello.ws);
+    }
+    if (hello.type != 'A') {
+        close(fd);
+        return;
+    }
+
+    char status = relay->client >= 0 ? CONSOLE_ATTACH_BUSY : CONSOLE_ATTACH_OK;
+    if (write_all(fd, &status, 1) != 0 || status != CONSOLE_ATTACH_OK || scrollback_replay(fd) != 0) {
+        close(fd);
+        return;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLRDHUP, .data.fd = fd};
+    if (epoll_ctl(relay->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        close(fd);
+        return;
+    }
+    relay->client = fd;
+}
+
+// 轉發進程主迴圈：沒有事件時阻塞在 epoll_wait 中
+static void relay_loop(int master, int listen_fd, log_writer_t* log) {
+    relay_t relay = {.master = master, .client = -1, .use_splice = 1, .log = log};
+    struct epoll_event events[4];
+
+    relay.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (relay.epoll_fd == -1 ||
+        pipe2(relay.out_pipe, O_CLOEXEC) == -1 ||
+        pipe2(relay.copy_pipe, O_CLOEXEC | O_NONBLOCK) == -1 ||
+        pipe2(relay.in_pipe, O_CLOEXEC) == -1 ||
+        pipe2(relay.log_pipe, O_CLOEXEC) == -1) {
+        return;
+    }
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = master};
+    epoll_ctl(relay.epoll_fd, EPOLL_CTL_ADD, master, &ev);
+    ev.data.fd = listen_fd;
+    epoll_ctl(relay.epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+    for (;;) {
+        // 只有在限速暫停時才需要超時，其餘時間一直阻塞
+        int timeout = -1;
+        if (relay.throttled) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long ms = (relay.resume_at.tv_sec - now.tv_sec) * 1000 + (relay.resume_at.tv_nsec - now.tv_nsec) / 1000000;
+            if (ms <= 0) {
+                ev.events = EPOLLIN;
+                ev.data.fd = master;
+                epoll_ctl(relay.epoll_fd, EPOLL_CTL_MOD, master, &ev);
+                relay.throttled = 0;
+            } else {
+                timeout = (int)ms + 1;
+            }
+        }
+        int n = epoll_wait(relay.epoll_fd, events, 4, timeout);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == master) {
+                // 先讀完剩餘的輸出；從端全部關閉後 read 返回 EIO
+                if (relay_output(&relay) == -1) {
+                    relay_drop_client(&relay);
+                    return;
+                }
+            } else if (fd == listen_fd) {
+                relay_accept(&relay, listen_fd);
+            } else if (fd == relay.client) {
+                if (events[i].events & EPOLLIN) {
+                    relay_input(&relay);
+                } else {
+                    relay_drop_client(&relay);
+                }
+            }
+        }
+    }
+}
+
+int console_start(console_t* console) {
+    struct sockaddr_un addr;
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", console->socket_path);
+    unlink(console->socket_path);
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(listen_fd, 8) == -1) {
+        close(listen_fd);
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(listen_fd);
+        unlink(console->socket_path);
+        return -1;
+    }
+    if (pid == 0) {
+        // 轉發進程隨 runtime 結束，並且不響應終端信號
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        signal(SIGINT, SIG_IGN);
+        signal(SIGQUIT, SIG_IGN);
+        signal(SIGTSTP, SIG_IGN);
+        signal(SIGHUP, SIG_IGN);
+        signal(SIGPIPE, SIG_IGN);
+        close(console->slave);
+        relay_loop(console->master, listen_fd, &console->log);
+        log_writer_close(&console->log);
+        _exit(0);
+    }
+
+    // 日誌文件只由轉發進程寫入
+    close(listen_fd);
+    log_writer_close(&console->log);
+    console->relay_pid = pid;
+    return 0;
+}
+
+void console_stop(console_t* console) {
+    if (console->relay_pid > 0) {
+        // 容器的進程全部結束後轉發進程會自行退出；最多等待 1 秒讓它送完剩餘的輸出
+        for (int i = 0; i < 100; i++) {
+            if (waitpid(console->relay_pid, NULL, WNOHANG) != 0) {
+                console->relay_pid = -1;
+                break;
+            }
+            struct timespec ts = {0, 10 * 1000 * 1000};
+            nanosleep(&ts, NULL);
+        }
+        if (console->relay_pid > 0) {
+            kill(console->relay_pid, SIGKILL);
+            waitpid(console->relay_pid, NULL, 0);
+            console->relay_pid = -1;
+        }
+    }
+    if (console->master >= 0) {
+        close(console->master);
+        console->master = -1;
+    }
+    unlink(console->socket_path);
+}
+
+// 連接到容器的控制台 socket 並送出 hello
+static int console_connect(const char* container_id, char type) {
+    struct sockaddr_un addr;
+    console_hello_t hello;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    console_socket_path(container_id, addr.sun_path, sizeof(addr.sun_path));
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    memset(&hello, 0, sizeof(hello));
+    hello.type = type;
+    ioctl(STDIN_FILENO, TIOCGWINSZ, &hello.ws);
+    if (write_all(fd, (const char*)&hello, sizeof(hello)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static volatile sig_atomic_t window_changed;
+
+static void handle_sigwinch(int sig) {
+    (void)sig;
+    window_changed = 1;
+}
+
+int console_attach(const char* container_id) {
+    char buf[CONSOLE_CHUNK];
+    char status;
+    struct termios saved;
+    int raw = 0;
+    int result = -1;
+    int detach_pending = 0;
+
+    int fd = console_connect(container_id, 'A');
+    if (fd == -1) {
+        fprintf(stderr, "錯誤: 無法連接到容器 %s 的控制台: %s\n", container_id, strerror(errno));
+        return -1;
+    }
+    if (read(fd, &status, 1) != 1 || status != CONSOLE_ATTACH_OK) {
+        fprintf(stderr, "錯誤: 已有其他終端連接到容器 %s\n", container_id);
+        close(fd);
+        return -1;
+    }
+
+    // 終端切換到 raw 模式，讓 Ctrl-C 等按鍵原樣傳給容器
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved) == 0) {
+        struct termios t = saved;
+        cfmakeraw(&t);
+        raw = tcsetattr(STDIN_FILENO, TCSANOW, &t) == 0;
+    }
+
+    // 不使用 SA_RESTART，讓 poll 被 SIGWINCH 打斷
+    struct sigaction sa, old_sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_sigwinch;
+    sigaction(SIGWINCH, &sa, &old_sa);
+
+    struct pollfd fds[2] = {{fd, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+    int nfds = 2;
+    while (result == -1) {
+        if (window_changed) {
+            window_changed = 0;
+            int wfd = console_connect(container_id, 'W');
+            if (wfd != -1) {
+                close(wfd);
+            }
+        }
+        if (poll(fds, nfds, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (fds[0].revents) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0) {
+                result = 1;
+                break;
+            }
+            write_all(STDOUT_FILENO, buf, n);
+        }
+
+        if (nfds > 1 && fds[1].revents) {
+            ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+            if (n <= 0) {
+                // 輸入已結束（例如管道），繼續接收容器輸出
+                nfds = 1;
+                continue;
+            }
+            // 偵測 Ctrl-P Ctrl-Q；其他按鍵原樣送出
+            char out[CONSOLE_CHUNK + 1];
+            size_t len = 0;
+            for (ssize_t i = 0; i < n; i++) {
+                if (detach_pending) {
+                    detach_pending = 0;
+                    if (buf[i] == CONSOLE_DETACH_KEY2) {
+                        result = 0;
+                        break;
+                    }
+                    out[len++] = CONSOLE_DETACH_KEY1;
+                }
+                if (buf[i] == CONSOLE_DETACH_KEY1) {
+                    detach_pending = 1;
+                } else {
+                    out[len++] = buf[i];
+                }
+            }
+            if (len > 0 && write_all(fd, out, len) != 0) {
+                result = 1;
+            }
+        }
+    }
+
+    sigaction(SIGWINCH, &old_sa, NULL);
+    if (raw) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+    }
+    close(fd);
+    return result;
+}
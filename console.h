@@ -0,0 +1,69 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <sys/types.h>
+#include "logs.h"
+
+// 每個容器保留的輸出回滾緩衝區大小（重新 attach 時先重放這些內容）
+#define CONSOLE_SCROLLBACK_SIZE (64 * 1024)
+
+// 分離 (detach) 按鍵序列：Ctrl-P Ctrl-Q（與 docker 相同）
+#define CONSOLE_DETACH_KEY1 0x10
+#define CONSOLE_DETACH_KEY2 0x11
+
+// 容器控制台（pty 主端 + 轉發進程）
+typedef struct {
+    pid_t relay_pid;           // 轉發進程 ID，-1 表示未運行
+    int master;                // pty 主端
+    int slave;                 // pty 從端（傳給容器後由 runtime 關閉）
+    char socket_path[108];     // attach 使用的 unix socket 路徑 (sun_path 的長度)
+    log_writer_t log;          // 容器輸出的日誌（由 console_start 之前的調用者打開）
+} console_t;
+
+/**
+ * 取得容器控制台 socket 的路徑
+ * @param container_id 容器 ID
+ * @param path 輸出緩衝區
+ * @param size 緩衝區大小
+ */
+void console_socket_path(const char* container_id, char* path, size_t size);
+
+/**
+ * 為容器分配 pty 對
+ * @param console 輸出的控制台狀態
+ * @param container_id 容器 ID
+ * @return 0 成功，-1 失敗
+ */
+int console_open(console_t* console, const char* container_id);
+
+/**
+ * 啟動轉發進程：以 epoll 等待 pty 主端與 attach 連線，用 splice 在兩者之間搬運資料
+ * 沒有 attach 時輸出寫入回滾緩衝區，閒置時不消耗 CPU
+ * 日誌已打開時同時把輸出 splice 到日誌文件，並按日誌速率限制讀取 pty
+ * 必須在 clone() 之前調用（轉發進程不持有從端）
+ * @param console 控制台狀態
+ * @return 0 成功，-1 失敗
+ */
+int console_start(console_t* console);
+
+/**
+ * 在容器內把 pty 從端設為控制終端和標準輸入輸出（在 clone 出的子進程中調用）
+ * @param slave pty 從端
+ * @return 0 成功，-1 失敗
+ */
+int console_setup_slave(int slave);
+
+/**
+ * 等待轉發進程送完剩餘輸出後結束，並刪除 socket
+ * @param console 控制台狀態
+ */
+void console_stop(console_t* console);
+
+/**
+ * 把目前的終端連接到容器控制台，直到按下 Ctrl-P Ctrl-Q 或容器退出
+ * @param container_id 容器 ID
+ * @return 0 已分離，1 容器已退出，-1 連接失敗
+ */
+int console_attach(const char* container_id);
+
+#endif // CONSOLE_H
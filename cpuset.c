@@ -0,0 +1,425 @@
+#include "cpuset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <dirent.h>
+#include <sys/file.h>
+
+#define CPUSET_MAX_RECORDS 1024
+
+// 共享狀態文件中的一筆記錄
+typedef struct {
+    char container_id[64];
+    pid_t owner;               // 持有此放置的 runtime 進程
+    int policy;
+    cpu_set_t cpus;
+} cpuset_record_t;
+
+// 解析 cpulist 格式字串（例如 "0-3,8-11"）
+int cpuset_parse_list(const char* list, cpu_set_t* set) {
+    CPU_ZERO(set);
+    const char* p = list;
+
+    while (*p && *p != '\n') {
+        char* end;
+        long start = strtol(p, &end, 10);
+        if (end == p) {
+            return -1;
+        }
+        long stop = start;
+        p = end;
+        if (*p == '-') {
+            p++;
+            stop = strtol(p, &end, 10);
+            if (end == p) {
+                return -1;
+            }
+            p = end;
+        }
+        if (start < 0 || stop >= CPU_SETSIZE || stop < start) {
+            return -1;
+        }
+        for (long cpu = start; cpu <= stop; cpu++) {
+            CPU_SET(cpu, set);
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return 0;
+}
+
+// 將 CPU 集合格式化為 cpulist 字串
+void cpuset_format_list(const cpu_set_t* set, char* buf, size_t size) {
+    size_t len = 0;
+    buf[0] = '\0';
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, set)) {
+            continue;
+        }
+        int stop = cpu;
+        while (stop + 1 < CPU_SETSIZE && CPU_ISSET(stop + 1, set)) {
+            stop++;
+        }
+        int n;
+        if (stop == cpu) {
+            n = snprintf(buf + len, size - len, "%s%d", len ? "," : "", cpu);
+        } else {
+            n = snprintf(buf + len, size - len, "%s%d-%d", len ? "," : "", cpu, stop);
+        }
+        if (n < 0 || (size_t)n >= size - len) {
+            return;
+        }
+        len += n;
+        cpu = stop;
+    }
+}
+
+// 讀取 sysfs 中的 cpulist 文件
+static int read_cpulist_file(const char* path, cpu_set_t* set) {
+    char buffer[1024];
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    if (!fgets(buffer, sizeof(buffer), file)) {
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    return cpuset_parse_list(buffer, set);
+}
+
+// 讀取所有 NUMA 節點的 CPU 列表，沒有 NUMA 信息時視為單一節點 0
+static int read_numa_nodes(cpu_set_t* node_cpus, int max_nodes) {
+    char path[512];
+    int max_node = -1;
+    DIR* dir = opendir("/sys/devices/system/node");
+
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            int node;
+            if (sscanf(entry->d_name, "node%d", &node) != 1 || node < 0 || node >= max_nodes) {
+                continue;
+            }
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+            if (read_cpulist_file(path, &node_cpus[node]) == 0 && CPU_COUNT(&node_cpus[node]) > 0) {
+                if (node > max_node) max_node = node;
+            }
+        }
+        closedir(dir);
+    }
+
+    if (max_node < 0) {
+        if (read_cpulist_file("/sys/devices/system/cpu/online", &node_cpus[0]) != 0) {
+            return -1;
+        }
+        max_node = 0;
+    }
+    return max_node + 1;
+}
+
+// 查找 CPU 所屬的 NUMA 節點
+static int node_of_cpu(const cpu_set_t* node_cpus, int node_count, int cpu) {
+    for (int node = 0; node < node_count; node++) {
+        if (CPU_ISSET(cpu, &node_cpus[node])) {
+            return node;
+        }
+    }
+    return 0;
+}
+
+// 查找 CPU 的最後一級快取所共享的 CPU 列表
+static int read_llc_cpus(int cpu, cpu_set_t* set) {
+    char path[512];
+    int found = -1;
+
+    // index 越大快取層級越高，取最後一個存在的 unified/data 快取
+    for (int index = 0; index < 8; index++) {
+        cpu_set_t candidate;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+        if (read_cpulist_file(path, &candidate) == 0) {
+            *set = candidate;
+            found = 0;
+        }
+    }
+    return found;
+}
+
+// 從 sysfs 讀取主機的 CPU / NUMA 拓撲
+int cpuset_read_topology(cpuset_domain_level_t level, cpuset_topology_t* topo) {
+    static cpu_set_t node_cpus[CPUSET_MAX_DOMAINS];
+    cpu_set_t online;
+
+    memset(topo, 0, sizeof(*topo));
+    memset(node_cpus, 0, sizeof(node_cpus));
+
+    int node_count = read_numa_nodes(node_cpus, CPUSET_MAX_DOMAINS);
+    if (node_count <= 0) {
+        return -1;
+    }
+    if (read_cpulist_file("/sys/devices/system/cpu/online", &online) != 0) {
+        CPU_ZERO(&online);
+        for (int node = 0; node < node_count; node++) {
+            CPU_OR(&online, &online, &node_cpus[node]);
+        }
+    }
+
+    if (level == CPUSET_DOMAIN_NODE) {
+        for (int node = 0; node < node_count; node++) {
+            if (CPU_COUNT(&node_cpus[node]) == 0) {
+                continue;
+            }
+            CPU_AND(&topo->domains[topo->domain_count].cpus, &node_cpus[node], &online);
+            topo->domains[topo->domain_count].node = node;
+            topo->domain_count++;
+        }
+        return topo->domain_count > 0 ? 0 : -1;
+    }
+
+    // LLC 域：依序為每個尚未歸類的 CPU 找出其共享 LLC 的 CPU 組
+    cpu_set_t assigned;
+    CPU_ZERO(&assigned);
+    for (int cpu = 0; cpu < CPU_SETSIZE && topo->domain_count < CPUSET_MAX_DOMAINS; cpu++) {
+        if (!CPU_ISSET(cpu, &online) || CPU_ISSET(cpu, &assigned)) {
+            continue;
+        }
+        cpuset_domain_t* domain = &topo->domains[topo->domain_count];
+        if (read_llc_cpus(cpu, &domain->cpus) != 0) {
+            CPU_ZERO(&domain->cpus);
+            CPU_SET(cpu, &domain->cpus);
+        }
+        CPU_AND(&domain->cpus, &domain->cpus, &online);
+        CPU_OR(&assigned, &assigned, &domain->cpus);
+        domain->node = node_of_cpu(node_cpus, node_count, cpu);
+        topo->domain_count++;
+    }
+    return topo->domain_count > 0 ? 0 : -1;
+}
+
+// 讀取共享狀態文件，並丟棄 runtime 進程已經結束的記錄
+static int load_records(FILE* file, cpuset_record_t* records, int max_records) {
+    char line[1200];
+    int count = 0;
+
+    rewind(file);
+    while (count < max_records && fgets(line, sizeof(line), file)) {
+        cpuset_record_t* record = &records[count];
+        char cpus[1024];
+        int owner;
+        if (sscanf(line, "%63s %d %d %1023s", record->container_id, &owner, &record->policy, cpus) != 4) {
+            continue;
+        }
+        record->owner = owner;
+        if (kill(record->owner, 0) == -1 && errno == ESRCH) {
+            continue;
+        }
+        if (cpuset_parse_list(cpus, &record->cpus) != 0) {
+            continue;
+        }
+        count++;
+    }
+    return count;
+}
+
+// 將記錄寫回共享狀態文件
+static void store_records(FILE* file, const cpuset_record_t* records, int count) {
+    char cpus[1024];
+
+    if (ftruncate(fileno(file), 0) == -1) {
+        return;
+    }
+    rewind(file);
+    for (int i = 0; i < count; i++) {
+        cpuset_format_list(&records[i].cpus, cpus, sizeof(cpus));
+        fprintf(file, "%s %d %d %s\n", records[i].container_id, (int)records[i].owner, records[i].policy, cpus);
+    }
+    fflush(file);
+}
+
+// 打開並鎖定共享狀態文件
+static FILE* open_state_locked(void) {
+    int fd = open(CPUSET_STATE_PATH, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (flock(fd, LOCK_EX) == -1) {
+        close(fd);
+        return NULL;
+    }
+    FILE* file = fdopen(fd, "r+");
+    if (!file) {
+        close(fd);
+    }
+    return file;
+}
+
+// 為容器分配 CPU 放置
+int cpuset_allocate(const char* container_id, const cpuset_request_t* request, cpuset_placement_t* placement) {
+    static cpuset_record_t records[CPUSET_MAX_RECORDS];
+    cpuset_topology_t topo;
+    cpu_set_t reserved, occupied;
+
+    memset(placement, 0, sizeof(*placement));
+    placement->domain = -1;
+
+    if (request->policy == CPUSET_POLICY_NONE) {
+        return 0;
+    }
+    if (cpuset_read_topology(request->level, &topo) != 0) {
+        fprintf(stderr, "警告: 無法讀取 CPU 拓撲，容器將不綁定 CPU\n");
+        return -1;
+    }
+
+    FILE* state = open_state_locked();
+    if (!state) {
+        fprintf(stderr, "警告: 無法打開 cpuset 狀態文件 %s: %s\n", CPUSET_STATE_PATH, strerror(errno));
+        return -1;
+    }
+    int count = load_records(state, records, CPUSET_MAX_RECORDS);
+
+    // 已被獨佔容器佔用的 CPU；獨佔分配還要避開共享容器已綁定的 CPU（它們的 cpuset 不會被縮小）
+    CPU_ZERO(&reserved);
+    CPU_ZERO(&occupied);
+    for (int i = 0; i < count; i++) {
+        if (records[i].policy == CPUSET_POLICY_EXCLUSIVE) {
+            CPU_OR(&reserved, &reserved, &records[i].cpus);
+        }
+        CPU_OR(&occupied, &occupied, &records[i].cpus);
+    }
+
+    int best = -1;
+    cpu_set_t chosen;
+    CPU_ZERO(&chosen);
+
+    if (request->policy == CPUSET_POLICY_EXCLUSIVE) {
+        // 選擇空閒 CPU 最少但仍能滿足需求的域（best fit），保留大塊空閒域給後續容器
+        int want = request->exclusive_cpus > 0 ? request->exclusive_cpus : 1;
+        int best_free = 0;
+        for (int d = 0; d < topo.domain_count; d++) {
+            cpu_set_t free_cpus;
+            CPU_XOR(&free_cpus, &topo.domains[d].cpus, &occupied);
+            CPU_AND(&free_cpus, &free_cpus, &topo.domains[d].cpus);
+            int nfree = CPU_COUNT(&free_cpus);
+            if (nfree >= want && (best == -1 || nfree < best_free)) {
+                best = d;
+                best_free = nfree;
+                chosen = free_cpus;
+            }
+        }
+        if (best != -1) {
+            // 只保留前 want 個空閒 CPU
+            int taken = 0;
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (!CPU_ISSET(cpu, &chosen)) continue;
+                if (taken < want) taken++;
+                else CPU_CLR(cpu, &chosen);
+            }
+        }
+    } else {
+        // 共享模式：選擇每個可用 CPU 上共享容器最少的域
+        double best_load = 0;
+        for (int d = 0; d < topo.domain_count; d++) {
+            cpu_set_t usable;
+            CPU_XOR(&usable, &topo.domains[d].cpus, &reserved);
+            CPU_AND(&usable, &usable, &topo.domains[d].cpus);
+            int nusable = CPU_COUNT(&usable);
+            if (nusable == 0) {
+                continue;
+            }
+            int sharers = 0;
+            for (int i = 0; i < count; i++) {
+                cpu_set_t overlap;
+                CPU_AND(&overlap, &records[i].cpus, &topo.domains[d].cpus);
+                if (records[i].policy == CPUSET_POLICY_SHARED && CPU_COUNT(&overlap) > 0) {
+                    sharers++;
+                }
+            }
+            double load = (double)(sharers + 1) / nusable;
+            if (best == -1 || load < best_load) {
+                best = d;
+                best_load = load;
+                chosen = usable;
+            }
+        }
+    }
+
+    if (best == -1) {
+        flock(fileno(state), LOCK_UN);
+        fclose(state);
+        fprintf(stderr, "警告: 沒有足夠的空閒 CPU 滿足放置請求\n");
+        return -1;
+    }
+
+    // 移除同 ID 的舊記錄後加入新記錄
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(records[i].container_id, container_id) != 0) {
+            records[kept++] = records[i];
+        }
+    }
+    if (kept < CPUSET_MAX_RECORDS) {
+        snprintf(records[kept].container_id, sizeof(records[kept].container_id), "%s", container_id);
+        records[kept].owner = getpid();
+        records[kept].policy = request->policy;
+        records[kept].cpus = chosen;
+        kept++;
+    }
+    store_records(state, records, kept);
+    flock(fileno(state), LOCK_UN);
+    fclose(state);
+
+    cpuset_format_list(&chosen, placement->cpus, sizeof(placement->cpus));
+    snprintf(placement->mems, sizeof(placement->mems), "%d", topo.domains[best].node);
+    placement->domain = best;
+    return 0;
+}
+
+// 釋放容器的 CPU 放置
+void cpuset_release(const char* container_id) {
+    static cpuset_record_t records[CPUSET_MAX_RECORDS];
+
+    FILE* state = open_state_locked();
+    if (!state) {
+        return;
+    }
+    int count = load_records(state, records, CPUSET_MAX_RECORDS);
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(records[i].container_id, container_id) != 0) {
+            records[kept++] = records[i];
+        }
+    }
+    store_records(state, records, kept);
+    flock(fileno(state), LOCK_UN);
+    fclose(state);
+}
+
+// 解析放置策略字串（none / shared / exclusive[:N]）
+int cpuset_parse_policy(const char* str, cpuset_request_t* request) {
+    if (strcmp(str, "none") == 0) {
+        request->policy = CPUSET_POLICY_NONE;
+    } else if (strcmp(str, "shared") == 0) {
+        request->policy = CPUSET_POLICY_SHARED;
+    } else if (strncmp(str, "exclusive", 9) == 0) {
+        request->policy = CPUSET_POLICY_EXCLUSIVE;
+        request->exclusive_cpus = 1;
+        if (str[9] == ':') {
+            request->exclusive_cpus = atoi(str + 10);
+            if (request->exclusive_cpus <= 0) {
+                return -1;
+            }
+        } else if (str[9] != '\0') {
+            return -1;
+        }
+    } else {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef CPUSET_H
+#define CPUSET_H
+
+#include <sched.h>
+#include <sys/types.h>
+
+// 記錄各容器 CPU 佔用情況的共享狀態文件（所有容器進程共用，以 flock 保護）
+#define CPUSET_STATE_PATH "/tmp/docker_in_c_cpuset.state"
+
+// 拓撲中最多可識別的放置域數量
+#define CPUSET_MAX_DOMAINS 64
+
+// 放置策略
+typedef enum {
+    CPUSET_POLICY_NONE = 0,    // 不綁定，容器可在所有 CPU 上執行
+    CPUSET_POLICY_SHARED,      // 與其他共享容器共用一個域內的 CPU
+    CPUSET_POLICY_EXCLUSIVE    // 獨佔一個域內指定數量的 CPU
+} cpuset_policy_t;
+
+// 放置域的粒度
+typedef enum {
+    CPUSET_DOMAIN_NODE = 0,    // 以 NUMA 節點為單位
+    CPUSET_DOMAIN_LLC          // 以共享最後一級快取 (LLC) 的 CPU 組為單位
+} cpuset_domain_level_t;
+
+// 一個放置域：一組共享 LLC 或 NUMA 節點的 CPU
+typedef struct {
+    cpu_set_t cpus;            // 域內的 CPU
+    int node;                  // 所屬 NUMA 節點
+} cpuset_domain_t;
+
+// 主機 CPU 拓撲
+typedef struct {
+    cpuset_domain_t domains[CPUSET_MAX_DOMAINS];
+    int domain_count;
+} cpuset_topology_t;
+
+// 放置請求
+typedef struct {
+    cpuset_policy_t policy;
+    cpuset_domain_level_t level;
+    int exclusive_cpus;        // 獨佔模式下需要的 CPU 數量
+} cpuset_request_t;
+
+// 放置結果（可直接寫入 cpuset.cpus / cpuset.mems）
+typedef struct {
+    char cpus[256];
+    char mems[64];
+    int domain;                // 被選中的域索引，-1 表示未綁定
+} cpuset_placement_t;
+
+/**
+ * 解析 cpulist 格式字串（例如 "0-3,8-11"）
+ * @param list cpulist 字串
+ * @param set 輸出的 CPU 集合
+ * @return 0 成功，-1 失敗
+ */
+int cpuset_parse_list(const char* list, cpu_set_t* set);
+
+/**
+ * 將 CPU 集合格式化為 cpulist 字串
+ * @param set CPU 集合
+ * @param buf 輸出緩衝區
+ * @param size 緩衝區大小
+ */
+void cpuset_format_list(const cpu_set_t* set, char* buf, size_t size);
+
+/**
+ * 從 sysfs 讀取主機的 CPU / NUMA 拓撲
+ * @param level 放置域的粒度
+ * @param topo 輸出的拓撲
+ * @return 0 成功，-1 失敗
+ */
+int cpuset_read_topology(cpuset_domain_level_t level, cpuset_topology_t* topo);
+
+/**
+ * 為容器分配 CPU 放置（會記錄到共享狀態文件中）
+ * @param container_id 容器 ID
+ * @param request 放置請求
+ * @param placement 輸出的放置結果
+ * @return 0 成功，-1 失敗（例如沒有足夠的空閒 CPU）
+ */
+int cpuset_allocate(const char* container_id, const cpuset_request_t* request, cpuset_placement_t* placement);
+
+/**
+ * 釋放容器的 CPU 放置
+ * @param container_id 容器 ID
+ */
+void cpuset_release(const char* container_id);
+
+/**
+ * 解析放置策略字串（none / shared / exclusive[:N]）
+ * @param str 策略字串
+ * @param request 輸出的放置請求
+ * @return 0 成功，-1 格式錯誤
+ */
+int cpuset_parse_policy(const char* str, cpuset_request_t* request);
+
+#endif // CPUSET_H
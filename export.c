@@ -0,0 +1,832 @@
+#include "export.h"
+#include "image.h"
+#include "lazy.h"
+#include "namespace.h"
+#include "sha256.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/xattr.h>
+
+#define EXPORT_BUFFER_SIZE (1024 * 1024)  // 頭部與小文件的緩衝，以及壓縮輸出的緩衝
+#define MMAP_THRESHOLD (256 * 1024)       // 小於此大小的文件直接 read，mmap 的開銷不划算
+#define MMAP_WINDOW (64 * 1024 * 1024)    // 大文件分段映射，限制虛擬地址空間的佔用
+#define HEADER_MAX (64 * 1024)            // 一個條目的頭部（含 pax 擴展頭部）上限
+
+static volatile sig_atomic_t interrupted;
+
+static void on_interrupt(int sig) {
+    (void)sig;
+    interrupted = 1;
+}
+
+// 硬連結表中的一項：同一個 inode 第一次出現時的路徑
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    char* path;
+    uint32_t entry;            // 在 TOC 中的條目編號（延遲層）
+} link_entry_t;
+
+// 導出狀態
+typedef struct {
+    const export_options_t* options;
+    int out_fd;
+    off_t out_base;            // 輸出文件中外層 tar 的起點
+    off_t out_pos;             // 已寫出的外層 tar 位元組數
+    int failed;
+    encoder_t encoder;
+    sha256_t diff;             // 未壓縮層的摘要 (diff_id)
+    sha256_t blob;             // 壓縮後層的摘要
+    uint64_t unpacked;
+    uint64_t packed;
+    unsigned char* buf;        // 未壓縮數據的緩衝（頭部、小文件）
+    size_t buf_len;
+    unsigned char* out;        // 壓縮輸出
+    uint64_t root_mnt;         // 根目錄的掛載 ID，不同的表示遇到掛載點
+    uid_t real_uid;
+    gid_t real_gid;
+    link_entry_t* links;       // 開放定址的雜湊表
+    size_t link_capacity;
+    size_t link_count;
+    uint64_t files;
+    char path[4096];           // 目前條目相對於根目錄的路徑
+    lazy_toc_t toc;            // 延遲層的目錄表
+    uint32_t parent;           // 目前目錄在 TOC 中的條目編號
+    sha256_t frame;            // 目前 frame 壓縮數據的摘要
+    uint64_t frame_packed;     // 目前 frame 在 blob 中的起點
+    uint64_t frame_unpacked;   // 目前 frame 在 tar 流中的起點
+} export_t;
+
+static void export_fail(export_t* ex, const char* what) {
+    if (!ex->failed) {
+        fprintf(stderr, "錯誤: %s: %s\n", what, strerror(errno));
+        ex->failed = 1;
+    }
+}
+
+/* ---------- 輸出 ---------- */
+
+static void out_write(export_t* ex, const void* data, size_t len) {
+    const unsigned char* p = data;
+    while (len > 0 && !ex->failed) {
+        ssize_t n = write(ex->out_fd, p, len);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            export_fail(ex, "寫入輸出文件失敗");
+            return;
+        }
+        p += n;
+        len -= (size_t)n;
+        ex->out_pos += n;
+    }
+}
+
+// 壓縮一段數據，壓縮結果直接寫到輸出
+static void layer_compress(export_t* ex, const void* data, size_t len, int finish) {
+    const unsigned char* in = data;
+
+    while (!ex->failed) {
+        ssize_t n = encoder_run(&ex->encoder, &in, &len, ex->out, EXPORT_BUFFER_SIZE, finish);
+        if (n < 0) {
+            errno = EIO;
+            export_fail(ex, "壓縮失敗");
+            return;
+        }
+        sha256_update(&ex->blob, ex->out, (size_t)n);
+        if (ex->options->lazy) {
+            sha256_update(&ex->frame, ex->out, (size_t)n);
+        }
+        ex->packed += (uint64_t)n;
+        out_write(ex, ex->out, (size_t)n);
+        if (finish ? ex->encoder.finished : (len == 0 && (size_t)n < EXPORT_BUFFER_SIZE)) {
+            return;
+        }
+    }
+}
+
+// 結束目前的 frame 並記錄到 TOC
+static void layer_cut(export_t* ex) {
+    lazy_chunk_t chunk;
+
+    layer_compress(ex, NULL, 0, 1);
+    chunk.offset = ex->frame_packed;
+    chunk.size = (uint32_t)(ex->packed - ex->frame_packed);
+    chunk.raw_size = (uint32_t)(ex->unpacked - ex->frame_unpacked);
+    sha256_final(&ex->frame, chunk.digest);
+    if (!ex->failed && lazy_toc_add_chunk(&ex->toc, &chunk) != 0) {
+        export_fail(ex, "生成目錄表失敗");
+    }
+    sha256_init(&ex->frame);
+    ex->frame_packed = ex->packed;
+    ex->frame_unpacked = ex->unpacked;
+}
+
+// 把未壓縮的層數據交給壓縮器
+// 延遲層在 tar 流的每 LAZY_CHUNK_SIZE 位元組處結束一個 frame，讀取時可以只解壓需要的部分
+static void layer_feed(export_t* ex, const void* data, size_t len, int finish) {
+    const unsigned char* in = data;
+
+    sha256_update(&ex->diff, data, len);
+    if (!ex->options->lazy) {
+        ex->unpacked += len;
+        layer_compress(ex, data, len, finish);
+        return;
+    }
+    while (len > 0 && !ex->failed) {
+        size_t n = LAZY_CHUNK_SIZE - (size_t)(ex->unpacked % LAZY_CHUNK_SIZE);
+        if (n > len) n = len;
+        ex->unpacked += n;
+        layer_compress(ex, in, n, 0);
+        in += n;
+        len -= n;
+        if (ex->unpacked % LAZY_CHUNK_SIZE == 0) {
+            layer_cut(ex);
+        }
+    }
+    if (finish && ex->unpacked > ex->frame_unpacked) {
+        layer_cut(ex);
+    }
+}
+
+static void layer_flush(export_t* ex) {
+    if (ex->buf_len > 0) {
+        layer_feed(ex, ex->buf, ex->buf_len, 0);
+        ex->buf_len = 0;
+    }
+}
+
+// 寫入層的 tar 數據：小塊先累積在緩衝區，大塊直接交給壓縮器（不再複製一次）
+static void layer_write(export_t* ex, const void* data, size_t len) {
+    if (ex->buf_len + len > EXPORT_BUFFER_SIZE) {
+        layer_flush(ex);
+    }
+    if (len >= EXPORT_BUFFER_SIZE / 2) {
+        layer_feed(ex, data, len, 0);
+        return;
+    }
+    memcpy(ex->buf + ex->buf_len, data, len);
+    ex->buf_len += len;
+}
+
+static void layer_pad(export_t* ex, uint64_t size) {
+    static const unsigned char zeros[512];
+    if (size % 512) {
+        layer_write(ex, zeros, 512 - size % 512);
+    }
+}
+
+/* ---------- tar 頭部 ---------- */
+
+// tar 條目的元數據
+typedef struct {
+    const char* name;
+    const char* linkname;
+    char type;
+    mode_t mode;
+    uid_t uid;
+    gid_t gid;
+    uint64_t size;
+    time_t mtime;
+    unsigned int devmajor;
+    unsigned int devminor;
+    const char* pax;           // 額外的 pax 記錄（xattr），可為 NULL
+    size_t pax_len;
+} tar_meta_t;
+
+// 以八進位寫入數字欄位，放不下時返回 -1（改用 pax 記錄）
+static int tar_octal(char* field, size_t width, uint64_t value) {
+    if (width < 12 && value >> ((width - 1) * 3)) {
+        return -1;
+    }
+    if (width == 12 && value > 077777777777ULL) {
+        return -1;
+    }
+    snprintf(field, width, "%0*llo", (int)(width - 1), (unsigned long long)value);
+    return 0;
+}
+
+// 追加一條 pax 記錄 "<長度> <鍵>=<值>\n"，長度包括表示長度本身的數字
+static size_t pax_record(char* buf, size_t size, size_t len, const char* key, const char* value, size_t value_len) {
+    size_t body = strlen(key) + value_len + 3;   // 空格、'='、'\n'
+    size_t total = body + 1;
+    while (total != body + (size_t)snprintf(NULL, 0, "%zu", total)) {
+        total = body + (size_t)snprintf(NULL, 0, "%zu", total);
+    }
+    if (len + total > size) {
+        return len;
+    }
+    len += (size_t)snprintf(buf + len, size - len, "%zu %s=", total, key);
+    memcpy(buf + len, value, value_len);
+    len += value_len;
+    buf[len++] = '\n';
+    return len;
+}
+
+static void tar_checksum(unsigned char* header) {
+    unsigned int sum = 0;
+    memset(header + 148, ' ', 8);
+    for (int i = 0; i < 512; i++) {
+        sum += header[i];
+    }
+    snprintf((char*)header + 148, 8, "%06o", sum);
+}
+
+static void tar_basic_header(unsigned char* header, const char* name, char type, mode_t mode, uid_t uid, gid_t gid,
+                             uint64_t size, time_t mtime) {
+    memset(header, 0, 512);
+    snprintf((char*)header, 100, "%s", name);
+    tar_octal((char*)header + 100, 8, mode & 07777);
+    tar_octal((char*)header + 108, 8, uid);
+    tar_octal((char*)header + 116, 8, gid);
+    tar_octal((char*)header + 124, 12, size);
+    tar_octal((char*)header + 136, 12, mtime > 0 ? (uint64_t)mtime : 0);
+    header[156] = (unsigned char)type;
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+}
+
+/**
+ * 生成條目的頭部：ustar 放不下的欄位（長路徑、大文件、xattr）放在前面的 pax 擴展頭部
+ * @return 頭部的總長度（512 的倍數）
+ */
+static size_t tar_build(const tar_meta_t* meta, unsigned char* out) {
+    static __thread char pax[HEADER_MAX - 1024];
+    unsigned char* header = out;
+    size_t pax_len = 0;
+    char number[32];
+
+    if (strlen(meta->name) >= 100) {
+        pax_len = pax_record(pax, sizeof(pax), pax_len, "path", meta->name, strlen(meta->name));
+    }
+    if (meta->linkname && strlen(meta->linkname) >= 100) {
+        pax_len = pax_record(pax, sizeof(pax), pax_len, "linkpath", meta->linkname, strlen(meta->linkname));
+    }
+    if (meta->size > 077777777777ULL) {
+        snprintf(number, sizeof(number), "%llu", (unsigned long long)meta->size);
+        pax_len = pax_record(pax, sizeof(pax), pax_len, "size", number, strlen(number));
+    }
+    if (meta->uid > 07777777 || meta->gid > 07777777) {
+        snprintf(number, sizeof(number), "%u", (unsigned int)meta->uid);
+        pax_len = pax_record(pax, sizeof(pax), pax_len, "uid", number, strlen(number));
+        snprintf(number, sizeof(number), "%u", (unsigned int)meta->gid);
+        pax_len = pax_record(pax, sizeof(pax), pax_len, "gid", number, strlen(number));
+    }
+    if (meta->pax && meta->pax_len + pax_len <= sizeof(pax)) {
+        memcpy(pax + pax_len, meta->pax, meta->pax_len);
+        pax_len += meta->pax_len;
+    }
+
+    if (pax_len > 0) {
+        tar_basic_header(header, "././@PaxHeader", 'x', 0644, 0, 0, pax_len, 0);
+        tar_checksum(header);
+        memcpy(header + 512, pax, pax_len);
+        size_t padded = (pax_len + 511) / 512 * 512;
+        memset(header + 512 + pax_len, 0, padded - pax_len);
+        header += 512 + padded;
+    }
+
+    tar_basic_header(header, meta->name, meta->type, meta->mode, meta->uid > 07777777 ? 0 : meta->uid,
+                     meta->gid > 07777777 ? 0 : meta->gid, meta->size > 077777777777ULL ? 0 : meta->size, meta->mtime);
+    if (meta->linkname) {
+        snprintf((char*)header + 157, 100, "%s", meta->linkname);
+    }
+    if (meta->type == '3' || meta->type == '4') {
+        tar_octal((char*)header + 329, 8, meta->devmajor);
+        tar_octal((char*)header + 337, 8, meta->devminor);
+    }
+    tar_checksum(header);
+    return (size_t)(header + 512 - out);
+}
+
+static void layer_entry(export_t* ex, const tar_meta_t* meta) {
+    static __thread unsigned char header[HEADER_MAX];
+    layer_write(ex, header, tar_build(meta, header));
+}
+
+// 外層 tar 中的小文件（config、manifest 等）
+static void outer_file(export_t* ex, const char* name, const void* data, size_t len) {
+    static const unsigned char zeros[512];
+    unsigned char header[512];
+
+    tar_basic_header(header, name, '0', 0644, 0, 0, len, 0);
+    tar_checksum(header);
+    out_write(ex, header, sizeof(header));
+    out_write(ex, data, len);
+    if (len % 512) {
+        out_write(ex, zeros, 512 - len % 512);
+    }
+}
+
+/* ---------- 遍歷目錄樹 ---------- */
+
+// 讀取需要保留的擴展屬性，組成 pax 記錄（OverlayFS 自己的屬性不導出）
+// table 不為 NULL 時同時以 TOC 的屬性表格式輸出
+static size_t collect_xattrs(int fd, char* pax, size_t size, int* opaque, unsigned char* table, size_t table_size,
+                             size_t* table_len) {
+    char names[4096];
+    char value[1024];
+    char key[300];
+    size_t len = 0;
+
+    *opaque = 0;
+    if (table_len) {
+        *table_len = 0;
+    }
+    ssize_t names_len = flistxattr(fd, names, sizeof(names));
+    for (ssize_t i = 0; i < names_len; i += (ssize_t)strlen(names + i) + 1) {
+        const char* name = names + i;
+        if (strncmp(name, "trusted.overlay.", 16) == 0 || strncmp(name, "user.overlay.", 13) == 0) {
+            if (strcmp(strchr(name, '.') + 1, "overlay.opaque") == 0) {
+                ssize_t n = fgetxattr(fd, name, value, sizeof(value));
+                *opaque |= n == 1 && value[0] == 'y';
+            }
+            continue;
+        }
+        ssize_t n = fgetxattr(fd, name, value, sizeof(value));
+        if (n >= 0) {
+            snprintf(key, sizeof(key), "SCHILY.xattr.%s", name);
+            len = pax_record(pax, size, len, key, value, (size_t)n);
+            size_t name_len = strlen(name) + 1;
+            if (table && *table_len + name_len + 4 + (size_t)n <= table_size) {
+                uint32_t value_len = (uint32_t)n;
+                memcpy(table + *table_len, name, name_len);
+                memcpy(table + *table_len + name_len, &value_len, 4);
+                memcpy(table + *table_len + name_len + 4, value, (size_t)n);
+                *table_len += name_len + 4 + (size_t)n;
+            }
+        }
+    }
+    return len;
+}
+
+static int name_compare(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// 取得條目所在的掛載 ID
+static uint64_t mount_id(int dirfd, const char* name) {
+    struct statx stx;
+    if (statx(dirfd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, STATX_MNT_ID, &stx) == -1 ||
+        !(stx.stx_mask & STATX_MNT_ID)) {
+        return 0;
+    }
+    return stx.stx_mnt_id;
+}
+
+// 查找或記錄硬連結，返回同一 inode 第一次出現時的記錄
+static const link_entry_t* link_lookup(export_t* ex, const struct stat* st) {
+    if (ex->link_count * 2 >= ex->link_capacity) {
+        size_t capacity = ex->link_capacity ? ex->link_capacity * 2 : 1024;
+        link_entry_t* table = calloc(capacity, sizeof(link_entry_t));
+        if (!table) {
+            return NULL;
+        }
+        for (size_t i = 0; i < ex->link_capacity; i++) {
+            if (ex->links[i].path) {
+                size_t slot = (size_t)(ex->links[i].ino * 0x9e3779b97f4a7c15ULL) & (capacity - 1);
+                while (table[slot].path) slot = (slot + 1) & (capacity - 1);
+                table[slot] = ex->links[i];
+            }
+        }
+        free(ex->links);
+        ex->links = table;
+        ex->link_capacity = capacity;
+    }
+    size_t slot = (size_t)(st->st_ino * 0x9e3779b97f4a7c15ULL) & (ex->link_capacity - 1);
+    while (ex->links[slot].path) {
+        if (ex->links[slot].ino == st->st_ino && ex->links[slot].dev == st->st_dev) {
+            return &ex->links[slot];
+        }
+        slot = (slot + 1) & (ex->link_capacity - 1);
+    }
+    // 接下來加入 TOC 的條目就是這個文件
+    ex->links[slot] = (link_entry_t){st->st_dev, st->st_ino, strdup(ex->path), (uint32_t)ex->toc.entry_count};
+    ex->link_count++;
+    return NULL;
+}
+
+// 寫入普通文件的內容：大文件以 mmap 映射後直接交給壓縮器
+static void export_file_data(export_t* ex, int fd, uint64_t size) {
+    uint64_t done = 0;
+
+    if (ex->options->use_mmap && size >= MMAP_THRESHOLD) {
+        layer_flush(ex);
+        while (done < size && !ex->failed) {
+            size_t len = size - done < MMAP_WINDOW ? (size_t)(size - done) : MMAP_WINDOW;
+            void* map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, (off_t)done);
+            if (map == MAP_FAILED) {
+                break;   // 例如不支援 mmap 的文件系統，剩餘部分改用 read
+            }
+            madvise(map, len, MADV_SEQUENTIAL);
+            layer_feed(ex, map, len, 0);
+            munmap(map, len);
+            done += len;
+        }
+    }
+    while (done < size && !ex->failed) {
+        size_t want = size - done < EXPORT_BUFFER_SIZE / 2 ? (size_t)(size - done) : EXPORT_BUFFER_SIZE / 2;
+        if (ex->buf_len + want > EXPORT_BUFFER_SIZE) {
+            layer_flush(ex);
+        }
+        ssize_t n = pread(fd, ex->buf + ex->buf_len, want, (off_t)done);
+        if (n <= 0) {
+            // 文件在導出期間被截短：以零補足 tar 頭部中記錄的大小
+            memset(ex->buf + ex->buf_len, 0, want);
+            n = (ssize_t)want;
+        }
+        ex->buf_len += (size_t)n;
+        done += (uint64_t)n;
+    }
+    layer_pad(ex, size);
+}
+
+static void export_dir(export_t* ex, int dirfd, size_t prefix_len);
+
+// 在延遲層的 TOC 中記錄條目（普通文件需在其 tar 頭部之後、內容之前調用），返回條目編號
+static long toc_entry(export_t* ex, const char* name, const struct stat* st, const tar_meta_t* meta, uint32_t flags,
+                      uint32_t link, const char* target, const unsigned char* xattrs, size_t xattr_len) {
+    lazy_entry_t entry;
+
+    if (!ex->options->lazy || ex->failed) {
+        return -1;
+    }
+    memset(&entry, 0, sizeof(entry));
+    entry.parent = ex->parent;
+    entry.link = link;
+    entry.mode = st->st_mode;
+    entry.uid = meta->uid;
+    entry.gid = meta->gid;
+    // 內核的 new_encode_dev 格式，與 FUSE 的 rdev 欄位一致
+    entry.rdev = (minor(st->st_rdev) & 0xff) | (major(st->st_rdev) << 8) | ((minor(st->st_rdev) & ~0xffU) << 12);
+    entry.flags = flags;
+    entry.mtime = st->st_mtime;
+    if (S_ISREG(st->st_mode) && !(flags & LAZY_HARDLINK)) {
+        entry.size = meta->size;
+        entry.offset = ex->unpacked + ex->buf_len;
+    }
+    long index = lazy_toc_add_entry(&ex->toc, &entry, name, target, xattrs, xattr_len);
+    if (index < 0) {
+        errno = ENOMEM;
+        export_fail(ex, "生成目錄表失敗");
+    }
+    return index;
+}
+
+// 導出目錄中的一個條目（ex->path 已是其相對路徑）
+static void export_entry(export_t* ex, int dirfd, const char* name) {
+    static __thread char pax[HEADER_MAX / 2];
+    static __thread unsigned char table[HEADER_MAX / 2];
+    unsigned char* xattrs = ex->options->lazy ? table : NULL;
+    size_t xattr_len = 0;
+    char target[4096];
+    struct stat st;
+    int opaque = 0;
+
+    if (fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) == -1) {
+        return;   // 導出期間被刪除
+    }
+    size_t path_len = strlen(ex->path);
+    // 容器的 root 映射到主機的真實用戶，導入時反向轉換（與 import 對稱）
+    tar_meta_t meta = {ex->path, NULL, '0', st.st_mode, st.st_uid == ex->real_uid ? 0 : st.st_uid,
+                       st.st_gid == ex->real_gid ? 0 : st.st_gid, 0, st.st_mtime, 0, 0, NULL, 0};
+
+    // 掛載點：目錄只保留空目錄，掛載上的文件（例如 bind mount 的設備文件）略過
+    if (ex->root_mnt && mount_id(dirfd, name) != ex->root_mnt) {
+        if (S_ISDIR(st.st_mode) && path_len + 1 < sizeof(ex->path)) {
+            strcat(ex->path, "/");
+            meta.type = '5';
+            layer_entry(ex, &meta);
+            toc_entry(ex, name, &st, &meta, 0, 0, NULL, NULL, 0);
+        }
+        return;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        int fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd == -1 || path_len + 2 >= sizeof(ex->path)) {
+            if (fd != -1) close(fd);
+            return;
+        }
+        meta.pax = pax;
+        meta.pax_len = collect_xattrs(fd, pax, sizeof(pax), &opaque, xattrs, sizeof(table), &xattr_len);
+        strcat(ex->path, "/");
+        meta.type = '5';
+        layer_entry(ex, &meta);
+        long index = toc_entry(ex, name, &st, &meta, opaque && ex->options->overlay_layer ? LAZY_OPAQUE : 0, 0, NULL,
+                               xattrs, xattr_len);
+        if (opaque && ex->options->overlay_layer) {
+            // 不透明目錄：下層目錄中的內容全部被隱藏
+            char marker[4200];
+            snprintf(marker, sizeof(marker), "%s.wh..wh..opq", ex->path);
+            tar_meta_t wh = {marker, NULL, '0', 0644, 0, 0, 0, st.st_mtime, 0, 0, NULL, 0};
+            layer_entry(ex, &wh);
+        }
+        uint32_t parent = ex->parent;
+        ex->parent = index >= 0 ? (uint32_t)index : parent;
+        export_dir(ex, fd, path_len + 1);
+        ex->parent = parent;
+        close(fd);
+    } else if (S_ISREG(st.st_mode)) {
+        const link_entry_t* first = st.st_nlink > 1 ? link_lookup(ex, &st) : NULL;
+        if (first) {
+            meta.type = '1';
+            meta.linkname = first->path;
+            layer_entry(ex, &meta);
+            // 目標未能導出（無法讀取）時 TOC 中也沒有它，略過這個連結
+            if (first->entry < ex->toc.entry_count && S_ISREG(ex->toc.entries[first->entry].mode) &&
+                !(ex->toc.entries[first->entry].flags & LAZY_HARDLINK)) {
+                toc_entry(ex, name, &st, &meta, LAZY_HARDLINK, first->entry, NULL, NULL, 0);
+            }
+            return;
+        }
+        int fd = openat(dirfd, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd == -1) {
+            fprintf(stderr, "警告: 無法讀取 %s: %s，略過\n", ex->path, strerror(errno));
+            return;
+        }
+        meta.size = (uint64_t)st.st_size;
+        meta.pax = pax;
+        meta.pax_len = collect_xattrs(fd, pax, sizeof(pax), &opaque, xattrs, sizeof(table), &xattr_len);
+        layer_entry(ex, &meta);
+        toc_entry(ex, name, &st, &meta, 0, 0, NULL, xattrs, xattr_len);
+        export_file_data(ex, fd, meta.size);
+        close(fd);
+        ex->files++;
+    } else if (S_ISLNK(st.st_mode)) {
+        ssize_t n = readlinkat(dirfd, name, target, sizeof(target) - 1);
+        if (n < 0) {
+            return;
+        }
+        target[n] = '\0';
+        meta.type = '2';
+        meta.linkname = target;
+        meta.mode = 0777;
+        layer_entry(ex, &meta);
+        toc_entry(ex, name, &st, &meta, 0, 0, target, NULL, 0);
+    } else if (S_ISCHR(st.st_mode) && st.st_rdev == 0 && ex->options->overlay_layer) {
+        // OverlayFS 的刪除標記 → .wh.<名稱>
+        char marker[4200];
+        const char* slash = strrchr(ex->path, '/');
+        snprintf(marker, sizeof(marker), "%.*s.wh.%s", slash ? (int)(slash - ex->path + 1) : 0, ex->path, name);
+        meta.name = marker;
+        meta.mode = 0644;
+        layer_entry(ex, &meta);
+        toc_entry(ex, name, &st, &meta, 0, 0, NULL, NULL, 0);
+    } else if (S_ISCHR(st.st_mode) || S_ISBLK(st.st_mode)) {
+        meta.type = S_ISCHR(st.st_mode) ? '3' : '4';
+        meta.devmajor = major(st.st_rdev);
+        meta.devminor = minor(st.st_rdev);
+        layer_entry(ex, &meta);
+        toc_entry(ex, name, &st, &meta, 0, 0, NULL, NULL, 0);
+    } else if (S_ISFIFO(st.st_mode)) {
+        meta.type = '6';
+        layer_entry(ex, &meta);
+        toc_entry(ex, name, &st, &meta, 0, 0, NULL, NULL, 0);
+    }
+    // socket 不能放進 tar，略過
+}
+
+// 以名稱排序遍歷目錄：相同的內容總是生成相同的層摘要，重複導入時可以重用
+static void export_dir(export_t* ex, int dirfd, size_t prefix_len) {
+    size_t count = 0, capacity = 64;
+    char** names = malloc(capacity * sizeof(char*));
+    struct dirent* entry;
+
+    int fd = dup(dirfd);
+    DIR* dir = fd == -1 ? NULL : fdopendir(fd);
+    if (!dir || !names) {
+        if (fd != -1 && !dir) close(fd);
+        free(names);
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        if (count == capacity) {
+            char** grown = realloc(names, (capacity *= 2) * sizeof(char*));
+            if (!grown) break;
+            names = grown;
+        }
+        names[count++] = strdup(entry->d_name);
+    }
+    closedir(dir);
+    qsort(names, count, sizeof(char*), name_compare);
+
+    for (size_t i = 0; i < count; i++) {
+        if (!ex->failed && !interrupted && names[i] && prefix_len + strlen(names[i]) + 2 < sizeof(ex->path)) {
+            strcpy(ex->path + prefix_len, names[i]);
+            export_entry(ex, dirfd, names[i]);
+        }
+        free(names[i]);
+    }
+    free(names);
+    ex->path[prefix_len] = '\0';
+}
+
+/* ---------- OCI 佈局 ---------- */
+
+static const char* layer_media_type(codec_type_t codec) {
+    switch (codec) {
+    case CODEC_GZIP: return "application/vnd.oci.image.layer.v1.tar+gzip";
+    case CODEC_ZSTD: return "application/vnd.oci.image.layer.v1.tar+zstd";
+    default:         return "application/vnd.oci.image.layer.v1.tar";
+    }
+}
+
+// 寫入一個以摘要命名的 blob，返回其十六進位摘要
+static void outer_blob(export_t* ex, const char* data, char* hex) {
+    char name[100];
+    sha256_t ctx;
+
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, strlen(data));
+    sha256_final_hex(&ctx, hex);
+    snprintf(name, sizeof(name), "blobs/sha256/%s", hex);
+    outer_file(ex, name, data, strlen(data));
+}
+
+// JSON 字串中需要轉義的字元
+static void json_escape(const char* in, char* out, size_t size) {
+    size_t n = 0;
+    for (; *in && n + 7 < size; in++) {
+        if (*in == '"' || *in == '\\') {
+            out[n++] = '\\';
+            out[n++] = *in;
+        } else if ((unsigned char)*in < 0x20) {
+            n += (size_t)snprintf(out + n, size - n, "\\u%04x", *in);
+        } else {
+            out[n++] = *in;
+        }
+    }
+    out[n] = '\0';
+}
+
+int export_image(int root_fd, int out_fd, const export_options_t* options) {
+    static export_t ex;
+    char diff_hex[SHA256_HEX_LEN + 1], blob_hex[SHA256_HEX_LEN + 1];
+    char config_hex[SHA256_HEX_LEN + 1], manifest_hex[SHA256_HEX_LEN + 1], toc_hex[SHA256_HEX_LEN + 1];
+    char json[4096], name[600];
+    unsigned char header[512];
+    struct sigaction action, old_int, old_term, old_hup;
+    struct timespec start, end;
+
+    memset(&ex, 0, sizeof(ex));
+    ex.options = options;
+    ex.out_fd = out_fd;
+    ex.out_base = lseek(out_fd, 0, SEEK_CUR);
+    if (ex.out_base == -1) {
+        fprintf(stderr, "錯誤: 輸出必須是可定位的文件（層寫完後才能回填其摘要），請使用 -o 或重定向到文件\n");
+        return -1;
+    }
+    if (options->lazy && options->codec != CODEC_ZSTD) {
+        fprintf(stderr, "錯誤: 延遲層需要 zstd 壓縮（gzip 沒有可略過的 frame）\n");
+        return -1;
+    }
+    ex.buf = malloc(EXPORT_BUFFER_SIZE);
+    ex.out = malloc(EXPORT_BUFFER_SIZE);
+    // 延遲層的每個 frame 必須能獨立解壓，不能使用長距離匹配和多線程壓縮
+    if (!ex.buf || !ex.out ||
+        (options->lazy ? encoder_init_frames(&ex.encoder, options->level)
+                       : encoder_init(&ex.encoder, options->codec, options->level, options->threads)) != 0) {
+        fprintf(stderr, "錯誤: 無法初始化 %s 壓縮\n", codec_name(options->codec));
+        free(ex.buf);
+        free(ex.out);
+        return -1;
+    }
+    sha256_init(&ex.diff);
+    sha256_init(&ex.blob);
+    sha256_init(&ex.frame);
+    ex.root_mnt = mount_id(root_fd, ".");
+    ex.real_uid = get_real_uid();
+    ex.real_gid = get_real_gid();
+    if (options->lazy) {
+        // TOC 的第 0 個條目是層的根目錄（tar 中沒有對應的條目）
+        struct stat st;
+        tar_meta_t meta = {"", NULL, '5', 0, 0, 0, 0, 0, 0, 0, NULL, 0};
+        if (fstat(root_fd, &st) == 0) {
+            meta.uid = st.st_uid == ex.real_uid ? 0 : st.st_uid;
+            meta.gid = st.st_gid == ex.real_gid ? 0 : st.st_gid;
+            toc_entry(&ex, "", &st, &meta, 0, 0, NULL, NULL, 0);
+        } else {
+            export_fail(&ex, "無法讀取根目錄");
+        }
+    }
+
+    // 中斷時停止遍歷並返回，讓調用者有機會解凍容器
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_interrupt;
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+    sigaction(SIGHUP, &action, &old_hup);
+    interrupted = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // 層的頭部先寫佔位，摘要和大小在層寫完後回填
+    tar_basic_header(header, "blobs/sha256/pending", '0', 0644, 0, 0, 0, 0);
+    tar_checksum(header);
+    out_write(&ex, header, sizeof(header));
+
+    export_dir(&ex, root_fd, 0);
+    memset(ex.buf + ex.buf_len, 0, 1024);   // 層 tar 的結束標記
+    ex.buf_len += 1024;
+    layer_flush(&ex);
+    layer_feed(&ex, NULL, 0, 1);
+    if (interrupted && !ex.failed) {
+        fprintf(stderr, "錯誤: 導出被中斷\n");
+        ex.failed = 1;
+    }
+    if (options->lazy && !ex.failed) {
+        // 目錄表放在最後的 skippable frame 中，整個 blob 仍可按普通的 tar+zstd 解壓
+        unsigned char* tail;
+        size_t tail_len;
+        if (lazy_toc_finish(&ex.toc, ex.unpacked, ex.packed, &tail, &tail_len, toc_hex) != 0) {
+            errno = ENOMEM;
+            export_fail(&ex, "生成目錄表失敗");
+        } else {
+            sha256_update(&ex.blob, tail, tail_len);
+            ex.packed += tail_len;
+            out_write(&ex, tail, tail_len);
+            free(tail);
+        }
+    }
+
+    if (!ex.failed) {
+        static const unsigned char zeros[1024];
+        sha256_final_hex(&ex.diff, diff_hex);
+        sha256_final_hex(&ex.blob, blob_hex);
+        if (ex.packed % 512) {
+            out_write(&ex, zeros, 512 - ex.packed % 512);
+        }
+        snprintf(name, sizeof(name), "blobs/sha256/%s", blob_hex);
+        tar_basic_header(header, name, '0', 0644, 0, 0, ex.packed, 0);
+        tar_checksum(header);
+        if (pwrite(out_fd, header, sizeof(header), ex.out_base) != (ssize_t)sizeof(header)) {
+            export_fail(&ex, "回填層的 tar 頭部失敗");
+        }
+
+        // config 中不記錄時間：相同的內容總是生成相同的鏡像摘要
+        snprintf(json, sizeof(json),
+                 "{\"architecture\":\"%s\",\"os\":\"linux\",\"rootfs\":{\"type\":\"layers\",\"diff_ids\":[\"sha256:%s\"]}}",
+                 image_host_arch(), diff_hex);
+        outer_blob(&ex, json, config_hex);
+        size_t config_size = strlen(json);
+        snprintf(json, sizeof(json),
+                 "{\"schemaVersion\":2,\"mediaType\":\"application/vnd.oci.image.manifest.v1+json\","
+                 "\"config\":{\"mediaType\":\"application/vnd.oci.image.config.v1+json\",\"digest\":\"sha256:%s\",\"size\":%zu},"
+                 "\"layers\":[{\"mediaType\":\"%s\",\"digest\":\"sha256:%s\",\"size\":%llu}]}",
+                 config_hex, config_size, layer_media_type(options->codec), blob_hex, (unsigned long long)ex.packed);
+        outer_blob(&ex, json, manifest_hex);
+        size_t manifest_size = strlen(json);
+        json_escape(options->name ? options->name : "", name, sizeof(name));
+        snprintf(json, sizeof(json),
+                 "{\"schemaVersion\":2,\"manifests\":[{\"mediaType\":\"application/vnd.oci.image.manifest.v1+json\","
+                 "\"digest\":\"sha256:%s\",\"size\":%zu,\"platform\":{\"architecture\":\"%s\",\"os\":\"linux\"},"
+                 "\"annotations\":{\"org.opencontainers.image.ref.name\":\"%s\"}}]}",
+                 manifest_hex, manifest_size, image_host_arch(), name);
+        outer_file(&ex, "index.json", json, strlen(json));
+        snprintf(json, sizeof(json), "{\"imageLayoutVersion\":\"1.0.0\"}");
+        outer_file(&ex, "oci-layout", json, strlen(json));
+        out_write(&ex, zeros, sizeof(zeros));
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    if (!ex.failed) {
+        // 輸出可能是標準輸出，訊息寫到標準錯誤
+        fprintf(stderr, "導出 %llu 個文件：%.1f MB → %s %.1f MB，耗時 %.2f 秒 (%.0f MB/s)\n",
+                (unsigned long long)ex.files, ex.unpacked / 1048576.0, codec_name(options->codec),
+                ex.packed / 1048576.0, elapsed, elapsed > 0 ? ex.unpacked / 1048576.0 / elapsed : 0);
+        fprintf(stderr, "層 sha256:%s，鏡像 sha256:%.12s\n", diff_hex, config_hex);
+        if (options->lazy) {
+            fprintf(stderr, "延遲層：%zu 個 frame，%zu 個條目，目錄表 sha256:%.12s\n", ex.toc.chunk_count,
+                    ex.toc.entry_count, toc_hex);
+        }
+    }
+
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+    sigaction(SIGHUP, &old_hup, NULL);
+    encoder_free(&ex.encoder);
+    lazy_toc_free(&ex.toc);
+    for (size_t i = 0; i < ex.link_capacity; i++) {
+        free(ex.links[i].path);
+    }
+    free(ex.links);
+    free(ex.buf);
+    free(ex.out);
+    return ex.failed ? -1 : 0;
+}
@@ -0,0 +1,28 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "codec.h"
+
+// 導出選項
+typedef struct {
+    codec_type_t codec;        // 層的壓縮格式
+    int level;                 // 壓縮等級，0 表示該格式的預設值
+    int threads;               // zstd 壓縮的工作線程數
+    int overlay_layer;         // 來源是 OverlayFS 的層目錄：0/0 字元設備與不透明屬性轉回 .wh. 文件
+    int use_mmap;              // 以 mmap 直接把文件內容交給壓縮器（來源在導出期間不會被修改時才安全）
+    int lazy;                  // 生成可隨機讀取的層（只支援 zstd），見 lazy.h
+    const char* name;          // 寫入 index.json 的鏡像名稱
+} export_options_t;
+
+/**
+ * 把目錄樹導出為只有一層的 OCI 鏡像佈局 tar，可直接以 import 導入
+ * 層的 tar 在遍歷目錄時即時生成並壓縮，不產生臨時文件；
+ * 掛載在目錄樹中的其他文件系統（/proc、/sys、卷等）只保留掛載點
+ * @param root_fd 要導出的目錄
+ * @param out_fd 輸出文件（必須可定位：層寫完後才知道其摘要和大小，需要回填 tar 頭部）
+ * @param options 導出選項
+ * @return 0 成功，-1 失敗（已輸出錯誤信息）
+ */
+int export_image(int root_fd, int out_fd, const export_options_t* options);
+
+#endif // EXPORT_H
@@ -0,0 +1,1685 @@
+#include "image.h"
+#include "codec.h"
+#include "lazy.h"
+#include "namespace.h"
+#include "sha256.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/utsname.h>
+#include <sys/xattr.h>
+
+#define CHUNK_SIZE (1024 * 1024)   // 流水線中每個數據塊的大小
+#define QUEUE_DEPTH 8              // 每個階段之間最多緩衝的數據塊
+#define MAX_META_SIZE (16 * 1024 * 1024) // manifest / config 等小文件的上限
+#define TAR_MAX_XATTRS 8
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* ---------- tar 解析 ---------- */
+
+// tar 條目（已合併 pax / GNU 長名稱頭部）
+typedef struct {
+    char name[4096];
+    char linkname[4096];
+    char type;
+    mode_t mode;
+    uid_t uid;
+    gid_t gid;
+    uint64_t size;
+    time_t mtime;
+    unsigned int devmajor;
+    unsigned int devminor;
+    int xattr_count;
+    struct {
+        char name[128];
+        char value[256];
+        size_t len;
+    } xattrs[TAR_MAX_XATTRS];
+} tar_entry_t;
+
+// 順序讀取的 tar 流：外層文件以 pread 讀取，層內容從流水線的隊列讀取
+typedef struct {
+    int (*read)(void* ctx, void* buf, size_t len);   // 讀滿 len 位元組，0 成功，-1 失敗
+    int (*skip)(void* ctx, uint64_t len);
+    void* ctx;
+    uint64_t data_left;        // 目前條目尚未讀取的數據
+    uint64_t padding;          // 目前條目數據之後的填充
+} tar_reader_t;
+
+// 解析數字欄位：八進位文字，或首位元組最高位為 1 時的 base-256（大文件、大 UID）
+static uint64_t tar_number(const char* field, size_t len) {
+    uint64_t value = 0;
+
+    if ((unsigned char)field[0] & 0x80) {
+        value = (unsigned char)field[0] & 0x7f;
+        for (size_t i = 1; i < len; i++) {
+            value = value << 8 | (unsigned char)field[i];
+        }
+        return value;
+    }
+    for (size_t i = 0; i < len && field[i]; i++) {
+        if (field[i] >= '0' && field[i] <= '7') {
+            value = value * 8 + (uint64_t)(field[i] - '0');
+        }
+    }
+    return value;
+}
+
+// 讀取特殊條目（pax / GNU 長名稱）的內容
+static char* tar_read_meta(tar_reader_t* reader, uint64_t size) {
+    if (size > MAX_META_SIZE) {
+        return NULL;
+    }
+    char* data = malloc(size + 1);
+    if (!data || reader->read(reader->ctx, data, size) != 0) {
+        free(data);
+        return NULL;
+    }
+    data[size] = '\0';
+    reader->data_left = 0;
+    return data;
+}
+
+// 套用 pax 擴展頭部（"長度 鍵=值\n"）
+static void tar_apply_pax(tar_entry_t* entry, const char* data, size_t size, uint64_t* size_override) {
+    const char* p = data;
+    const char* end = data + size;
+
+    while (p < end) {
+        char* q;
+        long len = strtol(p, &q, 10);
+        if (len <= 0 || p + len > end || *q != ' ') {
+            return;
+        }
+        const char* key = q + 1;
+        const char* eq = memchr(key, '=', (size_t)(p + len - key));
+        if (!eq) {
+            return;
+        }
+        size_t key_len = (size_t)(eq - key);
+        const char* value = eq + 1;
+        size_t value_len = (size_t)(p + len - 1 - value);   // 不含結尾的 '\n'
+
+        if (key_len == 4 && strncmp(key, "path", 4) == 0 && value_len < sizeof(entry->name)) {
+            memcpy(entry->name, value, value_len);
+            entry->name[value_len] = '\0';
+        } else if (key_len == 8 && strncmp(key, "linkpath", 8) == 0 && value_len < sizeof(entry->linkname)) {
+            memcpy(entry->linkname, value, value_len);
+            entry->linkname[value_len] = '\0';
+        } else if (key_len == 4 && strncmp(key, "size", 4) == 0) {
+            *size_override = strtoull(value, NULL, 10);
+        } else if (key_len == 3 && strncmp(key, "uid", 3) == 0) {
+            entry->uid = (uid_t)strtoul(value, NULL, 10);
+        } else if (key_len == 3 && strncmp(key, "gid", 3) == 0) {
+            entry->gid = (gid_t)strtoul(value, NULL, 10);
+        } else if (key_len == 5 && strncmp(key, "mtime", 5) == 0) {
+            entry->mtime = (time_t)strtoll(value, NULL, 10);
+        } else if (key_len > 13 && strncmp(key, "SCHILY.xattr.", 13) == 0 && entry->xattr_count < TAR_MAX_XATTRS &&
+                   key_len - 13 < sizeof(entry->xattrs[0].name) && value_len <= sizeof(entry->xattrs[0].value)) {
+            int i = entry->xattr_count++;
+            memcpy(entry->xattrs[i].name, key + 13, key_len - 13);
+            entry->xattrs[i].name[key_len - 13] = '\0';
+            memcpy(entry->xattrs[i].value, value, value_len);
+            entry->xattrs[i].len = value_len;
+        }
+        p += len;
+    }
+}
+
+/**
+ * 讀取下一個條目的頭部（跳過上一個條目未讀取的數據）
+ * @return 1 讀到條目，0 歸檔結束，-1 格式錯誤
+ */
+static int tar_next(tar_reader_t* reader, tar_entry_t* entry) {
+    unsigned char header[512];
+    char pending_name[4096] = "", pending_link[4096] = "";
+    char* pax = NULL;
+    size_t pax_len = 0;
+
+    for (;;) {
+        if (reader->skip(reader->ctx, reader->data_left + reader->padding) != 0 ||
+            reader->read(reader->ctx, header, sizeof(header)) != 0) {
+            free(pax);
+            return -1;
+        }
+        reader->data_left = 0;
+        reader->padding = 0;
+
+        // 全零的區塊表示歸檔結束
+        unsigned int sum = 0;
+        int zero = 1;
+        for (int i = 0; i < 512; i++) {
+            sum += (i >= 148 && i < 156) ? ' ' : header[i];
+            zero &= header[i] == 0;
+        }
+        if (zero) {
+            free(pax);
+            return 0;
+        }
+        if (sum != tar_number((const char*)header + 148, 8)) {
+            free(pax);
+            return -1;
+        }
+
+        memset(entry, 0, offsetof(tar_entry_t, xattrs));
+        entry->type = (char)header[156];
+        entry->mode = (mode_t)tar_number((const char*)header + 100, 8) & 07777;
+        entry->uid = (uid_t)tar_number((const char*)header + 108, 8);
+        entry->gid = (gid_t)tar_number((const char*)header + 116, 8);
+        entry->size = tar_number((const char*)header + 124, 12);
+        entry->mtime = (time_t)tar_number((const char*)header + 136, 12);
+        entry->devmajor = (unsigned int)tar_number((const char*)header + 329, 8);
+        entry->devminor = (unsigned int)tar_number((const char*)header + 337, 8);
+        reader->data_left = entry->size;
+        reader->padding = (512 - entry->size % 512) % 512;
+
+        // ustar：名稱 = prefix + "/" + name
+        if (memcmp(header + 257, "ustar", 5) == 0 && header[345]) {
+            snprintf(entry->name, sizeof(entry->name), "%.155s/%.100s", (const char*)header + 345, (const char*)header);
+        } else {
+            snprintf(entry->name, sizeof(entry->name), "%.100s", (const char*)header);
+        }
+        snprintf(entry->linkname, sizeof(entry->linkname), "%.100s", (const char*)header + 157);
+
+        if (entry->type == 'L' || entry->type == 'K') {
+            // GNU 長名稱：內容是下一個條目的名稱或連結目標
+            char* data = tar_read_meta(reader, entry->size);
+            if (!data) {
+                free(pax);
+                return -1;
+            }
+            snprintf(entry->type == 'L' ? pending_name : pending_link, 4096, "%s", data);
+            free(data);
+            continue;
+        }
+        if (entry->type == 'x') {
+            free(pax);
+            pax_len = entry->size;
+            if (!(pax = tar_read_meta(reader, entry->size))) {
+                return -1;
+            }
+            continue;
+        }
+        if (entry->type == 'g') {
+            continue;
+        }
+
+        entry->xattr_count = 0;
+        if (pending_name[0]) {
+            snprintf(entry->name, sizeof(entry->name), "%s", pending_name);
+        }
+        if (pending_link[0]) {
+            snprintf(entry->linkname, sizeof(entry->linkname), "%s", pending_link);
+        }
+        if (pax) {
+            uint64_t size = entry->size;
+            tar_apply_pax(entry, pax, pax_len, &size);
+            entry->size = size;
+            reader->data_left = size;
+            reader->padding = (512 - size % 512) % 512;
+            free(pax);
+        }
+        return 1;
+    }
+}
+
+// 去掉開頭的 "./" 和 "/"；含有 ".." 的路徑視為無效
+static int tar_clean_path(char* path) {
+    char* p = path;
+
+    for (;;) {
+        if (p[0] == '/') {
+            p++;
+        } else if (p[0] == '.' && p[1] == '/') {
+            p += 2;
+        } else {
+            break;
+        }
+    }
+    memmove(path, p, strlen(p) + 1);
+    size_t len = strlen(path);
+    while (len > 0 && path[len - 1] == '/') {
+        path[--len] = '\0';
+    }
+    if (strcmp(path, ".") == 0) {
+        path[0] = '\0';
+    }
+    for (char* c = path; (c = strstr(c, "..")) != NULL; c += 2) {
+        if ((c == path || c[-1] == '/') && (c[2] == '\0' || c[2] == '/')) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* ---------- 外層 tar 文件 ---------- */
+
+// 外層 tar 中的一個文件
+typedef struct {
+    char name[256];
+    char link[256];            // 符號連結的目標（docker save 以連結表示重複的層），普通文件為空
+    off_t offset;
+    uint64_t size;
+} archive_member_t;
+
+typedef struct {
+    int fd;
+    archive_member_t* members;
+    int count;
+} archive_t;
+
+typedef struct {
+    int fd;
+    off_t offset;
+} file_source_t;
+
+static int file_read(void* ctx, void* buf, size_t len) {
+    file_source_t* src = ctx;
+    while (len > 0) {
+        ssize_t n = pread(src->fd, buf, len, src->offset);
+        if (n <= 0) {
+            return -1;
+        }
+        src->offset += n;
+        buf = (char*)buf + n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int file_skip(void* ctx, uint64_t len) {
+    ((file_source_t*)ctx)->offset += (off_t)len;
+    return 0;
+}
+
+// 掃描外層 tar 的頭部，記錄每個文件的位置（只讀頭部，數據部分直接跳過）
+static int archive_open(archive_t* archive, const char* path) {
+    tar_entry_t* entry = malloc(sizeof(tar_entry_t));
+    file_source_t src = {-1, 0};
+    tar_reader_t reader = {file_read, file_skip, &src, 0, 0};
+    int capacity = 0;
+    int ret;
+
+    memset(archive, 0, sizeof(*archive));
+    archive->fd = src.fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (archive->fd == -1 || !entry) {
+        free(entry);
+        return -1;
+    }
+    while ((ret = tar_next(&reader, entry)) == 1) {
+        if (entry->type != '0' && entry->type != '\0' && entry->type != '7' && entry->type != '2') {
+            continue;
+        }
+        if (tar_clean_path(entry->name) != 0 || strlen(entry->name) >= sizeof(archive->members[0].name)) {
+            continue;
+        }
+        if (archive->count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            archive_member_t* grown = realloc(archive->members, (size_t)capacity * sizeof(archive_member_t));
+            if (!grown) {
+                ret = -1;
+                break;
+            }
+            archive->members = grown;
+        }
+        archive_member_t* member = &archive->members[archive->count++];
+        memcpy(member->name, entry->name, strlen(entry->name) + 1);
+        member->link[0] = '\0';
+        if (entry->type == '2') {
+            // 相對於連結所在目錄的路徑
+            const char* slash = strrchr(entry->name, '/');
+            size_t dir_len = slash && entry->linkname[0] != '/' ? (size_t)(slash - entry->name) + 1 : 0;
+            size_t link_len = strlen(entry->linkname);
+            if (dir_len + link_len < sizeof(member->link)) {
+                memcpy(member->link, entry->name, dir_len);
+                memcpy(member->link + dir_len, entry->linkname, link_len + 1);
+            }
+        }
+        member->offset = src.offset;
+        member->size = entry->size;
+    }
+    free(entry);
+    return ret;
+}
+
+static void archive_close(archive_t* archive) {
+    free(archive->members);
+    if (archive->fd != -1) {
+        close(archive->fd);
+    }
+}
+
+// 規範化路徑中的 "." 和 ".."（只用於外層 tar 內的連結目標）
+static void normalize_path(char* path) {
+    char* parts[64];
+    int count = 0;
+    char copy[512];
+
+    snprintf(copy, sizeof(copy), "%s", path);
+    for (char* save = NULL, *part = strtok_r(copy, "/", &save); part; part = strtok_r(NULL, "/", &save)) {
+        if (strcmp(part, "..") == 0) {
+            count -= count > 0;
+        } else if (strcmp(part, ".") != 0 && count < 64) {
+            parts[count++] = part;
+        }
+    }
+    path[0] = '\0';
+    for (int i = 0; i < count; i++) {
+        strcat(path, i ? "/" : "");
+        strcat(path, parts[i]);
+    }
+}
+
+static const archive_member_t* archive_find(const archive_t* archive, const char* name) {
+    char clean[512];
+    snprintf(clean, sizeof(clean), "%s", name);
+    normalize_path(clean);
+
+    // 最多跟隨幾層連結
+    for (int depth = 0; depth < 8; depth++) {
+        const archive_member_t* found = NULL;
+        for (int i = 0; i < archive->count && !found; i++) {
+            if (strcmp(archive->members[i].name, clean) == 0) {
+                found = &archive->members[i];
+            }
+        }
+        if (!found || !found->link[0]) {
+            return found;
+        }
+        snprintf(clean, sizeof(clean), "%s", found->link);
+        normalize_path(clean);
+    }
+    return NULL;
+}
+
+// 讀取外層 tar 中的小文件（manifest、config），expected 不為空時校驗 sha256
+static char* archive_read(const archive_t* archive, const char* name, const char* expected) {
+    const archive_member_t* member = archive_find(archive, name);
+    if (!member || member->size > MAX_META_SIZE) {
+        fprintf(stderr, "錯誤: 鏡像中找不到 %s\n", name);
+        return NULL;
+    }
+    char* data = malloc(member->size + 1);
+    file_source_t src = {archive->fd, member->offset};
+    if (!data || file_read(&src, data, member->size) != 0) {
+        free(data);
+        return NULL;
+    }
+    data[member->size] = '\0';
+
+    if (expected && expected[0]) {
+        sha256_t ctx;
+        char hex[SHA256_HEX_LEN + 1];
+        sha256_init(&ctx);
+        sha256_update(&ctx, data, member->size);
+        sha256_final_hex(&ctx, hex);
+        if (strcmp(hex, expected) != 0) {
+            fprintf(stderr, "錯誤: %s 的摘要不符（預期 %s，實際 %s）\n", name, expected, hex);
+            free(data);
+            return NULL;
+        }
+    }
+    return data;
+}
+
+/* ---------- 最小的 JSON 讀取 ---------- */
+
+static const char* json_ws(const char* p) {
+    while (p && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+// 跳過一個值，返回其後的位置
+static const char* json_skip(const char* p) {
+    int depth = 0;
+
+    p = json_ws(p);
+    do {
+        if (!p || !*p) {
+            return NULL;
+        }
+        if (*p == '"') {
+            for (p++; *p && *p != '"'; p++) {
+                if (*p == '\\' && p[1]) {
+                    p++;
+                }
+            }
+            if (!*p) {
+                return NULL;
+            }
+            p++;
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+            p++;
+        } else if (*p == '}' || *p == ']') {
+            depth--;
+            p++;
+        } else if (depth == 0) {
+            while (*p && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n') {
+                p++;
+            }
+        } else {
+            p++;
+        }
+    } while (depth > 0);
+    return p;
+}
+
+// 取得物件中某個鍵的值（obj 指向 '{'）
+static const char* json_get(const char* obj, const char* key) {
+    size_t key_len = strlen(key);
+    const char* p = json_ws(obj);
+
+    if (!p || *p != '{') {
+        return NULL;
+    }
+    p = json_ws(p + 1);
+    while (p && *p == '"') {
+        const char* name = p + 1;
+        const char* name_end = json_skip(p);
+        if (!name_end) {
+            return NULL;
+        }
+        p = json_ws(name_end);
+        if (*p != ':') {
+            return NULL;
+        }
+        p = json_ws(p + 1);
+        if ((size_t)(name_end - 1 - name) == key_len && strncmp(name, key, key_len) == 0) {
+            return p;
+        }
+        p = json_ws(json_skip(p));
+        if (!p || *p != ',') {
+            return NULL;
+        }
+        p = json_ws(p + 1);
+    }
+    return NULL;
+}
+
+// 取得陣列中的第 index 個元素（arr 指向 '['）
+static const char* json_at(const char* arr, int index) {
+    const char* p = json_ws(arr);
+
+    if (!p || *p != '[') {
+        return NULL;
+    }
+    p = json_ws(p + 1);
+    if (*p == ']') {
+        return NULL;
+    }
+    for (int i = 0; i < index; i++) {
+        p = json_ws(json_skip(p));
+        if (!p || *p != ',') {
+            return NULL;
+        }
+        p = json_ws(p + 1);
+    }
+    return p;
+}
+
+// 複製字串值（只處理鏡像元數據中會出現的簡單轉義）
+static int json_string(const char* p, char* out, size_t size) {
+    size_t n = 0;
+
+    if (!p || *p != '"' || size == 0) {
+        return -1;
+    }
+    for (p++; *p && *p != '"'; p++) {
+        if (*p == '\\' && p[1]) {
+            p++;
+        }
+        if (n + 1 < size) {
+            out[n++] = *p;
+        }
+    }
+    out[n] = '\0';
+    return *p == '"' ? 0 : -1;
+}
+
+// "sha256:<hex>" 中的十六進位部分
+static int digest_hex(const char* digest, char* hex) {
+    if (strncmp(digest, "sha256:", 7) != 0 || strlen(digest + 7) != SHA256_HEX_LEN ||
+        strspn(digest + 7, "0123456789abcdef") != SHA256_HEX_LEN) {
+        return -1;
+    }
+    memcpy(hex, digest + 7, SHA256_HEX_LEN + 1);
+    return 0;
+}
+
+// 從 blobs/sha256/<hex> 或 <hex>.json 形式的路徑取得預期的摘要，其他形式返回空字串
+static void path_digest(const char* path, char* hex) {
+    const char* base = strrchr(path, '/');
+    char digest[80];
+
+    base = base ? base + 1 : path;
+    hex[0] = '\0';
+    snprintf(digest, sizeof(digest), "sha256:%.*s", SHA256_HEX_LEN, base);
+    if ((strncmp(path, "blobs/sha256/", 13) == 0 && strlen(base) == SHA256_HEX_LEN) ||
+        (strlen(base) == SHA256_HEX_LEN + 5 && strcmp(base + SHA256_HEX_LEN, ".json") == 0)) {
+        if (digest_hex(digest, hex) != 0) {
+            hex[0] = '\0';
+        }
+    }
+}
+
+/* ---------- 層的流水線 ---------- */
+
+typedef struct {
+    unsigned char* data;       // NULL 表示流結束
+    size_t len;
+} chunk_t;
+
+// 有界的數據塊隊列，生產者在隊列滿時阻塞（限制每層佔用的記憶體）
+typedef struct {
+    chunk_t items[QUEUE_DEPTH];
+    int head;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} chunk_queue_t;
+
+static void queue_init(chunk_queue_t* queue) {
+    memset(queue, 0, sizeof(*queue));
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+}
+
+static void queue_destroy(chunk_queue_t* queue) {
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->changed);
+}
+
+static void queue_push(chunk_queue_t* queue, unsigned char* data, size_t len) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == QUEUE_DEPTH) {
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    queue->items[(queue->head + queue->count) % QUEUE_DEPTH] = (chunk_t){data, len};
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static chunk_t queue_pop(chunk_queue_t* queue) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    chunk_t chunk = queue->items[queue->head];
+    queue->head = (queue->head + 1) % QUEUE_DEPTH;
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return chunk;
+}
+
+// 丟棄隊列中剩餘的數據直到流結束（下游失敗後讓上游能夠結束）
+static void queue_drain(chunk_queue_t* queue) {
+    chunk_t chunk;
+    while ((chunk = queue_pop(queue)).data) {
+        free(chunk.data);
+    }
+}
+
+// 一個層的導入任務
+typedef struct {
+    int fd;                    // 外層 tar 文件
+    off_t offset;
+    uint64_t size;             // 壓縮後（blob）的大小
+    char blob_hex[SHA256_HEX_LEN + 1]; // 預期的 blob 摘要，未知時為空
+    char diff_hex[SHA256_HEX_LEN + 1]; // 預期的 diff_id（解壓後 tar 的摘要）
+    int failed;
+    char error[256];
+    codec_type_t codec;
+    uint64_t unpacked;         // 解壓後的大小
+    int reused;                // 層已存在，直接重用
+    int lazy;                  // 以延遲層導入，不解包
+    char toc_hex[SHA256_HEX_LEN + 1]; // 延遲層的目錄表摘要
+    chunk_queue_t raw;         // 讀取 → 解壓
+    chunk_queue_t plain;       // 解壓 → 校驗
+    chunk_queue_t tar;         // 校驗 → 解包
+    char blob_actual[SHA256_HEX_LEN + 1];
+    char diff_actual[SHA256_HEX_LEN + 1];
+} layer_job_t;
+
+static void job_fail(layer_job_t* job, const char* fmt, const char* detail) {
+    if (!__atomic_exchange_n(&job->failed, 1, __ATOMIC_SEQ_CST)) {
+        snprintf(job->error, sizeof(job->error), fmt, detail);
+    }
+}
+
+static int job_failed(layer_job_t* job) {
+    return __atomic_load_n(&job->failed, __ATOMIC_SEQ_CST);
+}
+
+// 階段 1：從外層 tar 讀取 blob 並計算其摘要
+static void* stage_read(void* arg) {
+    layer_job_t* job = arg;
+    sha256_t ctx;
+    uint64_t left = job->size;
+    off_t offset = job->offset;
+
+    sha256_init(&ctx);
+    while (left > 0 && !job_failed(job)) {
+        size_t want = left < CHUNK_SIZE ? (size_t)left : CHUNK_SIZE;
+        unsigned char* data = malloc(CHUNK_SIZE);
+        ssize_t n = data ? pread(job->fd, data, want, offset) : -1;
+        if (n <= 0) {
+            free(data);
+            job_fail(job, "讀取層失敗: %s", strerror(errno));
+            break;
+        }
+        sha256_update(&ctx, data, (size_t)n);
+        offset += n;
+        left -= (uint64_t)n;
+        queue_push(&job->raw, data, (size_t)n);
+    }
+    sha256_final_hex(&ctx, job->blob_actual);
+    queue_push(&job->raw, NULL, 0);
+    return NULL;
+}
+
+// 階段 2：解壓（gzip / zstd / 未壓縮）
+static void* stage_decode(void* arg) {
+    layer_job_t* job = arg;
+    decoder_t decoder = {0};
+    unsigned char* out = NULL;
+    size_t out_len = 0;
+    int initialized = 0;
+    chunk_t chunk;
+
+    while ((chunk = queue_pop(&job->raw)).data) {
+        if (job_failed(job)) {
+            free(chunk.data);
+            continue;
+        }
+        if (!initialized) {
+            job->codec = codec_detect(chunk.data, chunk.len);
+            if (decoder_init(&decoder, job->codec) != 0) {
+                job_fail(job, "不支援的壓縮格式: %s（需要 libzstd.so.1）", codec_name(job->codec));
+                free(chunk.data);
+                continue;
+            }
+            initialized = 1;
+        }
+        const unsigned char* in = chunk.data;
+        size_t in_len = chunk.len;
+        for (;;) {
+            const unsigned char* before = in;
+            if (!out && !(out = malloc(CHUNK_SIZE))) {
+                job_fail(job, "%s", strerror(ENOMEM));
+                break;
+            }
+            ssize_t n = decoder_run(&decoder, &in, &in_len, out + out_len, CHUNK_SIZE - out_len);
+            // 輸出未滿卻無法消耗輸入（例如壓縮流之後的多餘數據）同樣視為損壞
+            if (n < 0 || (n == 0 && in_len > 0 && out_len < CHUNK_SIZE && in == before)) {
+                job_fail(job, "層的 %s 數據已損壞", codec_name(job->codec));
+                break;
+            }
+            out_len += (size_t)n;
+            if (out_len == CHUNK_SIZE) {
+                queue_push(&job->plain, out, out_len);
+                out = NULL;
+                out_len = 0;
+                continue;
+            }
+            if (in_len == 0) {
+                break;
+            }
+        }
+        free(chunk.data);
+    }
+    if (initialized && !job_failed(job) && !decoder.finished) {
+        job_fail(job, "層的 %s 數據不完整", codec_name(job->codec));
+    }
+    if (out_len > 0 && !job_failed(job)) {
+        queue_push(&job->plain, out, out_len);
+    } else {
+        free(out);
+    }
+    if (initialized) {
+        decoder_free(&decoder);
+    }
+    queue_push(&job->plain, NULL, 0);
+    return NULL;
+}
+
+// 階段 3：計算解壓後內容的摘要（diff_id）
+static void* stage_hash(void* arg) {
+    layer_job_t* job = arg;
+    sha256_t ctx;
+    chunk_t chunk;
+
+    sha256_init(&ctx);
+    while ((chunk = queue_pop(&job->plain)).data) {
+        if (job_failed(job)) {
+            free(chunk.data);
+            continue;
+        }
+        sha256_update(&ctx, chunk.data, chunk.len);
+        job->unpacked += chunk.len;
+        queue_push(&job->tar, chunk.data, chunk.len);
+    }
+    sha256_final_hex(&ctx, job->diff_actual);
+    queue_push(&job->tar, NULL, 0);
+    return NULL;
+}
+
+// 從隊列讀取的 tar 流
+typedef struct {
+    chunk_queue_t* queue;
+    chunk_t chunk;
+    size_t pos;
+    int eof;
+} queue_source_t;
+
+static int queue_read(void* ctx, void* buf, size_t len) {
+    queue_source_t* src = ctx;
+    while (len > 0) {
+        if (src->pos == src->chunk.len) {
+            free(src->chunk.data);
+            src->chunk.data = NULL;
+            if (src->eof) {
+                return -1;
+            }
+            src->chunk = queue_pop(src->queue);
+            src->pos = 0;
+            if (!src->chunk.data) {
+                src->eof = 1;
+                src->chunk.len = 0;
+                return -1;
+            }
+        }
+        size_t n = src->chunk.len - src->pos < len ? src->chunk.len - src->pos : len;
+        if (buf) {
+            memcpy(buf, src->chunk.data + src->pos, n);
+            buf = (char*)buf + n;
+        }
+        src->pos += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int queue_skip(void* ctx, uint64_t len) {
+    while (len > 0) {
+        size_t n = len < CHUNK_SIZE ? (size_t)len : CHUNK_SIZE;
+        if (queue_read(ctx, NULL, n) != 0) {
+            return -1;
+        }
+        len -= n;
+    }
+    return 0;
+}
+
+/* ---------- 解包到層目錄 ---------- */
+
+// 打開條目的父目錄（不存在時逐層創建），*base 指向條目自己的名稱
+static int open_parent(int root_fd, char* path, char** base) {
+    char* slash = strrchr(path, '/');
+    if (!slash) {
+        *base = path;
+        return open_in_root(root_fd, "", O_PATH | O_DIRECTORY);
+    }
+    *slash = '\0';
+    *base = slash + 1;
+    int fd = open_in_root(root_fd, path, O_PATH | O_DIRECTORY);
+    if (fd == -1 && errno == ENOENT) {
+        // 有些 tar 不包含父目錄的條目
+        char* inner_base;
+        int parent = open_parent(root_fd, path, &inner_base);
+        if (parent != -1) {
+            mkdirat(parent, inner_base, 0755);
+            close(parent);
+        }
+        fd = open_in_root(root_fd, path, O_PATH | O_DIRECTORY);
+    }
+    *slash = '/';
+    return fd;
+}
+
+// 移除已存在的同名條目（同一層中後出現的條目覆蓋先出現的）
+static void remove_existing(int parent, const char* base, int keep_dir) {
+    struct stat st;
+    if (fstatat(parent, base, &st, AT_SYMLINK_NOFOLLOW) == 0 && !(keep_dir && S_ISDIR(st.st_mode))) {
+        unlinkat(parent, base, S_ISDIR(st.st_mode) ? AT_REMOVEDIR : 0);
+    }
+}
+
+static void apply_xattrs(int fd, const tar_entry_t* entry) {
+    for (int i = 0; i < entry->xattr_count; i++) {
+        fsetxattr(fd, entry->xattrs[i].name, entry->xattrs[i].value, entry->xattrs[i].len, 0);
+    }
+}
+
+// 寫入普通文件的內容
+static int extract_file(tar_reader_t* reader, int parent, const char* base, const tar_entry_t* entry) {
+    static __thread unsigned char buf[256 * 1024];
+    uint64_t left = entry->size;
+
+    remove_existing(parent, base, 0);
+    int fd = openat(parent, base, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        return -1;
+    }
+    while (left > 0) {
+        size_t n = left < sizeof(buf) ? (size_t)left : sizeof(buf);
+        if (reader->read(reader->ctx, buf, n) != 0) {
+            close(fd);
+            return -1;
+        }
+        reader->data_left -= n;
+        for (size_t done = 0; done < n; ) {
+            ssize_t w = write(fd, buf + done, n - done);
+            if (w <= 0) {
+                close(fd);
+                return -1;
+            }
+            done += (size_t)w;
+        }
+        left -= n;
+    }
+    // chown 會清除 setuid 位，所以先 chown 再 chmod
+    struct timespec times[2] = {{entry->mtime, 0}, {entry->mtime, 0}};
+    if (fchown(fd, entry->uid, entry->gid) == -1 || fchmod(fd, entry->mode) == -1) {
+        close(fd);
+        return -1;
+    }
+    apply_xattrs(fd, entry);
+    futimens(fd, times);
+    close(fd);
+    return 0;
+}
+
+// 把一個 tar 條目套用到層目錄
+// @return 0 成功，-1 失敗（errno 說明原因）
+static int extract_entry(tar_reader_t* reader, int root_fd, tar_entry_t* entry) {
+    char* base;
+    int ret = 0;
+
+    if (tar_clean_path(entry->name) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (entry->name[0] == '\0') {
+        return 0;   // 層的根目錄本身
+    }
+    int parent = open_parent(root_fd, entry->name, &base);
+    if (parent == -1) {
+        return -1;
+    }
+
+    if (strcmp(base, ".wh..wh..opq") == 0) {
+        // 不透明目錄：下層目錄中的內容全部被隱藏
+        // 同時寫入 trusted.* 和 user.*，以特權方式或在用戶命名空間中 (userxattr) 掛載都能識別
+        int dir = openat(parent, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir != -1) {
+            fsetxattr(dir, "trusted.overlay.opaque", "y", 1, 0);
+            ret = fsetxattr(dir, "user.overlay.opaque", "y", 1, 0);
+            close(dir);
+        } else {
+            ret = -1;
+        }
+    } else if (strncmp(base, ".wh.", 4) == 0) {
+        // 刪除標記：OverlayFS 以 0/0 的字元設備表示被刪除的文件
+        struct timespec times[2] = {{entry->mtime, 0}, {entry->mtime, 0}};
+        remove_existing(parent, base + 4, 0);
+        ret = mknodat(parent, base + 4, S_IFCHR, makedev(0, 0));
+        if (ret == 0) {
+            utimensat(parent, base + 4, times, AT_SYMLINK_NOFOLLOW);
+        }
+    } else {
+        struct timespec times[2] = {{entry->mtime, 0}, {entry->mtime, 0}};
+        switch (entry->type) {
+        case '0': case '\0': case '7':
+            ret = extract_file(reader, parent, base, entry);
+            break;
+        case '5':
+            remove_existing(parent, base, 1);
+            if (mkdirat(parent, base, 0700) == -1 && errno != EEXIST) {
+                ret = -1;
+                break;
+            }
+            ret = fchownat(parent, base, entry->uid, entry->gid, AT_SYMLINK_NOFOLLOW) |
+                  fchmodat(parent, base, entry->mode, 0);
+            if (entry->xattr_count > 0) {
+                int dir = openat(parent, base, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if (dir != -1) {
+                    apply_xattrs(dir, entry);
+                    close(dir);
+                }
+            }
+            break;
+        case '2':
+            remove_existing(parent, base, 0);
+            ret = symlinkat(entry->linkname, parent, base);
+            if (ret == 0) {
+                fchownat(parent, base, entry->uid, entry->gid, AT_SYMLINK_NOFOLLOW);
+                utimensat(parent, base, times, AT_SYMLINK_NOFOLLOW);
+            }
+            break;
+        case '1': {
+            // 硬連結的目標同樣在層目錄之內解析
+            if (tar_clean_path(entry->linkname) != 0) {
+                errno = EINVAL;
+                ret = -1;
+                break;
+            }
+            int target = open_in_root(root_fd, entry->linkname, O_PATH | O_NOFOLLOW);
+            remove_existing(parent, base, 0);
+            ret = target == -1 ? -1 : linkat(target, "", parent, base, AT_EMPTY_PATH);
+            if (target != -1) close(target);
+            break;
+        }
+        case '3': case '4': case '6': {
+            mode_t type = entry->type == '3' ? S_IFCHR : entry->type == '4' ? S_IFBLK : S_IFIFO;
+            remove_existing(parent, base, 0);
+            ret = mknodat(parent, base, type | entry->mode, makedev(entry->devmajor, entry->devminor));
+            if (ret == 0) {
+                ret = fchownat(parent, base, entry->uid, entry->gid, AT_SYMLINK_NOFOLLOW) |
+                      fchmodat(parent, base, entry->mode, 0);
+                utimensat(parent, base, times, AT_SYMLINK_NOFOLLOW);
+            }
+            break;
+        }
+        default:
+            // 其他類型（例如 sparse 文件的擴展）不支援，數據由 tar_next 跳過
+            break;
+        }
+    }
+    close(parent);
+    return ret == 0 ? 0 : -1;
+}
+
+// 目錄的修改時間在其中的條目解包完後才能設置，先記錄下來
+typedef struct {
+    char* path;
+    time_t mtime;
+} dir_time_t;
+
+static void record_dir_time(dir_time_t** dirs, size_t* count, size_t* capacity, const tar_entry_t* entry) {
+    if (*count == *capacity) {
+        size_t grown = *capacity ? *capacity * 2 : 64;
+        dir_time_t* table = realloc(*dirs, grown * sizeof(dir_time_t));
+        if (!table) {
+            return;
+        }
+        *dirs = table;
+        *capacity = grown;
+    }
+    (*dirs)[*count].path = strdup(entry->name);
+    (*dirs)[*count].mtime = entry->mtime;
+    if ((*dirs)[*count].path) {
+        (*count)++;
+    }
+}
+
+// 由深到淺恢復目錄的修改時間，重新導出同一層時得到相同的 diff_id
+static void apply_dir_times(int root_fd, dir_time_t* dirs, size_t count) {
+    for (size_t i = count; i-- > 0; ) {
+        struct timespec times[2] = {{dirs[i].mtime, 0}, {dirs[i].mtime, 0}};
+        int fd = open_in_root(root_fd, dirs[i].path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+        if (fd != -1) {
+            futimens(fd, times);
+            close(fd);
+        }
+        free(dirs[i].path);
+    }
+    free(dirs);
+}
+
+// 解包層並校驗摘要，成功後原子地改名為 layers/<diff_id>
+static void import_layer(layer_job_t* job) {
+    char tmp_path[512], final_path[512], cmd[600];
+    pthread_t reader_thread, decoder_thread, hasher_thread;
+    queue_source_t src;
+    tar_reader_t reader = {queue_read, queue_skip, &src, 0, 0};
+    tar_entry_t* entry = malloc(sizeof(tar_entry_t));
+    dir_time_t* dirs = NULL;
+    size_t dir_count = 0, dir_capacity = 0;
+
+    snprintf(final_path, sizeof(final_path), "%s/%s", IMAGE_LAYERS_DIR, job->diff_hex);
+    snprintf(tmp_path, sizeof(tmp_path), "%s/.tmp-%s-%d", IMAGE_LAYERS_DIR, job->diff_hex, getpid());
+    if (!entry || (mkdir(tmp_path, 0755) == -1 && errno != EEXIST)) {
+        job_fail(job, "無法創建層目錄: %s", strerror(errno));
+        free(entry);
+        return;
+    }
+    int root_fd = open(tmp_path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+
+    queue_init(&job->raw);
+    queue_init(&job->plain);
+    queue_init(&job->tar);
+    memset(&src, 0, sizeof(src));
+    src.queue = &job->tar;
+    pthread_create(&reader_thread, NULL, stage_read, job);
+    pthread_create(&decoder_thread, NULL, stage_decode, job);
+    pthread_create(&hasher_thread, NULL, stage_hash, job);
+
+    // 階段 4（本線程）：解包
+    int ret = 0;
+    while (root_fd != -1 && !job_failed(job) && (ret = tar_next(&reader, entry)) == 1) {
+        // 容器的 root 映射到主機的真實用戶，層中屬於 root 的文件也歸該用戶所有，容器內才會看到 root
+        if (entry->uid == 0) entry->uid = get_real_uid();
+        if (entry->gid == 0) entry->gid = get_real_gid();
+        if (entry->type == '5') {
+            record_dir_time(&dirs, &dir_count, &dir_capacity, entry);
+        }
+        if (extract_entry(&reader, root_fd, entry) != 0) {
+            char detail[4200];
+            snprintf(detail, sizeof(detail), "%s: %s", entry->name, strerror(errno));
+            job_fail(job, "無法解包 %s", detail);
+        }
+    }
+    if (root_fd == -1 || (!job_failed(job) && ret == -1)) {
+        job_fail(job, "%s", "層不是有效的 tar 格式");
+    }
+    // 讀完歸檔結束標記之後的填充，diff_id 涵蓋整個解壓後的流
+    free(src.chunk.data);
+    if (!src.eof) {
+        queue_drain(&job->tar);
+    }
+
+    pthread_join(reader_thread, NULL);
+    pthread_join(decoder_thread, NULL);
+    pthread_join(hasher_thread, NULL);
+    queue_destroy(&job->raw);
+    queue_destroy(&job->plain);
+    queue_destroy(&job->tar);
+    if (root_fd != -1) {
+        apply_dir_times(root_fd, dirs, dir_count);
+        close(root_fd);
+    } else {
+        free(dirs);
+    }
+    free(entry);
+
+    if (!job_failed(job) && job->blob_hex[0] && strcmp(job->blob_hex, job->blob_actual) != 0) {
+        job_fail(job, "blob 摘要不符（實際 sha256:%s）", job->blob_actual);
+    }
+    if (!job_failed(job) && strcmp(job->diff_hex, job->diff_actual) != 0) {
+        job_fail(job, "diff_id 不符（實際 sha256:%s）", job->diff_actual);
+    }
+    // 並行導入同一層時只保留先完成的那份
+    if (job_failed(job) || (rename(tmp_path, final_path) == -1 && errno != EEXIST && errno != ENOTEMPTY)) {
+        job_fail(job, "無法保存層: %s", strerror(errno));
+    }
+    if (access(tmp_path, F_OK) == 0) {
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", tmp_path);
+        if (system(cmd) != 0) {
+            fprintf(stderr, "警告: 無法刪除 %s\n", tmp_path);
+        }
+    }
+}
+
+// 工作線程共用的任務列表
+typedef struct {
+    layer_job_t* jobs;
+    int count;
+    int next;
+    pthread_mutex_t lock;
+} job_list_t;
+
+static void* layer_worker(void* arg) {
+    job_list_t* list = arg;
+    for (;;) {
+        pthread_mutex_lock(&list->lock);
+        int index = list->next < list->count ? list->next++ : -1;
+        pthread_mutex_unlock(&list->lock);
+        if (index < 0) {
+            return NULL;
+        }
+        if (!list->jobs[index].reused && !list->jobs[index].lazy) {
+            import_layer(&list->jobs[index]);
+        }
+    }
+}
+
+/* ---------- manifest ---------- */
+
+// 解析出的鏡像描述
+typedef struct {
+    char name[256];
+    char config_path[256];
+    char config_hex[SHA256_HEX_LEN + 1];
+    int layer_count;
+    char layer_paths[IMAGE_MAX_LAYERS][256];
+    char layer_hex[IMAGE_MAX_LAYERS][SHA256_HEX_LEN + 1];   // blob 摘要，未知時為空
+} image_manifest_t;
+
+// docker save 格式：manifest.json = [{"Config": ..., "RepoTags": [...], "Layers": [...]}]
+static int parse_docker_manifest(const char* json, image_manifest_t* m) {
+    const char* entry = json_at(json, 0);
+    const char* layers = entry ? json_get(entry, "Layers") : NULL;
+    const char* tags = entry ? json_get(entry, "RepoTags") : NULL;
+
+    if (!layers || json_string(json_get(entry, "Config"), m->config_path, sizeof(m->config_path)) != 0) {
+        return -1;
+    }
+    path_digest(m->config_path, m->config_hex);
+    if (tags && *tags == '[') {
+        json_string(json_at(tags, 0), m->name, sizeof(m->name));
+    }
+    for (const char* p; (p = json_at(layers, m->layer_count)) != NULL; m->layer_count++) {
+        if (m->layer_count >= IMAGE_MAX_LAYERS ||
+            json_string(p, m->layer_paths[m->layer_count], sizeof(m->layer_paths[0])) != 0) {
+            return -1;
+        }
+        path_digest(m->layer_paths[m->layer_count], m->layer_hex[m->layer_count]);
+    }
+    return 0;
+}
+
+const char* image_host_arch(void) {
+    static struct utsname uts;
+    uname(&uts);
+    if (strcmp(uts.machine, "x86_64") == 0) return "amd64";
+    if (strcmp(uts.machine, "aarch64") == 0) return "arm64";
+    return uts.machine;
+}
+
+// 從 index 中選擇一個 manifest：優先本機架構，否則第一個
+static const char* oci_select(const char* index) {
+    const char* manifests = json_get(index, "manifests");
+    const char* chosen = manifests ? json_at(manifests, 0) : NULL;
+    char arch[32];
+
+    for (int i = 0; manifests; i++) {
+        const char* desc = json_at(manifests, i);
+        if (!desc) {
+            break;
+        }
+        const char* platform = json_get(desc, "platform");
+        if (platform && json_string(json_get(platform, "architecture"), arch, sizeof(arch)) == 0 &&
+            strcmp(arch, image_host_arch()) == 0) {
+            return desc;
+        }
+    }
+    return chosen;
+}
+
+// OCI 佈局：index.json → (可能的多架構 index) → manifest → config / layers
+static int parse_oci_index(const archive_t* archive, const char* index_json, image_manifest_t* m) {
+    char digest[80], hex[SHA256_HEX_LEN + 1], path[256];
+    char* owned = NULL;
+    const char* desc = oci_select(index_json);
+
+    if (desc) {
+        const char* annotations = json_get(desc, "annotations");
+        if (annotations) {
+            json_string(json_get(annotations, "org.opencontainers.image.ref.name"), m->name, sizeof(m->name));
+        }
+    }
+    for (int depth = 0; desc && depth < 3; depth++) {
+        if (json_string(json_get(desc, "digest"), digest, sizeof(digest)) != 0 || digest_hex(digest, hex) != 0) {
+            break;
+        }
+        snprintf(path, sizeof(path), "blobs/sha256/%s", hex);
+        char* blob = archive_read(archive, path, hex);
+        free(owned);
+        owned = blob;
+        if (!blob) {
+            return -1;
+        }
+        if (json_get(blob, "manifests")) {
+            // 多架構的 index / manifest list
+            desc = oci_select(blob);
+            continue;
+        }
+
+        const char* config = json_get(blob, "config");
+        const char* layers = json_get(blob, "layers");
+        if (!config || !layers || json_string(json_get(config, "digest"), digest, sizeof(digest)) != 0 ||
+            digest_hex(digest, m->config_hex) != 0) {
+            break;
+        }
+        snprintf(m->config_path, sizeof(m->config_path), "blobs/sha256/%s", m->config_hex);
+        for (const char* layer; (layer = json_at(layers, m->layer_count)) != NULL; m->layer_count++) {
+            if (m->layer_count >= IMAGE_MAX_LAYERS ||
+                json_string(json_get(layer, "digest"), digest, sizeof(digest)) != 0 ||
+                digest_hex(digest, m->layer_hex[m->layer_count]) != 0) {
+                free(owned);
+                return -1;
+            }
+            snprintf(m->layer_paths[m->layer_count], sizeof(m->layer_paths[0]), "blobs/sha256/%s",
+                     m->layer_hex[m->layer_count]);
+        }
+        free(owned);
+        return 0;
+    }
+    free(owned);
+    return -1;
+}
+
+// 鏡像名稱對應的記錄文件（'/' 替換為 '_'）
+static void image_index_path(const char* name, char* path, size_t size) {
+    size_t len = (size_t)snprintf(path, size, "%s/", IMAGE_INDEX_DIR);
+    for (const char* p = name; *p && len + 1 < size; p++) {
+        path[len++] = *p == '/' ? '_' : *p;
+    }
+    path[len] = '\0';
+}
+
+static int image_store_init(void) {
+    if ((mkdir(IMAGE_STORE_DIR, 0755) == -1 && errno != EEXIST) ||
+        (mkdir(IMAGE_LAYERS_DIR, 0755) == -1 && errno != EEXIST) ||
+        (mkdir(IMAGE_INDEX_DIR, 0755) == -1 && errno != EEXIST)) {
+        return -1;
+    }
+    return 0;
+}
+
+// 寫入鏡像記錄（先寫臨時文件再改名）
+// 延遲層在 diff_id 之後記錄其目錄表摘要："layer sha256:<diff_id> lazy <toc>"
+static int image_write_index(const image_manifest_t* m, char diff_ids[][SHA256_HEX_LEN + 1],
+                             char lazy[][SHA256_HEX_LEN + 1]) {
+    char path[600], tmp[620];
+
+    image_index_path(m->name, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp-%d", path, getpid());
+    FILE* f = fopen(tmp, "w");
+    if (!f) {
+        return -1;
+    }
+    fprintf(f, "name %s\n", m->name);
+    fprintf(f, "config sha256:%s\n", m->config_hex);
+    for (int i = 0; i < m->layer_count; i++) {
+        fprintf(f, "layer sha256:%s%s%s\n", diff_ids[i], lazy[i][0] ? " lazy " : "", lazy[i]);
+    }
+    if (fclose(f) != 0 || rename(tmp, path) == -1) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 把可隨機讀取的層原樣複製到層存儲（layers/<目錄表摘要>.lazy），複製時校驗 blob 摘要
+ * 同時解壓計算 diff_id（不解包），確保登記在 diff_id 之下的正是這一層的內容
+ * @return 0 成功，-1 失敗（已填入 job->error）
+ */
+static int import_lazy_layer(layer_job_t* job) {
+    char path[600], tmp[620], hex[SHA256_HEX_LEN + 1];
+    sha256_t ctx, diff_ctx;
+    decoder_t decoder;
+    int decoding = 0;
+
+    snprintf(path, sizeof(path), "%s/%s.lazy", IMAGE_LAYERS_DIR, job->toc_hex);
+    if (access(path, F_OK) == 0) {
+        job->reused = 1;
+        return 0;
+    }
+    snprintf(tmp, sizeof(tmp), "%s/.%s.lazy.tmp-%d", IMAGE_LAYERS_DIR, job->toc_hex, getpid());
+    int out = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    unsigned char* buf = malloc(CHUNK_SIZE);
+    unsigned char* plain = malloc(CHUNK_SIZE);
+    if (out == -1 || !buf || !plain) {
+        job_fail(job, "無法創建 %s", tmp);
+        goto fail;
+    }
+    if (decoder_init(&decoder, CODEC_ZSTD) != 0) {
+        job_fail(job, "%s", "不支援的壓縮格式: zstd（需要 libzstd.so.1）");
+        goto fail;
+    }
+    decoding = 1;
+    sha256_init(&ctx);
+    sha256_init(&diff_ctx);
+    for (uint64_t done = 0; done < job->size; ) {
+        size_t want = job->size - done < CHUNK_SIZE ? (size_t)(job->size - done) : CHUNK_SIZE;
+        ssize_t n = pread(job->fd, buf, want, job->offset + (off_t)done);
+        if (n <= 0 || write(out, buf, (size_t)n) != n) {
+            job_fail(job, "複製延遲層失敗: %s", strerror(errno));
+            goto fail;
+        }
+        sha256_update(&ctx, buf, (size_t)n);
+        done += (uint64_t)n;
+        // 目錄表所在的 skippable frame 不產生輸出，解壓結果就是原始的 tar 流
+        const unsigned char* in = buf;
+        size_t in_len = (size_t)n;
+        while (in_len > 0) {
+            const unsigned char* before = in;
+            ssize_t m = decoder_run(&decoder, &in, &in_len, plain, CHUNK_SIZE);
+            if (m < 0 || (m == 0 && in == before)) {
+                job_fail(job, "%s", "層的 zstd 數據已損壞");
+                goto fail;
+            }
+            sha256_update(&diff_ctx, plain, (size_t)m);
+        }
+    }
+    sha256_final_hex(&ctx, hex);
+    if (strcmp(hex, job->blob_hex) != 0) {
+        job_fail(job, "blob 摘要不符 (sha256:%.12s)", hex);
+        goto fail;
+    }
+    sha256_final_hex(&diff_ctx, hex);
+    if (!decoder.finished || strcmp(hex, job->diff_hex) != 0) {
+        job_fail(job, "diff_id 不符（實際 sha256:%s）", hex);
+        goto fail;
+    }
+    if (fsync(out) == -1 || close(out) == -1 || rename(tmp, path) == -1) {
+        out = -1;
+        job_fail(job, "無法寫入 %s", path);
+        goto fail;
+    }
+    decoder_free(&decoder);
+    free(buf);
+    free(plain);
+    return 0;
+
+fail:
+    if (decoding) decoder_free(&decoder);
+    if (out != -1) close(out);
+    unlink(tmp);
+    free(buf);
+    free(plain);
+    return -1;
+}
+
+int image_import(const char* tarball, const char* name, int jobs, int lazy) {
+    archive_t archive;
+    image_manifest_t* m = calloc(1, sizeof(image_manifest_t));
+    static char diff_ids[IMAGE_MAX_LAYERS][SHA256_HEX_LEN + 1];
+    static char lazy_ids[IMAGE_MAX_LAYERS][SHA256_HEX_LEN + 1];
+    double start = now_sec();
+    int ret = -1;
+
+    if (!m || image_store_init() != 0) {
+        fprintf(stderr, "錯誤: 無法創建鏡像目錄 %s: %s\n", IMAGE_STORE_DIR, strerror(errno));
+        free(m);
+        return -1;
+    }
+    if (archive_open(&archive, tarball) != 0) {
+        fprintf(stderr, "錯誤: %s 不是有效的 tar 文件（壓縮過的文件請先解壓）\n", tarball);
+        archive_close(&archive);
+        free(m);
+        return -1;
+    }
+
+    // docker save 帶有 manifest.json；純 OCI 佈局只有 index.json
+    char* manifest = archive_find(&archive, "manifest.json") ? archive_read(&archive, "manifest.json", NULL) : NULL;
+    char* index_json = !manifest ? archive_read(&archive, "index.json", NULL) : NULL;
+    if ((manifest && parse_docker_manifest(manifest, m) != 0) ||
+        (index_json && parse_oci_index(&archive, index_json, m) != 0) || (!manifest && !index_json) || m->layer_count == 0) {
+        fprintf(stderr, "錯誤: 無法解析鏡像的 manifest\n");
+        goto out;
+    }
+
+    // config 記錄每一層解壓後的摘要 (rootfs.diff_ids)
+    char* config = archive_read(&archive, m->config_path, m->config_hex);
+    if (!config) {
+        goto out;
+    }
+    if (!m->config_hex[0]) {
+        sha256_t ctx;
+        sha256_init(&ctx);
+        sha256_update(&ctx, config, strlen(config));
+        sha256_final_hex(&ctx, m->config_hex);
+    }
+    const char* rootfs = json_get(config, "rootfs");
+    const char* ids = rootfs ? json_get(rootfs, "diff_ids") : NULL;
+    for (int i = 0; i < m->layer_count; i++) {
+        char digest[80];
+        if (!ids || json_string(json_at(ids, i), digest, sizeof(digest)) != 0 || digest_hex(digest, diff_ids[i]) != 0) {
+            fprintf(stderr, "錯誤: config 中缺少第 %d 層的 diff_id\n", i + 1);
+            free(config);
+            goto out;
+        }
+    }
+    free(config);
+
+    if (name) {
+        snprintf(m->name, sizeof(m->name), "%s", name);
+    } else if (!m->name[0]) {
+        snprintf(m->name, sizeof(m->name), "sha256:%.12s", m->config_hex);
+    }
+
+    // 準備任務：已存在的層直接重用
+    layer_job_t* layer_jobs = calloc((size_t)m->layer_count, sizeof(layer_job_t));
+    if (!layer_jobs) {
+        goto out;
+    }
+    uint64_t total_blob = 0;
+    for (int i = 0; i < m->layer_count; i++) {
+        layer_job_t* job = &layer_jobs[i];
+        const archive_member_t* member = archive_find(&archive, m->layer_paths[i]);
+        char path[600];
+        if (!member) {
+            fprintf(stderr, "錯誤: 鏡像中找不到層 %s\n", m->layer_paths[i]);
+            free(layer_jobs);
+            goto out;
+        }
+        job->fd = archive.fd;
+        job->offset = member->offset;
+        job->size = member->size;
+        memcpy(job->blob_hex, m->layer_hex[i], sizeof(job->blob_hex));
+        memcpy(job->diff_hex, diff_ids[i], sizeof(job->diff_hex));
+        snprintf(path, sizeof(path), "%s/%s", IMAGE_LAYERS_DIR, job->diff_hex);
+        job->reused = access(path, F_OK) == 0;
+        lazy_ids[i][0] = '\0';
+        // 延遲導入：已完整解包的層優先；不是可隨機讀取格式的層照常解包
+        // 沒有 blob 摘要的層（舊的 docker save 格式）無法校驗原樣保存的文件，同樣完整解包
+        if (lazy && !job->reused && !job->blob_hex[0]) {
+            printf("  [%d/%d] sha256:%.12s 沒有 blob 摘要，完整解包\n", i + 1, m->layer_count, job->diff_hex);
+        } else if (lazy && !job->reused) {
+            if (lazy_probe(job->fd, job->offset, job->size, job->toc_hex) == 0) {
+                job->lazy = 1;
+                memcpy(lazy_ids[i], job->toc_hex, sizeof(lazy_ids[i]));
+            } else {
+                printf("  [%d/%d] sha256:%.12s 不是可隨機讀取的層，完整解包\n", i + 1, m->layer_count, job->diff_hex);
+            }
+        }
+        total_blob += job->reused ? 0 : member->size;
+    }
+    for (int i = 0; i < m->layer_count; i++) {
+        if (layer_jobs[i].lazy) {
+            import_lazy_layer(&layer_jobs[i]);
+        }
+    }
+
+    // 多個層同時導入；每層內部的四個階段也各自在獨立的線程中並行
+    if (jobs <= 0) {
+        jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (jobs > m->layer_count) {
+        jobs = m->layer_count;
+    }
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    printf("導入 %s：%d 層，%d 個並行任務\n", m->name, m->layer_count, jobs);
+
+    job_list_t list = {layer_jobs, m->layer_count, 0, PTHREAD_MUTEX_INITIALIZER};
+    pthread_t* workers = calloc((size_t)jobs, sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; workers && i < jobs; i++) {
+        if (pthread_create(&workers[i], NULL, layer_worker, &list) == 0) {
+            started++;
+        }
+    }
+    if (started == 0) {
+        layer_worker(&list);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+
+    int failures = 0;
+    uint64_t total_unpacked = 0;
+    for (int i = 0; i < m->layer_count; i++) {
+        layer_job_t* job = &layer_jobs[i];
+        if (job->reused) {
+            printf("  [%d/%d] sha256:%.12s 已存在，重用\n", i + 1, m->layer_count, job->diff_hex);
+        } else if (job->failed) {
+            fprintf(stderr, "  [%d/%d] sha256:%.12s 失敗: %s\n", i + 1, m->layer_count, job->diff_hex, job->error);
+            failures++;
+        } else if (job->lazy) {
+            printf("  [%d/%d] sha256:%.12s 延遲載入 %.1f MB（目錄表 sha256:%.12s）\n", i + 1, m->layer_count,
+                   job->diff_hex, job->size / 1048576.0, job->toc_hex);
+        } else {
+            printf("  [%d/%d] sha256:%.12s %s %.1f MB → %.1f MB\n", i + 1, m->layer_count, job->diff_hex,
+                   codec_name(job->codec), job->size / 1048576.0, job->unpacked / 1048576.0);
+            total_unpacked += job->unpacked;
+        }
+    }
+    free(layer_jobs);
+    if (failures > 0) {
+        fprintf(stderr, "錯誤: %d 層導入失敗，鏡像未登記\n", failures);
+        goto out;
+    }
+    if (image_write_index(m, diff_ids, lazy_ids) != 0) {
+        fprintf(stderr, "錯誤: 無法寫入鏡像記錄: %s\n", strerror(errno));
+        goto out;
+    }
+
+    double elapsed = now_sec() - start;
+    printf("完成：%s (sha256:%.12s)，讀取 %.1f MB，解包 %.1f MB，耗時 %.2f 秒 (%.0f MB/s)\n",
+           m->name, m->config_hex, total_blob / 1048576.0, total_unpacked / 1048576.0, elapsed,
+           elapsed > 0 ? total_unpacked / 1048576.0 / elapsed : 0);
+    ret = 0;
+
+out:
+    free(manifest);
+    free(index_json);
+    archive_close(&archive);
+    free(m);
+    return ret;
+}
+
+// 讀取鏡像記錄中的各層 diff_id（由下而上），lazy 不為 NULL 時同時取得延遲層的目錄表摘要（非延遲層為空）
+static int image_read_index(const char* path, char* config_hex, char layers[][SHA256_HEX_LEN + 1],
+                            char lazy[][SHA256_HEX_LEN + 1], int max) {
+    char line[256], digest[80];
+    int count = 0;
+
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        const char* toc = strstr(line, " lazy ");
+        snprintf(digest, sizeof(digest), "%.*s", toc ? (int)(toc - line - 6) : (int)sizeof(digest), line + 6);
+        if (strncmp(line, "layer ", 6) == 0 && count < max && digest_hex(digest, layers[count]) == 0) {
+            if (lazy) {
+                snprintf(lazy[count], sizeof(lazy[count]), "%s",
+                         toc && strlen(toc + 6) == SHA256_HEX_LEN ? toc + 6 : "");
+            }
+            count++;
+        } else if (strncmp(line, "config ", 7) == 0 && config_hex) {
+            digest_hex(line + 7, config_hex);
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+int image_list(void) {
+    static char layers[IMAGE_MAX_LAYERS][SHA256_HEX_LEN + 1];
+    char path[600], config_hex[SHA256_HEX_LEN + 1], name[256], created[32];
+    struct dirent* entry;
+    struct stat st;
+
+    printf("%-40s  %-12s  %-6s  %s\n", "IMAGE", "ID", "LAYERS", "IMPORTED");
+    DIR* dir = opendir(IMAGE_INDEX_DIR);
+    if (!dir) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.' || strstr(entry->d_name, ".tmp-")) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", IMAGE_INDEX_DIR, entry->d_name);
+        config_hex[0] = '\0';
+        int count = image_read_index(path, config_hex, layers, NULL, IMAGE_MAX_LAYERS);
+        if (count < 0 || stat(path, &st) == -1) {
+            continue;
+        }
+        // 記錄中的第一行是原始名稱（文件名中的 '/' 已被替換）
+        FILE* f = fopen(path, "r");
+        snprintf(name, sizeof(name), "%s", entry->d_name);
+        if (f) {
+            char line[300];
+            if (fgets(line, sizeof(line), f) && strncmp(line, "name ", 5) == 0) {
+                line[strcspn(line, "\n")] = '\0';
+                snprintf(name, sizeof(name), "%s", line + 5);
+            }
+            fclose(f);
+        }
+        strftime(created, sizeof(created), "%Y-%m-%d %H:%M:%S", localtime(&st.st_mtime));
+        printf("%-40s  %-12.12s  %-6d  %s\n", name, config_hex, count, created);
+    }
+    closedir(dir);
+    return 0;
+}
+
+int image_lowerdir(const char* name, char* buf, size_t size) {
+    static char layers[IMAGE_MAX_LAYERS][SHA256_HEX_LEN + 1];
+    static char lazy[IMAGE_MAX_LAYERS][SHA256_HEX_LEN + 1];
+    char path[600];
+
+    image_index_path(name, path, sizeof(path));
+    int count = image_read_index(path, NULL, layers, lazy, IMAGE_MAX_LAYERS);
+    if (count <= 0) {
+        return -1;
+    }
+    // OverlayFS 的 lowerdir 以最上層在前
+    size_t len = 0;
+    buf[0] = '\0';
+    for (int i = count - 1; i >= 0; i--) {
+        char layer_path[600], item[SHA256_HEX_LEN + 8];
+        // 完整解包的層優先，否則使用延遲層文件（由 lazy_mount_start 換成掛載點下的目錄）
+        snprintf(item, sizeof(item), "%s", layers[i]);
+        snprintf(layer_path, sizeof(layer_path), "%s/%s", IMAGE_LAYERS_DIR, item);
+        if (access(layer_path, F_OK) != 0 && lazy[i][0]) {
+            snprintf(item, sizeof(item), "%s.lazy", lazy[i]);
+            snprintf(layer_path, sizeof(layer_path), "%s/%s", IMAGE_LAYERS_DIR, item);
+        }
+        if (access(layer_path, F_OK) != 0 || len + strlen(item) + 2 > size) {
+            return -1;
+        }
+        len += (size_t)snprintf(buf + len, size - len, "%s%s", len ? ":" : "", item);
+    }
+    return count;
+}
+
+int image_layer_path(const char* digest, char* path, size_t size) {
+    struct dirent* entry;
+    int matches = 0;
+
+    if (strncmp(digest, "sha256:", 7) == 0) {
+        digest += 7;
+    }
+    size_t len = strlen(digest);
+    DIR* dir = opendir(IMAGE_LAYERS_DIR);
+    if (!dir || len == 0) {
+        if (dir) closedir(dir);
+        return -1;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        // 略過導入中的臨時目錄和延遲層文件
+        if (entry->d_name[0] != '.' && !strchr(entry->d_name, '.') && strncmp(entry->d_name, digest, len) == 0) {
+            snprintf(path, size, "%s/%s", IMAGE_LAYERS_DIR, entry->d_name);
+            matches++;
+        }
+    }
+    closedir(dir);
+    return matches == 1 ? 0 : -1;
+}
@@ -0,0 +1,68 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stddef.h>
+
+// 導入的鏡像存放位置
+#define IMAGE_STORE_DIR "/tmp/docker_in_c_images"
+
+// 以內容定址的層目錄：layers/<diff_id 的十六進位>，可直接作為 OverlayFS 的 lowerdir
+// 延遲層則是 layers/<目錄表摘要>.lazy 文件，運行時經 FUSE 掛載
+#define IMAGE_LAYERS_DIR IMAGE_STORE_DIR "/layers"
+
+// 鏡像記錄：images/<名稱>，依序列出 config 與各層的 diff_id（由下而上）
+#define IMAGE_INDEX_DIR IMAGE_STORE_DIR "/images"
+
+// 單個鏡像最多的層數
+#define IMAGE_MAX_LAYERS 128
+
+// image_lowerdir 輸出的最大長度：每層最多 "<64 位十六進位>.lazy:" 70 個字元
+#define IMAGE_LOWERDIR_MAX (IMAGE_MAX_LAYERS * 72)
+
+/**
+ * 導入本地的 OCI 鏡像佈局或 docker save 的 tar 文件
+ * 校驗 manifest、config 及每一層的摘要，多個層並行解壓，
+ * 每層以 讀取 → 解壓 → 校驗 → 解包 的流水線直接寫入層目錄，不產生臨時 tar 文件；
+ * whiteout 轉換為 OverlayFS 的格式，已存在的層直接重用
+ * @param tarball tar 文件路徑（不能是壓縮過的外層文件，需要隨機讀取）
+ * @param name 鏡像名稱，NULL 時使用 tar 中記錄的標籤
+ * @param jobs 同時處理的層數，0 表示 CPU 數量
+ * @param lazy 可隨機讀取的層（見 lazy.h）只校驗 blob 摘要並原樣保存，運行時才按需解壓；
+ *             此時 diff_id 不會被校驗，內容的完整性由目錄表中每個 frame 的摘要保證
+ * @return 0 成功，-1 失敗
+ */
+int image_import(const char* tarball, const char* name, int jobs, int lazy);
+
+/**
+ * 列出已導入的鏡像
+ * @return 0 成功，-1 失敗
+ */
+int image_list(void);
+
+/**
+ * 取得鏡像的 OverlayFS lowerdir 選項
+ * 為了讓數十層的鏡像也不超過掛載選項的長度限制，層目錄以相對於 IMAGE_LAYERS_DIR 的名稱列出（最上層在前）
+ * 只以延遲層存在的層列為 "<目錄表摘要>.lazy"，需經 lazy_mount_start 改寫後才能掛載
+ * @param name 鏡像名稱
+ * @param buf 輸出緩衝區
+ * @param size 緩衝區大小
+ * @return 層數，-1 找不到鏡像或層已損壞
+ */
+int image_lowerdir(const char* name, char* buf, size_t size);
+
+/**
+ * 本機架構在 OCI 中的名稱（例如 x86_64 為 "amd64"）
+ * @return 架構名稱
+ */
+const char* image_host_arch(void);
+
+/**
+ * 根據 diff_id（或其唯一前綴，可帶 "sha256:"）找到層存儲中的層目錄
+ * @param digest diff_id 或前綴
+ * @param path 輸出的層目錄路徑
+ * @param size 緩衝區大小
+ * @return 0 成功，-1 找不到或前綴不唯一
+ */
+int image_layer_path(const char* digest, char* path, size_t size);
+
+#endif // IMAGE_H
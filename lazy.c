@@ -0,0 +1,1007 @@
+#include "lazy.h"
+#include "codec.h"
+#include "image.h"
+#include "namespace.h"
+#include "sha256.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <linux/fuse.h>
+
+#define LAZY_MAX_LAYERS 64                      // 一個容器最多的延遲層數
+#define LAZY_CACHE_SLOTS 16                     // 伺服器中保留的已解壓 frame 數
+#define LAZY_TOC_MAX (256 * 1024 * 1024)        // TOC 的大小上限
+#define LAZY_ATTR_TIMEOUT 3600                  // 層的內容不會改變，內核可以長時間快取條目和屬性
+#define FUSE_REQUEST_SIZE (132 * 1024)          // 請求緩衝區（不接受寫入，只需容納最大的請求頭部與名稱）
+
+/* ---------- 生成 TOC ---------- */
+
+// 確保動態數組還能容納 extra 個元素
+static int grow(void** data, size_t* capacity, size_t count, size_t extra, size_t elem) {
+    if (count + extra <= *capacity) {
+        return 0;
+    }
+    size_t wanted = *capacity ? *capacity : 256;
+    while (wanted < count + extra) {
+        wanted *= 2;
+    }
+    void* grown = realloc(*data, wanted * elem);
+    if (!grown) {
+        return -1;
+    }
+    *data = grown;
+    *capacity = wanted;
+    return 0;
+}
+
+static long add_string(lazy_toc_t* toc, const char* str) {
+    size_t len = strlen(str) + 1;
+    if (grow((void**)&toc->strings, &toc->string_capacity, toc->string_size, len, 1) != 0) {
+        return -1;
+    }
+    memcpy(toc->strings + toc->string_size, str, len);
+    toc->string_size += len;
+    return (long)(toc->string_size - len);
+}
+
+long lazy_toc_add_entry(lazy_toc_t* toc, const lazy_entry_t* entry, const char* name, const char* link,
+                        const void* xattrs, size_t xattr_len) {
+    if (grow((void**)&toc->entries, &toc->entry_capacity, toc->entry_count, 1, sizeof(lazy_entry_t)) != 0 ||
+        grow((void**)&toc->xattrs, &toc->xattr_capacity, toc->xattr_size, xattr_len, 1) != 0) {
+        return -1;
+    }
+    lazy_entry_t* e = &toc->entries[toc->entry_count];
+    *e = *entry;
+    long name_at = add_string(toc, name);
+    long link_at = link ? add_string(toc, link) : 0;
+    if (name_at < 0 || link_at < 0) {
+        return -1;
+    }
+    e->name = (uint32_t)name_at;
+    if (link) {
+        e->link = (uint32_t)link_at;
+    }
+    e->xattr = (uint32_t)toc->xattr_size;
+    e->xattr_len = (uint32_t)xattr_len;
+    if (xattr_len > 0) {
+        memcpy(toc->xattrs + toc->xattr_size, xattrs, xattr_len);
+        toc->xattr_size += xattr_len;
+    }
+    return (long)toc->entry_count++;
+}
+
+int lazy_toc_add_chunk(lazy_toc_t* toc, const lazy_chunk_t* chunk) {
+    if (grow((void**)&toc->chunks, &toc->chunk_capacity, toc->chunk_count, 1, sizeof(lazy_chunk_t)) != 0) {
+        return -1;
+    }
+    toc->chunks[toc->chunk_count++] = *chunk;
+    return 0;
+}
+
+static void put_frame_header(unsigned char* out, uint32_t size) {
+    uint32_t magic = LAZY_SKIPPABLE_MAGIC;
+    // zstd 的 frame 頭部為小端序，與結構體的存放方式一致（只支援小端序的主機）
+    memcpy(out, &magic, 4);
+    memcpy(out + 4, &size, 4);
+}
+
+int lazy_toc_finish(lazy_toc_t* toc, uint64_t raw_size, uint64_t blob_offset, unsigned char** out, size_t* out_len,
+                    char* toc_hex) {
+    lazy_toc_header_t header;
+    lazy_footer_t footer;
+    encoder_t encoder;
+    sha256_t ctx;
+
+    // 序列化：頭部、條目表、frame 表、字串表、擴展屬性表
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LAZY_TOC_MAGIC, sizeof(header.magic));
+    header.entry_count = (uint32_t)toc->entry_count;
+    header.chunk_count = (uint32_t)toc->chunk_count;
+    header.string_size = (uint32_t)toc->string_size;
+    header.xattr_size = (uint32_t)toc->xattr_size;
+    header.raw_size = raw_size;
+    size_t raw_len = sizeof(header) + toc->entry_count * sizeof(lazy_entry_t) + toc->chunk_count * sizeof(lazy_chunk_t) +
+                     toc->string_size + toc->xattr_size;
+    unsigned char* raw = malloc(raw_len);
+    if (!raw) {
+        return -1;
+    }
+    unsigned char* p = raw;
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    memcpy(p, toc->entries, toc->entry_count * sizeof(lazy_entry_t));
+    p += toc->entry_count * sizeof(lazy_entry_t);
+    memcpy(p, toc->chunks, toc->chunk_count * sizeof(lazy_chunk_t));
+    p += toc->chunk_count * sizeof(lazy_chunk_t);
+    memcpy(p, toc->strings, toc->string_size);
+    p += toc->string_size;
+    memcpy(p, toc->xattrs, toc->xattr_size);
+
+    // 壓縮到 [frame 頭部][壓縮過的 TOC][frame 頭部][footer]，頭部在壓縮完成後補上
+    size_t capacity = raw_len / 2 + 4096, len = 8;
+    unsigned char* buf = malloc(capacity);
+    const unsigned char* in = raw;
+    size_t in_len = raw_len;
+    if (!buf || encoder_init_frames(&encoder, 19) != 0) {
+        free(raw);
+        free(buf);
+        return -1;
+    }
+    while (!encoder.finished) {
+        if (capacity - len < 65536) {
+            unsigned char* grown = realloc(buf, capacity * 2);
+            if (!grown) {
+                break;
+            }
+            buf = grown;
+            capacity *= 2;
+        }
+        ssize_t n = encoder_run(&encoder, &in, &in_len, buf + len, capacity - len, 1);
+        if (n < 0) {
+            break;
+        }
+        len += (size_t)n;
+    }
+    int finished = encoder.finished;
+    encoder_free(&encoder);
+    free(raw);
+    if (!finished || len - 8 > LAZY_TOC_MAX || capacity - len < 8 + sizeof(footer)) {
+        free(buf);
+        return -1;
+    }
+
+    uint64_t toc_size = len - 8;
+    put_frame_header(buf, (uint32_t)toc_size);
+    memset(&footer, 0, sizeof(footer));
+    footer.toc_offset = blob_offset + 8;
+    footer.toc_size = toc_size;
+    footer.toc_raw_size = raw_len;
+    sha256_init(&ctx);
+    sha256_update(&ctx, buf + 8, toc_size);
+    sha256_final(&ctx, footer.toc_digest);
+    for (int i = 0; i < SHA256_DIGEST_LEN; i++) {
+        snprintf(toc_hex + i * 2, 3, "%02x", footer.toc_digest[i]);
+    }
+    memcpy(footer.magic, LAZY_FOOTER_MAGIC, sizeof(footer.magic));
+    put_frame_header(buf + len, sizeof(footer));
+    memcpy(buf + len + 8, &footer, sizeof(footer));
+    *out = buf;
+    *out_len = len + 8 + sizeof(footer);
+    return 0;
+}
+
+void lazy_toc_free(lazy_toc_t* toc) {
+    free(toc->entries);
+    free(toc->chunks);
+    free(toc->strings);
+    free(toc->xattrs);
+    memset(toc, 0, sizeof(*toc));
+}
+
+/* ---------- 讀取 TOC ---------- */
+
+// 已載入的延遲層
+typedef struct {
+    int fd;
+    off_t base;                // blob 在文件中的位置
+    unsigned char* toc;        // 解壓後的 TOC（以下指針都指向其中）
+    lazy_toc_header_t* header;
+    lazy_entry_t* entries;
+    lazy_chunk_t* chunks;
+    const char* strings;
+    const unsigned char* xattrs;
+    uint32_t* child_start;     // 目錄 i 的子條目為 children[child_start[i] .. child_start[i + 1])，按名稱排序
+    uint32_t* children;
+    uint32_t* nlink;
+    unsigned char* fetched;    // 每個 frame 是否已被讀取過
+    uint64_t packed_size;      // 所有 frame 壓縮後的總大小
+} lazy_layer_t;
+
+static void layer_free(lazy_layer_t* layer) {
+    free(layer->toc);
+    free(layer->child_start);
+    free(layer->children);
+    free(layer->nlink);
+    free(layer->fetched);
+    if (layer->fd != -1) {
+        close(layer->fd);
+    }
+    memset(layer, 0, sizeof(*layer));
+    layer->fd = -1;
+}
+
+static int pread_full(int fd, void* buf, size_t len, off_t offset) {
+    unsigned char* p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, offset);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int compare_children(const void* a, const void* b, void* arg) {
+    const lazy_layer_t* layer = arg;
+    return strcmp(layer->strings + layer->entries[*(const uint32_t*)a].name,
+                  layer->strings + layer->entries[*(const uint32_t*)b].name);
+}
+
+// 檢查 TOC 的一致性，並建立目錄的子條目索引
+static int layer_index(lazy_layer_t* layer, uint64_t data_size) {
+    lazy_toc_header_t* h = layer->header;
+    uint32_t count = h->entry_count;
+
+    if (count == 0 || !S_ISDIR(layer->entries[0].mode)) {
+        return -1;
+    }
+    // frame 表：除最後一個外大小固定，覆蓋整個 tar 流
+    uint64_t raw = 0;
+    for (uint32_t i = 0; i < h->chunk_count; i++) {
+        lazy_chunk_t* c = &layer->chunks[i];
+        if ((i + 1 < h->chunk_count && c->raw_size != LAZY_CHUNK_SIZE) || c->raw_size == 0 ||
+            c->raw_size > LAZY_CHUNK_SIZE || c->size > 2 * LAZY_CHUNK_SIZE || c->offset + c->size > data_size) {
+            return -1;
+        }
+        raw += c->raw_size;
+        layer->packed_size += c->size;
+    }
+    if (raw != h->raw_size || h->string_size == 0 || layer->strings[h->string_size - 1] != '\0') {
+        return -1;
+    }
+    layer->child_start = calloc((size_t)count + 1, sizeof(uint32_t));
+    layer->children = calloc(count, sizeof(uint32_t));
+    layer->nlink = calloc(count, sizeof(uint32_t));
+    layer->fetched = calloc(h->chunk_count + 1, 1);
+    if (!layer->child_start || !layer->children || !layer->nlink || !layer->fetched) {
+        return -1;
+    }
+    // 父目錄總在子條目之前，硬連結總在其目標之後，因此不會有環
+    for (uint32_t i = 0; i < count; i++) {
+        lazy_entry_t* e = &layer->entries[i];
+        if (e->name >= h->string_size || (uint64_t)e->xattr + e->xattr_len > h->xattr_size ||
+            (i > 0 && (e->parent >= i || !S_ISDIR(layer->entries[e->parent].mode)))) {
+            return -1;
+        }
+        if (e->flags & LAZY_HARDLINK) {
+            if (e->link >= i || !S_ISREG(layer->entries[e->link].mode) || layer->entries[e->link].flags & LAZY_HARDLINK) {
+                return -1;
+            }
+            layer->nlink[e->link]++;
+        } else if (S_ISLNK(e->mode) && e->link >= h->string_size) {
+            return -1;
+        } else if (S_ISREG(e->mode) && (e->offset > h->raw_size || e->size > h->raw_size - e->offset)) {
+            return -1;
+        }
+        layer->nlink[i] += S_ISDIR(e->mode) ? 2 : 1;
+        if (i > 0) {
+            layer->child_start[e->parent + 1]++;
+            if (S_ISDIR(e->mode)) {
+                layer->nlink[e->parent]++;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        layer->child_start[i + 1] += layer->child_start[i];
+    }
+    uint32_t* fill = calloc((size_t)count + 1, sizeof(uint32_t));
+    if (!fill) {
+        return -1;
+    }
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t parent = layer->entries[i].parent;
+        layer->children[layer->child_start[parent] + fill[parent]++] = i;
+    }
+    free(fill);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t n = layer->child_start[i + 1] - layer->child_start[i];
+        if (n > 1) {
+            qsort_r(layer->children + layer->child_start[i], n, sizeof(uint32_t), compare_children, layer);
+        }
+    }
+    return 0;
+}
+
+/**
+ * 讀取 blob 的結尾與 TOC，校驗摘要並建立索引
+ * @return 0 成功，-1 不是延遲層格式或已損壞
+ */
+static int layer_load(lazy_layer_t* layer, int fd, off_t offset, uint64_t size, char* toc_hex) {
+    unsigned char tail[8 + sizeof(lazy_footer_t)];
+    lazy_footer_t footer;
+    uint32_t magic, frame_size;
+    unsigned char digest[SHA256_DIGEST_LEN];
+    sha256_t ctx;
+
+    memset(layer, 0, sizeof(*layer));
+    layer->fd = -1;
+    if (size < sizeof(tail) || pread_full(fd, tail, sizeof(tail), offset + (off_t)(size - sizeof(tail))) != 0) {
+        return -1;
+    }
+    memcpy(&magic, tail, 4);
+    memcpy(&frame_size, tail + 4, 4);
+    memcpy(&footer, tail + 8, sizeof(footer));
+    if (magic != LAZY_SKIPPABLE_MAGIC || frame_size != sizeof(footer) ||
+        memcmp(footer.magic, LAZY_FOOTER_MAGIC, sizeof(footer.magic)) != 0 ||
+        footer.toc_size > LAZY_TOC_MAX || footer.toc_raw_size > 4ULL * LAZY_TOC_MAX ||
+        footer.toc_raw_size < sizeof(lazy_toc_header_t) || footer.toc_offset < 8 ||
+        footer.toc_offset + footer.toc_size != size - sizeof(tail)) {
+        return -1;
+    }
+
+    unsigned char* packed = malloc(footer.toc_size + 8);
+    layer->toc = malloc(footer.toc_raw_size);
+    if (!packed || !layer->toc ||
+        pread_full(fd, packed, footer.toc_size + 8, offset + (off_t)footer.toc_offset - 8) != 0) {
+        free(packed);
+        return -1;
+    }
+    memcpy(&magic, packed, 4);
+    memcpy(&frame_size, packed + 4, 4);
+    sha256_init(&ctx);
+    sha256_update(&ctx, packed + 8, footer.toc_size);
+    sha256_final(&ctx, digest);
+    int valid = magic == LAZY_SKIPPABLE_MAGIC && frame_size == footer.toc_size &&
+                memcmp(digest, footer.toc_digest, sizeof(digest)) == 0;
+
+    // 解壓 TOC
+    decoder_t decoder;
+    const unsigned char* in = packed + 8;
+    size_t in_len = footer.toc_size, out_len = 0;
+    if (valid && decoder_init(&decoder, CODEC_ZSTD) == 0) {
+        while (in_len > 0 && out_len < footer.toc_raw_size) {
+            ssize_t n = decoder_run(&decoder, &in, &in_len, layer->toc + out_len, footer.toc_raw_size - out_len);
+            if (n <= 0) {
+                break;
+            }
+            out_len += (size_t)n;
+        }
+        valid = decoder.finished && in_len == 0 && out_len == footer.toc_raw_size;
+        decoder_free(&decoder);
+    } else {
+        valid = 0;
+    }
+    free(packed);
+    if (!valid) {
+        return -1;
+    }
+
+    // 各表的位置
+    lazy_toc_header_t* h = (lazy_toc_header_t*)layer->toc;
+    uint64_t expected = sizeof(*h) + (uint64_t)h->entry_count * sizeof(lazy_entry_t) +
+                        (uint64_t)h->chunk_count * sizeof(lazy_chunk_t) + h->string_size + h->xattr_size;
+    if (memcmp(h->magic, LAZY_TOC_MAGIC, sizeof(h->magic)) != 0 || expected != footer.toc_raw_size) {
+        return -1;
+    }
+    layer->header = h;
+    layer->entries = (lazy_entry_t*)(layer->toc + sizeof(*h));
+    layer->chunks = (lazy_chunk_t*)(layer->entries + h->entry_count);
+    layer->strings = (const char*)(layer->chunks + h->chunk_count);
+    layer->xattrs = (const unsigned char*)layer->strings + h->string_size;
+    layer->base = offset;
+    if (layer_index(layer, footer.toc_offset - 8) != 0) {
+        return -1;
+    }
+    for (int i = 0; toc_hex && i < SHA256_DIGEST_LEN; i++) {
+        snprintf(toc_hex + i * 2, 3, "%02x", digest[i]);
+    }
+    return 0;
+}
+
+int lazy_probe(int fd, off_t offset, uint64_t size, char* toc_hex) {
+    lazy_layer_t layer;
+    int ret = layer_load(&layer, fd, offset, size, toc_hex);
+    layer_free(&layer);
+    return ret;
+}
+
+/* ---------- FUSE 伺服器 ---------- */
+
+// 節點編號：1 為掛載點的根目錄（列出各層），其他為 (層編號 + 1) << 32 | 條目編號
+#define NODE_LAYER(node) ((int)((node) >> 32) - 1)
+#define NODE_ENTRY(node) ((uint32_t)(node))
+#define MAKE_NODE(layer, entry) (((uint64_t)((layer) + 1) << 32) | (entry))
+
+// 已解壓的 frame
+typedef struct {
+    int layer;
+    uint32_t chunk;
+    uint64_t used;             // 最近使用的順序
+    unsigned char* data;
+} cache_slot_t;
+
+static lazy_layer_t layers[LAZY_MAX_LAYERS];
+static int layer_count;
+static cache_slot_t cache[LAZY_CACHE_SLOTS];
+static uint64_t cache_clock;
+static uid_t real_uid;
+static gid_t real_gid;
+static volatile sig_atomic_t stop_requested;
+
+static void on_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// 找到節點對應的條目，硬連結解析為其目標
+static lazy_entry_t* node_entry(uint64_t node, int* layer_out, uint32_t* index_out) {
+    int l = NODE_LAYER(node);
+    uint32_t index = NODE_ENTRY(node);
+    if (node == FUSE_ROOT_ID || l < 0 || l >= layer_count || index >= layers[l].header->entry_count) {
+        return NULL;
+    }
+    if (layers[l].entries[index].flags & LAZY_HARDLINK) {
+        index = layers[l].entries[index].link;
+    }
+    if (layer_out) *layer_out = l;
+    if (index_out) *index_out = index;
+    return &layers[l].entries[index];
+}
+
+static void fill_attr(uint64_t node, struct fuse_attr* attr) {
+    int l;
+    uint32_t index;
+    lazy_entry_t* e = node_entry(node, &l, &index);
+
+    memset(attr, 0, sizeof(*attr));
+    attr->blksize = 4096;
+    if (!e) {
+        attr->ino = FUSE_ROOT_ID;
+        attr->mode = S_IFDIR | 0555;
+        attr->nlink = 2 + (uint32_t)layer_count;
+        attr->size = 4096;
+        return;
+    }
+    attr->ino = MAKE_NODE(l, index);
+    attr->mode = e->mode;
+    attr->nlink = layers[l].nlink[index];
+    // 與完整解包時一致：層中屬於 root 的文件歸真實用戶所有，容器內才會看到 root
+    attr->uid = e->uid == 0 ? real_uid : e->uid;
+    attr->gid = e->gid == 0 ? real_gid : e->gid;
+    attr->rdev = e->rdev;
+    attr->size = S_ISLNK(e->mode) ? strlen(layers[l].strings + e->link) : S_ISDIR(e->mode) ? 4096 : e->size;
+    attr->blocks = (attr->size + 511) / 512;
+    attr->atime = attr->mtime = attr->ctime = (uint64_t)e->mtime;
+}
+
+static void fuse_reply(int fd, uint64_t unique, int error, const void* data, size_t len) {
+    struct fuse_out_header out;
+    struct iovec iov[2];
+
+    out.len = sizeof(out) + (error ? 0 : len);
+    out.error = error;
+    out.unique = unique;
+    iov[0].iov_base = &out;
+    iov[0].iov_len = sizeof(out);
+    iov[1].iov_base = (void*)data;
+    iov[1].iov_len = error ? 0 : len;
+    if (writev(fd, iov, 2) == -1) {
+        // 請求可能已被中斷，忽略
+    }
+}
+
+// 在目錄中按名稱二分查找
+static long find_child(int l, uint32_t dir, const char* name) {
+    lazy_layer_t* layer = &layers[l];
+    uint32_t lo = layer->child_start[dir], hi = layer->child_start[dir + 1];
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(name, layer->strings + layer->entries[layer->children[mid]].name);
+        if (cmp == 0) {
+            return layer->children[mid];
+        }
+        if (cmp < 0) hi = mid; else lo = mid + 1;
+    }
+    return -1;
+}
+
+// 取得已解壓的 frame：先查快取，否則讀取、校驗並解壓
+static const unsigned char* fetch_chunk(int l, uint32_t index) {
+    static unsigned char* packed;
+    lazy_layer_t* layer = &layers[l];
+    lazy_chunk_t* chunk = &layer->chunks[index];
+    cache_slot_t* slot = &cache[0];
+    unsigned char digest[SHA256_DIGEST_LEN];
+    sha256_t ctx;
+
+    for (int i = 0; i < LAZY_CACHE_SLOTS; i++) {
+        if (cache[i].data && cache[i].layer == l && cache[i].chunk == index) {
+            cache[i].used = ++cache_clock;
+            return cache[i].data;
+        }
+        if (cache[i].used < slot->used) {
+            slot = &cache[i];
+        }
+    }
+    if ((!packed && !(packed = malloc(2 * LAZY_CHUNK_SIZE))) ||
+        (!slot->data && !(slot->data = malloc(LAZY_CHUNK_SIZE)))) {
+        return NULL;
+    }
+    slot->used = 0;
+    if (pread_full(layer->fd, packed, chunk->size, layer->base + (off_t)chunk->offset) != 0) {
+        return NULL;
+    }
+    sha256_init(&ctx);
+    sha256_update(&ctx, packed, chunk->size);
+    sha256_final(&ctx, digest);
+    if (memcmp(digest, chunk->digest, sizeof(digest)) != 0) {
+        fprintf(stderr, "錯誤: 延遲層的第 %u 個 frame 摘要不符\n", index);
+        return NULL;
+    }
+
+    decoder_t decoder;
+    const unsigned char* in = packed;
+    size_t in_len = chunk->size, out_len = 0;
+    if (decoder_init(&decoder, CODEC_ZSTD) != 0) {
+        return NULL;
+    }
+    while (in_len > 0 && out_len < chunk->raw_size) {
+        ssize_t n = decoder_run(&decoder, &in, &in_len, slot->data + out_len, LAZY_CHUNK_SIZE - out_len);
+        if (n <= 0) {
+            break;
+        }
+        out_len += (size_t)n;
+    }
+    int valid = decoder.finished && out_len == chunk->raw_size;
+    decoder_free(&decoder);
+    if (!valid) {
+        return NULL;
+    }
+    slot->layer = l;
+    slot->chunk = index;
+    slot->used = ++cache_clock;
+    layer->fetched[index] = 1;
+    return slot->data;
+}
+
+// 讀取文件內容，返回讀到的長度，-1 失敗
+static ssize_t read_entry(int l, const lazy_entry_t* e, uint64_t offset, size_t size, unsigned char* out) {
+    if (offset >= e->size) {
+        return 0;
+    }
+    if (size > e->size - offset) {
+        size = (size_t)(e->size - offset);
+    }
+    size_t done = 0;
+    while (done < size) {
+        uint64_t raw = e->offset + offset + done;
+        uint32_t index = (uint32_t)(raw / LAZY_CHUNK_SIZE);
+        size_t within = (size_t)(raw % LAZY_CHUNK_SIZE);
+        const unsigned char* data = fetch_chunk(l, index);
+        if (!data) {
+            return -1;
+        }
+        size_t n = layers[l].chunks[index].raw_size - within;
+        if (n > size - done) n = size - done;
+        memcpy(out + done, data + within, n);
+        done += n;
+    }
+    return (ssize_t)done;
+}
+
+// 生成目錄列表：先是 "." 和 ".."，之後根目錄列出各層，層中的目錄列出其子條目
+// OverlayFS 對只來自單個下層的目錄直接轉發 readdir，因此也要提供 "." 和 ".."
+static size_t fill_dirents(uint64_t node, uint64_t offset, char* buf, size_t size) {
+    char name[16];
+    size_t len = 0;
+    int l = NODE_LAYER(node);
+    uint32_t index = NODE_ENTRY(node);
+    uint64_t total = 2 + (node == FUSE_ROOT_ID ? (uint64_t)layer_count
+                          : layers[l].child_start[index + 1] - layers[l].child_start[index]);
+
+    for (uint64_t i = offset; i < total; i++) {
+        const char* entry_name;
+        uint64_t ino;
+        uint32_t type;
+        if (i < 2) {
+            entry_name = i == 0 ? "." : "..";
+            ino = i == 0 || node == FUSE_ROOT_ID || index == 0 ? node : MAKE_NODE(l, layers[l].entries[index].parent);
+            type = DT_DIR;
+        } else if (node == FUSE_ROOT_ID) {
+            snprintf(name, sizeof(name), "%d", (int)(i - 2));
+            entry_name = name;
+            ino = MAKE_NODE(i - 2, 0);
+            type = DT_DIR;
+        } else {
+            uint32_t child = layers[l].children[layers[l].child_start[index] + i - 2];
+            lazy_entry_t* e = &layers[l].entries[child];
+            entry_name = layers[l].strings + e->name;
+            ino = MAKE_NODE(l, e->flags & LAZY_HARDLINK ? e->link : child);
+            type = (e->flags & LAZY_HARDLINK ? S_IFREG : e->mode & S_IFMT) >> 12;
+        }
+        size_t namelen = strlen(entry_name);
+        size_t entlen = FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + namelen);
+        if (len + entlen > size) {
+            break;
+        }
+        struct fuse_dirent* dirent = (struct fuse_dirent*)(buf + len);
+        memset(dirent, 0, entlen);
+        dirent->ino = ino;
+        dirent->off = i + 1;
+        dirent->namelen = (uint32_t)namelen;
+        dirent->type = type;
+        memcpy(dirent->name, entry_name, namelen);
+        len += entlen;
+    }
+    return len;
+}
+
+// 請求者是否與伺服器在同一個用戶命名空間（因而可以讀取 trusted.* 屬性）
+static int caller_privileged(pid_t pid) {
+    static ino_t own_ns;
+    char path[64];
+    struct stat st;
+
+    if (!own_ns && stat("/proc/self/ns/user", &st) == 0) {
+        own_ns = st.st_ino;
+    }
+    snprintf(path, sizeof(path), "/proc/%d/ns/user", (int)pid);
+    return stat(path, &st) == 0 && st.st_ino == own_ns;
+}
+
+// 生成擴展屬性：名稱列表（name 為 NULL）或單個屬性的值
+// 不透明目錄同時提供 trusted.* 與 user.* 兩種屬性，以特權方式或 userxattr 掛載的 OverlayFS 都能識別；
+// 與本地文件系統一致，列表中只對有權讀取的請求者列出 trusted.* 屬性，
+// 否則容器內的 OverlayFS 複製目錄時會讀到列出但無權讀取的屬性而失敗
+static ssize_t entry_xattr(int l, const lazy_entry_t* e, const char* name, char* out, size_t size, int trusted) {
+    static const char* opaque[] = {"trusted.overlay.opaque", "user.overlay.opaque"};
+    const unsigned char* p = layers[l].xattrs + e->xattr;
+    const unsigned char* end = p + e->xattr_len;
+    size_t len = 0;
+
+    for (int i = 0; e->flags & LAZY_OPAQUE && i < 2; i++) {
+        if (name && strcmp(name, opaque[i]) == 0) {
+            if (size > 0) out[0] = 'y';
+            return 1;
+        }
+        if (!name && (trusted || i > 0)) {
+            size_t n = strlen(opaque[i]) + 1;
+            if (len + n <= size) memcpy(out + len, opaque[i], n);
+            len += n;
+        }
+    }
+    while (p < end) {
+        const char* key = (const char*)p;
+        size_t key_len = strnlen(key, (size_t)(end - p));
+        uint32_t value_len;
+        if (key_len + 5 > (size_t)(end - p)) {
+            break;
+        }
+        memcpy(&value_len, p + key_len + 1, 4);
+        const unsigned char* value = p + key_len + 5;
+        if (value_len > (size_t)(end - value)) {
+            break;
+        }
+        if (name && strcmp(name, key) == 0) {
+            if (size > 0 && value_len <= size) memcpy(out, value, value_len);
+            return (ssize_t)value_len;
+        }
+        if (!name && (trusted || strncmp(key, "trusted.", 8) != 0)) {
+            if (len + key_len + 1 <= size) memcpy(out + len, key, key_len + 1);
+            len += key_len + 1;
+        }
+        p = value + value_len;
+    }
+    return name ? -1 : (ssize_t)len;
+}
+
+// FUSE 伺服器主迴圈
+static void serve_lazy(int fd) {
+    static char buffer[FUSE_REQUEST_SIZE];
+    static char reply[LAZY_CHUNK_SIZE];
+
+    while (!stop_requested) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n == -1) {
+            if (errno == EINTR || errno == EAGAIN || errno == ENOENT) {
+                continue;
+            }
+            return; // ENODEV: 已被卸載
+        }
+        if ((size_t)n < sizeof(struct fuse_in_header)) {
+            continue;
+        }
+        struct fuse_in_header* in = (struct fuse_in_header*)buffer;
+        void* arg = buffer + sizeof(*in);
+        int l = -1;
+        uint32_t index = 0;
+        lazy_entry_t* e = node_entry(in->nodeid, &l, &index);
+
+        switch (in->opcode) {
+        case FUSE_INIT: {
+            struct fuse_init_in* init_in = arg;
+            struct fuse_init_out init_out;
+            memset(&init_out, 0, sizeof(init_out));
+            init_out.major = FUSE_KERNEL_VERSION;
+            init_out.minor = FUSE_KERNEL_MINOR_VERSION;
+            init_out.max_readahead = init_in->max_readahead;
+            // 單次讀取最多一個 frame 的大小，並快取符號連結
+            init_out.flags = init_in->flags & (FUSE_MAX_PAGES | FUSE_CACHE_SYMLINKS);
+            init_out.max_pages = LAZY_CHUNK_SIZE / 4096;
+            init_out.max_background = 16;
+            init_out.congestion_threshold = 12;
+            init_out.max_write = 4096;
+            init_out.time_gran = 1000000000;
+            fuse_reply(fd, in->unique, 0, &init_out, sizeof(init_out));
+            break;
+        }
+        case FUSE_LOOKUP: {
+            const char* name = arg;
+            struct fuse_entry_out entry;
+            long child = -1;
+            char* end;
+            if (in->nodeid == FUSE_ROOT_ID) {
+                long layer = strtol(name, &end, 10);
+                child = *name && !*end && layer >= 0 && layer < layer_count ? layer : -1;
+            } else if (e && S_ISDIR(e->mode)) {
+                child = find_child(l, index, name);
+            }
+            // 不存在的名稱也回覆（節點 0），讓內核快取否定結果：OverlayFS 會在每一層查找同一個名稱
+            memset(&entry, 0, sizeof(entry));
+            entry.entry_valid = LAZY_ATTR_TIMEOUT;
+            entry.attr_valid = LAZY_ATTR_TIMEOUT;
+            if (child >= 0) {
+                uint64_t node = in->nodeid == FUSE_ROOT_ID ? MAKE_NODE(child, 0) : MAKE_NODE(l, (uint32_t)child);
+                node_entry(node, &l, &index);
+                entry.nodeid = MAKE_NODE(l, index);
+                fill_attr(entry.nodeid, &entry.attr);
+            }
+            fuse_reply(fd, in->unique, 0, &entry, sizeof(entry));
+            break;
+        }
+        case FUSE_GETATTR: {
+            struct fuse_attr_out attr_out;
+            memset(&attr_out, 0, sizeof(attr_out));
+            attr_out.attr_valid = LAZY_ATTR_TIMEOUT;
+            fill_attr(in->nodeid, &attr_out.attr);
+            fuse_reply(fd, in->unique, 0, &attr_out, sizeof(attr_out));
+            break;
+        }
+        case FUSE_READLINK:
+            if (!e || !S_ISLNK(e->mode)) {
+                fuse_reply(fd, in->unique, -EINVAL, NULL, 0);
+            } else {
+                const char* target = layers[l].strings + e->link;
+                fuse_reply(fd, in->unique, 0, target, strlen(target));
+            }
+            break;
+        case FUSE_OPEN: {
+            struct fuse_open_in* open_in = arg;
+            struct fuse_open_out open_out;
+            if ((open_in->flags & O_ACCMODE) != O_RDONLY) {
+                fuse_reply(fd, in->unique, -EROFS, NULL, 0);
+                break;
+            }
+            // 內容不會改變：保留頁面快取，已讀過的頁面不再經過伺服器
+            memset(&open_out, 0, sizeof(open_out));
+            open_out.open_flags = FOPEN_KEEP_CACHE;
+            fuse_reply(fd, in->unique, 0, &open_out, sizeof(open_out));
+            break;
+        }
+        case FUSE_READ: {
+            struct fuse_read_in* read_in = arg;
+            size_t size = read_in->size < sizeof(reply) ? read_in->size : sizeof(reply);
+            ssize_t len = e && S_ISREG(e->mode) ? read_entry(l, e, read_in->offset, size, (unsigned char*)reply) : -1;
+            fuse_reply(fd, in->unique, len < 0 ? -EIO : 0, reply, len < 0 ? 0 : (size_t)len);
+            break;
+        }
+        case FUSE_OPENDIR: {
+            struct fuse_open_out open_out;
+            memset(&open_out, 0, sizeof(open_out));
+            open_out.open_flags = FOPEN_KEEP_CACHE | FOPEN_CACHE_DIR;
+            fuse_reply(fd, in->unique, 0, &open_out, sizeof(open_out));
+            break;
+        }
+        case FUSE_READDIR: {
+            struct fuse_read_in* read_in = arg;
+            size_t size = read_in->size < sizeof(reply) ? read_in->size : sizeof(reply);
+            if (in->nodeid != FUSE_ROOT_ID && (!e || !S_ISDIR(e->mode))) {
+                fuse_reply(fd, in->unique, -ENOTDIR, NULL, 0);
+                break;
+            }
+            fuse_reply(fd, in->unique, 0, reply, fill_dirents(in->nodeid, read_in->offset, reply, size));
+            break;
+        }
+        case FUSE_GETXATTR:
+        case FUSE_LISTXATTR: {
+            struct fuse_getxattr_in* xattr_in = arg;
+            const char* name = in->opcode == FUSE_GETXATTR ? (const char*)(xattr_in + 1) : NULL;
+            ssize_t len = e ? entry_xattr(l, e, name, reply, xattr_in->size, name || caller_privileged((pid_t)in->pid)) : (name ? -1 : 0);
+            if (len < 0) {
+                fuse_reply(fd, in->unique, -ENODATA, NULL, 0);
+            } else if (xattr_in->size == 0) {
+                struct fuse_getxattr_out xattr_out = {(uint32_t)len, 0};
+                fuse_reply(fd, in->unique, 0, &xattr_out, sizeof(xattr_out));
+            } else if ((size_t)len > xattr_in->size) {
+                fuse_reply(fd, in->unique, -ERANGE, NULL, 0);
+            } else {
+                fuse_reply(fd, in->unique, 0, reply, (size_t)len);
+            }
+            break;
+        }
+        case FUSE_STATFS: {
+            struct fuse_statfs_out statfs_out;
+            memset(&statfs_out, 0, sizeof(statfs_out));
+            statfs_out.st.bsize = 4096;
+            statfs_out.st.frsize = 4096;
+            statfs_out.st.namelen = 255;
+            for (int i = 0; i < layer_count; i++) {
+                statfs_out.st.blocks += (layers[i].header->raw_size + 4095) / 4096;
+                statfs_out.st.files += layers[i].header->entry_count;
+            }
+            fuse_reply(fd, in->unique, 0, &statfs_out, sizeof(statfs_out));
+            break;
+        }
+        case FUSE_RELEASE:
+        case FUSE_RELEASEDIR:
+        case FUSE_FLUSH:
+        case FUSE_DESTROY:
+            fuse_reply(fd, in->unique, 0, NULL, 0);
+            break;
+        case FUSE_FORGET:
+        case FUSE_BATCH_FORGET:
+        case FUSE_INTERRUPT:
+            // 這些請求不需要回覆
+            break;
+        default:
+            // 只讀：寫入類的請求由內核以 EROFS 拒絕，其他不支援
+            fuse_reply(fd, in->unique, -ENOSYS, NULL, 0);
+            break;
+        }
+    }
+}
+
+// 輸出實際讀取的比例：容器只用到鏡像的一小部分時，只需解壓對應的 frame
+static void report_fetched(void) {
+    uint64_t fetched = 0, total = 0;
+    unsigned long chunks = 0, total_chunks = 0;
+
+    for (int i = 0; i < layer_count; i++) {
+        for (uint32_t c = 0; c < layers[i].header->chunk_count; c++) {
+            if (layers[i].fetched[c]) {
+                fetched += layers[i].chunks[c].size;
+                chunks++;
+            }
+        }
+        total += layers[i].packed_size;
+        total_chunks += layers[i].header->chunk_count;
+    }
+    printf("延遲載入: 讀取了 %lu / %lu 個 frame，%.1f / %.1f MB (%.1f%%)\n", chunks, total_chunks,
+           fetched / 1048576.0, total / 1048576.0, total > 0 ? fetched * 100.0 / total : 0);
+    fflush(stdout);
+}
+
+int lazy_mount_start(lazy_mount_t* lm, const char* mount_dir, const char* layers_dir, char* lowerdir, size_t size) {
+    static char rewritten[IMAGE_LOWERDIR_MAX];
+    char path[4096], options[256], toc_hex[SHA256_HEX_LEN + 1];
+    size_t len = 0;
+
+    lm->server_pid = -1;
+    lm->layer_count = 0;
+    snprintf(lm->mount_dir, sizeof(lm->mount_dir), "%s", mount_dir);
+    layer_count = 0;
+
+    // 載入每個延遲層（在主機上先校驗 TOC，損壞的層不會讓容器啟動到一半才失敗）
+    // 文件名就是導入時校驗過的 TOC 摘要，TOC 被替換的文件在這裡就會被拒絕
+    rewritten[0] = '\0';
+    for (char* item = lowerdir; *item; ) {
+        size_t item_len = strcspn(item, ":");
+        int is_lazy = item_len > 5 && strncmp(item + item_len - 5, ".lazy", 5) == 0;
+        if (is_lazy) {
+            struct stat st;
+            snprintf(path, sizeof(path), "%s/%.*s", layers_dir, (int)item_len, item);
+            int fd = open(path, O_RDONLY | O_CLOEXEC);
+            if (layer_count >= LAZY_MAX_LAYERS || fd == -1 || fstat(fd, &st) == -1 ||
+                layer_load(&layers[layer_count], fd, 0, (uint64_t)st.st_size, toc_hex) != 0 ||
+                item_len != SHA256_HEX_LEN + 5 || strncmp(item, toc_hex, SHA256_HEX_LEN) != 0) {
+                fprintf(stderr, "錯誤: 無法載入延遲層 %s（文件已損壞、與目錄表摘要不符或層數過多）\n", path);
+                if (fd != -1) close(fd);
+                layer_free(&layers[layer_count]);
+                goto fail;
+            }
+            layers[layer_count].fd = fd;
+            len += (size_t)snprintf(rewritten + len, sizeof(rewritten) - len, "%s%s/%d", len ? ":" : "", mount_dir,
+                                    layer_count);
+            layer_count++;
+        } else {
+            len += (size_t)snprintf(rewritten + len, sizeof(rewritten) - len, "%s%.*s", len ? ":" : "", (int)item_len,
+                                    item);
+        }
+        if (len >= sizeof(rewritten)) {
+            fprintf(stderr, "錯誤: lowerdir 過長\n");
+            goto fail;
+        }
+        item += item_len;
+        if (*item == ':') item++;
+    }
+    if (len >= size) {
+        fprintf(stderr, "錯誤: lowerdir 過長\n");
+        goto fail;
+    }
+
+    int fd = open("/dev/fuse", O_RDWR | O_CLOEXEC);
+    if (fd == -1) {
+        fprintf(stderr, "錯誤: 延遲層需要 /dev/fuse: %s\n", strerror(errno));
+        goto fail;
+    }
+    if (mkdir(mount_dir, 0755) == -1 && errno != EEXIST) {
+        close(fd);
+        goto fail;
+    }
+    // allow_other：容器在子用戶命名空間中；default_permissions：由內核按文件的權限位檢查訪問
+    snprintf(options, sizeof(options), "fd=%d,rootmode=40000,user_id=0,group_id=0,allow_other,default_permissions", fd);
+    if (mount("docker_in_c_lazy", mount_dir, "fuse.docker_in_c_lazy", MS_RDONLY, options) == -1) {
+        fprintf(stderr, "錯誤: 無法掛載延遲層: %s\n", strerror(errno));
+        close(fd);
+        rmdir(mount_dir);
+        goto fail;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        umount2(mount_dir, MNT_DETACH);
+        close(fd);
+        rmdir(mount_dir);
+        goto fail;
+    }
+    if (pid == 0) {
+        struct sigaction action;
+        // 伺服器隨 runtime 結束，並且不響應終端信號；SIGTERM 時輸出統計後退出
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        signal(SIGINT, SIG_IGN);
+        signal(SIGQUIT, SIG_IGN);
+        signal(SIGTSTP, SIG_IGN);
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = on_stop;
+        sigaction(SIGTERM, &action, NULL);
+        real_uid = get_real_uid();
+        real_gid = get_real_gid();
+        serve_lazy(fd);
+        report_fetched();
+        _exit(0);
+    }
+
+    close(fd);
+    memcpy(lowerdir, rewritten, len + 1);
+    lm->server_pid = pid;
+    lm->layer_count = layer_count;
+    for (int i = 0; i < layer_count; i++) {
+        layer_free(&layers[i]);
+    }
+    layer_count = 0;
+    return 0;
+
+fail:
+    for (int i = 0; i < layer_count; i++) {
+        layer_free(&layers[i]);
+    }
+    layer_count = 0;
+    return -1;
+}
+
+void lazy_mount_stop(lazy_mount_t* lm) {
+    if (lm->server_pid <= 0) {
+        return;
+    }
+    umount2(lm->mount_dir, MNT_DETACH);
+    kill(lm->server_pid, SIGTERM);
+    waitpid(lm->server_pid, NULL, 0);
+    rmdir(lm->mount_dir);
+    lm->server_pid = -1;
+}
@@ -0,0 +1,167 @@
+#ifndef LAZY_H
+#define LAZY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * 可隨機讀取的層格式（延遲載入）
+ *
+ * 層的 blob 仍是合法的 zstd 壓縮 tar：未壓縮的 tar 流每 LAZY_CHUNK_SIZE 位元組切成一個獨立的 zstd frame，
+ * 之後是兩個 zstd 的 skippable frame（普通解壓時被略過）：壓縮過的目錄表 (TOC)，以及固定大小的結尾。
+ * TOC 記錄每個條目的元數據、內容在 tar 流中的位置，以及每個 frame 的位置與摘要，
+ * 讀取文件時只需解壓它所在的 frame。
+ *
+ *   [frame 0] [frame 1] ... [frame N-1] [skippable: TOC] [skippable: lazy_footer_t]
+ */
+
+// 每個 frame 的未壓縮大小（最後一個可以較小）
+#define LAZY_CHUNK_SIZE (1024 * 1024)
+
+// TOC 與結尾使用的 skippable frame 魔數（0x184D2A50 ~ 0x184D2A5F 均為 skippable frame）
+#define LAZY_SKIPPABLE_MAGIC 0x184D2A5BU
+
+#define LAZY_TOC_MAGIC "DICTOC01"
+#define LAZY_FOOTER_MAGIC "DICLAZY1"
+
+// 條目標記
+#define LAZY_HARDLINK 0x1          // 硬連結：link 是目標的條目編號
+#define LAZY_OPAQUE 0x2            // OverlayFS 的不透明目錄
+
+// TOC 頭部，之後依序是條目表、frame 表、字串表和擴展屬性表
+typedef struct {
+    char magic[8];             // LAZY_TOC_MAGIC
+    uint32_t entry_count;      // 條目數（第 0 個是根目錄）
+    uint32_t chunk_count;      // frame 數
+    uint32_t string_size;      // 字串表大小
+    uint32_t xattr_size;       // 擴展屬性表大小
+    uint64_t raw_size;         // 未壓縮 tar 流的大小
+} lazy_toc_header_t;
+
+// 一個條目（文件、目錄、連結、設備）
+typedef struct {
+    uint32_t parent;           // 父目錄的條目編號
+    uint32_t name;             // 名稱在字串表中的位置
+    uint32_t link;             // 符號連結：目標在字串表中的位置；硬連結：目標的條目編號
+    uint32_t mode;             // st_mode（含文件類型）
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t rdev;             // 設備號（內核的 new_encode_dev 格式，0/0 字元設備為刪除標記）
+    uint32_t flags;            // LAZY_HARDLINK / LAZY_OPAQUE
+    uint32_t xattr;            // 擴展屬性在屬性表中的位置（"名稱\0" + 4 位元組長度 + 值，依序排列）
+    uint32_t xattr_len;
+    uint64_t size;
+    uint64_t offset;           // 文件內容在未壓縮 tar 流中的位置
+    int64_t mtime;
+} lazy_entry_t;
+
+// 一個 frame
+typedef struct {
+    uint64_t offset;           // 在 blob 中的位置
+    uint32_t size;             // 壓縮後大小
+    uint32_t raw_size;         // 解壓後大小
+    unsigned char digest[32];  // 壓縮數據的 sha256，讀取時校驗
+} lazy_chunk_t;
+
+// blob 結尾（skippable frame 的內容）
+typedef struct {
+    uint64_t toc_offset;       // 壓縮過的 TOC 在 blob 中的位置
+    uint64_t toc_size;         // 壓縮後大小
+    uint64_t toc_raw_size;     // 解壓後大小
+    unsigned char toc_digest[32]; // 壓縮過的 TOC 的 sha256，即層的內容地址
+    char magic[8];             // LAZY_FOOTER_MAGIC
+} lazy_footer_t;
+
+// 生成中的 TOC
+typedef struct {
+    lazy_entry_t* entries;
+    size_t entry_count;
+    size_t entry_capacity;
+    lazy_chunk_t* chunks;
+    size_t chunk_count;
+    size_t chunk_capacity;
+    char* strings;
+    size_t string_size;
+    size_t string_capacity;
+    unsigned char* xattrs;
+    size_t xattr_size;
+    size_t xattr_capacity;
+} lazy_toc_t;
+
+// 延遲載入的掛載（一個 FUSE 伺服器提供一個容器用到的所有延遲層）
+typedef struct {
+    pid_t server_pid;          // FUSE 伺服器進程 ID，-1 表示未運行
+    char mount_dir[256];       // 主機上的掛載點
+    int layer_count;
+} lazy_mount_t;
+
+/**
+ * 在 TOC 中加入一個條目
+ * @param toc TOC
+ * @param entry 條目（name、link、xattr 欄位由本函數填入；硬連結時 link 需已是目標的條目編號）
+ * @param name 名稱
+ * @param link 符號連結的目標，其他類型為 NULL
+ * @param xattrs 擴展屬性（格式同屬性表），可為 NULL
+ * @param xattr_len 擴展屬性長度
+ * @return 條目編號，-1 記憶體不足
+ */
+long lazy_toc_add_entry(lazy_toc_t* toc, const lazy_entry_t* entry, const char* name, const char* link,
+                        const void* xattrs, size_t xattr_len);
+
+/**
+ * 在 TOC 中加入一個 frame
+ * @return 0 成功，-1 記憶體不足
+ */
+int lazy_toc_add_chunk(lazy_toc_t* toc, const lazy_chunk_t* chunk);
+
+/**
+ * 生成 blob 的結尾：壓縮過的 TOC 與 footer 兩個 skippable frame
+ * @param toc TOC
+ * @param raw_size 未壓縮 tar 流的大小
+ * @param blob_offset 結尾在 blob 中的起始位置
+ * @param out 輸出的數據（調用者 free）
+ * @param out_len 輸出長度
+ * @param toc_hex 輸出 TOC 的十六進位摘要（65 位元組）
+ * @return 0 成功，-1 失敗
+ */
+int lazy_toc_finish(lazy_toc_t* toc, uint64_t raw_size, uint64_t blob_offset, unsigned char** out, size_t* out_len,
+                    char* toc_hex);
+
+/**
+ * 釋放 TOC
+ */
+void lazy_toc_free(lazy_toc_t* toc);
+
+/**
+ * 檢查 blob 是否為可隨機讀取的格式，並校驗其 TOC
+ * 只讀取結尾與 TOC，不解壓層的內容
+ * @param fd blob 所在的文件
+ * @param offset blob 在文件中的位置
+ * @param size blob 大小
+ * @param toc_hex 輸出 TOC 的十六進位摘要（65 位元組）
+ * @return 0 是且 TOC 有效，-1 不是或已損壞
+ */
+int lazy_probe(int fd, off_t offset, uint64_t size, char* toc_hex);
+
+/**
+ * 在主機上掛載延遲層並啟動 FUSE 伺服器
+ * lowerdir 中以 ".lazy" 結尾的項目（層目錄中的延遲層文件）改寫為掛載點下對應的目錄；
+ * 文件只在被讀取時才解壓其所在的 frame 並校驗摘要
+ * 必須在 clone() 之前調用，讓容器的掛載命名空間繼承此掛載
+ * @param lm 輸出的服務狀態
+ * @param mount_dir 主機上的掛載點（不存在時自動創建）
+ * @param layers_dir 層目錄
+ * @param lowerdir OverlayFS 的 lowerdir（就地改寫）
+ * @param size lowerdir 緩衝區大小
+ * @return 0 成功，-1 失敗（已輸出錯誤信息）
+ */
+int lazy_mount_start(lazy_mount_t* lm, const char* mount_dir, const char* layers_dir, char* lowerdir, size_t size);
+
+/**
+ * 卸載延遲層並停止 FUSE 伺服器（伺服器退出前輸出讀取的比例）
+ * @param lm 服務狀態
+ */
+void lazy_mount_stop(lazy_mount_t* lm);
+
+#endif // LAZY_H
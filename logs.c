@@ -0,0 +1,305 @@
+#include "logs.h"
+#include "state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+void log_file_path(const char* container_id, char* path, size_t size) {
+    snprintf(path, size, "%s/%s.log", LOGS_DIR, container_id);
+}
+
+// 打開新的日誌文件（splice 不支援 O_APPEND，寫入位置由文件偏移量維護）
+static int log_reopen(log_writer_t* log, int truncate) {
+    log->fd = open(log->path, O_WRONLY | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0640);
+    if (log->fd == -1) {
+        return -1;
+    }
+    log->size = lseek(log->fd, 0, SEEK_END);
+    if (log->size < 0) {
+        log->size = 0;
+    }
+    return 0;
+}
+
+int log_writer_open(log_writer_t* log, const char* container_id, long max_size, long rate) {
+    log->fd = -1;
+    log->max_size = max_size;
+    log->rate = rate;
+    log->tokens = rate;
+    clock_gettime(CLOCK_MONOTONIC, &log->refilled);
+    log_file_path(container_id, log->path, sizeof(log->path));
+
+    if (max_size <= 0) {
+        return 0;
+    }
+    if ((mkdir(RUNTIME_DIR, 0755) == -1 && errno != EEXIST) ||
+        (mkdir(LOGS_DIR, 0755) == -1 && errno != EEXIST)) {
+        return -1;
+    }
+    return log_reopen(log, 1);
+}
+
+// 文件超過上限時輪替：目前文件改名為 .1（覆蓋更舊的），再打開新文件
+static void log_rotate(log_writer_t* log) {
+    char old_path[272];
+
+    if (log->size < log->max_size) {
+        return;
+    }
+    snprintf(old_path, sizeof(old_path), "%s.1", log->path);
+    rename(log->path, old_path);
+    close(log->fd);
+    if (log_reopen(log, 1) != 0) {
+        log->fd = -1;
+    }
+}
+
+// 寫入記錄頭部
+static int log_write_header(log_writer_t* log, size_t len) {
+    struct timespec now;
+    char header[64];
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    int n = snprintf(header, sizeof(header), "%lld.%06ld %zu\n",
+                     (long long)now.tv_sec, now.tv_nsec / 1000, len);
+    if (write(log->fd, header, n) != n) {
+        return -1;
+    }
+    log->size += n;
+    return 0;
+}
+
+// 記錄沒有完整寫入時截斷回寫入頭部之前的位置，否則讀取時會把之後的頭部當作資料
+static int log_rollback(log_writer_t* log, off_t start) {
+    if (ftruncate(log->fd, start) == 0 && lseek(log->fd, start, SEEK_SET) == start) {
+        log->size = start;
+    }
+    return -1;
+}
+
+int log_write_pipe(log_writer_t* log, int pipe_fd, size_t len) {
+    if (log->fd < 0) {
+        return -1;
+    }
+    off_t start = log->size;
+    if (log_write_header(log, len) != 0) {
+        return log_rollback(log, start);
+    }
+    while (len > 0) {
+        ssize_t n = splice(pipe_fd, NULL, log->fd, NULL, len, SPLICE_F_MOVE);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return log_rollback(log, start);
+        }
+        len -= n;
+        log->size += n;
+    }
+    log_rotate(log);
+    return 0;
+}
+
+int log_write(log_writer_t* log, const char* data, size_t len) {
+    if (log->fd < 0) {
+        return -1;
+    }
+    off_t start = log->size;
+    if (log_write_header(log, len) != 0) {
+        return log_rollback(log, start);
+    }
+    while (len > 0) {
+        ssize_t n = write(log->fd, data, len);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return log_rollback(log, start);
+        }
+        data += n;
+        len -= n;
+        log->size += n;
+    }
+    log_rotate(log);
+    return 0;
+}
+
+int log_throttle_ms(log_writer_t* log, size_t len) {
+    struct timespec now;
+
+    if (log->rate <= 0) {
+        return 0;
+    }
+    // 令牌桶：按經過的時間補充，最多累積一秒的量
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (now.tv_sec - log->refilled.tv_sec) + (now.tv_nsec - log->refilled.tv_nsec) / 1e9;
+    log->refilled = now;
+    log->tokens += elapsed * log->rate;
+    if (log->tokens > log->rate) {
+        log->tokens = log->rate;
+    }
+    log->tokens -= len;
+    if (log->tokens >= 0) {
+        return 0;
+    }
+    return (int)(-log->tokens * 1000 / log->rate) + 1;
+}
+
+void log_writer_close(log_writer_t* log) {
+    if (log->fd >= 0) {
+        close(log->fd);
+        log->fd = -1;
+    }
+}
+
+// 日誌讀取狀態：記錄可能跨越多次 read（follow 時也可能只寫了一半）
+typedef struct {
+    char header[64];
+    size_t header_len;
+    size_t remaining;          // 目前記錄還沒輸出的位元組數
+    long long sec;
+    long usec;
+    int line_start;            // 下一個輸出的位元組是否在行首
+    int timestamps;
+} log_reader_t;
+
+static void log_reader_feed(log_reader_t* reader, const char* buf, size_t len) {
+    while (len > 0) {
+        if (reader->remaining == 0) {
+            // 讀取頭部直到換行
+            char c = *buf++;
+            len--;
+            if (c != '\n') {
+                if (reader->header_len < sizeof(reader->header) - 1) {
+                    reader->header[reader->header_len++] = c;
+                }
+                continue;
+            }
+            reader->header[reader->header_len] = '\0';
+            reader->header_len = 0;
+            if (sscanf(reader->header, "%lld.%ld %zu", &reader->sec, &reader->usec, &reader->remaining) != 3) {
+                reader->remaining = 0;
+            }
+            continue;
+        }
+
+        size_t n = len < reader->remaining ? len : reader->remaining;
+        if (!reader->timestamps) {
+            fwrite(buf, 1, n, stdout);
+        } else {
+            // 在每一行的開頭加上所屬記錄的時間
+            for (size_t i = 0; i < n; i++) {
+                if (reader->line_start) {
+                    char stamp[32];
+                    time_t sec = (time_t)reader->sec;
+                    struct tm tm;
+                    gmtime_r(&sec, &tm);
+                    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+                    printf("%s.%06ldZ ", stamp, reader->usec);
+                }
+                putchar(buf[i]);
+                reader->line_start = buf[i] == '\n';
+            }
+        }
+        buf += n;
+        len -= n;
+        reader->remaining -= n;
+    }
+}
+
+// 讀到文件結尾
+static void log_reader_drain(log_reader_t* reader, int fd) {
+    char buf[65536];
+    ssize_t n;
+
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        log_reader_feed(reader, buf, n);
+    }
+    fflush(stdout);
+}
+
+// 容器是否仍在運行（日誌仍可能增長）
+static int log_container_running(const char* container_id) {
+    container_record_t record;
+    return state_find(container_id, &record) == 0 && state_is_alive(&record);
+}
+
+int log_print(const char* container_id, int follow, int timestamps) {
+    log_reader_t reader;
+    char path[256];
+    char old_path[272];
+    struct stat st, current;
+
+    memset(&reader, 0, sizeof(reader));
+    reader.line_start = 1;
+    reader.timestamps = timestamps;
+
+    log_file_path(container_id, path, sizeof(path));
+    snprintf(old_path, sizeof(old_path), "%s.1", path);
+
+    // 先輸出已輪替的舊文件
+    int fd = open(old_path, O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        log_reader_drain(&reader, fd);
+        close(fd);
+    }
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        fprintf(stderr, "錯誤: 找不到容器 %s 的日誌\n", container_id);
+        return -1;
+    }
+    log_reader_drain(&reader, fd);
+    if (!follow) {
+        close(fd);
+        return 0;
+    }
+
+    // follow：以 inotify 等待日誌目錄的變化，最多每秒檢查一次容器是否已退出
+    int ino = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (ino != -1) {
+        inotify_add_watch(ino, LOGS_DIR, IN_MODIFY | IN_CREATE | IN_MOVED_TO);
+    }
+    for (;;) {
+        int running = log_container_running(container_id);
+        log_reader_drain(&reader, fd);
+
+        // 寫入端輪替了文件：舊文件讀完後切換到新文件
+        if (fstat(fd, &st) == 0 && stat(path, &current) == 0 && st.st_ino != current.st_ino) {
+            log_reader_drain(&reader, fd);
+            close(fd);
+            fd = open(path, O_RDONLY | O_CLOEXEC);
+            if (fd == -1) {
+                break;
+            }
+            continue;
+        }
+        if (!running) {
+            break;
+        }
+
+        if (ino != -1) {
+            char events[4096];
+            struct pollfd pfd = {ino, POLLIN, 0};
+            if (poll(&pfd, 1, 1000) > 0) {
+                while (read(ino, events, sizeof(events)) > 0) {
+                }
+            }
+        } else {
+            usleep(200 * 1000);
+        }
+    }
+
+    if (ino != -1) {
+        close(ino);
+    }
+    if (fd != -1) {
+        close(fd);
+    }
+    return 0;
+}
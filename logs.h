@@ -0,0 +1,88 @@
+#ifndef LOGS_H
+#define LOGS_H
+
+#include <stddef.h>
+#include <time.h>
+#include "runtime.h"
+
+// 容器日誌目錄（容器退出後保留，可用 logs 查看）
+#define LOGS_DIR RUNTIME_DIR "/logs"
+
+// 預設的單個日誌文件上限與寫入速率
+#define LOG_DEFAULT_MAX_SIZE (10L * 1024 * 1024)
+#define LOG_DEFAULT_RATE (1024L * 1024)
+
+// 日誌寫入器
+// 日誌文件由一連串記錄組成，每筆記錄是一行 "<秒>.<微秒> <長度>\n" 的頭部加上原始輸出，
+// 頭部之後的內容可以直接從管道 splice 到文件，不需要在用戶空間逐行插入時間戳
+typedef struct {
+    int fd;                    // 目前的日誌文件，-1 表示未啟用
+    char path[256];            // <LOGS_DIR>/<ID>.log，輪替後的舊文件為 <ID>.log.1
+    long size;                 // 目前文件的大小
+    long max_size;             // 超過後輪替；總佔用不超過兩倍
+    long rate;                 // 每秒允許寫入的位元組數，0 表示不限制
+    double tokens;             // 令牌桶中剩餘的位元組數（上限為一秒的量）
+    struct timespec refilled;  // 上次補充令牌的時間
+} log_writer_t;
+
+/**
+ * 取得容器日誌文件的路徑
+ * @param container_id 容器 ID
+ * @param path 輸出緩衝區
+ * @param size 緩衝區大小
+ */
+void log_file_path(const char* container_id, char* path, size_t size);
+
+/**
+ * 打開容器的日誌文件
+ * @param log 輸出的寫入器
+ * @param container_id 容器 ID
+ * @param max_size 單個文件的上限（位元組），0 表示不記錄日誌
+ * @param rate 每秒寫入上限（位元組），0 表示不限制
+ * @return 0 成功，-1 失敗
+ */
+int log_writer_open(log_writer_t* log, const char* container_id, long max_size, long rate);
+
+/**
+ * 把管道中的 len 個位元組 splice 到日誌文件（先寫入帶時間戳的頭部）
+ * @param log 寫入器
+ * @param pipe_fd 管道讀取端
+ * @param len 位元組數
+ * @return 0 成功，-1 失敗（寫了一半的記錄已截斷，管道中剩餘的資料由調用者處理）
+ */
+int log_write_pipe(log_writer_t* log, int pipe_fd, size_t len);
+
+/**
+ * 寫入一筆已在用戶空間的記錄（不支援 splice 時的備用路徑）
+ * @param log 寫入器
+ * @param data 資料
+ * @param len 位元組數
+ * @return 0 成功，-1 失敗
+ */
+int log_write(log_writer_t* log, const char* data, size_t len);
+
+/**
+ * 扣除已寫入的位元組並計算需要暫停讀取容器輸出的時間
+ * 超出速率時暫停讀取 pty，容器的寫入會因 pty 緩衝區滿而阻塞（不丟棄日誌）
+ * @param log 寫入器
+ * @param len 剛寫入的位元組數
+ * @return 需要等待的毫秒數，0 表示可以繼續
+ */
+int log_throttle_ms(log_writer_t* log, size_t len);
+
+/**
+ * 關閉日誌文件
+ * @param log 寫入器
+ */
+void log_writer_close(log_writer_t* log);
+
+/**
+ * 輸出容器的日誌
+ * @param container_id 容器 ID
+ * @param follow 是否持續輸出新的日誌，直到容器退出
+ * @param timestamps 是否在每行前加上時間戳
+ * @return 0 成功，-1 找不到日誌
+ */
+int log_print(const char* container_id, int follow, int timestamps);
+
+#endif // LOGS_H
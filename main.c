@@ -10,10 +10,28 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <sys/ioctl.h>
 #include <termios.h>
 #include <time.h>
+#include <getopt.h>
+#include <sys/syscall.h>
 #include "cgroup.h"
+#include "cpuset.h"
+#include "autoscale.h"
+#include "procfs.h"
+#include "runtime.h"
+#include "state.h"
+#include "console.h"
+#include "pid1.h"
+#include "netns.h"
+#include "volume.h"
+#include "image.h"
+#include "export.h"
+#include "lazy.h"
+#include "memtune.h"
+#include "qos.h"
+#include "metrics.h"
 #include "namespace.h"
 #include "rootfs.h"
 
@@ -23,15 +41,38 @@
 
 static char child_stack[STACK_SIZE];
 
+// 容器內進程的環境變量（容器的工作負載和 exec 共用）
+static char* container_env[] = {
+    "PATH=/bin:/usr/bin:/sbin:/usr/sbin", 
+    "HOME=/", 
+    "PS1=[容器] \\w # ", 
+    "TERM=xterm",  // 使用更通用的 xterm 終端類型
+    "TERMINFO=/usr/share/terminfo:/lib/terminfo:/etc/terminfo",  // 多個搜尋路徑
+    NULL
+};
+
 // 容器初始化參數結構
 typedef struct {
     cgroup_limits_t* limits;
     int sync_pipe[2];          // 用於父子進程同步的管道
     char container_root[256];  // 容器根目錄路徑
     char cgroup_name[128];     // cgroup 名稱
-    int container_id;          // 容器 ID
+    char container_id[CONTAINER_ID_LEN + 1]; // 容器 ID
+    int virtual_proc;          // 是否已在主機上啟動即時的虛擬 proc 文件服務
+    char virtual_proc_dir[512]; // 虛擬 proc 文件在主機上的掛載點
+    int rootfs_mode;           // 0 = bind mount, 1 = 複製, 2 = OverlayFS
+    int console_slave;         // pty 從端，-1 表示直接使用啟動容器的終端
+    char** command;            // 要執行的命令，NULL 表示交互式 bash
+    int use_init;              // 是否以內建的 init 作為 PID 1
+    volume_t volumes[MAX_VOLUMES]; // 掛載到容器中的卷（bind mount / tmpfs）
+    int volume_count;
+    char image_lowerdir[IMAGE_LOWERDIR_MAX]; // 使用導入的鏡像時各層的 lowerdir（相對於 IMAGE_LAYERS_DIR），空字串表示使用基礎 rootfs
+    memory_policy_t memory_policy; // THP 模式與 NUMA 記憶體策略
+    qos_class_t qos;           // CPU 服務等級
 } container_init_args_t;
 
+static const char* rootfs_mode_names[] = {"bind", "copy", "overlay"};
+
 // 創建基本的設備文件（當 devtmpfs 掛載失敗時的備用方案）
 static void create_basic_devices(const char* container_root) {
     char dev_path[512];
@@ -114,14 +155,7 @@ int container_init(void* arg) {
     
     // 使用 -i 參數強制 bash 進入交互模式
     char *argv[] = {"/bin/bash", "-i", NULL};
-    char *envp[] = {
-        "PATH=/bin:/usr/bin:/sbin:/usr/sbin", 
-        "HOME=/", 
-        "PS1=[容器] \\w # ", 
-        "TERM=xterm",  // 使用更通用的 xterm 終端類型
-        "TERMINFO=/usr/share/terminfo:/lib/terminfo:/etc/terminfo",  // 多個搜尋路徑
-        NULL
-    };
+    char **envp = container_env;
     
     // 關閉管道的寫入端（父進程使用）
     close(args->sync_pipe[1]);
@@ -133,6 +167,12 @@ int container_init(void* arg) {
     }
     close(args->sync_pipe[0]);
     
+    // 把 runtime 分配的 pty 設為控制終端，容器因此不再依附於啟動它的終端
+    if (args->console_slave >= 0 && console_setup_slave(args->console_slave) == -1) {
+        perror("console");
+        return -1;
+    }
+    
     // 在用戶命名空間中設置 UID/GID 為 0（必須在 uid_map 設置後立即執行）
     // 這樣後續創建的所有文件和目錄都會有正確的權限
     if (setgid(0) == -1) {
@@ -144,7 +184,7 @@ int container_init(void* arg) {
         return -1;
     }
     
-    // printf("=== 進入容器環境 (ID: %d) ===\n", args->container_id);
+    // printf("=== 進入容器環境 (ID: %s) ===\n", args->container_id);
     // printf("PID: %d\n", getpid());
     // printf("PPID: %d\n", getppid());
     // printf("UID: %d, GID: %d\n", getuid(), getgid());
@@ -155,7 +195,12 @@ int container_init(void* arg) {
     //   0 = Bind Mount (最快，但容器間共享文件系統，/tmp 只讀)
     //   1 = 複製模式 (較慢但完全隔離，/tmp 可寫) ✅
     //   2 = OverlayFS (推薦：快速 + 隔離，但需要內核支援)
-    if (setup_container_rootfs(container_root, 2) != 0) {  // 使用 OverlayFS
+    //   或以導入的鏡像的層作為 OverlayFS 的下層
+    if (args->image_lowerdir[0]) {
+        if (setup_image_rootfs(container_root, IMAGE_LAYERS_DIR, args->image_lowerdir) != 0) {
+            return -1;
+        }
+    } else if (setup_container_rootfs(container_root, args->rootfs_mode) != 0) {
         fprintf(stderr, "錯誤: 無法設置容器文件系統\n");
         return -1;
     }
@@ -175,8 +220,21 @@ int container_init(void* arg) {
         }
     }
 
-    // 在 chroot 之前創建虛擬 meminfo（在主機文件系統）
-    if (limits && limits->memory_limit_mb > 0) {
+    // 在 chroot 之前把即時的虛擬 proc 文件目錄 bind mount 進容器
+    if (args->virtual_proc) {
+        char vproc_path[512];
+        snprintf(vproc_path, sizeof(vproc_path), "%s/run", container_root);
+        mkdir(vproc_path, 0755);
+        snprintf(vproc_path, sizeof(vproc_path), "%s%s", container_root, VIRTUAL_PROC_DIR);
+        mkdir(vproc_path, 0755);
+        if (mount(args->virtual_proc_dir, vproc_path, NULL, MS_BIND, NULL) == -1) {
+            fprintf(stderr, "警告: 無法掛載虛擬 proc 文件: %s，改用靜態 meminfo\n", strerror(errno));
+            args->virtual_proc = 0;
+        }
+    }
+    
+    // 在 chroot 之前創建靜態的虛擬 meminfo（沒有即時服務時的備用方案）
+    if (!args->virtual_proc && limits && limits->memory_limit_mb > 0) {
         char meminfo_path[512];
         char tmp_dir[512];
         
@@ -215,6 +273,13 @@ int container_init(void* arg) {
     unlink(ptmx_link); // 如果已存在則刪除
     symlink("/dev/pts/ptmx", ptmx_link);
     
+    // 在 chroot 之前掛載卷：寫入直接到達主機的文件系統或 tmpfs，不經過 overlay 的 copy-up
+    for (int i = 0; i < args->volume_count; i++) {
+        if (volume_mount(container_root, &args->volumes[i]) != 0) {
+            return -1;
+        }
+    }
+    
     // 文件系統隔離：改變根目錄並切換工作目錄
     // chroot: 將進程的根目錄改為容器目錄，實現文件系統隔離
     // chdir: 切換到新的根目錄，避免工作目錄錯誤
@@ -242,31 +307,38 @@ int container_init(void* arg) {
     unlink("/dev/ptmx"); // 如果已存在則刪除
     symlink("/dev/pts/ptmx", "/dev/ptmx");
     
-    // 確保 /var/lib/dpkg/info/format 檔案是 2.0（在 chroot 後強制設置）
+    // 確保 /var/lib/dpkg/info/format 檔案是 2.0（在 chroot 後強制設置，導入的鏡像保持原樣）
     // 先確保目錄存在
-    mkdir("/var/lib/dpkg", 0755);
-    mkdir("/var/lib/dpkg/info", 0755);
+    if (!args->image_lowerdir[0]) {
+        mkdir("/var/lib/dpkg", 0755);
+        mkdir("/var/lib/dpkg/info", 0755);
+    
+        char format_path[512] = "/var/lib/dpkg/info/format";
+        unlink(format_path); // 刪除可能存在的舊檔案
+        FILE* format_file = fopen(format_path, "w");
+        if (format_file) {
+            fprintf(format_file, "2.0\n");
+            fclose(format_file);
+            chmod(format_path, 0644);
+        }
     
-    char format_path[512] = "/var/lib/dpkg/info/format";
-    unlink(format_path); // 刪除可能存在的舊檔案
-    FILE* format_file = fopen(format_path, "w");
-    if (format_file) {
-        fprintf(format_file, "2.0\n");
-        fclose(format_file);
-        chmod(format_path, 0644);
+        char format_new_path[512] = "/var/lib/dpkg/info/format-new";
+        unlink(format_new_path); // 刪除可能存在的舊檔案
+        format_file = fopen(format_new_path, "w");
+        if (format_file) {
+            fprintf(format_file, "2.0\n");
+            fclose(format_file);
+            chmod(format_new_path, 0644);
+        }
     }
     
-    char format_new_path[512] = "/var/lib/dpkg/info/format-new";
-    unlink(format_new_path); // 刪除可能存在的舊檔案
-    format_file = fopen(format_new_path, "w");
-    if (format_file) {
-        fprintf(format_file, "2.0\n");
-        fclose(format_file);
-        chmod(format_new_path, 0644);
+    // 即時的虛擬 proc 文件：每次讀取都根據 cgroup 狀態重新計算
+    if (args->virtual_proc) {
+        virtual_proc_bind();
     }
     
-    // 掛載虛擬 meminfo（已在 chroot 之前創建）
-    if (limits && limits->memory_limit_mb > 0) {
+    // 掛載靜態虛擬 meminfo（已在 chroot 之前創建）
+    if (!args->virtual_proc && limits && limits->memory_limit_mb > 0) {
         // 檢查 meminfo 文件是否存在
         if (access("/tmp/meminfo.custom", F_OK) != 0) {
             // printf("⚠️  警告: 虛擬 meminfo 文件不存在\n");
@@ -283,10 +355,26 @@ int container_init(void* arg) {
     
     // devtmpfs 和 devpts 已在 chroot 之前掛載
 
+    // 在 exec 之前套用 THP 與 NUMA 記憶體策略及服務等級的調度策略，容器內的所有進程繼承
+    if (memtune_apply(&args->memory_policy) != 0 || qos_apply_sched(args->qos) != 0) {
+        return -1;
+    }
+
     // printf("\n容器環境已準備就緒！\n");
     // printf("輸入 'exit' 離開容器\n\n");
     
-    // 執行 bash
+    // 內建 init 留在 PID 1 回收孤兒進程並轉發信號，工作負載在子進程中執行
+    if (args->use_init) {
+        return pid1_run(args->command ? args->command : argv, envp);
+    }
+    
+    // 執行指定的命令（在容器的 PATH 中查找），沒有指定時執行 bash
+    if (args->command) {
+        environ = envp;
+        execvp(args->command[0], args->command);
+        fprintf(stderr, "錯誤: 無法執行 %s: %s\n", args->command[0], strerror(errno));
+        return 127;
+    }
     if (execve("/bin/bash", argv, envp) == -1) {
         perror("execve");
         return -1;
@@ -296,10 +384,951 @@ int container_init(void* arg) {
 }
 
 
-int main() {
+// 命令列選項 ID（只有長選項）
+enum {
+    OPT_MEMORY = 256,
+    OPT_MEMORY_HIGH,
+    OPT_MEMORY_LOW,
+    OPT_MEMORY_MIN,
+    OPT_MEMORY_SWAP,
+    OPT_MEMORY_ZSWAP,
+    OPT_NO_OOM_GROUP,
+    OPT_CPU_SHARES,
+    OPT_CPU_QUOTA,
+    OPT_PIDS,
+    OPT_IO_MAX,
+    OPT_CPUSET,
+    OPT_CPUSET_DOMAIN,
+    OPT_CPU_AUTOSCALE,
+    OPT_CPU_AUTOSCALE_TARGET,
+    OPT_CPU_AUTOSCALE_INTERVAL,
+    OPT_NO_VIRTUAL_PROC,
+    OPT_ROOTFS,
+    OPT_DETACH,
+    OPT_INIT,
+    OPT_NET,
+    OPT_TMPFS,
+    OPT_IMAGE,
+    OPT_LAYER,
+    OPT_COMPRESS,
+    OPT_LEVEL,
+    OPT_NO_PAUSE,
+    OPT_LAZY,
+    OPT_LOG_SIZE,
+    OPT_LOG_RATE,
+    OPT_FOLLOW,
+    OPT_TIMESTAMPS,
+    OPT_FORCE,
+    OPT_KSM,
+    OPT_THP,
+    OPT_NUMA,
+    OPT_QOS,
+    OPT_CPU_PERIOD,
+    OPT_CPU_BURST,
+    OPT_LISTEN,
+    OPT_INTERVAL
+};
+
+static const struct option long_options[] = {
+    {"memory", required_argument, NULL, OPT_MEMORY},
+    {"memory-high", required_argument, NULL, OPT_MEMORY_HIGH},
+    {"memory-low", required_argument, NULL, OPT_MEMORY_LOW},
+    {"memory-min", required_argument, NULL, OPT_MEMORY_MIN},
+    {"memory-swap", required_argument, NULL, OPT_MEMORY_SWAP},
+    {"memory-zswap", required_argument, NULL, OPT_MEMORY_ZSWAP},
+    {"no-oom-group", no_argument, NULL, OPT_NO_OOM_GROUP},
+    {"cpu-shares", required_argument, NULL, OPT_CPU_SHARES},
+    {"cpu-quota", required_argument, NULL, OPT_CPU_QUOTA},
+    {"cpu-period", required_argument, NULL, OPT_CPU_PERIOD},
+    {"cpu-burst", required_argument, NULL, OPT_CPU_BURST},
+    {"pids", required_argument, NULL, OPT_PIDS},
+    {"io-max", required_argument, NULL, OPT_IO_MAX},
+    {"cpuset", required_argument, NULL, OPT_CPUSET},
+    {"cpuset-domain", required_argument, NULL, OPT_CPUSET_DOMAIN},
+    {"cpu-autoscale", required_argument, NULL, OPT_CPU_AUTOSCALE},
+    {"cpu-autoscale-target", required_argument, NULL, OPT_CPU_AUTOSCALE_TARGET},
+    {"cpu-autoscale-interval", required_argument, NULL, OPT_CPU_AUTOSCALE_INTERVAL},
+    {"no-virtual-proc", no_argument, NULL, OPT_NO_VIRTUAL_PROC},
+    {"rootfs", required_argument, NULL, OPT_ROOTFS},
+    {"detach", no_argument, NULL, OPT_DETACH},
+    {"init", no_argument, NULL, OPT_INIT},
+    {"net", required_argument, NULL, OPT_NET},
+    {"volume", required_argument, NULL, 'v'},
+    {"tmpfs", required_argument, NULL, OPT_TMPFS},
+    {"image", required_argument, NULL, OPT_IMAGE},
+    {"jobs", required_argument, NULL, 'j'},
+    {"output", required_argument, NULL, 'o'},
+    {"layer", no_argument, NULL, OPT_LAYER},
+    {"compress", required_argument, NULL, OPT_COMPRESS},
+    {"level", required_argument, NULL, OPT_LEVEL},
+    {"no-pause", no_argument, NULL, OPT_NO_PAUSE},
+    {"lazy", no_argument, NULL, OPT_LAZY},
+    {"log-size", required_argument, NULL, OPT_LOG_SIZE},
+    {"log-rate", required_argument, NULL, OPT_LOG_RATE},
+    {"follow", no_argument, NULL, OPT_FOLLOW},
+    {"timestamps", no_argument, NULL, OPT_TIMESTAMPS},
+    {"force", no_argument, NULL, OPT_FORCE},
+    {"ksm", no_argument, NULL, OPT_KSM},
+    {"thp", required_argument, NULL, OPT_THP},
+    {"numa", required_argument, NULL, OPT_NUMA},
+    {"qos", required_argument, NULL, OPT_QOS},
+    {"listen", required_argument, NULL, OPT_LISTEN},
+    {"interval", required_argument, NULL, OPT_INTERVAL},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+};
+
+// 顯示使用說明
+static void print_usage(const char* prog) {
+    fprintf(stderr, "用法: %s [run] [選項] [命令 [參數...]]  啟動新容器（未指定命令時執行交互式 bash）\n", prog);
+    fprintf(stderr, "      %s update <容器ID> [選項]  調整運行中容器的資源限制\n", prog);
+    fprintf(stderr, "      %s attach <容器ID>         連接到容器的終端 (Ctrl-P Ctrl-Q 分離)\n", prog);
+    fprintf(stderr, "      %s exec <容器ID> 命令 [參數...] 在運行中的容器內執行命令\n", prog);
+    fprintf(stderr, "      %s logs [-f] <容器ID>      顯示容器的輸出日誌 (-f 持續輸出)\n", prog);
+    fprintf(stderr, "      %s ps                      列出運行中的容器\n", prog);
+    fprintf(stderr, "      %s import [-j N] [--lazy] <tar文件> [名稱] 導入 OCI 佈局或 docker save 的鏡像\n", prog);
+    fprintf(stderr, "      %s images                  列出已導入的鏡像\n", prog);
+    fprintf(stderr, "      %s export [選項] <容器ID> [名稱] 把容器的文件系統導出為可導入的 OCI 鏡像\n", prog);
+    fprintf(stderr, "      %s inspect <容器ID>        顯示容器的詳細狀態 (JSON)\n", prog);
+    fprintf(stderr, "      %s metrics [-o 文件 [--interval 秒] | --listen socket] 以 Prometheus 文本格式輸出指標\n\n", prog);
+    fprintf(stderr, "資源限制選項:\n");
+    fprintf(stderr, "  --memory MB             記憶體硬限制 memory.max (預設 512)\n");
+    fprintf(stderr, "  --memory-high MB        記憶體節流閾值 memory.high (預設為 memory.max 的 7/8, 0 為不設置)\n");
+    fprintf(stderr, "  --memory-low MB         盡力保護的記憶體 memory.low\n");
+    fprintf(stderr, "  --memory-min MB         硬保護的記憶體 memory.min\n");
+    fprintf(stderr, "  --memory-swap MB        swap 上限 memory.swap.max (預設 -1 不限制)\n");
+    fprintf(stderr, "  --memory-zswap MB       zswap 上限 memory.zswap.max (預設 -1 不限制)\n");
+    fprintf(stderr, "  --no-oom-group          OOM 時只終止單個進程，而非整個容器\n");
+    fprintf(stderr, "  --cpu-shares N          CPU 份額 (預設 512)\n");
+    fprintf(stderr, "  --cpu-quota US          每個週期的 CPU 配額 (預設 50000, -1 為不限制)\n");
+    fprintf(stderr, "  --cpu-period US         CFS 週期 (預設 100000，範圍 1000-1000000)\n");
+    fprintf(stderr, "  --cpu-burst US          可累積到之後週期使用的未用配額 (cpu.max.burst，不超過配額)\n");
+    fprintf(stderr, "  --pids N                最大進程數 (預設 100)\n");
+    fprintf(stderr, "  --io-max SPEC           I/O 限制，io.max 格式 \"MAJ:MIN rbps=N wbps=N riops=N wiops=N\"\n");
+    fprintf(stderr, "run 選項:\n");
+    fprintf(stderr, "  --cpuset POLICY         CPU 放置策略: none (預設) / shared / exclusive[:N]\n");
+    fprintf(stderr, "  --cpuset-domain LEVEL   放置域粒度: node (預設, NUMA 節點) / llc (共享快取)\n");
+    fprintf(stderr, "  --cpu-autoscale MIN:MAX 根據 cpu.stat 節流統計在 MIN 與 MAX 微秒之間自動調整 CPU 配額\n");
+    fprintf(stderr, "  --cpu-autoscale-target R 目標節流比例 (預設 0.05)\n");
+    fprintf(stderr, "  --cpu-autoscale-interval MS 採樣間隔 (預設 1000)\n");
+    fprintf(stderr, "  --no-virtual-proc       不啟動即時 /proc/meminfo 服務，改用啟動時生成的靜態文件\n");
+    fprintf(stderr, "  --rootfs MODE           rootfs 模式: overlay (預設) / copy / bind\n");
+    fprintf(stderr, "  --image NAME            以導入的鏡像作為 rootfs（OverlayFS），取代基礎 rootfs\n");
+    fprintf(stderr, "  --detach                在背景運行，不連接到目前的終端\n");
+    fprintf(stderr, "  --net MODE              網絡模式: host (預設, 共用主機網絡) / loopback / bridge (%s)\n", NETNS_BRIDGE);
+    fprintf(stderr, "  -v, --volume H:C[:ro]   把主機路徑 H 掛載到容器的 C（不存在時創建目錄，可重複指定）\n");
+    fprintf(stderr, "  --tmpfs C[:MB]          在容器的 C 掛載 tmpfs (預設上限 %d MB，可重複指定)\n", TMPFS_DEFAULT_SIZE_MB);
+    fprintf(stderr, "  --init                  以內建的 init 作為 PID 1，回收孤兒進程並轉發信號\n");
+    fprintf(stderr, "  --qos CLASS             CPU 服務等級: latency-critical / normal (預設) / batch / idle\n");
+    fprintf(stderr, "  --ksm                   允許 KSM 合併容器內所有進程的相同記憶體頁（需主機啟用 KSM）\n");
+    fprintf(stderr, "  --thp MODE              透明大頁: default (沿用主機) / never / madvise (只有 madvise 的區域)\n");
+    fprintf(stderr, "  --numa MODE:NODES       NUMA 記憶體策略: bind / preferred / interleave，例如 bind:0 (bind / interleave 同時設置 cpuset.mems)\n");
+    fprintf(stderr, "  --log-size MB           單個日誌文件上限，超過後輪替 (預設 10, 0 為不記錄)\n");
+    fprintf(stderr, "  --log-rate KB           每秒最多記錄的輸出量，超過時容器的輸出被阻塞 (預設 1024, 0 為不限制)\n");
+    fprintf(stderr, "logs 選項:\n");
+    fprintf(stderr, "  -f, --follow            持續輸出新的日誌直到容器退出\n");
+    fprintf(stderr, "  --timestamps            在每行前加上時間戳\n");
+    fprintf(stderr, "import 選項:\n");
+    fprintf(stderr, "  -j, --jobs N            同時解壓的層數 (預設為 CPU 數量)\n");
+    fprintf(stderr, "  --lazy                  可隨機讀取的層不解包，運行時按需讀取\n");
+    fprintf(stderr, "export 選項:\n");
+    fprintf(stderr, "  -o, --output FILE       輸出文件 (預設為標準輸出，必須重定向到文件)\n");
+    fprintf(stderr, "  --layer                 參數是層存儲中的層 diff_id（前綴），而非容器 ID\n");
+    fprintf(stderr, "  --compress FORMAT       層的壓縮格式: zstd (預設) / gzip / none\n");
+    fprintf(stderr, "  --level N               壓縮等級 (預設 zstd 3, gzip 6)\n");
+    fprintf(stderr, "  -j, --jobs N            zstd 壓縮線程數 (預設為 CPU 數量)\n");
+    fprintf(stderr, "  --no-pause              導出期間不凍結容器（快照可能不一致）\n");
+    fprintf(stderr, "  --lazy                  生成可隨機讀取的層（zstd，單線程），可用 import --lazy 延遲載入\n");
+    fprintf(stderr, "update 選項:\n");
+    fprintf(stderr, "  --force                 允許把 memory.max / pids.max 縮小到目前用量以下\n");
+}
+
+// 解析整數選項值：整個字串必須是十進位整數，"1g"、空字串或超出範圍都視為無效，而不是靜默變成 0
+static int parse_int_arg(const char* arg, long* value) {
+    char* end;
+    errno = 0;
+    long v = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || errno == ERANGE || v < INT_MIN || v > INT_MAX) {
+        return -1;
+    }
+    *value = v;
+    return 0;
+}
+
+// 取得短選項值對應的長選項名稱（用於錯誤訊息）
+static const char* option_name(int opt) {
+    for (const struct option* o = long_options; o->name; o++) {
+        if (o->val == opt) {
+            return o->name;
+        }
+    }
+    return "?";
+}
+
+// 解析資源限制相關的選項
+// @return 1 已處理，0 不是資源限制選項，-1 選項值無效（已輸出錯誤信息）
+static int parse_limit_option(int opt, const char* arg, cgroup_limits_t* limits, unsigned int* mask) {
+    long value = 0;
+    
+    switch (opt) {
+    case OPT_MEMORY:
+    case OPT_MEMORY_HIGH:
+    case OPT_MEMORY_LOW:
+    case OPT_MEMORY_MIN:
+    case OPT_MEMORY_SWAP:
+    case OPT_MEMORY_ZSWAP:
+    case OPT_CPU_SHARES:
+    case OPT_CPU_QUOTA:
+    case OPT_CPU_PERIOD:
+    case OPT_CPU_BURST:
+    case OPT_PIDS:
+        if (parse_int_arg(arg, &value) != 0) {
+            fprintf(stderr, "錯誤: --%s 需要整數值: %s\n", option_name(opt), arg);
+            return -1;
+        }
+        break;
+    default:
+        break;
+    }
+    
+    switch (opt) {
+    case OPT_MEMORY:
+        limits->memory_limit_mb = value;
+        *mask |= CGROUP_SET_MEMORY_MAX;
+        break;
+    case OPT_MEMORY_HIGH:
+        limits->memory_high_mb = value;
+        *mask |= CGROUP_SET_MEMORY_HIGH;
+        break;
+    case OPT_MEMORY_LOW:
+        limits->memory_low_mb = value;
+        *mask |= CGROUP_SET_MEMORY_LOW;
+        break;
+    case OPT_MEMORY_MIN:
+        limits->memory_min_mb = value;
+        *mask |= CGROUP_SET_MEMORY_MIN;
+        break;
+    case OPT_MEMORY_SWAP:
+        limits->memory_swap_max_mb = value;
+        *mask |= CGROUP_SET_MEMORY_SWAP;
+        break;
+    case OPT_MEMORY_ZSWAP:
+        limits->memory_zswap_max_mb = value;
+        *mask |= CGROUP_SET_MEMORY_ZSWAP;
+        break;
+    case OPT_NO_OOM_GROUP:
+        limits->memory_oom_group = 0;
+        *mask |= CGROUP_SET_OOM_GROUP;
+        break;
+    case OPT_CPU_SHARES:
+        limits->cpu_shares = (int)value;
+        *mask |= CGROUP_SET_CPU_SHARES;
+        break;
+    case OPT_CPU_QUOTA:
+        limits->cpu_quota_us = (int)value;
+        *mask |= CGROUP_SET_CPU_QUOTA;
+        break;
+    case OPT_CPU_PERIOD:
+        limits->cpu_period_us = (int)value;
+        *mask |= CGROUP_SET_CPU_PERIOD;
+        break;
+    case OPT_CPU_BURST:
+        limits->cpu_burst_us = (int)value;
+        *mask |= CGROUP_SET_CPU_BURST;
+        break;
+    case OPT_PIDS:
+        limits->pids_max = (int)value;
+        *mask |= CGROUP_SET_PIDS;
+        break;
+    case OPT_IO_MAX:
+        snprintf(limits->io_max, sizeof(limits->io_max), "%s", arg);
+        *mask |= CGROUP_SET_IO;
+        break;
+    default:
+        return 0;
+    }
+    return 1;
+}
+
+// update 子命令：就地修改運行中容器的 cgroup 限制
+static int cmd_update(int argc, char* argv[]) {
+    cgroup_limits_t limits;
+    unsigned int mask = 0;
+    int force = 0;
+    int opt;
+    
+    memset(&limits, 0, sizeof(limits));
+    while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        int handled = parse_limit_option(opt, optarg, &limits, &mask);
+        if (handled < 0) {
+            return 1;
+        }
+        if (handled) {
+            continue;
+        }
+        if (opt == OPT_FORCE) {
+            force = 1;
+        } else if (opt == 'h') {
+            print_usage("main");
+            return 0;
+        } else {
+            fprintf(stderr, "錯誤: update 不支援此選項\n");
+            return 1;
+        }
+    }
+    
+    if (optind >= argc) {
+        fprintf(stderr, "錯誤: 請指定容器 ID\n");
+        return 1;
+    }
+    if (mask == 0) {
+        fprintf(stderr, "錯誤: 請至少指定一項要修改的限制\n");
+        return 1;
+    }
+    
+    char cgroup_name[128];
+    snprintf(cgroup_name, sizeof(cgroup_name), "%s%s", CGROUP_NAME_PREFIX, argv[optind]);
+    
+    if (update_cgroup_limits(cgroup_name, &limits, mask, force) != 0) {
+        return 1;
+    }
+    printf("容器 %s 的資源限制已更新\n", argv[optind]);
+    
+    // 同步狀態表中的限制
+    container_record_t record;
+    if (state_find(argv[optind], &record) == 0) {
+        if (mask & CGROUP_SET_MEMORY_MAX) record.memory_limit_mb = limits.memory_limit_mb;
+        if (mask & CGROUP_SET_CPU_SHARES) record.cpu_shares = limits.cpu_shares;
+        if (mask & CGROUP_SET_CPU_QUOTA) record.cpu_quota_us = limits.cpu_quota_us;
+        if (mask & CGROUP_SET_CPU_PERIOD) record.cpu_period_us = limits.cpu_period_us;
+        if (mask & CGROUP_SET_CPU_BURST) {
+            record.cpu_burst_us = limits.cpu_burst_us;
+        } else if (mask & CGROUP_SET_CPU_QUOTA && limits.cpu_quota_us > 0 && record.cpu_burst_us > limits.cpu_quota_us) {
+            record.cpu_burst_us = limits.cpu_quota_us;  // 縮小配額時突發配額已一併降低
+        }
+        if (mask & CGROUP_SET_PIDS) record.pids_max = limits.pids_max;
+        state_update(&record);
+    }
+    return 0;
+}
+
+// 把秒數格式化為簡短的持續時間（例如 "3m"、"2h"）
+static void format_duration(long seconds, char* buf, size_t size) {
+    if (seconds < 60) {
+        snprintf(buf, size, "%lds", seconds);
+    } else if (seconds < 3600) {
+        snprintf(buf, size, "%ldm", seconds / 60);
+    } else if (seconds < 86400) {
+        snprintf(buf, size, "%ldh", seconds / 3600);
+    } else {
+        snprintf(buf, size, "%ldd", seconds / 86400);
+    }
+}
+
+// attach 子命令：把目前的終端連接到背景運行的容器
+static int cmd_attach(int argc, char* argv[]) {
+    container_record_t record;
+    
+    if (argc < 2) {
+        fprintf(stderr, "錯誤: 請指定容器 ID\n");
+        return 1;
+    }
+    // 支援 ID 前綴
+    const char* id = state_find(argv[1], &record) == 0 ? record.id : argv[1];
+    int result = console_attach(id);
+    if (result == -1) {
+        return 1;
+    }
+    if (result == 0) {
+        printf("\n 已從容器 %s 分離\n", id);
+    }
+    return 0;
+}
+
+// exec 子命令：加入運行中容器的命名空間、cgroup 和根目錄後執行命令
+// 只需一次 pidfd_open + setns，不經過任何容器啟動流程，適合頻繁的健康檢查
+static int cmd_exec(int argc, char* argv[]) {
+    container_record_t record;
+    char path[64];
+    
+    if (argc < 3) {
+        fprintf(stderr, "錯誤: 用法 exec <容器ID> 命令 [參數...]\n");
+        return 1;
+    }
+    if (state_find(argv[1], &record) != 0 || !state_is_alive(&record) || record.status != CONTAINER_RUNNING) {
+        fprintf(stderr, "錯誤: 找不到運行中的容器 %s\n", argv[1]);
+        return 1;
+    }
+    
+    // 先取得 pidfd 和根目錄，再核對啟動時間：若 PID 已被重用，這兩者都不屬於容器
+    int pidfd = (int)syscall(SYS_pidfd_open, record.pid, 0);
+    snprintf(path, sizeof(path), "/proc/%d/root", record.pid);
+    int root_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (pidfd == -1 || root_fd == -1 || read_pid_starttime(record.pid) != record.pid_starttime) {
+        fprintf(stderr, "錯誤: 容器 %s 已退出\n", record.id);
+        goto fail;
+    }
+    
+    // 在加入 user 命名空間之前（仍有主機權限時）加入 cgroup，之後 fork 的子進程繼承
+    if (join_cgroup(getpid(), record.cgroup_name) != 0) {
+        fprintf(stderr, "警告: 無法加入容器的 cgroup，命令將不受容器的資源限制\n");
+    }
+    // 與容器 init 相同，KSM 標記同樣需要在加入 user 命名空間之前設置
+    if (record.ksm && ksm_set_merge(1) != 0) {
+        fprintf(stderr, "警告: 無法啟用 KSM 合併: %s\n", strerror(errno));
+    }
+    memory_policy_t memory_policy = {(thp_mode_t)record.thp_mode, (numa_mode_t)record.numa_mode, ""};
+    snprintf(memory_policy.numa_nodes, sizeof(memory_policy.numa_nodes), "%s", record.numa_nodes);
+    if (memtune_apply(&memory_policy) != 0 || qos_apply_sched((qos_class_t)record.qos) != 0) {
+        goto fail;
+    }
+    if (enter_container_namespaces(pidfd, root_fd) != 0) {
+        perror("setns");
+        goto fail;
+    }
+    close(pidfd);
+    close(root_fd);
+    
+    // 加入的 PID 命名空間只對子進程生效
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        environ = container_env;
+        execvp(argv[2], argv + 2);
+        fprintf(stderr, "錯誤: 無法執行 %s: %s\n", argv[2], strerror(errno));
+        _exit(errno == ENOENT ? 127 : 126);
+    }
+    
+    int status;
+    if (waitpid(pid, &status, 0) == -1) {
+        perror("waitpid");
+        return 1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+fail:
+    // 只有其中一個打開成功，或核對 / 設置失敗時，關閉已經打開的 pidfd 與根目錄
+    if (pidfd != -1) {
+        close(pidfd);
+    }
+    if (root_fd != -1) {
+        close(root_fd);
+    }
+    return 1;
+}
+
+// logs 子命令：輸出容器的日誌
+static int cmd_logs(int argc, char* argv[]) {
+    container_record_t record;
+    int follow = 0;
+    int timestamps = 0;
+    int opt;
+    
+    while ((opt = getopt_long(argc, argv, "fh", long_options, NULL)) != -1) {
+        if (opt == 'f' || opt == OPT_FOLLOW) {
+            follow = 1;
+        } else if (opt == OPT_TIMESTAMPS) {
+            timestamps = 1;
+        } else if (opt == 'h') {
+            print_usage("main");
+            return 0;
+        } else {
+            fprintf(stderr, "錯誤: logs 不支援此選項\n");
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "錯誤: 請指定容器 ID\n");
+        return 1;
+    }
+    // 運行中的容器支援 ID 前綴；已退出的容器需要完整 ID
+    const char* id = state_find(argv[optind], &record) == 0 ? record.id : argv[optind];
+    return log_print(id, follow, timestamps) == 0 ? 0 : 1;
+}
+
+// ps 子命令：列出狀態表中的容器
+static int cmd_ps(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    static container_record_t records[STATE_TABLE_CAPACITY];
+    int count = state_list(records, STATE_TABLE_CAPACITY);
+    if (count < 0) {
+        fprintf(stderr, "錯誤: 無法讀取狀態表 %s\n", STATE_TABLE_PATH);
+        return 1;
+    }
+    
+    time_t now = time(NULL);
+    printf("%-16s  %-8s  %-8s  %-7s  %-8s  %-8s  %s\n",
+           "CONTAINER ID", "PID", "STATUS", "ROOTFS", "MEMORY", "CPU", "UPTIME");
+    for (int i = 0; i < count; i++) {
+        container_record_t* r = &records[i];
+        char memory[32], cpu[32], uptime[32];
+        
+        // runtime 崩潰時記錄會殘留，顯示為 dead（下次啟動容器時回收）
+        const char* status = state_is_alive(r) ? container_status_name(r->status) : "dead";
+        snprintf(memory, sizeof(memory), "%ldM", (long)r->memory_limit_mb);
+        if (r->cpu_quota_us > 0) {
+            snprintf(cpu, sizeof(cpu), "%d%%", (int)((long long)r->cpu_quota_us * 100 / r->cpu_period_us));
+        } else {
+            snprintf(cpu, sizeof(cpu), "max");
+        }
+        format_duration((long)(now - r->started_at), uptime, sizeof(uptime));
+        printf("%-16s  %-8d  %-8s  %-7s  %-8s  %-8s  %s\n",
+               r->id, r->pid, status, rootfs_mode_names[r->rootfs_mode % 3], memory, cpu, uptime);
+    }
+    return 0;
+}
+
+// inspect 子命令：以 JSON 輸出單個容器的完整記錄
+static int cmd_inspect(int argc, char* argv[]) {
+    container_record_t r;
+    
+    if (argc < 2) {
+        fprintf(stderr, "錯誤: 請指定容器 ID\n");
+        return 1;
+    }
+    if (state_find(argv[1], &r) != 0) {
+        fprintf(stderr, "錯誤: 找不到容器 %s（或 ID 前綴不唯一）\n", argv[1]);
+        return 1;
+    }
+    
+    int alive = state_is_alive(&r);
+    printf("{\n");
+    printf("  \"id\": \"%s\",\n", r.id);
+    printf("  \"status\": \"%s\",\n", alive ? container_status_name(r.status) : "dead");
+    printf("  \"pid\": %d,\n", r.pid);
+    printf("  \"pid_starttime\": %llu,\n", (unsigned long long)r.pid_starttime);
+    printf("  \"pidfd_path\": \"%s\",\n", r.pidfd_path);
+    printf("  \"runtime_pid\": %d,\n", r.runtime_pid);
+    printf("  \"started_at\": %lld,\n", (long long)r.started_at);
+    if (r.status == CONTAINER_EXITED) {
+        printf("  \"exit_code\": %d,\n", r.exit_code);
+    }
+    printf("  \"rootfs_mode\": \"%s\",\n", rootfs_mode_names[r.rootfs_mode % 3]);
+    printf("  \"rootfs\": \"%s\",\n", r.rootfs);
+    printf("  \"image\": \"%s\",\n", r.image);
+    printf("  \"cgroup\": \"%s\",\n", r.cgroup_name);
+    printf("  \"qos\": \"%s\",\n", qos_profile((qos_class_t)r.qos)->name);
+    printf("  \"limits\": {\n");
+    printf("    \"memory_mb\": %lld,\n", (long long)r.memory_limit_mb);
+    printf("    \"cpu_shares\": %d,\n", r.cpu_shares);
+    printf("    \"cpu_quota_us\": %d,\n", r.cpu_quota_us);
+    printf("    \"cpu_period_us\": %d,\n", r.cpu_period_us);
+    printf("    \"cpu_burst_us\": %d,\n", r.cpu_burst_us);
+    printf("    \"pids_max\": %d,\n", r.pids_max);
+    printf("    \"cpuset_cpus\": \"%s\"\n", r.cpuset_cpus);
+    printf("  },\n");
+    printf("  \"network\": {\"mode\": \"%s\", \"address\": \"%s\"},\n", netns_mode_name(r.net_mode), r.address);
+    printf("  \"memory_policy\": {\"thp\": \"%s\", \"numa\": \"%s\", \"nodes\": \"%s\"},\n",
+           memtune_thp_name((thp_mode_t)r.thp_mode), memtune_numa_name((numa_mode_t)r.numa_mode), r.numa_nodes);
+    ksm_stats_t ksm;
+    if (r.ksm && alive && ksm_container_stats(r.cgroup_name, &ksm) == 0) {
+        printf("  \"ksm\": {\"enabled\": true, \"merging_pages\": %lld, \"profit\": %lld, "
+               "\"host_pages_sharing\": %lld, \"host_general_profit\": %lld}\n",
+               (long long)ksm.merging_pages, (long long)ksm.process_profit,
+               (long long)ksm_read_global("pages_sharing"), (long long)ksm_read_global("general_profit"));
+    } else {
+        printf("  \"ksm\": {\"enabled\": %s}\n", r.ksm ? "true" : "false");
+    }
+    printf("}\n");
+    return 0;
+}
+
+// import 子命令：導入鏡像到本地的層存儲
+static int cmd_import(int argc, char* argv[]) {
+    int jobs = 0;
+    int lazy = 0;
+    int opt;
+    
+    while ((opt = getopt_long(argc, argv, "hj:", long_options, NULL)) != -1) {
+        if (opt == 'j') {
+            jobs = atoi(optarg);
+            if (jobs < 1) {
+                fprintf(stderr, "錯誤: 並行任務數至少為 1\n");
+                return 1;
+            }
+        } else if (opt == OPT_LAZY) {
+            lazy = 1;
+        } else if (opt == 'h') {
+            print_usage("main");
+            return 0;
+        } else {
+            fprintf(stderr, "錯誤: import 不支援此選項\n");
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "錯誤: 請指定鏡像的 tar 文件\n");
+        return 1;
+    }
+    return image_import(argv[optind], optind + 1 < argc ? argv[optind + 1] : NULL, jobs, lazy) == 0 ? 0 : 1;
+}
+
+// export 子命令：把運行中容器（或層存儲中的一層）導出為單層的 OCI 鏡像
+static int cmd_export(int argc, char* argv[]) {
+    export_options_t options = {CODEC_ZSTD, 0, 0, 0, 0, 0, NULL};
+    const char* output = NULL;
+    int layer = 0;
+    int pause = 1;
+    int opt;
     
-    // 檢查並創建基礎 rootfs（如果需要）
-    if (!check_base_rootfs_exists()) {
+    while ((opt = getopt_long(argc, argv, "ho:j:", long_options, NULL)) != -1) {
+        if (opt == 'o') {
+            output = optarg;
+        } else if (opt == 'j') {
+            options.threads = atoi(optarg);
+            if (options.threads < 1) {
+                fprintf(stderr, "錯誤: 壓縮線程數至少為 1\n");
+                return 1;
+            }
+        } else if (opt == OPT_LAYER) {
+            layer = 1;
+        } else if (opt == OPT_COMPRESS) {
+            if (codec_parse(optarg, &options.codec) != 0) {
+                fprintf(stderr, "錯誤: 不支援的壓縮格式 %s（可用 zstd、gzip、none）\n", optarg);
+                return 1;
+            }
+        } else if (opt == OPT_LEVEL) {
+            options.level = atoi(optarg);
+        } else if (opt == OPT_NO_PAUSE) {
+            pause = 0;
+        } else if (opt == OPT_LAZY) {
+            options.lazy = 1;
+        } else if (opt == 'h') {
+            print_usage("main");
+            return 0;
+        } else {
+            fprintf(stderr, "錯誤: export 不支援此選項\n");
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "錯誤: 請指定容器 ID（或以 --layer 指定層）\n");
+        return 1;
+    }
+    if (!codec_available(options.codec)) {
+        fprintf(stderr, "錯誤: 系統中沒有 %s 壓縮庫\n", codec_name(options.codec));
+        return 1;
+    }
+    if (options.threads == 0) {
+        options.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    
+    char path[4096];
+    char default_name[64];
+    container_record_t record;
+    int root_fd;
+    int frozen = 0;
+    if (layer) {
+        if (image_layer_path(argv[optind], path, sizeof(path)) != 0) {
+            fprintf(stderr, "錯誤: 找不到層 %s（或前綴不唯一）\n", argv[optind]);
+            return 1;
+        }
+        root_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        // 層目錄不會被修改，可以安全地 mmap；其中的刪除標記轉回 .wh. 文件
+        options.overlay_layer = 1;
+        options.use_mmap = 1;
+        snprintf(default_name, sizeof(default_name), "layer-%.12s", strrchr(path, '/') + 1);
+    } else {
+        if (state_find(argv[optind], &record) != 0 || !state_is_alive(&record) || record.status != CONTAINER_RUNNING) {
+            fprintf(stderr, "錯誤: 找不到運行中的容器 %s\n", argv[optind]);
+            return 1;
+        }
+        // 經由容器 init 的根目錄讀取：OverlayFS 合併後的視圖，與容器內看到的一致
+        snprintf(path, sizeof(path), "/proc/%d/root", record.pid);
+        root_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (root_fd != -1 && read_pid_starttime(record.pid) != record.pid_starttime) {
+            close(root_fd);
+            root_fd = -1;
+            errno = ESRCH;
+        }
+        snprintf(default_name, sizeof(default_name), "export-%s", record.id);
+    }
+    if (root_fd == -1) {
+        fprintf(stderr, "錯誤: 無法打開 %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    options.name = optind + 1 < argc ? argv[optind + 1] : default_name;
+    
+    int out_fd = STDOUT_FILENO;
+    if (output) {
+        out_fd = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (out_fd == -1) {
+            fprintf(stderr, "錯誤: 無法創建 %s: %s\n", output, strerror(errno));
+            close(root_fd);
+            return 1;
+        }
+    } else if (isatty(STDOUT_FILENO)) {
+        fprintf(stderr, "錯誤: 不能把鏡像輸出到終端，請使用 -o 或重定向到文件\n");
+        close(root_fd);
+        return 1;
+    }
+    
+    // 凍結容器得到一致的快照；凍結期間文件不會被修改，也就可以安全地 mmap
+    if (!layer && pause) {
+        if (freeze_cgroup(record.cgroup_name, 1) == 0) {
+            frozen = 1;
+            options.use_mmap = 1;
+        } else {
+            fprintf(stderr, "警告: 無法凍結容器，導出期間被修改的文件可能不一致\n");
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+    int result = export_image(root_fd, out_fd, &options);
+    if (frozen && freeze_cgroup(record.cgroup_name, 0) != 0) {
+        fprintf(stderr, "錯誤: 無法解凍容器 %s，請手動寫入 cgroup.freeze\n", record.id);
+        result = -1;
+    }
+    close(root_fd);
+    if (output) {
+        if (close(out_fd) == -1) {
+            result = -1;
+        }
+        if (result != 0) {
+            unlink(output);
+        }
+    }
+    return result == 0 ? 0 : 1;
+}
+
+// metrics 子命令：輸出一次指標，或定期寫入文件，或在 Unix socket 上提供給抓取者
+static int cmd_metrics(int argc, char* argv[]) {
+    const char* output = NULL;
+    const char* listen_path = NULL;
+    int interval = 0;
+    int opt;
+    
+    while ((opt = getopt_long(argc, argv, "ho:", long_options, NULL)) != -1) {
+        if (opt == 'o') {
+            output = optarg;
+        } else if (opt == OPT_LISTEN) {
+            listen_path = optarg;
+        } else if (opt == OPT_INTERVAL) {
+            interval = atoi(optarg);
+            if (interval < 1) {
+                fprintf(stderr, "錯誤: 寫入間隔至少為 1 秒\n");
+                return 1;
+            }
+        } else if (opt == 'h') {
+            print_usage("main");
+            return 0;
+        } else {
+            fprintf(stderr, "錯誤: metrics 不支援此選項\n");
+            return 1;
+        }
+    }
+    if (listen_path) {
+        return metrics_serve(listen_path) == 0 ? 0 : 1;
+    }
+    if (!output) {
+        if (metrics_render(stdout) != 0) {
+            fprintf(stderr, "錯誤: 無法讀取指標表 %s\n", METRICS_TABLE_PATH);
+            return 1;
+        }
+        return 0;
+    }
+    // 定期寫入時交給 node_exporter 的 textfile collector 之類的工具讀取
+    for (;;) {
+        if (metrics_write_file(output) != 0) {
+            return 1;
+        }
+        if (interval == 0) {
+            return 0;
+        }
+        sleep(interval);
+    }
+}
+
+// run 子命令：創建並運行新容器
+static int cmd_run(int argc, char* argv[]) {
+    // 配置資源限制（可被命令列選項覆蓋）
+    static cgroup_limits_t limits = {
+        .memory_limit_mb = 512,    // 限制記憶體為 512 MB
+        .memory_high_mb = -1,      // 未指定時取 memory.max 的 7/8，超過後節流回收而不是直接 OOM
+        .memory_swap_max_mb = -1,  // swap 不另外限制（只在指定 --memory-swap 時寫入）
+        .memory_zswap_max_mb = -1, // zswap 不另外限制
+        .memory_oom_group = 1,     // OOM 時整個容器一起終止
+        .cpu_shares = 512,         // CPU 份額為 512 (預設的一半)
+        .cpu_quota_us = 50000,     // CPU 配額為 50% (50000/100000)
+        .cpu_period_us = CGROUP_DEFAULT_CPU_PERIOD_US,
+        .pids_max = 100            // 最多 100 個進程
+    };
+    cpuset_request_t cpuset_request = {CPUSET_POLICY_NONE, CPUSET_DOMAIN_NODE, 0};
+    cpu_autoscale_config_t autoscale;
+    virtual_proc_t vproc = {-1, "", ""};
+    lazy_mount_t lazy = {-1, "", 0};
+    int use_virtual_proc = 1;
+    int rootfs_mode = 2;
+    int detach = 0;
+    int use_init = 0;
+    int ksm = 0;
+    memory_policy_t memory_policy = {THP_DEFAULT, NUMA_DEFAULT, ""};
+    qos_class_t qos = QOS_NORMAL;
+    net_mode_t net_mode = NET_HOST;
+    static volume_t volumes[MAX_VOLUMES];
+    int volume_count = 0;
+    const char* image = NULL;
+    long log_size = LOG_DEFAULT_MAX_SIZE;
+    long log_rate = LOG_DEFAULT_RATE;
+    unsigned int mask = 0;
+    
+    cpu_autoscale_defaults(&autoscale);
+    
+    // "+"：遇到第一個非選項參數就停止，之後都屬於容器內的命令
+    int opt;
+    while ((opt = getopt_long(argc, argv, "+hv:", long_options, NULL)) != -1) {
+        int handled = parse_limit_option(opt, optarg, &limits, &mask);
+        if (handled < 0) {
+            return 1;
+        }
+        if (handled) {
+            continue;
+        }
+        switch (opt) {
+        case OPT_CPUSET:
+            if (cpuset_parse_policy(optarg, &cpuset_request) != 0) {
+                fprintf(stderr, "錯誤: 無效的 CPU 放置策略: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_CPUSET_DOMAIN:
+            if (strcmp(optarg, "node") == 0) {
+                cpuset_request.level = CPUSET_DOMAIN_NODE;
+            } else if (strcmp(optarg, "llc") == 0) {
+                cpuset_request.level = CPUSET_DOMAIN_LLC;
+            } else {
+                fprintf(stderr, "錯誤: 無效的放置域粒度: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_CPU_AUTOSCALE:
+            if (cpu_autoscale_parse_range(optarg, &autoscale) != 0) {
+                fprintf(stderr, "錯誤: 無效的配額範圍: %s（格式 MIN:MAX，MIN 至少 1000）\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_CPU_AUTOSCALE_TARGET:
+            autoscale.target_ratio = atof(optarg);
+            if (autoscale.target_ratio <= 0 || autoscale.target_ratio >= 1) {
+                fprintf(stderr, "錯誤: 目標節流比例必須在 0 與 1 之間\n");
+                return 1;
+            }
+            break;
+        case OPT_CPU_AUTOSCALE_INTERVAL:
+            autoscale.interval_ms = atoi(optarg);
+            if (autoscale.interval_ms < 10) {
+                fprintf(stderr, "錯誤: 採樣間隔至少為 10 毫秒\n");
+                return 1;
+            }
+            break;
+        case OPT_NO_VIRTUAL_PROC:
+            use_virtual_proc = 0;
+            break;
+        case OPT_DETACH:
+            detach = 1;
+            break;
+        case OPT_INIT:
+            use_init = 1;
+            break;
+        case OPT_KSM:
+            ksm = 1;
+            break;
+        case OPT_QOS:
+            if (qos_parse(optarg, &qos) != 0) {
+                fprintf(stderr, "錯誤: 無效的服務等級: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_THP:
+            if (memtune_parse_thp(optarg, &memory_policy.thp) != 0) {
+                fprintf(stderr, "錯誤: 無效的透明大頁模式: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_NUMA:
+            if (memtune_parse_numa(optarg, &memory_policy) != 0) {
+                fprintf(stderr, "錯誤: 無效的 NUMA 記憶體策略: %s（格式 bind|preferred|interleave:節點列表）\n", optarg);
+                return 1;
+            }
+            break;
+        case OPT_NET:
+            if (netns_parse_mode(optarg, &net_mode) != 0) {
+                fprintf(stderr, "錯誤: 無效的網絡模式: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'v':
+        case OPT_TMPFS:
+            if (volume_count >= MAX_VOLUMES) {
+                fprintf(stderr, "錯誤: 最多只能指定 %d 個卷\n", MAX_VOLUMES);
+                return 1;
+            }
+            if ((opt == 'v' ? volume_parse_bind(optarg, &volumes[volume_count])
+                            : volume_parse_tmpfs(optarg, &volumes[volume_count])) != 0) {
+                fprintf(stderr, "錯誤: 無效的卷: %s\n", optarg);
+                return 1;
+            }
+            volume_count++;
+            break;
+        case OPT_IMAGE:
+            image = optarg;
+            break;
+        case OPT_LOG_SIZE:
+            log_size = atol(optarg) * 1024 * 1024;
+            break;
+        case OPT_LOG_RATE:
+            log_rate = atol(optarg) * 1024;
+            break;
+        case OPT_ROOTFS:
+            for (rootfs_mode = 2; rootfs_mode >= 0; rootfs_mode--) {
+                if (strcmp(optarg, rootfs_mode_names[rootfs_mode]) == 0) {
+                    break;
+                }
+            }
+            if (rootfs_mode < 0) {
+                fprintf(stderr, "錯誤: 無效的 rootfs 模式: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (limits.memory_high_mb < 0) {
+        limits.memory_high_mb = limits.memory_limit_mb * 7 / 8;
+    }
+    qos_apply_limits(qos, &limits, mask);
+    if (validate_cgroup_limits(&limits) != 0) {
+        return 1;
+    }
+    if (ksm && !ksm_running()) {
+        fprintf(stderr, "警告: 主機的 KSM 未運行（%s/run 不為 1），頁面不會被合併\n", KSM_SYSFS_DIR);
+    }
+    metrics_launch_begin();
+    
+    // 檢查並創建基礎 rootfs（如果需要）；使用導入的鏡像時不需要基礎 rootfs
+    static char lowerdir[IMAGE_LOWERDIR_MAX];
+    if (image) {
+        if (rootfs_mode != 2) {
+            fprintf(stderr, "錯誤: --image 只支援 overlay 模式\n");
+            return 1;
+        }
+        int layers = image_lowerdir(image, lowerdir, sizeof(lowerdir));
+        if (layers < 0) {
+            fprintf(stderr, "錯誤: 找不到鏡像 %s（或其層已損壞），請先使用 import 導入\n", image);
+            metrics_launch_failed(METRICS_FAIL_IMAGE);
+            return 1;
+        }
+        printf(" 使用鏡像: %s (%d 層)\n\n", image, layers);
+    } else if (!check_base_rootfs_exists()) {
         // printf("⚠️  未找到基礎容器映像\n");
         // printf("提示: 這是首次運行，需要創建基礎映像（約需 10-30 秒）\n");
         // printf("      後續容器啟動將會非常快速\n\n");
@@ -316,6 +1345,7 @@ int main() {
         
         if (create_base_rootfs() != 0) {
             fprintf(stderr, "錯誤: 創建基礎 rootfs 失敗\n");
+            metrics_launch_failed(METRICS_FAIL_IMAGE);
             return 1;
         }
     } else {
@@ -324,34 +1354,172 @@ int main() {
     
     // printf("正在創建容器...\n");
     
-    // 生成唯一的容器 ID（使用當前時間戳和進程ID）
-    int container_id = (int)time(NULL) % 100000 + getpid() % 1000;
+    // 分配唯一的容器 ID（64 位隨機數，以 mkdir 原子預留，並行啟動也不會衝突）
+    char container_id[CONTAINER_ID_LEN + 1];
+    if (allocate_container_id(container_id, sizeof(container_id)) != 0) {
+        fprintf(stderr, "錯誤: 無法分配容器 ID\n");
+        metrics_launch_failed(METRICS_FAIL_ID);
+        return 1;
+    }
+    printf(" 容器 ID: %s\n", container_id);
+    metrics_phase_end(METRICS_PHASE_PREPARE);
     
-    // printf("容器 ID: %d\n", container_id);
+    // 分配 pty 後分成兩個進程：背景的監控進程負責容器的整個生命週期，
+    // 前台進程只是一個 attach 客戶端，分離或終端關閉都不會影響容器
+    console_t console = {.relay_pid = -1, .master = -1, .slave = -1, .log.fd = -1};
+    int ready_pipe[2] = {-1, -1};
+    if (console_open(&console, container_id) == 0 && pipe(ready_pipe) == 0) {
+        fflush(stdout);
+        pid_t monitor = fork();
+        if (monitor == -1) {
+            perror("fork");
+            metrics_launch_failed(METRICS_FAIL_FORK);
+            goto fail;
+        }
+        if (monitor > 0) {
+            int monitor_status;
+            char ready;
+            close(ready_pipe[1]);
+            close(console.master);
+            close(console.slave);
+            if (read(ready_pipe[0], &ready, 1) != 1) {
+                // 監控進程在容器啟動前就失敗了
+                waitpid(monitor, &monitor_status, 0);
+                return WIFEXITED(monitor_status) ? WEXITSTATUS(monitor_status) : 1;
+            }
+            close(ready_pipe[0]);
+            if (detach) {
+                printf(" 容器在背景運行，使用 '%s attach %s' 連接\n", argv[0], container_id);
+                return 0;
+            }
+            if (console_attach(container_id) == 0) {
+                printf("\n 已從容器 %s 分離，使用 '%s attach %s' 重新連接\n", container_id, argv[0], container_id);
+                return 0;
+            }
+            waitpid(monitor, &monitor_status, 0);
+            return WIFEXITED(monitor_status) ? WEXITSTATUS(monitor_status) : 1;
+        }
+        
+        // 監控進程：脫離終端的會話，終端關閉時不會收到 SIGHUP
+        close(ready_pipe[0]);
+        metrics_adopt();
+        setsid();
+        signal(SIGHUP, SIG_IGN);
+        int devnull = open("/dev/null", O_RDONLY);
+        if (devnull != -1) {
+            dup2(devnull, STDIN_FILENO);
+            close(devnull);
+        }
+    } else {
+        fprintf(stderr, "警告: 無法分配 pty，容器將直接使用目前的終端（不支援 attach）\n");
+        if (console.master >= 0) {
+            close(console.master);
+            close(console.slave);
+            console.master = -1;
+            console.slave = -1;
+        }
+    }
     
-    // 配置資源限制
-    static cgroup_limits_t limits = {
-        .memory_limit_mb = 512,    // 限制記憶體為 512 MB
-        .cpu_shares = 512,         // CPU 份額為 512 (預設的一半)
-        .cpu_quota_us = 50000,     // CPU 配額為 50% (50000/100000)
-        .pids_max = 100            // 最多 100 個進程
-    };
+    // 網絡命名空間在 clone 前才取出，先宣告以便啟動失敗時統一釋放
+    int host_netns = -1;
+    int container_netns = -1;
+    char net_address[16] = "";
+    
+    // 根據主機拓撲為容器分配 CPU / NUMA 節點
+    cpuset_placement_t placement;
+    if (cpuset_allocate(container_id, &cpuset_request, &placement) == 0 && placement.domain >= 0) {
+        snprintf(limits.cpuset_cpus, sizeof(limits.cpuset_cpus), "%s", placement.cpus);
+        snprintf(limits.cpuset_mems, sizeof(limits.cpuset_mems), "%s", placement.mems);
+        printf(" CPU 放置: cpus=%s mems=%s\n", placement.cpus, placement.mems);
+    }
+    
+    // bind / interleave 策略以 cpuset.mems 同步限制（取代 CPU 放置選擇的節點）
+    char policy_mems[64];
+    memtune_cpuset_mems(&memory_policy, policy_mems, sizeof(policy_mems));
+    if (policy_mems[0]) {
+        snprintf(limits.cpuset_mems, sizeof(limits.cpuset_mems), "%s", policy_mems);
+    }
+    if (memory_policy.thp != THP_DEFAULT || memory_policy.numa != NUMA_DEFAULT) {
+        printf(" 記憶體策略: thp=%s numa=%s%s%s\n", memtune_thp_name(memory_policy.thp),
+               memtune_numa_name(memory_policy.numa), memory_policy.numa_nodes[0] ? ":" : "", memory_policy.numa_nodes);
+    }
     
     // 創建用於同步的管道
     static container_init_args_t args;
     args.limits = &limits;
-    args.container_id = container_id;
+    args.rootfs_mode = rootfs_mode;
+    args.console_slave = console.slave;
+    args.command = optind < argc ? argv + optind : NULL;
+    args.use_init = use_init;
+    args.memory_policy = memory_policy;
+    args.qos = qos;
+    memcpy(args.volumes, volumes, sizeof(volumes));
+    args.volume_count = volume_count;
+    snprintf(args.image_lowerdir, sizeof(args.image_lowerdir), "%s", lowerdir);
+    for (int i = 0; i < volume_count; i++) {
+        char description[800];
+        volume_describe(&volumes[i], description, sizeof(description));
+        printf(" 卷: %s\n", description);
+    }
+    snprintf(args.container_id, sizeof(args.container_id), "%s", container_id);
     
     // 生成唯一的容器根目錄和 cgroup 名稱
-    snprintf(args.container_root, sizeof(args.container_root), "%s%d", CONTAINER_ROOT_PREFIX, container_id);
-    snprintf(args.cgroup_name, sizeof(args.cgroup_name), "%s%d", CGROUP_NAME_PREFIX, container_id);
+    snprintf(args.container_root, sizeof(args.container_root), "%s%s", CONTAINER_ROOT_PREFIX, container_id);
+    snprintf(args.cgroup_name, sizeof(args.cgroup_name), "%s%s", CGROUP_NAME_PREFIX, container_id);
     
     // printf("容器根目錄: %s\n", args.container_root);
     // printf("Cgroup 名稱: %s\n\n", args.cgroup_name);
     
+    // 在 clone 之前啟動即時的虛擬 proc 文件服務，讓容器的掛載命名空間繼承此掛載
+    if (use_virtual_proc) {
+        snprintf(args.virtual_proc_dir, sizeof(args.virtual_proc_dir), "%s_proc", args.container_root);
+        args.virtual_proc = virtual_proc_start(&vproc, args.virtual_proc_dir, args.cgroup_name) == 0;
+    }
+    
+    // 延遲層同樣在 clone 之前掛載，lowerdir 中的延遲層文件換成 FUSE 掛載點下的目錄
+    if (strstr(args.image_lowerdir, ".lazy")) {
+        char lazy_dir[300];
+        snprintf(lazy_dir, sizeof(lazy_dir), "%s_lazy", args.container_root);
+        if (lazy_mount_start(&lazy, lazy_dir, IMAGE_LAYERS_DIR, args.image_lowerdir, sizeof(args.image_lowerdir)) != 0) {
+            metrics_launch_failed(METRICS_FAIL_LAZY);
+            goto fail;
+        }
+    }
+    
+    // 在 clone 之前啟動控制台轉發進程（轉發進程不持有 pty 從端，容器退出後即可看到掛斷）
+    // 容器的輸出同時記錄到日誌文件
+    if (console.slave >= 0 && log_writer_open(&console.log, container_id, log_size, log_rate) != 0) {
+        fprintf(stderr, "警告: 無法打開日誌文件 %s: %s\n", console.log.path, strerror(errno));
+    }
+    if (console.slave >= 0 && console_start(&console) != 0) {
+        fprintf(stderr, "錯誤: 無法啟動控制台: %s\n", strerror(errno));
+        metrics_launch_failed(METRICS_FAIL_CONSOLE);
+        goto fail;
+    }
+    
     if (pipe(args.sync_pipe) == -1) {
         perror("pipe");
-        exit(EXIT_FAILURE);
+        metrics_launch_failed(METRICS_FAIL_CLONE);
+        goto fail;
+    }
+    metrics_phase_end(METRICS_PHASE_SETUP);
+    
+    // 從池中取出預先創建的網絡命名空間，clone 期間暫時切換過去讓容器繼承，之後切回主機網絡
+    if (net_mode != NET_HOST) {
+        container_netns = netns_claim(net_mode, net_address, sizeof(net_address));
+        host_netns = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+        if (container_netns == -1 || host_netns == -1 || setns(container_netns, CLONE_NEWNET) == -1) {
+            fprintf(stderr, "錯誤: 無法準備網絡命名空間 (%s): %s\n", netns_mode_name(net_mode), strerror(errno));
+            metrics_launch_failed(METRICS_FAIL_NETWORK);
+            goto fail;
+        }
+    }
+    metrics_phase_end(METRICS_PHASE_NETWORK);
+    
+    // KSM 標記只能在主機的用戶命名空間中設置：先標記 runtime 自身，clone 出的 init 繼承後再取消
+    if (ksm && ksm_set_merge(1) != 0) {
+        fprintf(stderr, "警告: 無法啟用 KSM 合併 (PR_SET_MEMORY_MERGE): %s\n", strerror(errno));
+        ksm = 0;
     }
     
     // 創建子進程，使用新的命名空間
@@ -365,13 +1533,28 @@ int main() {
                       SIGCHLD,          // 子進程結束時發送 SIGCHLD
                       &args);           // 傳遞參數結構
     
+    if (ksm) {
+        ksm_set_merge(0);
+    }
     if (pid == -1) {
         perror("clone");
-        exit(EXIT_FAILURE);
+        metrics_launch_failed(METRICS_FAIL_CLONE);
+        goto fail;
+    }
+    if (host_netns != -1) {
+        if (setns(host_netns, CLONE_NEWNET) == -1) {
+            perror("setns");
+        }
+        close(host_netns);
+        close(container_netns);
+        printf(" 網絡: %s %s\n", netns_mode_name(net_mode), net_address);
     }
     
     // 關閉管道的讀取端（子進程使用）
     close(args.sync_pipe[0]);
+    if (console.slave >= 0) {
+        close(console.slave);
+    }
     
     // printf("容器已創建，PID: %d\n\n", pid);
     
@@ -383,23 +1566,107 @@ int main() {
     
     // 通知子進程映射已完成，可以繼續執行
     close(args.sync_pipe[1]);
+    metrics_phase_end(METRICS_PHASE_NAMESPACES);
     
-    // 設置資源限制
-    setup_cgroup_limits(pid, &limits, args.cgroup_name);
+    // 設置資源限制（容器照常運行，但要讓用戶知道哪些限制沒有生效）
+    if (setup_cgroup_limits(pid, &limits, args.cgroup_name) != 0) {
+        fprintf(stderr, "警告: 部分資源限制未能套用，容器將在沒有這些限制的情況下運行\n");
+        metrics_launch_failed(METRICS_FAIL_CGROUP_LIMITS);
+    }
+    metrics_phase_end(METRICS_PHASE_CGROUP);
     // printf("\n");
     
-    // 等待子進程結束
+    // 登記到共享狀態表，供 ps / inspect 查詢
+    container_record_t record;
+    memset(&record, 0, sizeof(record));
+    snprintf(record.id, sizeof(record.id), "%s", container_id);
+    record.status = CONTAINER_RUNNING;
+    record.pid = pid;
+    record.runtime_pid = getpid();
+    record.pid_starttime = read_pid_starttime(pid);
+    record.started_at = time(NULL);
+    record.rootfs_mode = rootfs_mode;
+    snprintf(record.image, sizeof(record.image), "%s", image ? image : "");
+    snprintf(record.pidfd_path, sizeof(record.pidfd_path), "/proc/%d", pid);
+    snprintf(record.cgroup_name, sizeof(record.cgroup_name), "%s", args.cgroup_name);
+    snprintf(record.rootfs, sizeof(record.rootfs), "%s", args.container_root);
+    record.memory_limit_mb = limits.memory_limit_mb;
+    record.cpu_shares = limits.cpu_shares;
+    record.cpu_quota_us = limits.cpu_quota_us;
+    record.cpu_period_us = limits.cpu_period_us;
+    record.cpu_burst_us = limits.cpu_burst_us;
+    record.pids_max = limits.pids_max;
+    snprintf(record.cpuset_cpus, sizeof(record.cpuset_cpus), "%s", limits.cpuset_cpus);
+    record.net_mode = net_mode;
+    record.ksm = ksm;
+    record.qos = qos;
+    record.thp_mode = memory_policy.thp;
+    record.numa_mode = memory_policy.numa;
+    snprintf(record.numa_nodes, sizeof(record.numa_nodes), "%s", memory_policy.numa_nodes);
+    snprintf(record.address, sizeof(record.address), "%s", net_address);
+    if (state_add(&record) != 0) {
+        fprintf(stderr, "警告: 無法登記容器狀態，ps 將看不到此容器\n");
+    }
+    metrics_phase_end(METRICS_PHASE_REGISTER);
+    metrics_launch_ready();
+    
+    // 通知前台進程容器已啟動；背景運行時之後的訊息寫入日誌文件
+    char detach_log_path[256] = "";
+    if (ready_pipe[1] >= 0) {
+        if (write(ready_pipe[1], "1", 1) != 1) {
+            perror("write");
+        }
+        close(ready_pipe[1]);
+        if (detach) {
+            snprintf(detach_log_path, sizeof(detach_log_path), "/tmp/docker_in_c_%s.log", container_id);
+            int log_fd = open(detach_log_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (log_fd != -1) {
+                dup2(log_fd, STDOUT_FILENO);
+                dup2(log_fd, STDERR_FILENO);
+                close(log_fd);
+            }
+        }
+    }
+    
+    // 容器已啟動，在背景把網絡命名空間池補回目標數量，下一個容器不需要等待創建
+    if (net_mode != NET_HOST) {
+        netns_pool_refill_async(net_mode, NETNS_POOL_TARGET);
+    }
+    
+    // 等待子進程結束（啟用自動調節時同時運行 CPU 配額控制迴圈）
     int status;
-    if (waitpid(pid, &status, 0) == -1) {
+    if (autoscale.enabled) {
+        snprintf(autoscale.log_path, sizeof(autoscale.log_path), "/tmp/docker_in_c_autoscale_%s.log", container_id);
+        if (cpu_autoscale_run(pid, args.cgroup_name, &autoscale, &status) == -1) {
+            perror("waitpid");
+            exit(EXIT_FAILURE);
+        }
+    } else if (waitpid(pid, &status, 0) == -1) {
         perror("waitpid");
         exit(EXIT_FAILURE);
     }
     
     printf("容器已退出\n");
+    metrics_teardown_begin();
     
-    // 清理 cgroup
+    // 清理期間在 ps 中顯示為 exited（可能已被 update 修改過，先讀回最新記錄）
+    if (state_find(container_id, &record) == 0) {
+        record.status = CONTAINER_EXITED;
+        record.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        state_update(&record);
+    }
+    
+    // 停止虛擬 proc 文件服務和延遲層
+    virtual_proc_stop(&vproc);
+    lazy_mount_stop(&lazy);
+    
+    // 清理 cgroup 並釋放 CPU 放置
     cleanup_cgroup(args.cgroup_name);
     
+    // cgroup 中的進程都已結束，轉發進程送完剩餘輸出後退出
+    console_stop(&console);
+    cpuset_release(container_id);
+    
     // 清理容器目錄
     char cleanup_cmd[512];
     snprintf(cleanup_cmd, sizeof(cleanup_cmd), "rm -rf %s", args.container_root);
@@ -422,6 +1689,69 @@ int main() {
         perror("清理 OverlayFS 目錄");
     }
     
-    printf("容器 %d 清理完成\n", container_id);
+    state_remove(container_id);
+    release_container_id(container_id);
+    if (detach_log_path[0]) {
+        unlink(detach_log_path);
+    }
+    metrics_teardown_end();
+    printf("容器 %s 清理完成\n", container_id);
     return 0;
-}
\ No newline at end of file
+
+fail:
+    // 容器未能啟動：撤銷已完成的步驟（切回主機網絡並釋放命名空間、停止 FUSE 服務與轉發進程），
+    // 最後釋放 CPU 放置與容器 ID 的預留
+    if (host_netns != -1) {
+        setns(host_netns, CLONE_NEWNET);
+        close(host_netns);
+    }
+    if (container_netns != -1) {
+        close(container_netns);
+    }
+    if (console.slave >= 0) {
+        close(console.slave);
+    }
+    console_stop(&console);
+    lazy_mount_stop(&lazy);
+    virtual_proc_stop(&vproc);
+    cpuset_release(container_id);
+    release_container_id(container_id);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "update") == 0) {
+        return cmd_update(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "attach") == 0) {
+        return cmd_attach(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "exec") == 0) {
+        return cmd_exec(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "logs") == 0) {
+        return cmd_logs(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "ps") == 0) {
+        return cmd_ps(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "inspect") == 0) {
+        return cmd_inspect(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "import") == 0) {
+        return cmd_import(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "export") == 0) {
+        return cmd_export(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "metrics") == 0) {
+        return cmd_metrics(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "images") == 0) {
+        return image_list() == 0 ? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "run") == 0) {
+        return cmd_run(argc - 1, argv + 1);
+    }
+    return cmd_run(argc, argv);
+}
@@ -0,0 +1,189 @@
+#include "memtune.h"
+#include "cgroup.h"
+#include "cpuset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+// 較舊的 glibc 標頭沒有此常數（Linux 6.4 起支援）
+#ifndef PR_SET_MEMORY_MERGE
+#define PR_SET_MEMORY_MERGE 67
+#endif
+
+// PR_SET_THP_DISABLE 的旗標：保留 madvise(MADV_HUGEPAGE) 區域的大頁（Linux 6.18 起支援）
+#ifndef PR_THP_DISABLE_EXCEPT_ADVISED
+#define PR_THP_DISABLE_EXCEPT_ADVISED (1 << 1)
+#endif
+
+// set_mempolicy 節點位圖支援的最大節點數
+#define NUMA_MAX_NODES 1024
+
+static const char* thp_names[] = {"default", "never", "madvise"};
+static const char* numa_names[] = {"default", "bind", "preferred", "interleave"};
+
+int ksm_set_merge(int enable) {
+    return prctl(PR_SET_MEMORY_MERGE, enable ? 1 : 0, 0, 0, 0) == 0 ? 0 : -1;
+}
+
+int64_t ksm_read_global(const char* name) {
+    char path[256];
+    long long value;
+
+    snprintf(path, sizeof(path), "%s/%s", KSM_SYSFS_DIR, name);
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    int ok = fscanf(fp, "%lld", &value) == 1;
+    fclose(fp);
+    return ok ? value : -1;
+}
+
+int ksm_running(void) {
+    return ksm_read_global("run") == 1;
+}
+
+// 把一個進程的 ksm_stat 累加到統計中
+static void add_process_stats(const char* pid, ksm_stats_t* stats) {
+    char path[64], line[128];
+    long long value;
+
+    snprintf(path, sizeof(path), "/proc/%s/ksm_stat", pid);
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "ksm_merging_pages %lld", &value) == 1) {
+            stats->merging_pages += value;
+        } else if (sscanf(line, "ksm_process_profit %lld", &value) == 1) {
+            stats->process_profit += value;
+        }
+    }
+    fclose(fp);
+    stats->processes++;
+}
+
+int ksm_container_stats(const char* cgroup_name, ksm_stats_t* stats) {
+    char cgroup_path[512], path[600], pid[32];
+
+    memset(stats, 0, sizeof(*stats));
+    get_cgroup_path(detect_cgroup_version(), "memory", cgroup_name, cgroup_path, sizeof(cgroup_path));
+    snprintf(path, sizeof(path), "%s/cgroup.procs", cgroup_path);
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    while (fscanf(fp, "%31s", pid) == 1) {
+        add_process_stats(pid, stats);
+    }
+    fclose(fp);
+    return 0;
+}
+
+const char* memtune_thp_name(thp_mode_t mode) {
+    return (unsigned)mode < sizeof(thp_names) / sizeof(thp_names[0]) ? thp_names[mode] : "unknown";
+}
+
+const char* memtune_numa_name(numa_mode_t mode) {
+    return (unsigned)mode < sizeof(numa_names) / sizeof(numa_names[0]) ? numa_names[mode] : "unknown";
+}
+
+int memtune_parse_thp(const char* value, thp_mode_t* mode) {
+    for (size_t i = 0; i < sizeof(thp_names) / sizeof(thp_names[0]); i++) {
+        if (strcmp(value, thp_names[i]) == 0) {
+            *mode = (thp_mode_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int memtune_parse_numa(const char* spec, memory_policy_t* policy) {
+    char path[64];
+    cpu_set_t nodes;
+    const char* colon = strchr(spec, ':');
+    size_t mode_len = colon ? (size_t)(colon - spec) : strlen(spec);
+
+    numa_mode_t mode = NUMA_DEFAULT;
+    for (size_t i = 1; i < sizeof(numa_names) / sizeof(numa_names[0]); i++) {
+        if (strlen(numa_names[i]) == mode_len && strncmp(spec, numa_names[i], mode_len) == 0) {
+            mode = (numa_mode_t)i;
+        }
+    }
+    if (mode == NUMA_DEFAULT || !colon) {
+        return -1;
+    }
+    // 節點列表與 cpulist 同一格式，借用 cpu_set_t 解析
+    if (cpuset_parse_list(colon + 1, &nodes) != 0 || CPU_COUNT(&nodes) == 0) {
+        return -1;
+    }
+    for (int node = 0; node < CPU_SETSIZE && node < NUMA_MAX_NODES; node++) {
+        if (!CPU_ISSET(node, &nodes)) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/meminfo", node);
+        if (access(path, F_OK) != 0) {
+            fprintf(stderr, "錯誤: NUMA 節點 %d 不存在\n", node);
+            return -1;
+        }
+    }
+    policy->numa = mode;
+    cpuset_format_list(&nodes, policy->numa_nodes, sizeof(policy->numa_nodes));
+    return 0;
+}
+
+void memtune_cpuset_mems(const memory_policy_t* policy, char* mems, size_t size) {
+    // preferred 允許退回其他節點，不能用 cpuset.mems 限制
+    if (policy->numa == NUMA_BIND || policy->numa == NUMA_INTERLEAVE) {
+        snprintf(mems, size, "%s", policy->numa_nodes);
+    } else if (size > 0) {
+        mems[0] = '\0';
+    }
+}
+
+int memtune_apply(const memory_policy_t* policy) {
+    if (policy->thp == THP_NEVER && prctl(PR_SET_THP_DISABLE, 1, 0, 0, 0) == -1) {
+        fprintf(stderr, "錯誤: 無法禁用透明大頁: %s\n", strerror(errno));
+        return -1;
+    }
+    if (policy->thp == THP_MADVISE && prctl(PR_SET_THP_DISABLE, 1, PR_THP_DISABLE_EXCEPT_ADVISED, 0, 0) == -1) {
+        fprintf(stderr, "錯誤: 無法設置透明大頁的 madvise 模式（需要 Linux 6.18 以上）: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (policy->numa == NUMA_DEFAULT) {
+        return 0;
+    }
+    cpu_set_t nodes;
+    unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+    memset(mask, 0, sizeof(mask));
+    if (cpuset_parse_list(policy->numa_nodes, &nodes) != 0) {
+        return -1;
+    }
+    for (int node = 0; node < CPU_SETSIZE && node < NUMA_MAX_NODES; node++) {
+        if (CPU_ISSET(node, &nodes)) {
+            mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+        }
+    }
+
+    int mode = MPOL_BIND;
+    if (policy->numa == NUMA_INTERLEAVE) {
+        mode = MPOL_INTERLEAVE;
+    } else if (policy->numa == NUMA_PREFERRED) {
+        // MPOL_PREFERRED 只接受一個節點，多個節點使用 MPOL_PREFERRED_MANY (Linux 5.15 起)
+        mode = CPU_COUNT(&nodes) == 1 ? MPOL_PREFERRED : MPOL_PREFERRED_MANY;
+    }
+    if (syscall(SYS_set_mempolicy, mode, mask, (unsigned long)NUMA_MAX_NODES) == -1) {
+        fprintf(stderr, "錯誤: 無法設置 NUMA 記憶體策略 %s:%s: %s\n",
+                memtune_numa_name(policy->numa), policy->numa_nodes, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+#ifndef MEMTUNE_H
+#define MEMTUNE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 主機 KSM 的 sysfs 目錄
+#define KSM_SYSFS_DIR "/sys/kernel/mm/ksm"
+
+// 透明大頁 (THP) 模式
+typedef enum {
+    THP_DEFAULT = 0,           // 沿用主機的設定
+    THP_NEVER,                 // 完全禁用 (PR_SET_THP_DISABLE)
+    THP_MADVISE                // 只有 madvise(MADV_HUGEPAGE) 的區域使用大頁（Linux 6.18 以上）
+} thp_mode_t;
+
+// NUMA 記憶體策略（set_mempolicy 的模式）
+typedef enum {
+    NUMA_DEFAULT = 0,          // 不設置，沿用主機的預設策略
+    NUMA_BIND,                 // 只從指定節點分配 (MPOL_BIND)
+    NUMA_PREFERRED,            // 優先從指定節點分配，不足時退回其他節點 (MPOL_PREFERRED / MPOL_PREFERRED_MANY)
+    NUMA_INTERLEAVE            // 在指定節點之間交錯分配 (MPOL_INTERLEAVE)
+} numa_mode_t;
+
+// 容器的記憶體策略（在 container_init 中 exec 之前套用，所有子孫繼承）
+typedef struct {
+    thp_mode_t thp;
+    numa_mode_t numa;
+    char numa_nodes[64];       // 節點列表 (cpulist 格式，例如 "0-1")
+} memory_policy_t;
+
+// 容器的 KSM 統計（容器 cgroup 中所有進程的 /proc/<pid>/ksm_stat 之和）
+typedef struct {
+    int64_t merging_pages;     // 已與其他頁合併的頁數 (ksm_merging_pages)
+    int64_t process_profit;    // 合併節省的記憶體減去元數據開銷，位元組 (ksm_process_profit)
+    int processes;             // 統計到的進程數
+} ksm_stats_t;
+
+/**
+ * 設置目前進程的 KSM 合併標記 (PR_SET_MEMORY_MERGE)
+ * 標記在 fork/clone 時繼承、execve 後保留，因此設置後創建的容器 init 及其所有子孫都可被合併。
+ * 需要初始用戶命名空間中的 CAP_SYS_RESOURCE，必須在 clone(CLONE_NEWUSER) 之前調用
+ * @param enable 1 啟用，0 關閉（關閉時已合併的頁被拆開）
+ * @return 0 成功，-1 失敗（內核不支援或沒有權限）
+ */
+int ksm_set_merge(int enable);
+
+/**
+ * 檢查主機的 KSM 是否在運行（/sys/kernel/mm/ksm/run 為 1）
+ * @return 1 運行中，0 未運行或不支援
+ */
+int ksm_running(void);
+
+/**
+ * 讀取容器的 KSM 統計
+ * @param cgroup_name 容器的 cgroup 名稱
+ * @param stats 輸出的統計
+ * @return 0 成功，-1 無法讀取 cgroup 的進程列表
+ */
+int ksm_container_stats(const char* cgroup_name, ksm_stats_t* stats);
+
+/**
+ * 讀取主機 KSM 的一項統計（例如 pages_sharing、general_profit）
+ * @param name /sys/kernel/mm/ksm 下的文件名
+ * @return 數值，無法讀取時為 -1
+ */
+int64_t ksm_read_global(const char* name);
+
+/**
+ * 解析 --thp 參數
+ * @param value never / madvise / default
+ * @param mode 輸出的 THP 模式
+ * @return 0 成功，-1 無效的值
+ */
+int memtune_parse_thp(const char* value, thp_mode_t* mode);
+
+/**
+ * 解析 --numa 參數（MODE:NODES，例如 bind:0、interleave:0-3）
+ * 會檢查節點是否存在
+ * @param spec 參數字串
+ * @param policy 輸出的策略（只修改 numa 與 numa_nodes）
+ * @return 0 成功，-1 格式錯誤或節點不存在
+ */
+int memtune_parse_numa(const char* spec, memory_policy_t* policy);
+
+/**
+ * 套用記憶體策略到目前進程（兩者都在 fork 時繼承、execve 後保留，不需要特權）
+ * @param policy 記憶體策略
+ * @return 0 成功，-1 失敗（已輸出錯誤信息）
+ */
+int memtune_apply(const memory_policy_t* policy);
+
+/**
+ * 策略需要的 cpuset.mems（bind / interleave 時為策略的節點，其他情況為空字串）
+ * @param policy 記憶體策略
+ * @param mems 輸出緩衝區
+ * @param size 緩衝區大小
+ */
+void memtune_cpuset_mems(const memory_policy_t* policy, char* mems, size_t size);
+
+/**
+ * THP 模式的名稱
+ */
+const char* memtune_thp_name(thp_mode_t mode);
+
+/**
+ * NUMA 策略模式的名稱
+ */
+const char* memtune_numa_name(numa_mode_t mode);
+
+#endif // MEMTUNE_H
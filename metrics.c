@@ -0,0 +1,628 @@
+#include "metrics.h"
+#include "cgroup.h"
+#include "state.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define METRICS_TABLE_MAGIC 0x4D455452u  // "METR"
+#define METRICS_TABLE_VERSION 1
+#define METRICS_PREFIX "docker_in_c_"
+
+// 等待抓取請求內容的最長時間（毫秒），之後按非 HTTP 的請求處理
+#define METRICS_REQUEST_TIMEOUT_MS 200
+
+// 直方圖桶的上界（微秒），最後一個桶為 +Inf
+static const uint64_t bucket_bounds_us[METRICS_BUCKETS - 1] = {
+    500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000,
+};
+
+static const char* phase_names[METRICS_PHASE_COUNT] = {
+    "prepare", "setup", "network", "namespaces", "cgroup", "register",
+};
+
+static const char* failure_names[METRICS_FAIL_COUNT] = {
+    "image", "id", "fork", "console", "lazy", "network", "clone", "cgroup_limits",
+};
+
+// 延遲直方圖（各桶的次數不累積，輸出時才累加成 Prometheus 的 le 語義）
+typedef struct {
+    uint64_t buckets[METRICS_BUCKETS];
+    uint64_t count;
+    uint64_t sum_us;
+} histogram_t;
+
+// 一個槽位的計數，全部是 uint64_t，歸併與合併時當作陣列逐項相加
+typedef struct {
+    uint64_t attempts;
+    uint64_t launches;
+    uint64_t failures[METRICS_FAIL_COUNT];
+    histogram_t phases[METRICS_PHASE_COUNT];
+    histogram_t launch;
+    histogram_t teardown;
+} metrics_counters_t;
+
+// 一個槽位：只有擁有者進程寫入，對齊到快取行，不同進程的更新不會互相爭用
+typedef struct {
+    int32_t owner_pid;         // 0 表示空閒；第 0 個槽位沒有擁有者；以 CAS 從 0 改為擁有者的 PID 來佔用
+    uint64_t owner_starttime;  // 擁有者的啟動時間，用於檢測 PID 重用；0 表示正在佔用 / 轉交，只檢查 PID
+    metrics_counters_t counters;
+} __attribute__((aligned(64))) metrics_slot_t;
+
+// 指標表文件頭
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;
+} __attribute__((aligned(64))) metrics_header_t;
+
+// 已映射的指標表
+typedef struct {
+    int fd;
+    metrics_header_t* header;
+    metrics_slot_t* slots;
+} metrics_table_t;
+
+// 目前進程的指標表映射與槽位（第一次更新時才打開，之後一直保留到進程退出）
+static metrics_table_t table = {-1, NULL, NULL};
+static metrics_slot_t* slot;
+static int claim_failed;
+
+// 啟動與清理的計時起點
+static struct timespec launch_start;
+static struct timespec phase_start;
+static struct timespec teardown_start;
+
+static size_t table_size(void) {
+    return sizeof(metrics_header_t) + (size_t)METRICS_SLOTS * sizeof(metrics_slot_t);
+}
+
+static void counter_add(uint64_t* counter, uint64_t value) {
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+// 把 from 的計數逐項加到 to
+static void counters_merge(metrics_counters_t* to, metrics_counters_t* from) {
+    uint64_t* dst = (uint64_t*)to;
+    uint64_t* src = (uint64_t*)from;
+    for (size_t i = 0; i < sizeof(metrics_counters_t) / sizeof(uint64_t); i++) {
+        uint64_t value = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        if (value) {
+            counter_add(&dst[i], value);
+        }
+    }
+}
+
+static int table_valid(int fd, const struct stat* st) {
+    metrics_header_t header;
+
+    if ((size_t)st->st_size != table_size() || pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+        return 0;
+    }
+    return header.magic == METRICS_TABLE_MAGIC && header.version == METRICS_TABLE_VERSION &&
+           header.slot_count == METRICS_SLOTS && header.slot_size == sizeof(metrics_slot_t);
+}
+
+// 打開並映射指標表，持有 flock 直到 table_unlock
+// @param lock LOCK_SH、LOCK_EX（抓取與歸還槽位），或 0 表示不加鎖（佔用槽位）
+// @param create 文件不存在或格式不符時是否（重新）建立
+static int table_open(metrics_table_t* t, int lock, int create) {
+    struct stat st;
+    size_t size = table_size();
+
+    if (create && mkdir(RUNTIME_DIR, 0755) == -1 && errno != EEXIST) {
+        return -1;
+    }
+    t->fd = open(METRICS_TABLE_PATH, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+    if (t->fd == -1) {
+        return -1;
+    }
+    if ((lock && flock(t->fd, lock) == -1) || fstat(t->fd, &st) == -1) {
+        close(t->fd);
+        return -1;
+    }
+    int valid = table_valid(t->fd, &st);
+    if (!valid && !lock && create) {
+        // 不加鎖打開時只有建立指標表需要排他鎖，取得鎖後重新檢查（可能已由其他進程建立）
+        if (flock(t->fd, LOCK_EX) == -1 || fstat(t->fd, &st) == -1) {
+            close(t->fd);
+            return -1;
+        }
+        valid = table_valid(t->fd, &st);
+    }
+    int fresh = 0;
+    if (!valid) {
+        // 指標只在主機運行期間有意義，格式變更後直接丟棄舊表
+        if (!create || ftruncate(t->fd, 0) == -1 || ftruncate(t->fd, size) == -1) {
+            close(t->fd);
+            return -1;
+        }
+        fresh = 1;
+    }
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, t->fd, 0);
+    if (map == MAP_FAILED) {
+        close(t->fd);
+        return -1;
+    }
+    t->header = map;
+    t->slots = (metrics_slot_t*)((char*)map + sizeof(metrics_header_t));
+    if (fresh) {
+        t->header->magic = METRICS_TABLE_MAGIC;
+        t->header->version = METRICS_TABLE_VERSION;
+        t->header->slot_count = METRICS_SLOTS;
+        t->header->slot_size = sizeof(metrics_slot_t);
+    }
+    return 0;
+}
+
+// 釋放 flock，保留映射（映射引用同一個打開的文件，只關閉 fd 不會釋放鎖）
+static void table_unlock(metrics_table_t* t) {
+    flock(t->fd, LOCK_UN);
+    close(t->fd);
+    t->fd = -1;
+}
+
+static void table_close(metrics_table_t* t) {
+    if (t->fd != -1) {
+        table_unlock(t);
+    }
+    munmap(t->header, table_size());
+    t->header = NULL;
+    t->slots = NULL;
+}
+
+// 槽位的擁有者是否仍然存活（PID 被重用時啟動時間不同）
+// 佔用與轉交槽位時 PID 與啟動時間不是一次寫入的：啟動時間為 0 時只檢查 PID，
+// 檢查期間兩者有任何變化都當作存活，留到下一次再回收
+static int owner_alive(const metrics_slot_t* s) {
+    pid_t pid = __atomic_load_n(&s->owner_pid, __ATOMIC_ACQUIRE);
+    uint64_t starttime = __atomic_load_n(&s->owner_starttime, __ATOMIC_ACQUIRE);
+    if ((kill(pid, 0) == 0 || errno == EPERM) && (starttime == 0 || read_pid_starttime(pid) == starttime)) {
+        return 1;
+    }
+    return __atomic_load_n(&s->owner_pid, __ATOMIC_ACQUIRE) != pid ||
+           __atomic_load_n(&s->owner_starttime, __ATOMIC_ACQUIRE) != starttime;
+}
+
+// 把槽位的計數歸併到第 0 個槽位並清空（調用者持有排他鎖）
+static void slot_retire(metrics_table_t* t, metrics_slot_t* s) {
+    counters_merge(&t->slots[0].counters, &s->counters);
+    memset(&s->counters, 0, sizeof(s->counters));
+    __atomic_store_n(&s->owner_starttime, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->owner_pid, 0, __ATOMIC_RELEASE);
+}
+
+// 回收所有擁有者已退出的槽位（調用者持有排他鎖），返回回收的槽位數
+static int slots_reclaim(metrics_table_t* t) {
+    int reclaimed = 0;
+    for (int i = 1; i < METRICS_SLOTS; i++) {
+        metrics_slot_t* s = &t->slots[i];
+        if (__atomic_load_n(&s->owner_pid, __ATOMIC_ACQUIRE) != 0 && !owner_alive(s)) {
+            slot_retire(t, s);
+            reclaimed++;
+        }
+    }
+    return reclaimed;
+}
+
+// 進程退出時把自己的槽位歸併到第 0 個槽位，讓槽位可以重用
+static void slot_release(void) {
+    metrics_table_t t;
+
+    if (!slot || slot == &table.slots[0] || slot->owner_pid != getpid()) {
+        return;
+    }
+    if (table_open(&t, LOCK_EX, 0) == 0) {
+        // 另一個映射指向同一個文件，以下標找到對應的槽位
+        slot_retire(&t, &t.slots[slot - table.slots]);
+        table_close(&t);
+    }
+    slot = NULL;
+}
+
+// 以 CAS 佔用一個空閒槽位（從 PID 決定的位置開始找，減少同時啟動的進程互相爭用），沒有空閒槽位時返回 NULL
+static metrics_slot_t* slot_try_claim(pid_t pid) {
+    for (int n = 0; n < METRICS_SLOTS - 1; n++) {
+        metrics_slot_t* s = &table.slots[1 + (pid + n) % (METRICS_SLOTS - 1)];
+        int32_t expected = 0;
+        if (__atomic_load_n(&s->owner_pid, __ATOMIC_RELAXED) == 0 &&
+            __atomic_compare_exchange_n(&s->owner_pid, &expected, pid, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+// 佔用一個槽位：不加鎖地 CAS 一個空閒槽位；擁有者已退出的槽位由抓取時回收，
+// 只有所有槽位都被佔用時才加排他鎖回收一次，仍然沒有空閒槽位時共用第 0 個槽位
+static void slot_claim(void) {
+    if (table_open(&table, 0, 1) != 0) {
+        claim_failed = 1;
+        return;
+    }
+    pid_t pid = getpid();
+    metrics_slot_t* s = slot_try_claim(pid);
+    if (!s && flock(table.fd, LOCK_EX) == 0 && slots_reclaim(&table) > 0) {
+        s = slot_try_claim(pid);
+    }
+    if (s) {
+        __atomic_store_n(&s->owner_starttime, read_pid_starttime(pid), __ATOMIC_RELEASE);
+    }
+    slot = s ? s : &table.slots[0];
+    table_unlock(&table);
+    atexit(slot_release);
+}
+
+// 目前進程的槽位，第一次調用時佔用（失敗時返回 NULL，不再重試）
+static metrics_slot_t* current_slot(void) {
+    if (!slot && !claim_failed) {
+        slot_claim();
+    }
+    return slot;
+}
+
+static uint64_t elapsed_us(const struct timespec* since, struct timespec* now) {
+    clock_gettime(CLOCK_MONOTONIC, now);
+    int64_t us = (int64_t)(now->tv_sec - since->tv_sec) * 1000000 + (now->tv_nsec - since->tv_nsec) / 1000;
+    return us > 0 ? (uint64_t)us : 0;
+}
+
+static void observe(histogram_t* histogram, uint64_t us) {
+    int bucket = 0;
+    while (bucket < METRICS_BUCKETS - 1 && us > bucket_bounds_us[bucket]) {
+        bucket++;
+    }
+    counter_add(&histogram->buckets[bucket], 1);
+    counter_add(&histogram->count, 1);
+    counter_add(&histogram->sum_us, us);
+}
+
+void metrics_launch_begin(void) {
+    // 先開始計時再佔用槽位，打開指標表與佔用槽位的時間計入 prepare 階段
+    clock_gettime(CLOCK_MONOTONIC, &launch_start);
+    phase_start = launch_start;
+    metrics_slot_t* s = current_slot();
+    if (s) {
+        counter_add(&s->counters.attempts, 1);
+    }
+}
+
+void metrics_phase_end(metrics_phase_t phase) {
+    struct timespec now;
+    uint64_t us = elapsed_us(&phase_start, &now);
+    phase_start = now;
+    if (slot && (unsigned)phase < METRICS_PHASE_COUNT) {
+        observe(&slot->counters.phases[phase], us);
+    }
+}
+
+void metrics_launch_failed(metrics_failure_t cause) {
+    if (slot && (unsigned)cause < METRICS_FAIL_COUNT) {
+        counter_add(&slot->counters.failures[cause], 1);
+    }
+}
+
+void metrics_launch_ready(void) {
+    struct timespec now;
+    uint64_t us = elapsed_us(&launch_start, &now);
+    if (slot) {
+        observe(&slot->counters.launch, us);
+        counter_add(&slot->counters.launches, 1);
+    }
+}
+
+void metrics_adopt(void) {
+    if (!slot || slot == &table.slots[0]) {
+        return;
+    }
+    // 轉交期間啟動時間先清為 0，抓取時只檢查 PID，不會把正在轉交的槽位當作已退出而回收
+    __atomic_store_n(&slot->owner_starttime, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&slot->owner_pid, getpid(), __ATOMIC_RELEASE);
+    __atomic_store_n(&slot->owner_starttime, read_pid_starttime(getpid()), __ATOMIC_RELEASE);
+}
+
+void metrics_teardown_begin(void) {
+    clock_gettime(CLOCK_MONOTONIC, &teardown_start);
+}
+
+void metrics_teardown_end(void) {
+    struct timespec now;
+    uint64_t us = elapsed_us(&teardown_start, &now);
+    if (slot) {
+        observe(&slot->counters.teardown, us);
+    }
+}
+
+// 輸出一個直方圖的所有樣本（label 為空字串時不加標籤）
+static void render_histogram(FILE* out, const char* name, const char* label, const histogram_t* histogram) {
+    uint64_t cumulative = 0;
+    const char* sep = label[0] ? "," : "";
+
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        cumulative += histogram->buckets[i];
+        if (i < METRICS_BUCKETS - 1) {
+            fprintf(out, "%s%s_bucket{%s%sle=\"%g\"} %llu\n", METRICS_PREFIX, name, label, sep,
+                    bucket_bounds_us[i] / 1e6, (unsigned long long)cumulative);
+        } else {
+            fprintf(out, "%s%s_bucket{%s%sle=\"+Inf\"} %llu\n", METRICS_PREFIX, name, label, sep,
+                    (unsigned long long)cumulative);
+        }
+    }
+    fprintf(out, "%s%s_sum%s%s%s %.6f\n", METRICS_PREFIX, name, label[0] ? "{" : "", label, label[0] ? "}" : "",
+            histogram->sum_us / 1e6);
+    fprintf(out, "%s%s_count%s%s%s %llu\n", METRICS_PREFIX, name, label[0] ? "{" : "", label, label[0] ? "}" : "",
+            (unsigned long long)histogram->count);
+}
+
+static void render_help(FILE* out, const char* name, const char* type, const char* help) {
+    fprintf(out, "# HELP %s%s %s\n# TYPE %s%s %s\n", METRICS_PREFIX, name, help, METRICS_PREFIX, name, type);
+}
+
+// 一個容器的資源用量（讀不到的項目為 -1）
+typedef struct {
+    double cpu_seconds;
+    long long memory_bytes;
+    long long pids;
+} container_usage_t;
+
+static long long read_number(const char* cgroup_path, const char* filename) {
+    char buffer[64];
+    if (read_cgroup_file(cgroup_path, filename, buffer, sizeof(buffer)) != 0) {
+        return -1;
+    }
+    return atoll(buffer);
+}
+
+// 從 cgroup 讀取容器的 CPU 時間、記憶體用量與進程數
+static void read_container_usage(int version, const char* cgroup_name, container_usage_t* usage) {
+    char path[512];
+
+    usage->cpu_seconds = -1;
+    if (version == 2) {
+        char stat_path[600], key[64];
+        unsigned long long value;
+        get_cgroup_path(version, NULL, cgroup_name, path, sizeof(path));
+        snprintf(stat_path, sizeof(stat_path), "%s/cpu.stat", path);
+        FILE* fp = fopen(stat_path, "r");
+        if (fp) {
+            while (fscanf(fp, "%63s %llu", key, &value) == 2) {
+                if (strcmp(key, "usage_usec") == 0) {
+                    usage->cpu_seconds = value / 1e6;
+                }
+            }
+            fclose(fp);
+        }
+        usage->memory_bytes = read_number(path, "memory.current");
+        usage->pids = read_number(path, "pids.current");
+        return;
+    }
+    // v1 的 CPU 時間來自 cpuacct.usage（納秒）
+    get_cgroup_path(version, "cpuacct", cgroup_name, path, sizeof(path));
+    long long cpu_ns = read_number(path, "cpuacct.usage");
+    if (cpu_ns >= 0) {
+        usage->cpu_seconds = cpu_ns / 1e9;
+    }
+    get_cgroup_path(version, "memory", cgroup_name, path, sizeof(path));
+    usage->memory_bytes = read_number(path, "memory.usage_in_bytes");
+    get_cgroup_path(version, "pids", cgroup_name, path, sizeof(path));
+    usage->pids = read_number(path, "pids.current");
+}
+
+// 輸出運行中容器的資源用量（每個容器一個樣本，另加所有容器的總和）
+static void render_containers(FILE* out) {
+    static container_record_t records[STATE_TABLE_CAPACITY];
+    static container_usage_t usages[STATE_TABLE_CAPACITY];
+    int count = state_list(records, STATE_TABLE_CAPACITY);
+    int version = detect_cgroup_version();
+    int running = 0;
+    double total_cpu = 0;
+    long long total_memory = 0, total_pids = 0;
+
+    for (int i = 0; i < (count > 0 ? count : 0); i++) {
+        if (!state_is_alive(&records[i]) || records[i].status != CONTAINER_RUNNING) {
+            records[i].id[0] = '\0';
+            continue;
+        }
+        read_container_usage(version, records[i].cgroup_name, &usages[i]);
+        running++;
+        total_cpu += usages[i].cpu_seconds > 0 ? usages[i].cpu_seconds : 0;
+        total_memory += usages[i].memory_bytes > 0 ? usages[i].memory_bytes : 0;
+        total_pids += usages[i].pids > 0 ? usages[i].pids : 0;
+    }
+
+    render_help(out, "containers_running", "gauge", "運行中的容器數");
+    fprintf(out, "%scontainers_running %d\n", METRICS_PREFIX, running);
+    render_help(out, "containers_cpu_seconds", "gauge", "所有運行中容器已使用的 CPU 時間之和（秒）");
+    fprintf(out, "%scontainers_cpu_seconds %.6f\n", METRICS_PREFIX, total_cpu);
+    render_help(out, "containers_memory_bytes", "gauge", "所有運行中容器的記憶體用量之和");
+    fprintf(out, "%scontainers_memory_bytes %lld\n", METRICS_PREFIX, total_memory);
+    render_help(out, "containers_pids", "gauge", "所有運行中容器的進程數之和");
+    fprintf(out, "%scontainers_pids %lld\n", METRICS_PREFIX, total_pids);
+
+    render_help(out, "container_cpu_seconds_total", "counter", "容器已使用的 CPU 時間（秒）");
+    for (int i = 0; i < count; i++) {
+        if (records[i].id[0] && usages[i].cpu_seconds >= 0) {
+            fprintf(out, "%scontainer_cpu_seconds_total{id=\"%s\"} %.6f\n", METRICS_PREFIX, records[i].id,
+                    usages[i].cpu_seconds);
+        }
+    }
+    render_help(out, "container_memory_bytes", "gauge", "容器的記憶體用量");
+    for (int i = 0; i < count; i++) {
+        if (records[i].id[0] && usages[i].memory_bytes >= 0) {
+            fprintf(out, "%scontainer_memory_bytes{id=\"%s\"} %lld\n", METRICS_PREFIX, records[i].id,
+                    usages[i].memory_bytes);
+        }
+    }
+    render_help(out, "container_memory_limit_bytes", "gauge", "容器的記憶體上限");
+    for (int i = 0; i < count; i++) {
+        if (records[i].id[0] && records[i].memory_limit_mb > 0) {
+            fprintf(out, "%scontainer_memory_limit_bytes{id=\"%s\"} %lld\n", METRICS_PREFIX, records[i].id,
+                    (long long)records[i].memory_limit_mb * 1024 * 1024);
+        }
+    }
+    render_help(out, "container_pids", "gauge", "容器中的進程數");
+    for (int i = 0; i < count; i++) {
+        if (records[i].id[0] && usages[i].pids >= 0) {
+            fprintf(out, "%scontainer_pids{id=\"%s\"} %lld\n", METRICS_PREFIX, records[i].id, usages[i].pids);
+        }
+    }
+    render_help(out, "container_pids_limit", "gauge", "容器的進程數上限");
+    for (int i = 0; i < count; i++) {
+        if (records[i].id[0] && records[i].pids_max > 0) {
+            fprintf(out, "%scontainer_pids_limit{id=\"%s\"} %d\n", METRICS_PREFIX, records[i].id, records[i].pids_max);
+        }
+    }
+}
+
+int metrics_render(FILE* out) {
+    metrics_counters_t total;
+    metrics_table_t t;
+    char label[64];
+
+    // 指標表還不存在（沒有啟動過容器）時輸出全部為 0 的計數
+    // 抓取時持有排他鎖，順便回收擁有者已退出（例如被 SIGKILL）的槽位，啟動路徑因此不需要加鎖
+    memset(&total, 0, sizeof(total));
+    if (access(METRICS_TABLE_PATH, F_OK) == 0) {
+        if (table_open(&t, LOCK_EX, 0) != 0) {
+            return -1;
+        }
+        slots_reclaim(&t);
+        for (int i = 0; i < METRICS_SLOTS; i++) {
+            counters_merge(&total, &t.slots[i].counters);
+        }
+        table_close(&t);
+    }
+
+    render_help(out, "launch_attempts_total", "counter", "容器啟動的嘗試次數");
+    fprintf(out, "%slaunch_attempts_total %llu\n", METRICS_PREFIX, (unsigned long long)total.attempts);
+    render_help(out, "launches_total", "counter", "成功啟動的容器數（以 rate() 計算啟動速率）");
+    fprintf(out, "%slaunches_total %llu\n", METRICS_PREFIX, (unsigned long long)total.launches);
+    render_help(out, "launch_failures_total", "counter", "按原因分類的啟動失敗次數（cgroup_limits 的容器仍然啟動）");
+    for (int i = 0; i < METRICS_FAIL_COUNT; i++) {
+        fprintf(out, "%slaunch_failures_total{cause=\"%s\"} %llu\n", METRICS_PREFIX, failure_names[i],
+                (unsigned long long)total.failures[i]);
+    }
+    render_help(out, "launch_duration_seconds", "histogram", "從開始啟動到容器就緒的耗時");
+    render_histogram(out, "launch_duration_seconds", "", &total.launch);
+    render_help(out, "launch_phase_duration_seconds", "histogram", "容器啟動各階段的耗時");
+    for (int i = 0; i < METRICS_PHASE_COUNT; i++) {
+        snprintf(label, sizeof(label), "phase=\"%s\"", phase_names[i]);
+        render_histogram(out, "launch_phase_duration_seconds", label, &total.phases[i]);
+    }
+    render_help(out, "teardown_duration_seconds", "histogram", "容器退出後清理 cgroup、控制台與目錄的耗時");
+    render_histogram(out, "teardown_duration_seconds", "", &total.teardown);
+
+    render_containers(out);
+    return ferror(out) ? -1 : 0;
+}
+
+int metrics_write_file(const char* path) {
+    char tmp_path[4096];
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%d", path, getpid());
+    FILE* out = fopen(tmp_path, "w");
+    if (!out) {
+        fprintf(stderr, "錯誤: 無法創建 %s: %s\n", tmp_path, strerror(errno));
+        return -1;
+    }
+    int result = metrics_render(out);
+    if (fclose(out) != 0) {
+        result = -1;
+    }
+    if (result != 0 || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "錯誤: 無法寫入指標文件 %s: %s\n", path, strerror(errno));
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+// 處理一個抓取連接
+static void serve_client(int client) {
+    char request[512];
+    ssize_t n = 0;
+    struct pollfd pfd = {client, POLLIN, 0};
+
+    // 只看請求的開頭是否為 HTTP；客戶端不發送任何內容時等到逾時後直接輸出
+    if (poll(&pfd, 1, METRICS_REQUEST_TIMEOUT_MS) > 0) {
+        n = read(client, request, sizeof(request) - 1);
+    }
+    int http = n >= 4 && strncmp(request, "GET ", 4) == 0;
+
+    char* body = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&body, &length);
+    if (!out) {
+        return;
+    }
+    int result = metrics_render(out);
+    fclose(out);
+
+    FILE* conn = fdopen(dup(client), "w");
+    if (conn) {
+        if (http && result == 0) {
+            fprintf(conn, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                          "Content-Length: %zu\r\n\r\n", length);
+        } else if (http) {
+            fprintf(conn, "HTTP/1.0 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
+        }
+        if (result == 0) {
+            fwrite(body, 1, length, conn);
+        }
+        fclose(conn);
+    }
+    free(body);
+}
+
+int metrics_serve(const char* path) {
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "錯誤: socket 路徑過長: %s\n", path);
+        return -1;
+    }
+    int server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server == -1) {
+        perror("socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    unlink(path);
+    if (bind(server, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(server, 16) == -1) {
+        fprintf(stderr, "錯誤: 無法監聽 %s: %s\n", path, strerror(errno));
+        close(server);
+        return -1;
+    }
+    // 抓取者提前斷開時寫入失敗即可，不要被 SIGPIPE 終止
+    signal(SIGPIPE, SIG_IGN);
+    printf("指標服務: %s\n", path);
+    fflush(stdout);
+
+    for (;;) {
+        int client = accept4(server, NULL, NULL, SOCK_CLOEXEC);
+        if (client == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            perror("accept");
+            close(server);
+            return -1;
+        }
+        serve_client(client);
+        close(client);
+    }
+}
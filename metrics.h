@@ -0,0 +1,105 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include "runtime.h"
+
+// 指標表文件（記憶體映射，所有 runtime 進程共用）
+#define METRICS_TABLE_PATH RUNTIME_DIR "/metrics.table"
+
+// 指標表的槽位數：第 0 個槽位保存已退出進程的總計，其餘 511 個槽位每個 runtime 進程佔用一個
+// 同時運行（包括 --detach 的監控進程）超過 511 個時，之後的啟動都共用第 0 個槽位
+// （計數仍然正確且無鎖，只是共用同一組快取行而互相爭用）
+#define METRICS_SLOTS 512
+
+// 延遲直方圖的桶數（最後一個桶為 +Inf）
+#define METRICS_BUCKETS 15
+
+// 容器啟動的階段（依序計時，每個階段從上一個階段結束時開始）
+typedef enum {
+    METRICS_PHASE_PREPARE = 0,     // 鏡像 / 基礎 rootfs 檢查與分配容器 ID
+    METRICS_PHASE_SETUP,           // 控制台、CPU 放置、虛擬 proc、延遲層
+    METRICS_PHASE_NETWORK,         // 從池中取出網絡命名空間（host 模式接近 0）
+    METRICS_PHASE_NAMESPACES,      // clone 與用戶命名空間映射
+    METRICS_PHASE_CGROUP,          // 設置 cgroup 資源限制
+    METRICS_PHASE_REGISTER,        // 登記到狀態表
+    METRICS_PHASE_COUNT
+} metrics_phase_t;
+
+// 啟動失敗的原因
+typedef enum {
+    METRICS_FAIL_IMAGE = 0,        // 找不到鏡像或無法創建基礎 rootfs
+    METRICS_FAIL_ID,               // 無法分配容器 ID
+    METRICS_FAIL_FORK,             // 無法 fork 監控進程
+    METRICS_FAIL_CONSOLE,          // 無法啟動控制台
+    METRICS_FAIL_LAZY,             // 無法掛載延遲層
+    METRICS_FAIL_NETWORK,          // 無法準備網絡命名空間
+    METRICS_FAIL_CLONE,            // clone 失敗
+    METRICS_FAIL_CGROUP_LIMITS,    // 部分資源限制未能套用（容器仍然啟動）
+    METRICS_FAIL_COUNT
+} metrics_failure_t;
+
+/**
+ * 開始一次容器啟動：開始計時並計入嘗試次數
+ * 第一次更新指標時才映射指標表並以 CAS 佔用空閒槽位（只有建立指標表或槽位用完時才加鎖），
+ * 之後所有更新都是無鎖的原子加法
+ */
+void metrics_launch_begin(void);
+
+/**
+ * 結束一個啟動階段，記錄從上一個階段結束（或啟動開始）到現在的耗時
+ * @param phase 階段
+ */
+void metrics_phase_end(metrics_phase_t phase);
+
+/**
+ * 記錄一次啟動失敗
+ * @param cause 失敗原因
+ */
+void metrics_launch_failed(metrics_failure_t cause);
+
+/**
+ * 容器已就緒：記錄從啟動開始的總耗時並計入成功啟動的次數
+ */
+void metrics_launch_ready(void);
+
+/**
+ * 把目前進程的槽位轉給調用者（fork 出的監控進程接手容器的其餘生命週期時調用）
+ * 原來的進程退出時不會再歸併這個槽位
+ */
+void metrics_adopt(void);
+
+/**
+ * 容器已退出，開始計時清理
+ */
+void metrics_teardown_begin(void);
+
+/**
+ * 清理完成，記錄清理耗時
+ */
+void metrics_teardown_end(void);
+
+/**
+ * 以 Prometheus 文本格式輸出所有指標
+ * 回收擁有者已退出的槽位，合併所有槽位的計數，並從 cgroup 讀取每個運行中容器的 CPU / 記憶體 / 進程數用量
+ * @param out 輸出流
+ * @return 0 成功，-1 無法讀取指標表
+ */
+int metrics_render(FILE* out);
+
+/**
+ * 把指標寫入文件（先寫臨時文件再 rename，讀取者不會看到寫了一半的內容）
+ * @param path 文件路徑
+ * @return 0 成功，-1 失敗（已輸出錯誤信息）
+ */
+int metrics_write_file(const char* path);
+
+/**
+ * 在 Unix socket 上提供指標，每個連接輸出一次目前的指標後關閉
+ * 請求以 "GET " 開頭時回應 HTTP/1.0，否則直接輸出文本（方便 socat 等工具讀取）
+ * @param path socket 路徑（已存在時先刪除）
+ * @return 只在出錯時返回 -1（已輸出錯誤信息）
+ */
+int metrics_serve(const char* path);
+
+#endif // METRICS_H
@@ -3,7 +3,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sched.h>
+#include <linux/openat2.h>
+#include <sys/syscall.h>
 
 // 獲取真實用戶 UID（即使在 sudo 下運行）
 uid_t get_real_uid(void) {
@@ -23,6 +27,26 @@ gid_t get_real_gid(void) {
     return getgid();
 }
 
+// 加入運行中容器的命名空間
+int enter_container_namespaces(int pidfd, int root_fd) {
+    // 容器的網絡命名空間屬於主機的用戶命名空間，必須在加入容器的用戶命名空間之前（仍有主機權限時）加入
+    if (setns(pidfd, CLONE_NEWNET) == -1) {
+        return -1;
+    }
+    // 內核 5.8 起 setns 接受 pidfd，並一次性（原子地）切換多個命名空間
+    if (setns(pidfd, CLONE_NEWUSER | CLONE_NEWNS | CLONE_NEWPID | CLONE_NEWUTS | CLONE_NEWIPC) == -1) {
+        return -1;
+    }
+    // setns 把根目錄重設為 mount 命名空間的根，容器是以 chroot 進入其 rootfs 的，需要再 chroot 一次
+    if (fchdir(root_fd) == -1 || chroot(".") == -1 || chdir("/") == -1) {
+        return -1;
+    }
+    if (setgid(0) == -1 || setuid(0) == -1) {
+        return -1;
+    }
+    return 0;
+}
+
 // 設置用戶命名空間的 UID/GID 映射
 int setup_user_namespace(pid_t pid) {
     char path[256];
@@ -82,3 +106,12 @@ int setup_user_namespace(pid_t pid) {
     return 0;
 }
 
+// 以 root_fd 為根解析路徑
+int open_in_root(int root_fd, const char* path, int flags) {
+    struct open_how how;
+
+    memset(&how, 0, sizeof(how));
+    how.flags = flags | O_CLOEXEC;
+    how.resolve = RESOLVE_IN_ROOT | RESOLVE_NO_MAGICLINKS;
+    return (int)syscall(SYS_openat2, root_fd, path[0] ? path : ".", &how, sizeof(how));
+}
@@ -25,5 +25,25 @@ gid_t get_real_gid(void);
  */
 int setup_user_namespace(pid_t pid);
 
+/**
+ * 加入運行中容器的網絡命名空間後，以一次 setns(pidfd) 加入 user / mount / PID / UTS / IPC 命名空間，
+ * 再 chroot 到容器的根目錄並切換為容器內的 root
+ * PID 命名空間只對之後 fork 出的子進程生效
+ * @param pidfd 容器 init 進程的 pidfd
+ * @param root_fd 事先打開的 /proc/<pid>/root（加入 mount 命名空間後仍指向容器的根目錄）
+ * @return 0 成功，-1 失敗
+ */
+int enter_container_namespaces(int pidfd, int root_fd);
+
+/**
+ * 以 root_fd 為根解析並打開路徑 (openat2 RESOLVE_IN_ROOT)：".." 與絕對路徑的符號連結都不會離開該目錄
+ * 用於在容器根目錄或鏡像層目錄中操作不可信的路徑
+ * @param root_fd 作為根的目錄
+ * @param path 路徑（空字串表示根目錄本身）
+ * @param flags open 標誌（自動加上 O_CLOEXEC）
+ * @return 文件描述符，-1 失敗
+ */
+int open_in_root(int root_fd, const char* path, int flags);
+
 #endif // NAMESPACE_H
 
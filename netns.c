@@ -0,0 +1,362 @@
+#include "netns.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/wait.h>
+
+#ifndef NSFS_MAGIC
+#define NSFS_MAGIC 0x6e736673
+#endif
+
+// 命名空間編號的上限：10.88.1.2 - 10.88.255.251，超過後從 0 開始重用已釋放的編號
+#define NETNS_MAX_INDEX (255 * 250)
+
+static const char* net_mode_names[] = {"host", "loopback", "bridge"};
+
+int netns_parse_mode(const char* str, net_mode_t* mode) {
+    for (int i = NET_HOST; i <= NET_BRIDGE; i++) {
+        if (strcmp(str, net_mode_names[i]) == 0) {
+            *mode = (net_mode_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char* netns_mode_name(net_mode_t mode) {
+    return mode <= NET_BRIDGE ? net_mode_names[mode] : "unknown";
+}
+
+// 池目錄：<NETNS_POOL_DIR>/<模式>
+static int netns_pool_dir(net_mode_t mode, char* path, size_t size) {
+    snprintf(path, size, "%s/%s", NETNS_POOL_DIR, netns_mode_name(mode));
+    if ((mkdir(RUNTIME_DIR, 0755) == -1 && errno != EEXIST) ||
+        (mkdir(NETNS_POOL_DIR, 0755) == -1 && errno != EEXIST) ||
+        (mkdir(path, 0755) == -1 && errno != EEXIST)) {
+        return -1;
+    }
+    return 0;
+}
+
+// 編號是否仍被使用：池中（任一模式）有此編號的命名空間，或主機端的 veth 還在
+// （已取走的命名空間隨容器結束而銷毀，內核同時刪除 veth，編號即可重用）
+static int netns_index_in_use(int index) {
+    char path[300];
+
+    for (int mode = NET_LOOPBACK; mode <= NET_BRIDGE; mode++) {
+        snprintf(path, sizeof(path), "%s/%s/ns-%d", NETNS_POOL_DIR, net_mode_names[mode], index);
+        if (access(path, F_OK) == 0) {
+            return 1;
+        }
+        snprintf(path, sizeof(path), "%s/%s/ns-%d.claim", NETNS_POOL_DIR, net_mode_names[mode], index);
+        if (access(path, F_OK) == 0) {
+            return 1;
+        }
+    }
+    snprintf(path, sizeof(path), "/sys/class/net/dicv%d", index);
+    return access(path, F_OK) == 0;
+}
+
+// 分配命名空間編號（決定 veth 名稱與 IP 地址）並在 dir 中佔住其 claim 文件
+// 從上次的位置往後找第一個未使用的編號，到達上限後回到 0
+static int netns_next_index(const char* dir) {
+    char path[300];
+    int start = 0;
+
+    snprintf(path, sizeof(path), "%s/index", NETNS_POOL_DIR);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1 || flock(fd, LOCK_EX) == -1) {
+        if (fd != -1) close(fd);
+        return -1;
+    }
+    char buf[32] = "";
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n > 0) {
+        buf[n] = '\0';
+        start = atoi(buf) % NETNS_MAX_INDEX;
+    }
+
+    // 先佔住 claim 文件（仍持有鎖）：命名空間配置完成之前不會被取走，編號也不會被重複分配
+    int index = -1;
+    for (int i = 0; i < NETNS_MAX_INDEX && index < 0; i++) {
+        int candidate = (start + i) % NETNS_MAX_INDEX;
+        if (netns_index_in_use(candidate)) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/ns-%d.claim", dir, candidate);
+        int claim = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (claim != -1) {
+            close(claim);
+            index = candidate;
+        }
+    }
+    if (index >= 0) {
+        n = snprintf(buf, sizeof(buf), "%d\n", (index + 1) % NETNS_MAX_INDEX);
+        if (ftruncate(fd, 0) == -1 || pwrite(fd, buf, n, 0) != n) {
+            snprintf(path, sizeof(path), "%s/ns-%d.claim", dir, index);
+            unlink(path);
+            index = -1;
+        }
+    }
+    close(fd);
+    return index;
+}
+
+// 編號對應的容器地址：10.88.<1 + k/250>.<2 + k%250>
+static void netns_address(int index, char* buf, size_t size) {
+    snprintf(buf, size, "10.88.%d.%d", 1 + index / 250, 2 + index % 250);
+}
+
+// 啟用當前網絡命名空間的 lo（用 ioctl，不需要 ip 命令）
+static int loopback_up(void) {
+    struct ifreq ifr;
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "lo");
+    int ret = ioctl(fd, SIOCGIFFLAGS, &ifr);
+    if (ret == 0) {
+        ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+        ret = ioctl(fd, SIOCSIFFLAGS, &ifr);
+    }
+    close(fd);
+    return ret;
+}
+
+// 確保本地網橋存在並已啟用
+static int ensure_bridge(void) {
+    char cmd[256];
+
+    if (access("/sys/class/net/" NETNS_BRIDGE, F_OK) == 0) {
+        return 0;
+    }
+    snprintf(cmd, sizeof(cmd),
+             "ip link add %s type bridge 2>/dev/null; ip addr add %s/%d dev %s 2>/dev/null; ip link set %s up",
+             NETNS_BRIDGE, NETNS_BRIDGE_ADDR, NETNS_BRIDGE_PREFIX, NETNS_BRIDGE, NETNS_BRIDGE);
+    return system(cmd) == 0 ? 0 : -1;
+}
+
+int netns_create(net_mode_t mode) {
+    char dir[256], path[300], claim[320], cmd[512], address[32];
+    int ready[2], go[2];
+
+    if (mode == NET_HOST || netns_pool_dir(mode, dir, sizeof(dir)) != 0) {
+        return -1;
+    }
+    int index = netns_next_index(dir);
+    if (index < 0) {
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/ns-%d", dir, index);
+    snprintf(claim, sizeof(claim), "%s.claim", path);
+    netns_address(index, address, sizeof(address));
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd == -1 || pipe2(ready, O_CLOEXEC) == -1 || pipe2(go, O_CLOEXEC) == -1) {
+        if (fd != -1) close(fd);
+        unlink(claim);
+        return -1;
+    }
+    close(fd);
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        unlink(path);
+        unlink(claim);
+        return -1;
+    }
+    if (pid == 0) {
+        // 輔助進程：進入新的網絡命名空間，等待主機端接好 veth 後配置容器端
+        char ch = 1;
+        if (unshare(CLONE_NEWNET) == -1 || loopback_up() == -1) {
+            _exit(1);
+        }
+        if (write(ready[1], &ch, 1) != 1 || read(go[0], &ch, 1) != 1 || ch != 1) {
+            _exit(1);
+        }
+        if (mode == NET_BRIDGE) {
+            snprintf(cmd, sizeof(cmd),
+                     "ip addr add %s/%d dev eth0 && ip link set eth0 up && ip route add default via %s",
+                     address, NETNS_BRIDGE_PREFIX, NETNS_BRIDGE_ADDR);
+            _exit(system(cmd) == 0 ? 0 : 1);
+        }
+        _exit(0);
+    }
+    close(ready[1]);
+    close(go[0]);
+
+    char ch = 0;
+    char ns_path[64];
+    snprintf(ns_path, sizeof(ns_path), "/proc/%d/ns/net", pid);
+    int ok = read(ready[0], &ch, 1) == 1 && mount(ns_path, path, NULL, MS_BIND, NULL) == 0;
+    if (ok && mode == NET_BRIDGE) {
+        // veth 的主機端接到網橋，容器端以 eth0 的名稱直接創建在新的命名空間中
+        snprintf(cmd, sizeof(cmd),
+                 "ip link add dicv%d type veth peer name eth0 netns %d && ip link set dicv%d master %s up",
+                 index, pid, index, NETNS_BRIDGE);
+        ok = ensure_bridge() == 0 && system(cmd) == 0;
+    }
+    ch = ok ? 1 : 0;
+    if (write(go[1], &ch, 1) != 1) {
+        ok = 0;
+    }
+    close(ready[0]);
+    close(go[1]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        umount2(path, MNT_DETACH);
+        unlink(path);
+        unlink(claim);
+        return -1;
+    }
+
+    // 配置完成，開放給容器取用
+    unlink(claim);
+    return 0;
+}
+
+// 數池中的空閒命名空間（沒有 claim 文件的 ns-*）
+static int netns_pool_count(const char* dir) {
+    char claim[600];
+    struct dirent* entry;
+    int count = 0;
+
+    DIR* d = opendir(dir);
+    if (!d) {
+        return 0;
+    }
+    while ((entry = readdir(d)) != NULL) {
+        if (strncmp(entry->d_name, "ns-", 3) != 0 || strchr(entry->d_name, '.')) {
+            continue;
+        }
+        snprintf(claim, sizeof(claim), "%s/%s.claim", dir, entry->d_name);
+        if (access(claim, F_OK) != 0) {
+            count++;
+        }
+    }
+    closedir(d);
+    return count;
+}
+
+int netns_pool_fill(net_mode_t mode, int target) {
+    char dir[256], lock_path[300];
+
+    if (mode == NET_HOST || netns_pool_dir(mode, dir, sizeof(dir)) != 0) {
+        return -1;
+    }
+    // 只允許一個補充者，其他的直接返回
+    snprintf(lock_path, sizeof(lock_path), "%s/fill.lock", dir);
+    int lock = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock == -1) {
+        return -1;
+    }
+    if (flock(lock, LOCK_EX | LOCK_NB) == -1) {
+        close(lock);
+        return netns_pool_count(dir);
+    }
+
+    int count = netns_pool_count(dir);
+    while (count < target && netns_create(mode) == 0) {
+        count++;
+    }
+    close(lock);
+    return count;
+}
+
+void netns_pool_refill_async(net_mode_t mode, int target) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        // 兩次 fork：補充進程由 init 接管，runtime 不需要等待它
+        // 不繼承 runtime 的任何文件描述符（例如容器的同步管道），以免延遲它們的 EOF
+        if (fork() == 0) {
+            setsid();
+            close_range(3, ~0U, 0);
+            netns_pool_fill(mode, target);
+        }
+        _exit(0);
+    }
+    if (pid > 0) {
+        waitpid(pid, NULL, 0);
+    }
+}
+
+// 嘗試取走池中的某個命名空間
+static int netns_take(const char* dir, const char* name) {
+    char path[600], claim[620];
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    snprintf(claim, sizeof(claim), "%s.claim", path);
+
+    // O_EXCL 保證同一個命名空間只會被一個容器取走
+    int fd = open(claim, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        return -1;
+    }
+    close(fd);
+
+    // 重開機後殘留的文件已不是命名空間 (nsfs)，直接丟棄
+    struct statfs fs;
+    int ns_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (ns_fd != -1 && (fstatfs(ns_fd, &fs) == -1 || fs.f_type != NSFS_MAGIC)) {
+        close(ns_fd);
+        ns_fd = -1;
+    }
+    umount2(path, MNT_DETACH);
+    unlink(path);
+    unlink(claim);
+    return ns_fd;
+}
+
+int netns_claim(net_mode_t mode, char* address, size_t size) {
+    char dir[256];
+    struct dirent* entry;
+
+    if (mode == NET_HOST || netns_pool_dir(mode, dir, sizeof(dir)) != 0) {
+        return -1;
+    }
+
+    // 最多嘗試兩次：第一次從池中取，池為空時當場創建一個再取
+    for (int attempt = 0; attempt < 2; attempt++) {
+        DIR* d = opendir(dir);
+        if (!d) {
+            return -1;
+        }
+        while ((entry = readdir(d)) != NULL) {
+            if (strncmp(entry->d_name, "ns-", 3) != 0 || strchr(entry->d_name, '.')) {
+                continue;
+            }
+            int fd = netns_take(dir, entry->d_name);
+            if (fd >= 0) {
+                if (mode == NET_BRIDGE) {
+                    netns_address(atoi(entry->d_name + 3), address, size);
+                } else {
+                    snprintf(address, size, "127.0.0.1");
+                }
+                closedir(d);
+                return fd;
+            }
+        }
+        closedir(d);
+        if (attempt == 0 && netns_create(mode) != 0) {
+            return -1;
+        }
+    }
+    return -1;
+}
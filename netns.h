@@ -0,0 +1,72 @@
+#ifndef NETNS_H
+#define NETNS_H
+
+#include <stddef.h>
+#include "runtime.h"
+
+// 預先創建的網絡命名空間池（每個命名空間 bind mount 到一個文件上保持存活）
+#define NETNS_POOL_DIR RUNTIME_DIR "/netns"
+
+// 池中保持的空閒命名空間數量（容器取走後在背景補充）
+#define NETNS_POOL_TARGET 4
+
+// bridge 模式使用的本地網橋（不做 NAT，只連接主機與容器）
+#define NETNS_BRIDGE "dic0"
+#define NETNS_BRIDGE_ADDR "10.88.0.1"
+#define NETNS_BRIDGE_PREFIX 16
+
+// 網絡模式
+typedef enum {
+    NET_HOST = 0,              // 共用主機的網絡棧（不使用 CLONE_NEWNET）
+    NET_LOOPBACK,              // 獨立的網絡命名空間，只有已啟用的 lo
+    NET_BRIDGE                 // lo + 連接到本地網橋的 veth (eth0)
+} net_mode_t;
+
+/**
+ * 解析網絡模式字串（host / loopback / bridge）
+ * @param str 模式字串
+ * @param mode 輸出的網絡模式
+ * @return 0 成功，-1 格式錯誤
+ */
+int netns_parse_mode(const char* str, net_mode_t* mode);
+
+/**
+ * 網絡模式的名稱
+ * @param mode 網絡模式
+ * @return 模式名稱
+ */
+const char* netns_mode_name(net_mode_t mode);
+
+/**
+ * 創建一個新的網絡命名空間並放入池中
+ * @param mode NET_LOOPBACK 或 NET_BRIDGE
+ * @return 0 成功，-1 失敗
+ */
+int netns_create(net_mode_t mode);
+
+/**
+ * 把池補充到 target 個空閒命名空間（同一時間只有一個進程在補充）
+ * @param mode 網絡模式
+ * @param target 目標數量
+ * @return 池中的數量，-1 失敗
+ */
+int netns_pool_fill(net_mode_t mode, int target);
+
+/**
+ * 在背景補充池（不等待完成）
+ * @param mode 網絡模式
+ * @param target 目標數量
+ */
+void netns_pool_refill_async(net_mode_t mode, int target);
+
+/**
+ * 從池中取出一個網絡命名空間；池為空時當場創建
+ * 取出後池中的 bind mount 被移除，命名空間隨最後一個使用它的進程結束而銷毀
+ * @param mode 網絡模式
+ * @param address 輸出容器 eth0 的 IPv4 地址（loopback 模式為 127.0.0.1）
+ * @param size 緩衝區大小
+ * @return 命名空間的文件描述符（可用於 setns），-1 失敗
+ */
+int netns_claim(net_mode_t mode, char* address, size_t size);
+
+#endif // NETNS_H
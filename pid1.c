@@ -0,0 +1,67 @@
+#include "pid1.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+int pid1_run(char** argv, char** envp) {
+    sigset_t all, old;
+
+    // 阻塞所有信號再以 sigwaitinfo 取出：
+    // 命名空間的 init 沒有處理函式時會忽略容器內發來的信號，被阻塞的信號則不受此限制
+    sigfillset(&all);
+    sigprocmask(SIG_BLOCK, &all, &old);
+
+    pid_t child = fork();
+    if (child == -1) {
+        perror("fork");
+        return 1;
+    }
+    if (child == 0) {
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        // 工作負載使用自己的進程組並成為終端的前台進程組，終端產生的信號 (Ctrl-C) 直接送給它
+        setpgid(0, 0);
+        if (isatty(STDIN_FILENO)) {
+            signal(SIGTTOU, SIG_IGN);
+            tcsetpgrp(STDIN_FILENO, getpid());
+            signal(SIGTTOU, SIG_DFL);
+        }
+        environ = envp;
+        execvp(argv[0], argv);
+        fprintf(stderr, "錯誤: 無法執行 %s: %s\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+
+    for (;;) {
+        siginfo_t info;
+        int sig = sigwaitinfo(&all, &info);
+        if (sig == -1) {
+            continue;
+        }
+
+        if (sig != SIGCHLD) {
+            // 終端的後台讀寫信號只可能來自 PID 1 自己，不轉發
+            if (sig != SIGTTIN && sig != SIGTTOU) {
+                kill(child, sig);
+            }
+            continue;
+        }
+
+        // 回收所有已結束的子進程（包括被重新指派給 PID 1 的孤兒進程）
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            if (pid != child) {
+                continue;
+            }
+            // 工作負載結束：PID 1 退出後內核會終止命名空間內剩餘的進程
+            if (WIFEXITED(status)) {
+                return WEXITSTATUS(status);
+            }
+            return 128 + WTERMSIG(status);
+        }
+    }
+}
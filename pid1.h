@@ -0,0 +1,15 @@
+#ifndef PID1_H
+#define PID1_H
+
+/**
+ * 以容器的 PID 1 身份運行工作負載（--init）
+ * fork 出工作負載後留在 PID 1：回收所有孤兒進程、把收到的信號轉發給工作負載，
+ * 工作負載退出後以相同的狀態退出（被信號終止時為 128 + 信號編號）
+ * 在容器內 chroot 並準備好文件系統之後調用
+ * @param argv 工作負載的命令（在 envp 的 PATH 中查找）
+ * @param envp 工作負載的環境變量
+ * @return 工作負載的退出碼
+ */
+int pid1_run(char** argv, char** envp);
+
+#endif // PID1_H
@@ -0,0 +1,663 @@
+#include "procfs.h"
+#include "cgroup.h"
+#include "cpuset.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <linux/fuse.h>
+
+// 單個虛擬文件的最大內容長度
+#define VIRTUAL_FILE_MAX (256 * 1024)
+
+// 讀取主機 /proc 文件時的緩衝區大小（大型主機的 cpuinfo / stat 可能很長）
+#define HOST_FILE_MAX (1024 * 1024)
+
+// 負載平均值的採樣間隔（與內核一致，5 秒）
+#define LOADAVG_INTERVAL_MS 5000
+
+// FUSE 請求緩衝區大小（必須不小於 max_write + 請求頭）
+#define FUSE_BUFFER_SIZE (132 * 1024)
+
+// 虛擬文件的內容生成函數
+typedef int (*render_fn)(const char* cgroup_name, char* buf, size_t size);
+
+// 虛擬文件表：名稱、生成函數、要覆蓋的容器內路徑
+static const struct {
+    const char* name;
+    render_fn render;
+    const char* target;
+} virtual_files[] = {
+    {"meminfo", render_meminfo, "/proc/meminfo"},
+    {"cpuinfo", render_cpuinfo, "/proc/cpuinfo"},
+    {"stat", render_stat, "/proc/stat"},
+    {"loadavg", render_loadavg, "/proc/loadavg"},
+    {"cpu_online", render_cpu_online, "/sys/devices/system/cpu/online"},
+    {"cpu_possible", render_cpu_online, "/sys/devices/system/cpu/possible"},
+};
+
+#define VIRTUAL_FILE_COUNT (sizeof(virtual_files) / sizeof(virtual_files[0]))
+
+// 容器 cgroup 的負載平均值（由伺服器每 5 秒採樣一次）
+static double container_loadavg[3];
+static int container_running;
+static int container_threads;
+
+// 已打開文件的內容快照（在 open 時生成，保證多次 read 之間內容一致）
+typedef struct {
+    size_t len;
+    char data[];
+} open_file_t;
+
+// 從 memory.stat 中讀取指定欄位（位元組）
+static long long stat_value(const char* stat, const char* key) {
+    size_t key_len = strlen(key);
+    const char* p = stat;
+    while (p && *p) {
+        if (strncmp(p, key, key_len) == 0 && p[key_len] == ' ') {
+            return atoll(p + key_len + 1);
+        }
+        p = strchr(p, '\n');
+        if (p) p++;
+    }
+    return 0;
+}
+
+// 讀取整個文件到緩衝區
+static int read_whole_file(const char* path, char* buf, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    size_t len = 0;
+    ssize_t n;
+    while (len + 1 < size && (n = read(fd, buf + len, size - len - 1)) > 0) {
+        len += n;
+    }
+    close(fd);
+    buf[len] = '\0';
+    return (int)len;
+}
+
+// 主機的 /proc/meminfo 中某一欄位（kB）
+static long long host_meminfo_kb(const char* key) {
+    char buf[8192];
+    if (read_whole_file("/proc/meminfo", buf, sizeof(buf)) < 0) {
+        return 0;
+    }
+    char* p = strstr(buf, key);
+    return p ? atoll(p + strlen(key) + 1) : 0;
+}
+
+// 根據容器 cgroup 的 memory.max / memory.current / memory.stat 生成 meminfo 內容
+int render_meminfo(const char* cgroup_name, char* buf, size_t size) {
+    int version = detect_cgroup_version();
+    char mem_path[512];
+    char path[600];
+    char value[64];
+    static char stat[16384];
+
+    get_cgroup_path(version, "memory", cgroup_name, mem_path, sizeof(mem_path));
+
+    long long host_total = host_meminfo_kb("MemTotal:") * 1024;
+    long long limit = -1, usage = 0, swap_limit = 0, swap_usage = 0;
+
+    if (read_cgroup_file(mem_path, version == 2 ? "memory.max" : "memory.limit_in_bytes", value, sizeof(value)) == 0 &&
+        strncmp(value, "max", 3) != 0) {
+        limit = atoll(value);
+    }
+    if (read_cgroup_file(mem_path, version == 2 ? "memory.current" : "memory.usage_in_bytes", value, sizeof(value)) == 0) {
+        usage = atoll(value);
+    }
+    if (version == 2) {
+        if (read_cgroup_file(mem_path, "memory.swap.max", value, sizeof(value)) == 0) {
+            swap_limit = strncmp(value, "max", 3) == 0 ? host_meminfo_kb("SwapTotal:") * 1024 : atoll(value);
+        }
+        if (read_cgroup_file(mem_path, "memory.swap.current", value, sizeof(value)) == 0) {
+            swap_usage = atoll(value);
+        }
+    }
+    snprintf(path, sizeof(path), "%s/memory.stat", mem_path);
+    if (read_whole_file(path, stat, sizeof(stat)) < 0) {
+        stat[0] = '\0';
+    }
+
+    // 沒有限制或限制超過主機記憶體時以主機總量為準
+    long long total = (limit < 0 || (host_total > 0 && limit > host_total)) ? host_total : limit;
+    if (usage > total) usage = total;
+
+    // v2 使用 file/anon，v1 使用 cache/rss
+    int v2 = version == 2;
+    long long file = stat_value(stat, v2 ? "file" : "total_cache");
+    long long shmem = stat_value(stat, v2 ? "shmem" : "total_shmem");
+    long long active_file = stat_value(stat, v2 ? "active_file" : "total_active_file");
+    long long inactive_file = stat_value(stat, v2 ? "inactive_file" : "total_inactive_file");
+    long long active_anon = stat_value(stat, v2 ? "active_anon" : "total_active_anon");
+    long long inactive_anon = stat_value(stat, v2 ? "inactive_anon" : "total_inactive_anon");
+    long long dirty = stat_value(stat, v2 ? "file_dirty" : "total_dirty");
+    long long writeback = stat_value(stat, v2 ? "file_writeback" : "total_writeback");
+    long long slab_reclaimable = stat_value(stat, "slab_reclaimable");
+    long long slab_unreclaimable = stat_value(stat, "slab_unreclaimable");
+    long long mapped = stat_value(stat, v2 ? "file_mapped" : "total_mapped_file");
+
+    long long free_bytes = total - usage;
+    // 可用記憶體 = 空閒 + 可回收的頁面快取 + 可回收的 slab
+    long long available = free_bytes + active_file + inactive_file + slab_reclaimable;
+    if (available > total) available = total;
+    if (swap_usage > swap_limit) swap_usage = swap_limit;
+
+    return snprintf(buf, size,
+                    "MemTotal:       %8lld kB\n"
+                    "MemFree:        %8lld kB\n"
+                    "MemAvailable:   %8lld kB\n"
+                    "Buffers:        %8d kB\n"
+                    "Cached:         %8lld kB\n"
+                    "SwapCached:     %8d kB\n"
+                    "Active:         %8lld kB\n"
+                    "Inactive:       %8lld kB\n"
+                    "Active(anon):   %8lld kB\n"
+                    "Inactive(anon): %8lld kB\n"
+                    "Active(file):   %8lld kB\n"
+                    "Inactive(file): %8lld kB\n"
+                    "SwapTotal:      %8lld kB\n"
+                    "SwapFree:       %8lld kB\n"
+                    "Dirty:          %8lld kB\n"
+                    "Writeback:      %8lld kB\n"
+                    "Mapped:         %8lld kB\n"
+                    "Shmem:          %8lld kB\n"
+                    "Slab:           %8lld kB\n"
+                    "SReclaimable:   %8lld kB\n"
+                    "SUnreclaim:     %8lld kB\n",
+                    total / 1024, free_bytes / 1024, available / 1024, 0, file / 1024, 0,
+                    (active_anon + active_file) / 1024, (inactive_anon + inactive_file) / 1024,
+                    active_anon / 1024, inactive_anon / 1024, active_file / 1024, inactive_file / 1024,
+                    swap_limit / 1024, (swap_limit - swap_usage) / 1024,
+                    dirty / 1024, writeback / 1024, mapped / 1024, shmem / 1024,
+                    (slab_reclaimable + slab_unreclaimable) / 1024,
+                    slab_reclaimable / 1024, slab_unreclaimable / 1024);
+}
+
+// 計算容器可見的 CPU：cpuset 有效 CPU 中的前 N 個，N 為 CPU 配額向上取整
+int effective_cpus(const char* cgroup_name, cpu_set_t* set) {
+    int version = detect_cgroup_version();
+    char path[512];
+    char buffer[1024];
+
+    CPU_ZERO(set);
+    get_cgroup_path(version, "cpuset", cgroup_name, path, sizeof(path));
+    if (read_cgroup_file(path, version == 2 ? "cpuset.cpus.effective" : "cpuset.effective_cpus", buffer, sizeof(buffer)) != 0 ||
+        cpuset_parse_list(buffer, set) != 0 || CPU_COUNT(set) == 0) {
+        if (read_cgroup_file("/sys/devices/system/cpu", "online", buffer, sizeof(buffer)) != 0 ||
+            cpuset_parse_list(buffer, set) != 0) {
+            CPU_ZERO(set);
+            CPU_SET(0, set);
+        }
+    }
+
+    // 配額限制：quota / period 向上取整
+    long quota = -1, period = 100000;
+    get_cgroup_path(version, "cpu", cgroup_name, path, sizeof(path));
+    if (version == 2) {
+        if (read_cgroup_file(path, "cpu.max", buffer, sizeof(buffer)) == 0 && strncmp(buffer, "max", 3) != 0) {
+            char* space = strchr(buffer, ' ');
+            quota = atol(buffer);
+            if (space) period = atol(space + 1);
+        }
+    } else if (read_cgroup_file(path, "cpu.cfs_quota_us", buffer, sizeof(buffer)) == 0) {
+        quota = atol(buffer);
+        if (read_cgroup_file(path, "cpu.cfs_period_us", buffer, sizeof(buffer)) == 0) {
+            period = atol(buffer);
+        }
+    }
+    if (quota > 0 && period > 0) {
+        int limit = (int)((quota + period - 1) / period);
+        int kept = 0;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (!CPU_ISSET(cpu, set)) continue;
+            if (kept < limit) kept++;
+            else CPU_CLR(cpu, set);
+        }
+    }
+    return CPU_COUNT(set);
+}
+
+// 只保留容器可見 CPU 的 /proc/cpuinfo，並重新編號 processor
+int render_cpuinfo(const char* cgroup_name, char* buf, size_t size) {
+    static char host[HOST_FILE_MAX];
+    cpu_set_t set;
+    size_t len = 0;
+    int next = 0;
+
+    effective_cpus(cgroup_name, &set);
+    if (read_whole_file("/proc/cpuinfo", host, sizeof(host)) < 0) {
+        return -1;
+    }
+
+    // cpuinfo 以空行分隔每個 CPU 的區塊
+    char* block = host;
+    while (*block) {
+        char* end = strstr(block, "\n\n");
+        size_t block_len = end ? (size_t)(end - block) + 2 : strlen(block);
+        int cpu;
+        if (sscanf(block, "processor : %d", &cpu) == 1 && CPU_ISSET(cpu, &set)) {
+            char* colon = strchr(block, ':');
+            char* eol = strchr(block, '\n');
+            if (colon && eol && colon < eol) {
+                int n = snprintf(buf + len, size - len, "processor\t: %d%.*s",
+                                 next++, (int)(block + block_len - eol), eol);
+                if (n < 0 || (size_t)n >= size - len) break;
+                len += n;
+            }
+        }
+        block += block_len;
+    }
+    return (int)len;
+}
+
+// 只保留容器可見 CPU 的 /proc/stat，並重新計算總和行
+int render_stat(const char* cgroup_name, char* buf, size_t size) {
+    static char host[HOST_FILE_MAX];
+    static char cpus[VIRTUAL_FILE_MAX];
+    unsigned long long total[10] = {0};
+    cpu_set_t set;
+    size_t cpus_len = 0;
+    int next = 0;
+
+    effective_cpus(cgroup_name, &set);
+    if (read_whole_file("/proc/stat", host, sizeof(host)) < 0) {
+        return -1;
+    }
+
+    char* rest = NULL;
+    char* saveptr = NULL;
+    for (char* line = strtok_r(host, "\n", &saveptr); line; line = strtok_r(NULL, "\n", &saveptr)) {
+        int cpu;
+        if (strncmp(line, "cpu ", 4) == 0) {
+            continue;
+        }
+        if (sscanf(line, "cpu%d", &cpu) != 1) {
+            // 第一個非 CPU 行之後的內容原樣輸出
+            rest = line;
+            break;
+        }
+        if (!CPU_ISSET(cpu, &set)) {
+            continue;
+        }
+        unsigned long long v[10] = {0};
+        char* fields = strchr(line, ' ');
+        sscanf(fields ? fields : "", "%llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+               &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8], &v[9]);
+        for (int i = 0; i < 10; i++) total[i] += v[i];
+        int n = snprintf(cpus + cpus_len, sizeof(cpus) - cpus_len, "cpu%d%s\n", next++, fields ? fields : "");
+        if (n < 0 || (size_t)n >= sizeof(cpus) - cpus_len) break;
+        cpus_len += n;
+    }
+
+    int len = snprintf(buf, size, "cpu  %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu\n%s",
+                       total[0], total[1], total[2], total[3], total[4],
+                       total[5], total[6], total[7], total[8], total[9], cpus);
+    if (len < 0 || (size_t)len >= size) {
+        return len;
+    }
+    // strtok_r 已把 rest 之後的換行替換為 '\0'，逐行還原輸出
+    while (rest && *rest) {
+        int n = snprintf(buf + len, size - len, "%s\n", rest);
+        if (n < 0 || (size_t)n >= size - len) break;
+        len += n;
+        rest = strtok_r(NULL, "\n", &saveptr);
+    }
+    return len;
+}
+
+// 容器自身 cgroup 的負載平均值
+int render_loadavg(const char* cgroup_name, char* buf, size_t size) {
+    (void)cgroup_name;
+    return snprintf(buf, size, "%.2f %.2f %.2f %d/%d 0\n",
+                    container_loadavg[0], container_loadavg[1], container_loadavg[2],
+                    container_running, container_threads);
+}
+
+// /sys/devices/system/cpu/online 與 possible：容器內的 CPU 編號為 0..N-1
+int render_cpu_online(const char* cgroup_name, char* buf, size_t size) {
+    cpu_set_t set;
+    int count = effective_cpus(cgroup_name, &set);
+    if (count <= 1) {
+        return snprintf(buf, size, "0\n");
+    }
+    return snprintf(buf, size, "0-%d\n", count - 1);
+}
+
+// 統計 cgroup 中處於可運行 (R) 或不可中斷睡眠 (D) 狀態的線程，更新負載平均值
+static void sample_loadavg(const char* cgroup_name, double elapsed_sec) {
+    static const double periods[3] = {60.0, 300.0, 900.0};
+    int version = detect_cgroup_version();
+    char path[600];
+    char cgroup_path[512];
+    int running = 0, threads = 0;
+
+    get_cgroup_path(version, "cpu", cgroup_name, cgroup_path, sizeof(cgroup_path));
+    snprintf(path, sizeof(path), "%s/%s", cgroup_path, version == 2 ? "cgroup.threads" : "tasks");
+    FILE* file = fopen(path, "r");
+    if (file) {
+        int tid;
+        while (fscanf(file, "%d", &tid) == 1) {
+            char stat_path[64];
+            char stat[512];
+            threads++;
+            snprintf(stat_path, sizeof(stat_path), "/proc/%d/stat", tid);
+            if (read_whole_file(stat_path, stat, sizeof(stat)) <= 0) {
+                continue;
+            }
+            // 狀態欄位位於命令名稱（括號內）之後
+            char* paren = strrchr(stat, ')');
+            if (paren && (paren[2] == 'R' || paren[2] == 'D')) {
+                running++;
+            }
+        }
+        fclose(file);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        double decay = exp(-elapsed_sec / periods[i]);
+        container_loadavg[i] = container_loadavg[i] * decay + running * (1.0 - decay);
+    }
+    container_running = running;
+    container_threads = threads;
+}
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 填入節點屬性：1 為根目錄，2.. 為 virtual_files 中的文件
+static void fill_attr(uint64_t nodeid, struct fuse_attr* attr) {
+    memset(attr, 0, sizeof(*attr));
+    attr->ino = nodeid;
+    attr->blksize = 4096;
+    if (nodeid == FUSE_ROOT_ID) {
+        attr->mode = S_IFDIR | 0555;
+        attr->nlink = 2;
+    } else {
+        // 內容在每次打開時動態生成，大小固定報告為 0，讀取時繞過頁面快取
+        attr->mode = S_IFREG | 0444;
+        attr->nlink = 1;
+    }
+}
+
+// 發送 FUSE 回覆
+static void fuse_reply(int fd, uint64_t unique, int error, const void* data, size_t len) {
+    struct fuse_out_header out;
+    struct iovec iov[2];
+
+    out.len = sizeof(out) + (error ? 0 : len);
+    out.error = error;
+    out.unique = unique;
+    iov[0].iov_base = &out;
+    iov[0].iov_len = sizeof(out);
+    iov[1].iov_base = (void*)data;
+    iov[1].iov_len = error ? 0 : len;
+    if (writev(fd, iov, 2) == -1) {
+        // 請求可能已被中斷，忽略
+    }
+}
+
+// 生成目錄列表
+static size_t fill_dirents(uint64_t offset, char* buf, size_t size) {
+    size_t len = 0;
+    for (uint64_t i = offset; i < VIRTUAL_FILE_COUNT; i++) {
+        size_t namelen = strlen(virtual_files[i].name);
+        size_t entlen = FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + namelen);
+        if (len + entlen > size) {
+            break;
+        }
+        struct fuse_dirent* dirent = (struct fuse_dirent*)(buf + len);
+        memset(dirent, 0, entlen);
+        dirent->ino = i + 2;
+        dirent->off = i + 1;
+        dirent->namelen = namelen;
+        dirent->type = DT_REG;
+        memcpy(dirent->name, virtual_files[i].name, namelen);
+        len += entlen;
+    }
+    return len;
+}
+
+// FUSE 伺服器主迴圈
+static void serve_fuse(int fd, const char* cgroup_name) {
+    static char buffer[FUSE_BUFFER_SIZE];
+    static char reply[FUSE_BUFFER_SIZE];
+
+    long long last_sample = monotonic_ms();
+    sample_loadavg(cgroup_name, 0);
+
+    for (;;) {
+        // 等待請求的同時每 5 秒採樣一次負載
+        long long now = monotonic_ms();
+        if (now - last_sample >= LOADAVG_INTERVAL_MS) {
+            sample_loadavg(cgroup_name, (now - last_sample) / 1000.0);
+            last_sample = now;
+        }
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, (int)(LOADAVG_INTERVAL_MS - (now - last_sample)));
+        if (ready == 0 || (ready == -1 && errno == EINTR)) {
+            continue;
+        }
+        if (ready == -1 || pfd.revents & (POLLERR | POLLHUP)) {
+            return;
+        }
+
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n == -1) {
+            if (errno == EINTR || errno == EAGAIN || errno == ENOENT) {
+                continue;
+            }
+            return; // ENODEV: 已被卸載
+        }
+        if ((size_t)n < sizeof(struct fuse_in_header)) {
+            continue;
+        }
+        struct fuse_in_header* in = (struct fuse_in_header*)buffer;
+        void* arg = buffer + sizeof(*in);
+
+        switch (in->opcode) {
+        case FUSE_INIT: {
+            struct fuse_init_in* init_in = arg;
+            struct fuse_init_out init_out;
+            memset(&init_out, 0, sizeof(init_out));
+            init_out.major = FUSE_KERNEL_VERSION;
+            init_out.minor = FUSE_KERNEL_MINOR_VERSION;
+            init_out.max_readahead = init_in->max_readahead;
+            init_out.max_background = 16;
+            init_out.congestion_threshold = 12;
+            init_out.max_write = 64 * 1024;
+            init_out.time_gran = 1;
+            fuse_reply(fd, in->unique, 0, &init_out, sizeof(init_out));
+            break;
+        }
+        case FUSE_LOOKUP: {
+            const char* name = arg;
+            struct fuse_entry_out entry;
+            int found = -1;
+            for (size_t i = 0; in->nodeid == FUSE_ROOT_ID && i < VIRTUAL_FILE_COUNT; i++) {
+                if (strcmp(name, virtual_files[i].name) == 0) {
+                    found = (int)i;
+                }
+            }
+            if (found < 0) {
+                fuse_reply(fd, in->unique, -ENOENT, NULL, 0);
+                break;
+            }
+            memset(&entry, 0, sizeof(entry));
+            entry.nodeid = found + 2;
+            entry.entry_valid = 60;
+            entry.attr_valid = 1;
+            fill_attr(entry.nodeid, &entry.attr);
+            fuse_reply(fd, in->unique, 0, &entry, sizeof(entry));
+            break;
+        }
+        case FUSE_GETATTR: {
+            struct fuse_attr_out attr_out;
+            memset(&attr_out, 0, sizeof(attr_out));
+            attr_out.attr_valid = 1;
+            fill_attr(in->nodeid, &attr_out.attr);
+            fuse_reply(fd, in->unique, 0, &attr_out, sizeof(attr_out));
+            break;
+        }
+        case FUSE_OPEN: {
+            struct fuse_open_out open_out;
+            uint64_t index = in->nodeid - 2;
+            if (in->nodeid < 2 || index >= VIRTUAL_FILE_COUNT) {
+                fuse_reply(fd, in->unique, -EISDIR, NULL, 0);
+                break;
+            }
+            open_file_t* file = malloc(sizeof(open_file_t) + VIRTUAL_FILE_MAX);
+            if (!file) {
+                fuse_reply(fd, in->unique, -ENOMEM, NULL, 0);
+                break;
+            }
+            int len = virtual_files[index].render(cgroup_name, file->data, VIRTUAL_FILE_MAX);
+            file->len = len < 0 ? 0 : (len >= VIRTUAL_FILE_MAX ? VIRTUAL_FILE_MAX - 1 : (size_t)len);
+            memset(&open_out, 0, sizeof(open_out));
+            open_out.fh = (uint64_t)(uintptr_t)file;
+            open_out.open_flags = FOPEN_DIRECT_IO;
+            fuse_reply(fd, in->unique, 0, &open_out, sizeof(open_out));
+            break;
+        }
+        case FUSE_READ: {
+            struct fuse_read_in* read_in = arg;
+            open_file_t* file = (open_file_t*)(uintptr_t)read_in->fh;
+            size_t len = 0;
+            if (read_in->offset < file->len) {
+                len = file->len - read_in->offset;
+                if (len > read_in->size) len = read_in->size;
+            }
+            fuse_reply(fd, in->unique, 0, file->data + read_in->offset, len);
+            break;
+        }
+        case FUSE_RELEASE: {
+            struct fuse_release_in* release_in = arg;
+            free((void*)(uintptr_t)release_in->fh);
+            fuse_reply(fd, in->unique, 0, NULL, 0);
+            break;
+        }
+        case FUSE_OPENDIR: {
+            struct fuse_open_out open_out;
+            memset(&open_out, 0, sizeof(open_out));
+            fuse_reply(fd, in->unique, 0, &open_out, sizeof(open_out));
+            break;
+        }
+        case FUSE_READDIR: {
+            struct fuse_read_in* read_in = arg;
+            size_t size = read_in->size < sizeof(reply) ? read_in->size : sizeof(reply);
+            size_t len = fill_dirents(read_in->offset, reply, size);
+            fuse_reply(fd, in->unique, 0, reply, len);
+            break;
+        }
+        case FUSE_RELEASEDIR:
+        case FUSE_FLUSH:
+        case FUSE_DESTROY:
+            fuse_reply(fd, in->unique, 0, NULL, 0);
+            break;
+        case FUSE_FORGET:
+        case FUSE_BATCH_FORGET:
+        case FUSE_INTERRUPT:
+            // 這些請求不需要回覆
+            break;
+        default:
+            fuse_reply(fd, in->unique, -ENOSYS, NULL, 0);
+            break;
+        }
+    }
+}
+
+// 在主機上掛載虛擬 proc 文件系統並啟動 FUSE 伺服器
+int virtual_proc_start(virtual_proc_t* vp, const char* mount_dir, const char* cgroup_name) {
+    char options[256];
+
+    vp->server_pid = -1;
+    snprintf(vp->mount_dir, sizeof(vp->mount_dir), "%s", mount_dir);
+    snprintf(vp->cgroup_name, sizeof(vp->cgroup_name), "%s", cgroup_name);
+
+    int fd = open("/dev/fuse", O_RDWR | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    if (mkdir(mount_dir, 0755) == -1 && errno != EEXIST) {
+        close(fd);
+        return -1;
+    }
+
+    // allow_other：容器在子用戶命名空間中，需要允許其他用戶訪問
+    snprintf(options, sizeof(options), "fd=%d,rootmode=40000,user_id=0,group_id=0,allow_other", fd);
+    if (mount("docker_in_c_proc", mount_dir, "fuse.docker_in_c_proc", MS_NOSUID | MS_NODEV | MS_NOEXEC, options) == -1) {
+        close(fd);
+        rmdir(mount_dir);
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        umount2(mount_dir, MNT_DETACH);
+        close(fd);
+        rmdir(mount_dir);
+        return -1;
+    }
+    if (pid == 0) {
+        // 伺服器隨 runtime 結束，並且不響應終端信號
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        signal(SIGINT, SIG_IGN);
+        signal(SIGQUIT, SIG_IGN);
+        signal(SIGTSTP, SIG_IGN);
+        serve_fuse(fd, cgroup_name);
+        _exit(0);
+    }
+
+    close(fd);
+    vp->server_pid = pid;
+    return 0;
+}
+
+// 卸載虛擬 proc 文件系統並停止 FUSE 伺服器
+void virtual_proc_stop(virtual_proc_t* vp) {
+    if (vp->server_pid <= 0) {
+        return;
+    }
+    umount2(vp->mount_dir, MNT_DETACH);
+    kill(vp->server_pid, SIGKILL);
+    waitpid(vp->server_pid, NULL, 0);
+    rmdir(vp->mount_dir);
+    vp->server_pid = -1;
+}
+
+// 在容器內把虛擬文件 bind mount 到 /proc 對應位置
+int virtual_proc_bind(void) {
+    char source[512];
+    int count = 0;
+
+    for (size_t i = 0; i < VIRTUAL_FILE_COUNT; i++) {
+        snprintf(source, sizeof(source), "%s/%s", VIRTUAL_PROC_DIR, virtual_files[i].name);
+        if (access(virtual_files[i].target, F_OK) != 0) {
+            continue;
+        }
+        if (mount(source, virtual_files[i].target, NULL, MS_BIND, NULL) == 0) {
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,95 @@
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include <sched.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// 容器內掛載虛擬 proc 文件目錄的位置（在容器根目錄下）
+#define VIRTUAL_PROC_DIR "/run/docker_in_c_proc"
+
+// 虛擬 proc 文件服務（本地 FUSE 伺服器）
+typedef struct {
+    pid_t server_pid;          // FUSE 伺服器進程 ID，-1 表示未運行
+    char mount_dir[256];       // 主機上的掛載點
+    char cgroup_name[128];     // 容器的 cgroup 名稱
+} virtual_proc_t;
+
+/**
+ * 根據容器 cgroup 的 memory.max / memory.current / memory.stat 生成 meminfo 內容
+ * @param cgroup_name cgroup 名稱
+ * @param buf 輸出緩衝區
+ * @param size 緩衝區大小
+ * @return 內容長度，-1 失敗
+ */
+int render_meminfo(const char* cgroup_name, char* buf, size_t size);
+
+/**
+ * 計算容器可見的 CPU 集合
+ * 取 cpuset 有效 CPU 中的前 N 個，N 為 CPU 配額 (quota / period) 向上取整
+ * @param cgroup_name cgroup 名稱
+ * @param set 輸出的 CPU 集合
+ * @return 可見的 CPU 數量
+ */
+int effective_cpus(const char* cgroup_name, cpu_set_t* set);
+
+/**
+ * 生成只包含容器可見 CPU 的 /proc/cpuinfo（processor 重新編號為 0..N-1）
+ * @param cgroup_name cgroup 名稱
+ * @param buf 輸出緩衝區
+ * @param size 緩衝區大小
+ * @return 內容長度，-1 失敗
+ */
+int render_cpuinfo(const char* cgroup_name, char* buf, size_t size);
+
+/**
+ * 生成只包含容器可見 CPU 的 /proc/stat，總和行只累加這些 CPU
+ * @param cgroup_name cgroup 名稱
+ * @param buf 輸出緩衝區
+ * @param size 緩衝區大小
+ * @return 內容長度，-1 失敗
+ */
+int render_stat(const char* cgroup_name, char* buf, size_t size);
+
+/**
+ * 生成容器自身 cgroup 的 /proc/loadavg（由 FUSE 伺服器每 5 秒採樣）
+ * @param cgroup_name cgroup 名稱
+ * @param buf 輸出緩衝區
+ * @param size 緩衝區大小
+ * @return 內容長度
+ */
+int render_loadavg(const char* cgroup_name, char* buf, size_t size);
+
+/**
+ * 生成 /sys/devices/system/cpu/online 與 possible 的內容 ("0-N")
+ * @param cgroup_name cgroup 名稱
+ * @param buf 輸出緩衝區
+ * @param size 緩衝區大小
+ * @return 內容長度
+ */
+int render_cpu_online(const char* cgroup_name, char* buf, size_t size);
+
+/**
+ * 在主機上掛載虛擬 proc 文件系統並啟動 FUSE 伺服器
+ * 每次打開文件時都會根據容器 cgroup 的即時狀態重新生成內容
+ * 必須在 clone() 之前調用，讓容器的掛載命名空間繼承此掛載
+ * @param vp 輸出的服務狀態
+ * @param mount_dir 主機上的掛載點（不存在時自動創建）
+ * @param cgroup_name 容器的 cgroup 名稱
+ * @return 0 成功，-1 失敗（例如沒有 /dev/fuse）
+ */
+int virtual_proc_start(virtual_proc_t* vp, const char* mount_dir, const char* cgroup_name);
+
+/**
+ * 卸載虛擬 proc 文件系統並停止 FUSE 伺服器
+ * @param vp 服務狀態
+ */
+void virtual_proc_stop(virtual_proc_t* vp);
+
+/**
+ * 在容器內把虛擬文件 bind mount 到 /proc 對應位置（在 chroot 並掛載 /proc 之後調用）
+ * @return 成功覆蓋的文件數
+ */
+int virtual_proc_bind(void);
+
+#endif // PROCFS_H
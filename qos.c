@@ -0,0 +1,53 @@
+#include "qos.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+
+// 各服務等級的調度配置（cpu_shares 經 cgroup v2 換算後：1024 為最高權重 10000，預設 512 為 5000）
+static const qos_profile_t profiles[] = {
+    [QOS_NORMAL]           = {"normal",           512,  0, SCHED_OTHER, 0,  0},
+    [QOS_LATENCY_CRITICAL] = {"latency-critical", 1024, 0, SCHED_OTHER, 50, 0},
+    [QOS_BATCH]            = {"batch",            128,  0, SCHED_BATCH, 0,  60},
+    [QOS_IDLE]             = {"idle",             2,    1, SCHED_IDLE,  0,  20},
+};
+
+int qos_parse(const char* name, qos_class_t* qos) {
+    for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        if (strcmp(name, profiles[i].name) == 0) {
+            *qos = (qos_class_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const qos_profile_t* qos_profile(qos_class_t qos) {
+    if ((unsigned)qos >= sizeof(profiles) / sizeof(profiles[0])) {
+        qos = QOS_NORMAL;
+    }
+    return &profiles[qos];
+}
+
+void qos_apply_limits(qos_class_t qos, cgroup_limits_t* limits, unsigned int mask) {
+    const qos_profile_t* profile = qos_profile(qos);
+    if (!(mask & CGROUP_SET_CPU_SHARES)) {
+        limits->cpu_shares = profile->cpu_shares;
+    }
+    limits->cpu_idle = profile->cpu_idle;
+    limits->cpu_uclamp_min = profile->uclamp_min;
+    limits->cpu_uclamp_max = profile->uclamp_max;
+}
+
+int qos_apply_sched(qos_class_t qos) {
+    const qos_profile_t* profile = qos_profile(qos);
+    if (profile->sched_policy == SCHED_OTHER) {
+        return 0;
+    }
+    struct sched_param param = {.sched_priority = 0};
+    if (sched_setscheduler(0, profile->sched_policy, &param) == -1) {
+        fprintf(stderr, "錯誤: 無法設置服務等級 %s 的調度策略: %s\n", profile->name, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
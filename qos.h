@@ -0,0 +1,54 @@
+#ifndef QOS_H
+#define QOS_H
+
+#include "cgroup.h"
+
+// CPU 調度的服務等級
+typedef enum {
+    QOS_NORMAL = 0,            // 預設：CFS/EEVDF 的普通權重
+    QOS_LATENCY_CRITICAL,      // 延遲敏感：最高權重，以 uclamp.min 保持 CPU 頻率，縮短喚醒延遲
+    QOS_BATCH,                 // 批量任務：低權重，SCHED_BATCH 不搶佔其他任務
+    QOS_IDLE                   // 閒置任務：cpu.idle + SCHED_IDLE，只使用其他容器剩下的 CPU
+} qos_class_t;
+
+// 服務等級對應的調度配置
+typedef struct {
+    const char* name;
+    int cpu_shares;            // 寫入 cpu.shares / 換算為 cpu.weight（未指定 --cpu-shares 時）
+    int cpu_idle;              // cpu.idle（cgroup 整體只在 CPU 閒置時運行）
+    int sched_policy;          // 容器 init 的調度策略 (SCHED_OTHER / SCHED_BATCH / SCHED_IDLE)
+    int uclamp_min;            // cpu.uclamp.min (%)，0 表示不設置
+    int uclamp_max;            // cpu.uclamp.max (%)，0 表示不設置
+} qos_profile_t;
+
+/**
+ * 解析服務等級名稱
+ * @param name latency-critical / normal / batch / idle
+ * @param qos 輸出的服務等級
+ * @return 0 成功，-1 無效的名稱
+ */
+int qos_parse(const char* name, qos_class_t* qos);
+
+/**
+ * 取得服務等級的調度配置
+ * @param qos 服務等級
+ * @return 調度配置（無效的等級返回 normal 的配置）
+ */
+const qos_profile_t* qos_profile(qos_class_t qos);
+
+/**
+ * 把服務等級的 cgroup 配置填入資源限制
+ * @param qos 服務等級
+ * @param limits 資源限制
+ * @param mask 命令列已明確指定的欄位（CGROUP_SET_CPU_SHARES 時保留指定的份額）
+ */
+void qos_apply_limits(qos_class_t qos, cgroup_limits_t* limits, unsigned int mask);
+
+/**
+ * 設置目前進程的調度策略（在 exec 之前調用，子孫繼承；降級到 SCHED_BATCH / SCHED_IDLE 不需要特權）
+ * @param qos 服務等級
+ * @return 0 成功，-1 失敗（已輸出錯誤信息）
+ */
+int qos_apply_sched(qos_class_t qos);
+
+#endif // QOS_H
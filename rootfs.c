@@ -6,6 +6,7 @@
 #include <sys/stat.h>
 #include <sys/mount.h>
 #include <errno.h>
+#include <fcntl.h>
 
 // 複製 terminfo 資料庫
 void terminfo_copy(const char* container_root) {
@@ -1045,3 +1046,90 @@ int setup_container_rootfs(const char* container_root, int use_copy) {
     return 0;
 }
 
+
+// 以新的掛載 API 掛載 OverlayFS，每層以一次 "lowerdir+" 加入（內核 6.8+），不受選項長度的一頁限制
+static int mount_overlay_layers(const char* target, const char* lowerdir, const char* upper_dir,
+                                const char* work_dir, int userxattr) {
+    char layer[4096];
+    int fs = fsopen("overlay", FSOPEN_CLOEXEC);
+    if (fs == -1) {
+        return -1;
+    }
+    int ok = 1;
+    for (const char* item = lowerdir; ok && *item; ) {
+        size_t len = strcspn(item, ":");
+        snprintf(layer, sizeof(layer), "%.*s", (int)len, item);
+        ok = fsconfig(fs, FSCONFIG_SET_STRING, "lowerdir+", layer, 0) == 0;
+        item += len + (item[len] == ':');
+    }
+    ok = ok && fsconfig(fs, FSCONFIG_SET_STRING, "upperdir", upper_dir, 0) == 0 &&
+         fsconfig(fs, FSCONFIG_SET_STRING, "workdir", work_dir, 0) == 0 &&
+         (!userxattr || fsconfig(fs, FSCONFIG_SET_FLAG, "userxattr", NULL, 0) == 0) &&
+         fsconfig(fs, FSCONFIG_CMD_CREATE, NULL, NULL, 0) == 0;
+    int mnt = ok ? fsmount(fs, FSMOUNT_CLOEXEC, 0) : -1;
+    int saved = errno;
+    close(fs);
+    if (mnt == -1) {
+        errno = saved;
+        return -1;
+    }
+    int result = move_mount(mnt, "", AT_FDCWD, target, MOVE_MOUNT_F_EMPTY_PATH);
+    saved = errno;
+    close(mnt);
+    errno = saved;
+    return result;
+}
+
+// 以導入的鏡像層作為 OverlayFS 的下層
+int setup_image_rootfs(const char* container_root, const char* layers_dir, const char* lowerdir) {
+    char upper_dir[512], work_dir[512], tmp_dir[600];
+    char options[8192];
+    
+    snprintf(upper_dir, sizeof(upper_dir), "%s_upper", container_root);
+    snprintf(work_dir, sizeof(work_dir), "%s_work", container_root);
+    if ((mkdir(container_root, 0755) == -1 && errno != EEXIST) ||
+        (mkdir(upper_dir, 0755) == -1 && errno != EEXIST) ||
+        (mkdir(work_dir, 0755) == -1 && errno != EEXIST)) {
+        fprintf(stderr, "錯誤: 無法創建容器目錄: %s\n", strerror(errno));
+        return -1;
+    }
+    
+    // lowerdir 是相對於層目錄的名稱，掛載時以層目錄作為工作目錄（選項長度限制為一頁）
+    // 在用戶命名空間中掛載時，OverlayFS 只能讀寫 user.overlay.* 屬性，需要 userxattr
+    const char* extra[] = {",userxattr", ""};
+    int mounted = -1;
+    if (chdir(layers_dir) == -1) {
+        fprintf(stderr, "錯誤: 無法進入鏡像層目錄 %s: %s\n", layers_dir, strerror(errno));
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(extra) / sizeof(extra[0]) && mounted != 0; i++) {
+        int len = snprintf(options, sizeof(options), "lowerdir=%s,upperdir=%s,workdir=%s%s",
+                           lowerdir, upper_dir, work_dir, extra[i]);
+        if (len < sysconf(_SC_PAGESIZE) && (size_t)len < sizeof(options)) {
+            mounted = mount("overlay", container_root, "overlay", 0, options);
+        } else {
+            // 層數多的鏡像超過一頁，逐層傳給內核
+            mounted = mount_overlay_layers(container_root, lowerdir, upper_dir, work_dir, extra[i][0] != '\0');
+        }
+    }
+    if (mounted != 0) {
+        fprintf(stderr, "錯誤: 無法掛載鏡像的 OverlayFS: %s\n", strerror(errno));
+    }
+    if (chdir("/") == -1) {
+        return -1;
+    }
+    if (mounted != 0) {
+        return -1;
+    }
+    
+    // 鏡像不一定帶有掛載點和 /tmp（例如只含單個可執行文件的鏡像），在 upper 層補上
+    const char* mount_points[] = {"dev", "proc", "sys"};
+    for (size_t i = 0; i < sizeof(mount_points) / sizeof(mount_points[0]); i++) {
+        snprintf(tmp_dir, sizeof(tmp_dir), "%s/%s", container_root, mount_points[i]);
+        mkdir(tmp_dir, 0755);
+    }
+    snprintf(tmp_dir, sizeof(tmp_dir), "%s/tmp", container_root);
+    mkdir(tmp_dir, 01777);
+    chmod(tmp_dir, 01777);
+    return 0;
+}
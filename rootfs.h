@@ -25,6 +25,15 @@ int create_base_rootfs(void);
  */
 int setup_container_rootfs(const char* container_root, int use_copy);
 
+/**
+ * 以導入的鏡像為容器準備 rootfs（OverlayFS，鏡像的層作為只讀的下層）
+ * @param container_root 容器根目錄路徑
+ * @param layers_dir 層目錄（lowerdir 中的名稱相對於此目錄）
+ * @param lowerdir 以 ':' 分隔的層，最上層在前
+ * @return 0 成功，-1 失敗
+ */
+int setup_image_rootfs(const char* container_root, const char* layers_dir, const char* lowerdir);
+
 /**
  * 複製命令及其依賴庫
  * @param cmd_path 命令路徑
@@ -0,0 +1,74 @@
+#include "runtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+
+// 確保 runtime 目錄存在
+static int ensure_runtime_dirs(void) {
+    if (mkdir(RUNTIME_DIR, 0755) == -1 && errno != EEXIST) {
+        return -1;
+    }
+    if (mkdir(RUNTIME_CONTAINERS_DIR, 0755) == -1 && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+// 取得容器在 runtime 目錄中的專屬目錄路徑
+void container_runtime_path(const char* id, char* path, size_t size) {
+    snprintf(path, size, "%s/%s", RUNTIME_CONTAINERS_DIR, id);
+}
+
+// 分配新的容器 ID
+int allocate_container_id(char* id, size_t size) {
+    char path[512];
+
+    if (size < CONTAINER_ID_LEN + 1) {
+        return -1;
+    }
+    if (ensure_runtime_dirs() != 0) {
+        fprintf(stderr, "錯誤: 無法創建 runtime 目錄 %s: %s\n", RUNTIME_DIR, strerror(errno));
+        return -1;
+    }
+
+    for (int attempt = 0; attempt < 16; attempt++) {
+        uint64_t value;
+        if (getrandom(&value, sizeof(value), 0) != sizeof(value)) {
+            return -1;
+        }
+        snprintf(id, size, "%016llx", (unsigned long long)value);
+
+        // mkdir 是原子操作：目錄已存在時返回 EEXIST，換一個 ID 重試
+        container_runtime_path(id, path, sizeof(path));
+        if (mkdir(path, 0700) == 0) {
+            return 0;
+        }
+        if (errno != EEXIST) {
+            fprintf(stderr, "錯誤: 無法預留容器 ID: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+    return -1;
+}
+
+// 釋放容器 ID 的預留
+void release_container_id(const char* id) {
+    char path[512];
+    char cmd[600];
+
+    if (!id[0] || strchr(id, '/') || strchr(id, '.')) {
+        return;
+    }
+    container_runtime_path(id, path, sizeof(path));
+    if (rmdir(path) == -1 && errno == ENOTEMPTY) {
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", path);
+        if (system(cmd) == -1) {
+            perror("清理 runtime 目錄");
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <stddef.h>
+
+// runtime 狀態目錄（容器 ID 預留、狀態記錄等）
+#define RUNTIME_DIR "/tmp/docker_in_c_run"
+
+// 已預留的容器 ID 目錄
+#define RUNTIME_CONTAINERS_DIR RUNTIME_DIR "/containers"
+
+// 容器 ID 長度（64 位隨機數的十六進位表示）
+#define CONTAINER_ID_LEN 16
+
+/**
+ * 分配新的容器 ID
+ * 以 getrandom() 生成 64 位隨機 ID，並以 mkdir 在 RUNTIME_CONTAINERS_DIR 中原子預留，
+ * 即使大量容器在同一時間並行啟動也不會重複
+ * @param id 輸出的容器 ID
+ * @param size 緩衝區大小（至少 CONTAINER_ID_LEN + 1）
+ * @return 0 成功，-1 失敗
+ */
+int allocate_container_id(char* id, size_t size);
+
+/**
+ * 釋放容器 ID 的預留
+ * @param id 容器 ID
+ */
+void release_container_id(const char* id);
+
+/**
+ * 取得容器在 runtime 目錄中的專屬目錄路徑
+ * @param id 容器 ID
+ * @param path 輸出路徑
+ * @param size 緩衝區大小
+ */
+void container_runtime_path(const char* id, char* path, size_t size);
+
+#endif // RUNTIME_H
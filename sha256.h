@@ -0,0 +1,46 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_LEN 32
+#define SHA256_HEX_LEN 64
+
+// 增量計算的 SHA-256 狀態（用於邊讀取邊校驗的層內容）
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;           // 已輸入的位元組數
+    unsigned char buffer[64];
+    size_t buffered;
+} sha256_t;
+
+/**
+ * 初始化 SHA-256 狀態
+ * @param ctx 狀態
+ */
+void sha256_init(sha256_t* ctx);
+
+/**
+ * 輸入數據
+ * @param ctx 狀態
+ * @param data 數據
+ * @param len 長度
+ */
+void sha256_update(sha256_t* ctx, const void* data, size_t len);
+
+/**
+ * 結束計算並輸出 32 位元組的摘要
+ * @param ctx 狀態
+ * @param digest 輸出緩衝區（SHA256_DIGEST_LEN）
+ */
+void sha256_final(sha256_t* ctx, unsigned char* digest);
+
+/**
+ * 結束計算並輸出 64 個字元的十六進位摘要
+ * @param ctx 狀態
+ * @param hex 輸出緩衝區（至少 SHA256_HEX_LEN + 1）
+ */
+void sha256_final_hex(sha256_t* ctx, char* hex);
+
+#endif // SHA256_H
@@ -0,0 +1,323 @@
+#include "state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define STATE_TABLE_MAGIC 0x44494354u  // "DICT"
+#define STATE_TABLE_VERSION 7
+
+// 狀態表文件頭
+// 存活的記錄以雙向鏈表串起，ps 只需遍歷存活的容器；空閒槽位以單向鏈表串起，分配為 O(1)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t live_count;
+    int32_t live_head;         // 第一個存活記錄的槽位，-1 表示沒有
+    int32_t free_head;         // 第一個空閒槽位，-1 表示表已滿
+} state_header_t;
+
+// 一個槽位
+typedef struct {
+    int32_t next;
+    int32_t prev;
+    container_record_t record;
+} state_slot_t;
+
+// 已映射的狀態表
+typedef struct {
+    int fd;
+    state_header_t* header;
+    state_slot_t* slots;
+    size_t size;
+} state_table_t;
+
+static size_t state_table_size(void) {
+    return sizeof(state_header_t) + (size_t)STATE_TABLE_CAPACITY * sizeof(state_slot_t);
+}
+
+// 初始化新的狀態表（調用者持有排他鎖）
+static void state_table_init(state_table_t* table) {
+    state_header_t* header = table->header;
+
+    header->magic = STATE_TABLE_MAGIC;
+    header->version = STATE_TABLE_VERSION;
+    header->capacity = STATE_TABLE_CAPACITY;
+    header->live_count = 0;
+    header->live_head = -1;
+    header->free_head = 0;
+    for (int i = 0; i < STATE_TABLE_CAPACITY; i++) {
+        table->slots[i].next = i + 1 < STATE_TABLE_CAPACITY ? i + 1 : -1;
+        table->slots[i].prev = -1;
+    }
+}
+
+// 檢查文件大小及文件頭是否與目前的格式一致
+static int state_table_valid(int fd, const struct stat* st) {
+    state_header_t header;
+
+    if ((size_t)st->st_size != state_table_size() ||
+        pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+        return 0;
+    }
+    return header.magic == STATE_TABLE_MAGIC && header.version == STATE_TABLE_VERSION &&
+           header.capacity == STATE_TABLE_CAPACITY;
+}
+
+// 打開並映射狀態表，持有 flock 直到 state_table_close
+// @param lock LOCK_SH（讀取）或 LOCK_EX（修改）
+// @param create 文件不存在時是否創建
+static int state_table_open(state_table_t* table, int lock, int create) {
+    struct stat st;
+    size_t size = state_table_size();
+
+    if (create && mkdir(RUNTIME_DIR, 0755) == -1 && errno != EEXIST) {
+        return -1;
+    }
+    table->fd = open(STATE_TABLE_PATH, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+    if (table->fd == -1) {
+        return -1;
+    }
+    if (flock(table->fd, lock) == -1 || fstat(table->fd, &st) == -1) {
+        close(table->fd);
+        return -1;
+    }
+
+    // 新文件或舊版本的表：升級為排他鎖後重建（升級期間可能已被其他進程初始化，重新檢查）
+    int fresh = 0;
+    if (!state_table_valid(table->fd, &st)) {
+        if (lock != LOCK_EX && flock(table->fd, LOCK_EX) == -1) {
+            close(table->fd);
+            return -1;
+        }
+        if (fstat(table->fd, &st) == -1) {
+            close(table->fd);
+            return -1;
+        }
+        if (!state_table_valid(table->fd, &st)) {
+            if (st.st_size != 0) {
+                // 記錄只在 runtime 存活期間有意義，格式變更後直接丟棄舊表
+                fprintf(stderr, "警告: 狀態表 %s 格式不符（舊版本），重新建立\n", STATE_TABLE_PATH);
+            }
+            if (ftruncate(table->fd, 0) == -1 || ftruncate(table->fd, size) == -1) {
+                fprintf(stderr, "錯誤: 無法建立狀態表 %s\n", STATE_TABLE_PATH);
+                close(table->fd);
+                return -1;
+            }
+            fresh = 1;
+        }
+    }
+
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, table->fd, 0);
+    if (map == MAP_FAILED) {
+        close(table->fd);
+        return -1;
+    }
+    table->header = map;
+    table->slots = (state_slot_t*)((char*)map + sizeof(state_header_t));
+    table->size = size;
+
+    if (fresh) {
+        state_table_init(table);
+    }
+    return 0;
+}
+
+static void state_table_close(state_table_t* table) {
+    munmap(table->header, table->size);
+    close(table->fd);  // 同時釋放 flock
+}
+
+// 把槽位從存活鏈表移到空閒鏈表
+static void state_slot_free(state_table_t* table, int index) {
+    state_slot_t* slot = &table->slots[index];
+
+    if (slot->prev >= 0) {
+        table->slots[slot->prev].next = slot->next;
+    } else {
+        table->header->live_head = slot->next;
+    }
+    if (slot->next >= 0) {
+        table->slots[slot->next].prev = slot->prev;
+    }
+    memset(&slot->record, 0, sizeof(slot->record));
+    slot->prev = -1;
+    slot->next = table->header->free_head;
+    table->header->free_head = index;
+    table->header->live_count--;
+}
+
+// 在存活鏈表中查找 ID（exact 為 0 時匹配唯一前綴）
+// @return 槽位索引，-1 找不到，-2 前綴不唯一
+static int state_slot_find(state_table_t* table, const char* id, int exact) {
+    size_t len = strlen(id);
+    int found = -1;
+
+    if (len == 0) {
+        return -1;
+    }
+    for (int i = table->header->live_head; i >= 0; i = table->slots[i].next) {
+        const char* slot_id = table->slots[i].record.id;
+        if (strcmp(slot_id, id) == 0) {
+            return i;
+        }
+        if (!exact && strncmp(slot_id, id, len) == 0) {
+            if (found >= 0) {
+                return -2;
+            }
+            found = i;
+        }
+    }
+    return exact ? -1 : found;
+}
+
+uint64_t read_pid_starttime(pid_t pid) {
+    char path[64];
+    char buf[1024];
+    unsigned long long starttime = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return 0;
+    }
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+
+    // comm 可能包含空格和括號，從最後一個 ')' 之後開始數欄位（第 3 欄起）
+    char* p = strrchr(buf, ')');
+    if (!p) {
+        return 0;
+    }
+    p++;
+    for (int field = 3; field < 22 && p; field++) {
+        p = strchr(p + 1, ' ');
+    }
+    if (p) {
+        sscanf(p, " %llu", &starttime);
+    }
+    return starttime;
+}
+
+int state_is_alive(const container_record_t* record) {
+    if (record->runtime_pid <= 0) {
+        return 0;
+    }
+    return kill(record->runtime_pid, 0) == 0 || errno == EPERM;
+}
+
+const char* container_status_name(int status) {
+    switch (status) {
+    case CONTAINER_CREATED: return "created";
+    case CONTAINER_RUNNING: return "running";
+    case CONTAINER_EXITED:  return "exited";
+    default:                return "unknown";
+    }
+}
+
+int state_add(const container_record_t* record) {
+    state_table_t table;
+
+    if (state_table_open(&table, LOCK_EX, 1) != 0) {
+        fprintf(stderr, "錯誤: 無法打開狀態表 %s: %s\n", STATE_TABLE_PATH, strerror(errno));
+        return -1;
+    }
+
+    // 回收 runtime 已不存在（例如被 SIGKILL）的殘留記錄
+    for (int i = table.header->live_head; i >= 0; ) {
+        int next = table.slots[i].next;
+        if (!state_is_alive(&table.slots[i].record)) {
+            state_slot_free(&table, i);
+        }
+        i = next;
+    }
+
+    if (state_slot_find(&table, record->id, 1) >= 0) {
+        state_table_close(&table);
+        return -1;
+    }
+    int index = table.header->free_head;
+    if (index < 0) {
+        fprintf(stderr, "錯誤: 狀態表已滿（最多 %d 個容器）\n", STATE_TABLE_CAPACITY);
+        state_table_close(&table);
+        return -1;
+    }
+
+    state_slot_t* slot = &table.slots[index];
+    table.header->free_head = slot->next;
+    slot->record = *record;
+    slot->prev = -1;
+    slot->next = table.header->live_head;
+    if (slot->next >= 0) {
+        table.slots[slot->next].prev = index;
+    }
+    table.header->live_head = index;
+    table.header->live_count++;
+
+    state_table_close(&table);
+    return 0;
+}
+
+int state_update(const container_record_t* record) {
+    state_table_t table;
+
+    if (state_table_open(&table, LOCK_EX, 0) != 0) {
+        return -1;
+    }
+    int index = state_slot_find(&table, record->id, 1);
+    if (index >= 0) {
+        table.slots[index].record = *record;
+    }
+    state_table_close(&table);
+    return index >= 0 ? 0 : -1;
+}
+
+void state_remove(const char* id) {
+    state_table_t table;
+
+    if (state_table_open(&table, LOCK_EX, 0) != 0) {
+        return;
+    }
+    int index = state_slot_find(&table, id, 1);
+    if (index >= 0) {
+        state_slot_free(&table, index);
+    }
+    state_table_close(&table);
+}
+
+int state_find(const char* id, container_record_t* record) {
+    state_table_t table;
+
+    if (state_table_open(&table, LOCK_SH, 0) != 0) {
+        return -1;
+    }
+    int index = state_slot_find(&table, id, 0);
+    if (index >= 0) {
+        *record = table.slots[index].record;
+    }
+    state_table_close(&table);
+    return index >= 0 ? 0 : -1;
+}
+
+int state_list(container_record_t* records, int max) {
+    state_table_t table;
+    int count = 0;
+
+    if (state_table_open(&table, LOCK_SH, 0) != 0) {
+        // 還沒有任何容器啟動過
+        return errno == ENOENT ? 0 : -1;
+    }
+    for (int i = table.header->live_head; i >= 0 && count < max; i = table.slots[i].next) {
+        records[count++] = table.slots[i].record;
+    }
+    state_table_close(&table);
+    return count;
+}
@@ -0,0 +1,109 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "cgroup.h"
+#include "runtime.h"
+
+// 容器狀態表文件（記憶體映射的固定大小表，所有 runtime 進程共用）
+#define STATE_TABLE_PATH RUNTIME_DIR "/state.table"
+
+// 狀態表容量（同時存在的容器上限）
+#define STATE_TABLE_CAPACITY 4096
+
+// 容器狀態
+typedef enum {
+    CONTAINER_CREATED = 0,     // 已分配 ID，尚未啟動
+    CONTAINER_RUNNING,         // 運行中
+    CONTAINER_EXITED,          // 已退出，正在清理
+} container_status_t;
+
+// 容器記錄
+typedef struct {
+    char id[CONTAINER_ID_LEN + 1];
+    int32_t status;            // container_status_t
+    int32_t pid;               // 容器 init 進程的主機 PID
+    int32_t runtime_pid;       // 管理此容器的 runtime 進程 PID
+    uint64_t pid_starttime;    // init 進程的啟動時間 (jiffies)，用於檢測 PID 重用
+    int64_t started_at;        // 啟動時間 (Unix 秒)
+    int32_t exit_code;         // 退出碼（status 為 EXITED 時有效）
+    int32_t rootfs_mode;       // 0 = bind, 1 = copy, 2 = overlay
+    char pidfd_path[32];       // 可打開為 pidfd 的路徑 (/proc/<pid>)
+    char cgroup_name[128];
+    char rootfs[256];
+    int64_t memory_limit_mb;
+    int32_t cpu_shares;
+    int32_t cpu_quota_us;
+    int32_t cpu_period_us;
+    int32_t cpu_burst_us;
+    int32_t pids_max;
+    char cpuset_cpus[256];
+    int32_t net_mode;          // net_mode_t
+    char address[16];          // 容器的 IPv4 地址（bridge 模式）
+    char image[128];           // 導入的鏡像名稱，使用基礎 rootfs 時為空
+    int32_t ksm;               // 容器內的進程是否可被 KSM 合併
+    int32_t qos;               // qos_class_t
+    int32_t thp_mode;          // thp_mode_t
+    int32_t numa_mode;         // numa_mode_t
+    char numa_nodes[64];       // NUMA 策略的節點列表
+} container_record_t;
+
+/**
+ * 新增容器記錄
+ * @param record 容器記錄
+ * @return 0 成功，-1 失敗（表已滿或無法打開）
+ */
+int state_add(const container_record_t* record);
+
+/**
+ * 以相同 ID 覆蓋已存在的容器記錄
+ * @param record 容器記錄
+ * @return 0 成功，-1 找不到
+ */
+int state_update(const container_record_t* record);
+
+/**
+ * 刪除容器記錄
+ * @param id 容器 ID
+ */
+void state_remove(const char* id);
+
+/**
+ * 查找容器記錄（支援唯一的 ID 前綴）
+ * @param id 容器 ID 或前綴
+ * @param record 輸出的容器記錄
+ * @return 0 成功，-1 找不到或前綴不唯一
+ */
+int state_find(const char* id, container_record_t* record);
+
+/**
+ * 列出所有容器記錄（只遍歷存活的記錄，O(容器數)）
+ * @param records 輸出陣列
+ * @param max 陣列容量
+ * @return 記錄數量，-1 失敗
+ */
+int state_list(container_record_t* records, int max);
+
+/**
+ * 判斷記錄對應的 runtime 是否仍然存活（runtime 崩潰時記錄會殘留）
+ * @param record 容器記錄
+ * @return 1 存活，0 已不存在
+ */
+int state_is_alive(const container_record_t* record);
+
+/**
+ * 讀取進程的啟動時間 (/proc/<pid>/stat 第 22 欄)
+ * @param pid 進程 ID
+ * @return 啟動時間 (jiffies)，失敗返回 0
+ */
+uint64_t read_pid_starttime(pid_t pid);
+
+/**
+ * 容器狀態的文字表示
+ * @param status 容器狀態
+ * @return 狀態名稱
+ */
+const char* container_status_name(int status);
+
+#endif // STATE_H
@@ -0,0 +1,197 @@
+#include "volume.h"
+#include "namespace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+
+// 逐層創建主機上的目錄，新建的目錄交給真實用戶（容器內的 root 映射到該用戶）
+static int mkdir_host_path(const char* path) {
+    char buf[512];
+
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char* p = buf + 1; ; p++) {
+        if (*p != '/' && *p != '\0') {
+            continue;
+        }
+        char saved = *p;
+        *p = '\0';
+        if (mkdir(buf, 0755) == 0) {
+            if (chown(buf, get_real_uid(), get_real_gid()) == -1) {
+                fprintf(stderr, "警告: 無法設置 %s 的擁有者: %s\n", buf, strerror(errno));
+            }
+        } else if (errno != EEXIST) {
+            return -1;
+        }
+        *p = saved;
+        if (saved == '\0') {
+            return 0;
+        }
+    }
+}
+
+// 容器內的路徑必須是絕對路徑，且不能是根目錄本身
+static int volume_check_target(const char* target) {
+    return target[0] == '/' && target[strspn(target, "/")] != '\0' ? 0 : -1;
+}
+
+int volume_parse_bind(const char* spec, volume_t* volume) {
+    char buf[768];
+    struct stat st;
+
+    memset(volume, 0, sizeof(*volume));
+    volume->type = VOLUME_BIND;
+    snprintf(buf, sizeof(buf), "%s", spec);
+
+    char* source = buf;
+    char* target = strchr(source, ':');
+    if (!target || target == source) {
+        return -1;
+    }
+    *target++ = '\0';
+    char* mode = strchr(target, ':');
+    if (mode) {
+        *mode++ = '\0';
+        if (strcmp(mode, "ro") == 0) {
+            volume->read_only = 1;
+        } else if (strcmp(mode, "rw") != 0) {
+            return -1;
+        }
+    }
+    if (volume_check_target(target) != 0 || strlen(target) >= sizeof(volume->target)) {
+        return -1;
+    }
+    snprintf(volume->target, sizeof(volume->target), "%s", target);
+
+    // 主機路徑不存在時創建為目錄（例如第一次運行時的數據庫目錄）
+    if (stat(source, &st) == -1) {
+        if (errno != ENOENT || mkdir_host_path(source) == -1 || stat(source, &st) == -1) {
+            fprintf(stderr, "錯誤: 無法使用主機路徑 %s: %s\n", source, strerror(errno));
+            return -1;
+        }
+    }
+    char resolved[PATH_MAX];
+    if (!realpath(source, resolved) || strlen(resolved) >= sizeof(volume->source)) {
+        fprintf(stderr, "錯誤: 無法解析主機路徑 %s\n", source);
+        return -1;
+    }
+    memcpy(volume->source, resolved, strlen(resolved) + 1);
+    volume->is_dir = S_ISDIR(st.st_mode);
+    return 0;
+}
+
+int volume_parse_tmpfs(const char* spec, volume_t* volume) {
+    char buf[256];
+
+    memset(volume, 0, sizeof(*volume));
+    volume->type = VOLUME_TMPFS;
+    volume->is_dir = 1;
+    volume->size_mb = TMPFS_DEFAULT_SIZE_MB;
+    snprintf(buf, sizeof(buf), "%s", spec);
+
+    char* size = strchr(buf, ':');
+    if (size) {
+        *size++ = '\0';
+        volume->size_mb = atol(size);
+        if (volume->size_mb <= 0) {
+            return -1;
+        }
+    }
+    if (volume_check_target(buf) != 0) {
+        return -1;
+    }
+    snprintf(volume->target, sizeof(volume->target), "%s", buf);
+    return 0;
+}
+
+// 在容器根目錄內逐層打開（必要時創建）掛載點
+// @return 掛載點的 O_PATH 文件描述符，-1 失敗
+static int volume_open_target(int root_fd, const char* target, int is_dir) {
+    char path[256], prefix[256] = "";
+    char* saveptr;
+    int parent = dup(root_fd);
+
+    snprintf(path, sizeof(path), "%s", target);
+    char* name = strtok_r(path, "/", &saveptr);
+    while (name && parent != -1) {
+        char* next = strtok_r(NULL, "/", &saveptr);
+        int want_dir = next || is_dir;
+        size_t len = strlen(prefix);
+        snprintf(prefix + len, sizeof(prefix) - len, "/%s", name);
+
+        int fd = open_in_root(root_fd, prefix, O_PATH | (want_dir ? O_DIRECTORY : 0));
+        if (fd == -1 && errno == ENOENT) {
+            if (want_dir) {
+                mkdirat(parent, name, 0755);
+            } else {
+                int file = openat(parent, name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+                if (file != -1) close(file);
+            }
+            fd = open_in_root(root_fd, prefix, O_PATH | (want_dir ? O_DIRECTORY : 0));
+        }
+        close(parent);
+        parent = fd;
+        name = next;
+    }
+    return parent;
+}
+
+int volume_mount(const char* container_root, const volume_t* volume) {
+    char fd_path[64], data[64];
+    int ret = -1;
+
+    int root_fd = open(container_root, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd == -1) {
+        return -1;
+    }
+    int target_fd = volume_open_target(root_fd, volume->target, volume->is_dir);
+    if (target_fd == -1) {
+        fprintf(stderr, "錯誤: 無法在容器中創建掛載點 %s: %s\n", volume->target, strerror(errno));
+        close(root_fd);
+        return -1;
+    }
+
+    // 透過 /proc/self/fd 掛載到已解析的掛載點上，不再經過路徑查找
+    snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d", target_fd);
+    if (volume->type == VOLUME_TMPFS) {
+        snprintf(data, sizeof(data), "size=%ldm,mode=1777", volume->size_mb);
+        ret = mount("tmpfs", fd_path, "tmpfs", MS_NOSUID | MS_NODEV, data);
+    } else {
+        ret = mount(volume->source, fd_path, NULL, MS_BIND | MS_REC, NULL);
+    }
+    close(target_fd);
+    if (ret == -1) {
+        fprintf(stderr, "錯誤: 無法掛載卷到 %s: %s\n", volume->target, strerror(errno));
+        close(root_fd);
+        return -1;
+    }
+
+    // 只讀卷：MS_REMOUNT | MS_RDONLY 只影響頂層掛載，以 mount_setattr(AT_RECURSIVE) 把來源下的子掛載一併設為只讀
+    // （只添加 MOUNT_ATTR_RDONLY，來源已有的 nosuid/nodev 等標誌保持不變）
+    if (volume->type == VOLUME_BIND && volume->read_only) {
+        struct mount_attr attr = {.attr_set = MOUNT_ATTR_RDONLY};
+        // 重新打開以取得新掛載的根，而不是被覆蓋的掛載點
+        target_fd = open_in_root(root_fd, volume->target, O_PATH);
+        if (target_fd == -1 ||
+            mount_setattr(target_fd, "", AT_EMPTY_PATH | AT_RECURSIVE, &attr, sizeof(attr)) == -1) {
+            fprintf(stderr, "錯誤: 無法把卷 %s 設為只讀: %s\n", volume->target, strerror(errno));
+            ret = -1;
+        }
+        if (target_fd != -1) close(target_fd);
+    }
+    close(root_fd);
+    return ret;
+}
+
+void volume_describe(const volume_t* volume, char* buf, size_t size) {
+    if (volume->type == VOLUME_TMPFS) {
+        snprintf(buf, size, "tmpfs:%s:%ldM", volume->target, volume->size_mb);
+    } else {
+        snprintf(buf, size, "%s:%s:%s", volume->source, volume->target, volume->read_only ? "ro" : "rw");
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef VOLUME_H
+#define VOLUME_H
+
+#include <stddef.h>
+
+// 每個容器最多的卷數量
+#define MAX_VOLUMES 16
+
+// 未指定大小時 tmpfs 卷的上限
+#define TMPFS_DEFAULT_SIZE_MB 64
+
+// 卷類型
+typedef enum {
+    VOLUME_BIND = 0,           // 主機目錄或文件的 bind mount，不經過 overlay
+    VOLUME_TMPFS               // 有大小上限的 tmpfs，容器退出時消失
+} volume_type_t;
+
+// 掛載到容器中的卷
+typedef struct {
+    volume_type_t type;
+    char source[512];          // 主機上的絕對路徑（tmpfs 卷為空）
+    char target[256];          // 容器內的絕對路徑
+    int read_only;             // 是否以只讀方式掛載
+    long size_mb;              // tmpfs 卷的大小上限
+    int is_dir;                // 來源是否為目錄（決定掛載點創建為目錄還是文件）
+} volume_t;
+
+/**
+ * 解析 -v 參數（host:container[:ro|rw]）
+ * 主機路徑不存在時創建為目錄（擁有者為真實用戶，容器內的 root 可寫入）
+ * @param spec 參數字串
+ * @param volume 輸出的卷
+ * @return 0 成功，-1 格式錯誤或主機路徑無法使用
+ */
+int volume_parse_bind(const char* spec, volume_t* volume);
+
+/**
+ * 解析 --tmpfs 參數（container[:大小MB]）
+ * @param spec 參數字串
+ * @param volume 輸出的卷
+ * @return 0 成功，-1 格式錯誤
+ */
+int volume_parse_tmpfs(const char* spec, volume_t* volume);
+
+/**
+ * 在 chroot 之前把卷掛載到容器的根目錄下
+ * 掛載點在容器根目錄之內解析（容器中的符號連結不會指向主機的路徑），不存在時自動創建
+ * @param container_root 容器根目錄（主機上的路徑）
+ * @param volume 卷
+ * @return 0 成功，-1 失敗
+ */
+int volume_mount(const char* container_root, const volume_t* volume);
+
+/**
+ * 以 "source:target:ro" 的形式描述卷（用於輸出）
+ * @param volume 卷
+ * @param buf 輸出緩衝區
+ * @param size 緩衝區大小
+ */
+void volume_describe(const volume_t* volume, char* buf, size_t size);
+
+#endif // VOLUME_H